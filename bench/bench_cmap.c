@@ -0,0 +1,192 @@
+/* Contention benchmark for the concurrent map: lookup throughput with a
+   growing number of reader threads while one writer keeps updating, compared
+   to an ac_map behind a reader-writer lock and behind a mutex. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <ac/meta.h>
+#include <ac/cmap.h>
+
+#define KEYS           4096
+#define READERS_MAX    8
+#define RUN_SECONDS    0.5
+#define WRITE_PAUSE_NS 10000
+
+static uint64_t int_hash(const int *key) {
+    return (uint64_t)*key;
+}
+
+static bool int_eq(const int *a, const int *b) {
+    return *a == *b;
+}
+
+AC_CMAP_DECLARE(int_cmap, int, int, int_hash, int_eq);
+AC_CMAP_DEFINE(int_cmap, int, int, int_hash, int_eq);
+
+AC_MAP_DECLARE(int_map, int, int, int_hash, int_eq);
+AC_MAP_DEFINE(int_map, int, int, int_hash, int_eq);
+
+typedef enum bench_kind_e {
+    BENCH_CMAP,
+    BENCH_RWLOCK,
+    BENCH_MUTEX
+} bench_kind_t;
+
+static bench_kind_t kind;
+static bool done;
+
+static int_cmap_t cmap;
+static int_map_t map;
+static pthread_rwlock_t rwlock;
+static pthread_mutex_t mutex;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static bool lookup(int key, int *val) {
+    switch (kind) {
+        case BENCH_CMAP:
+            return int_cmap_get(&cmap, key, val);
+
+        case BENCH_RWLOCK: {
+            pthread_rwlock_rdlock(&rwlock);
+            int *found = int_map_get(&map, key);
+            if (found) {
+                *val = *found;
+            }
+            pthread_rwlock_unlock(&rwlock);
+            return found != NULL;
+        }
+
+        case BENCH_MUTEX: {
+            pthread_mutex_lock(&mutex);
+            int *found = int_map_get(&map, key);
+            if (found) {
+                *val = *found;
+            }
+            pthread_mutex_unlock(&mutex);
+            return found != NULL;
+        }
+    }
+    return false;
+}
+
+static void update(int key, int val) {
+    switch (kind) {
+        case BENCH_CMAP:
+            int_cmap_set(&cmap, key, val);
+            break;
+
+        case BENCH_RWLOCK:
+            pthread_rwlock_wrlock(&rwlock);
+            int_map_set(&map, key, val);
+            pthread_rwlock_unlock(&rwlock);
+            break;
+
+        case BENCH_MUTEX:
+            pthread_mutex_lock(&mutex);
+            int_map_set(&map, key, val);
+            pthread_mutex_unlock(&mutex);
+            break;
+    }
+}
+
+static void *reader(void *arg) {
+    unsigned seed  = (unsigned)(uintptr_t)arg + 1;
+    uint64_t reads = 0;
+    int sink       = 0;
+
+    while (!__atomic_load_n(&done, __ATOMIC_RELAXED)) {
+        for (int i = 0; i < 256; i++) {
+            seed = seed * 1103515245u + 12345u;
+            int val;
+            if (lookup((int)((seed >> 8) % KEYS), &val)) {
+                sink += val;
+            }
+        }
+        reads += 256;
+    }
+
+    if (sink == 42) {
+        putchar(' ');
+    }
+    return (void *)(uintptr_t)reads;
+}
+
+static void *writer(void *arg) {
+    (void)arg;
+    struct timespec pause = {0, WRITE_PAUSE_NS};
+    int key               = 0;
+
+    while (!__atomic_load_n(&done, __ATOMIC_RELAXED)) {
+        update(key, key);
+        key = (key + 1) % KEYS;
+        nanosleep(&pause, NULL);
+    }
+    return NULL;
+}
+
+static double bench(bench_kind_t bench_kind, int readers) {
+    kind = bench_kind;
+    done = false;
+
+    pthread_t threads[READERS_MAX], writer_thread;
+
+    for (intptr_t i = 0; i < readers; i++) {
+        pthread_create(&threads[i], NULL, reader, (void *)i);
+    }
+    pthread_create(&writer_thread, NULL, writer, NULL);
+
+    double start = now();
+    struct timespec tick = {0, 10000000};
+    while (now() - start < RUN_SECONDS) {
+        nanosleep(&tick, NULL);
+    }
+    __atomic_store_n(&done, true, __ATOMIC_RELAXED);
+
+    uint64_t reads = 0;
+    for (int i = 0; i < readers; i++) {
+        void *result;
+        pthread_join(threads[i], &result);
+        reads += (uint64_t)(uintptr_t)result;
+    }
+    pthread_join(writer_thread, NULL);
+
+    return (double)reads / (now() - start) / 1e6;
+}
+
+int main(void) {
+    int_cmap_new(&cmap);
+    int_map_new(&map);
+    pthread_rwlock_init(&rwlock, NULL);
+    pthread_mutex_init(&mutex, NULL);
+
+    for (int i = 0; i < KEYS; i++) {
+        int_cmap_set(&cmap, i, i);
+        int_map_set(&map, i, i);
+    }
+
+    printf("Lookups per second (millions), one writer updating every "
+           "%d us.\n\n",
+           WRITE_PAUSE_NS / 1000);
+    printf("%-8s %10s %10s %10s\n", "readers", "cmap", "rwlock", "mutex");
+
+    for (int readers = 1; readers <= READERS_MAX; readers *= 2) {
+        printf("%-8d %10.2f %10.2f %10.2f\n", readers,
+               bench(BENCH_CMAP, readers), bench(BENCH_RWLOCK, readers),
+               bench(BENCH_MUTEX, readers));
+    }
+
+    int_cmap_free(&cmap);
+    int_map_free(&map);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,112 @@
+/* Benchmark for ac_string_hash: speed per key length and distribution
+   quality on username-like keys, compared to the byte-wise FNV-1a it
+   replaced. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <ac/str.h>
+
+static uint64_t fnv1a(const void *data, size_t len) {
+    const unsigned char *p = data;
+    uint64_t hash          = 14695981039346656037ull;
+
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void bench_speed(const char *name,
+                        uint64_t (*hash)(const void *, size_t)) {
+    static const size_t lens[] = {4, 8, 16, 32, 64, 256, 1024};
+    char buf[1024];
+    memset(buf, 'x', sizeof buf);
+
+    printf("%-8s", name);
+    for (size_t l = 0; l < sizeof lens / sizeof lens[0]; l++) {
+        size_t iters = (size_t)(1 << 26) / (lens[l] + 16);
+        uint64_t sink = 0;
+
+        double start = now();
+        for (size_t i = 0; i < iters; i++) {
+            /* Feed the previous result back in to serialize the calls. */
+            buf[0] = (char)sink;
+            sink += hash(buf, lens[l]);
+        }
+        double secs = now() - start;
+
+        printf(" %6.2f", (double)(iters * lens[l]) / secs / 1e9);
+        if (sink == 42) {
+            putchar(' ');
+        }
+    }
+    printf("   GB/s\n");
+}
+
+/* Chi-square of N sequential usernames over B buckets taken from the low
+   bits, as an open-addressing table would. Close to B is good. */
+static void bench_quality(const char *name,
+                          uint64_t (*hash)(const void *, size_t)) {
+    enum { B = 1024, N = 1 << 20 };
+    static unsigned counts[B];
+    memset(counts, 0, sizeof counts);
+
+    char key[32];
+    for (unsigned i = 0; i < N; i++) {
+        int len = snprintf(key, sizeof key, "user%u", i);
+        counts[hash(key, (size_t)len) & (B - 1)]++;
+    }
+
+    double expected = (double)N / B, chi = 0;
+    for (unsigned i = 0; i < B; i++) {
+        double d = counts[i] - expected;
+        chi += d * d / expected;
+    }
+
+    /* Avalanche: flipping one input bit should flip half the output. */
+    unsigned flips = 0, trials = 0;
+    for (unsigned i = 0; i < 4096; i++) {
+        int len    = snprintf(key, sizeof key, "user%u", i);
+        uint64_t h = hash(key, (size_t)len);
+
+        for (int bit = 0; bit < len * 8; bit++) {
+            key[bit / 8] ^= (char)(1 << (bit % 8));
+            uint64_t d = h ^ hash(key, (size_t)len);
+            key[bit / 8] ^= (char)(1 << (bit % 8));
+
+            for (; d; d &= d - 1) {
+                flips++;
+            }
+            trials++;
+        }
+    }
+
+    printf("%-8s chi2 %8.1f (buckets %d)   avalanche %.3f (ideal 0.5)\n",
+           name, chi, B, (double)flips / trials / 64);
+}
+
+int main(void) {
+    ac_string_hash_init();
+
+    printf("speed    %6s %6s %6s %6s %6s %6s %6s\n", "4B", "8B", "16B",
+           "32B", "64B", "256B", "1KB");
+    bench_speed("fnv1a", fnv1a);
+    bench_speed("ac", ac_hash_bytes);
+
+    printf("\n");
+    bench_quality("fnv1a", fnv1a);
+    bench_quality("ac", ac_hash_bytes);
+
+    return EXIT_SUCCESS;
+}
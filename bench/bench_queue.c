@@ -0,0 +1,170 @@
+/* Throughput benchmark for the ring queues: elements moved per second from
+   producer threads to one consumer, for the SPSC queue with several batch
+   sizes, the MPSC queue with a growing number of producers, and a ring
+   behind a mutex as the baseline. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include <ac/meta.h>
+
+#define QUEUE_CAP     1024
+#define ITEMS         (1 << 22)
+#define PRODUCERS_MAX 4
+#define BATCH_MAX     64
+
+typedef enum bench_kind_e {
+    BENCH_SPSC,
+    BENCH_MPSC,
+    BENCH_MUTEX
+} bench_kind_t;
+
+static bench_kind_t kind;
+static size_t batch;
+static int producers;
+
+static ac_spsc(uint64_t) spsc;
+static ac_mpsc(uint64_t) mpsc;
+
+/* Baseline: the SPSC ring's slots and indices, guarded by a mutex. */
+static pthread_mutex_t mutex;
+static ac_spsc(uint64_t) locked;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static size_t push(const uint64_t *items, size_t n) {
+    switch (kind) {
+        case BENCH_SPSC:
+            return ac_spsc_push_n(spsc, items, n);
+
+        case BENCH_MPSC:
+            return ac_mpsc_push_n(mpsc, items, n);
+
+        case BENCH_MUTEX: {
+            pthread_mutex_lock(&mutex);
+            size_t pushed = ac_spsc_push_n(locked, items, n);
+            pthread_mutex_unlock(&mutex);
+            return pushed;
+        }
+    }
+    return 0;
+}
+
+static size_t pop(uint64_t *items, size_t n) {
+    switch (kind) {
+        case BENCH_SPSC:
+            return ac_spsc_pop_n(spsc, items, n);
+
+        case BENCH_MPSC:
+            return ac_mpsc_pop_n(mpsc, items, n);
+
+        case BENCH_MUTEX: {
+            pthread_mutex_lock(&mutex);
+            size_t popped = ac_spsc_pop_n(locked, items, n);
+            pthread_mutex_unlock(&mutex);
+            return popped;
+        }
+    }
+    return 0;
+}
+
+static void *producer(void *arg) {
+    (void)arg;
+    uint64_t items[BATCH_MAX];
+    size_t total = ITEMS / (size_t)producers;
+
+    for (size_t i = 0; i < BATCH_MAX; i++) {
+        items[i] = i;
+    }
+
+    for (size_t sent = 0; sent < total;) {
+        size_t n      = total - sent < batch ? total - sent : batch;
+        size_t pushed = push(items, n);
+
+        if (pushed == 0) {
+            sched_yield();
+        }
+        sent += pushed;
+    }
+    return NULL;
+}
+
+static double bench(bench_kind_t bench_kind, size_t bench_batch,
+                    int bench_producers) {
+    kind      = bench_kind;
+    batch     = bench_batch;
+    producers = bench_producers;
+
+    pthread_t threads[PRODUCERS_MAX];
+    double start = now();
+
+    for (intptr_t i = 0; i < producers; i++) {
+        pthread_create(&threads[i], NULL, producer, (void *)i);
+    }
+
+    uint64_t items[BATCH_MAX];
+    size_t total  = ITEMS / (size_t)producers * (size_t)producers;
+    uint64_t sink = 0;
+
+    for (size_t received = 0; received < total;) {
+        size_t n = pop(items, batch);
+
+        if (n == 0) {
+            sched_yield();
+        }
+        for (size_t i = 0; i < n; i++) {
+            sink += items[i];
+        }
+        received += n;
+    }
+
+    for (int i = 0; i < producers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    if (sink == 42) {
+        putchar(' ');
+    }
+    return (double)total / (now() - start) / 1e6;
+}
+
+int main(void) {
+    ac_spsc_new(spsc, QUEUE_CAP);
+    ac_mpsc_new(mpsc, QUEUE_CAP);
+    ac_spsc_new(locked, QUEUE_CAP);
+    pthread_mutex_init(&mutex, NULL);
+
+    printf("Elements per second (millions) through a queue of %d.\n\n",
+           QUEUE_CAP);
+
+    printf("One producer:\n");
+    printf("%-8s %10s %10s %10s\n", "batch", "spsc", "mpsc", "mutex");
+
+    for (size_t n = 1; n <= BATCH_MAX; n *= 4) {
+        printf("%-8zu %10.2f %10.2f %10.2f\n", n, bench(BENCH_SPSC, n, 1),
+               bench(BENCH_MPSC, n, 1), bench(BENCH_MUTEX, n, 1));
+    }
+
+    printf("\nBatches of 16:\n");
+    printf("%-8s %10s %10s\n", "writers", "mpsc", "mutex");
+
+    for (int n = 1; n <= PRODUCERS_MAX; n *= 2) {
+        printf("%-8d %10.2f %10.2f\n", n, bench(BENCH_MPSC, 16, n),
+               bench(BENCH_MUTEX, 16, n));
+    }
+
+    ac_spsc_free(spsc);
+    ac_mpsc_free(mpsc);
+    ac_spsc_free(locked);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,154 @@
+#ifndef AC_ACCOUNTS_H
+#define AC_ACCOUNTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include <ac/kdf.h>
+#include <ac/meta.h>
+#include <ac/str.h>
+
+/* -------------------------------------------------------------------------
+   Account store.
+   Registered names and their password hashes, in an open-addressing hash
+   table kept in a file mapped into memory: a header page followed by the
+   slots, a power of two of them. Lookups probe the mapped slots directly,
+   and an account is added by writing its slot in place, so the store needs
+   no loading and no saving. A sync thread then msync()s the page of the
+   slot and the header, so the event loop never waits on the disk. Accounts
+   are never removed, so probing stops at the first free slot.
+
+   The table is grown on the sync thread, by writing a copy with twice the
+   slots beside the file, syncing it, renaming it over the file and syncing
+   the directory, so a crash leaves one complete table or the other.
+   Accounts added meanwhile go into both tables, and the event loop switches
+   to the copy on the next ac_accounts_poll(). Names are hashed with a seed
+   kept in the header, drawn when the file is created.
+   ------------------------------------------------------------------------- */
+
+/** @brief Size of the header in front of the slots, one page. */
+#define AC_ACCOUNTS_HEADER 4096
+
+/** @brief Slots of a new store. */
+#define AC_ACCOUNTS_SLOTS 1024
+
+/** @brief Longest name, in bytes, and length of a salt. */
+#define AC_ACCOUNT_NAME_MAX 64
+#define AC_ACCOUNT_SALT     16
+
+typedef struct ac_accounts_header_s {
+    uint64_t magic;
+    uint64_t slots;
+    uint64_t len;
+    uint64_t seed;
+} ac_accounts_header_t;
+
+/** @brief A slot, 128 bytes. */
+typedef struct ac_account_s {
+    /** @brief Length of the name, 0 for a free slot. Written last. */
+    uint8_t name_len;
+    uint8_t reserved[3];
+    /** @brief PBKDF2 iterations the hash was derived with. */
+    uint32_t iterations;
+    /** @brief Milliseconds since the epoch. */
+    uint64_t created_ms;
+    char name[AC_ACCOUNT_NAME_MAX];
+    unsigned char salt[AC_ACCOUNT_SALT];
+    unsigned char hash[AC_SHA256_LEN];
+} ac_account_t;
+
+/** @brief A mapped store file. */
+typedef struct ac_accounts_table_s {
+    /** @brief The file, or -1 for none. */
+    int fd;
+    ac_accounts_header_t *hdr;
+    ac_account_t *slots;
+} ac_accounts_table_t;
+
+/** @brief A slot written and not yet synced, and the header of its table. */
+typedef struct ac_accounts_dirty_s {
+    ac_accounts_header_t *hdr;
+    ac_account_t *slot;
+} ac_accounts_dirty_t;
+
+typedef enum ac_accounts_grow_e {
+    AC_ACCOUNTS_GROW_IDLE,
+    /** @brief Waiting for the sync thread. */
+    AC_ACCOUNTS_GROW_REQUESTED,
+    /** @brief Being written by the sync thread. */
+    AC_ACCOUNTS_GROW_RUNNING,
+    /** @brief Renamed over the file, to be switched to. */
+    AC_ACCOUNTS_GROW_DONE,
+    /** @brief Failed, retried on the next add. */
+    AC_ACCOUNTS_GROW_FAILED
+} ac_accounts_grow_t;
+
+typedef struct ac_accounts_s {
+    /** @brief The store file, or -1 when accounts are disabled. The table
+     * is switched by the event loop only. */
+    int fd;
+    char *path;
+    ac_accounts_header_t *hdr;
+    ac_account_t *slots;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    /** @brief Slots to sync, and whether to stop. Guarded by the lock, like
+     * the rest below. Slots are written under it as well. */
+    ac_arr(ac_accounts_dirty_t) dirty;
+    bool stop;
+    ac_accounts_grow_t grow;
+    /** @brief The grown table, once the sync thread has created it. */
+    ac_accounts_table_t grown;
+    /** @brief A table replaced by a grow, unmapped by the sync thread once
+     * its slots are synced. */
+    ac_accounts_table_t retired;
+} ac_accounts_t;
+
+/**
+ * @brief Open the store at PATH, creating it if needed, and start the sync
+ * thread.
+ *
+ * @return true on success. On failure, also when PATH is not a store, the
+ * accounts are left disabled and the file untouched.
+ */
+bool ac_accounts_open(ac_accounts_t *accounts, const char *path);
+
+/** @brief Sync every account added and close the store. */
+void ac_accounts_close(ac_accounts_t *accounts);
+
+/** @brief Switch to a table grown since the last call. Call once a tick. */
+void ac_accounts_poll(ac_accounts_t *accounts);
+
+/** @brief Whether the store is open. */
+bool ac_accounts_enabled(const ac_accounts_t *accounts);
+
+/** @brief Number of accounts. */
+size_t ac_accounts_len(const ac_accounts_t *accounts);
+
+/**
+ * @brief Find the account of a name.
+ *
+ * @return The account, valid until the next ac_accounts_add(), or NULL.
+ */
+const ac_account_t *ac_accounts_find(const ac_accounts_t *accounts,
+                                     ac_str_view_t name);
+
+/** @brief Outcome of ac_accounts_add(). */
+typedef enum ac_accounts_status_e {
+    AC_ACCOUNTS_ADDED,
+    /** @brief The name has an account already. */
+    AC_ACCOUNTS_EXISTS,
+    /** @brief The store is full until it has been grown. */
+    AC_ACCOUNTS_FULL
+} ac_accounts_status_t;
+
+/** @brief Add an account, starting to grow the store when it is 70% full.
+ */
+ac_accounts_status_t ac_accounts_add(ac_accounts_t *accounts,
+                                     const ac_account_t *account);
+
+#endif
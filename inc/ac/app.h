@@ -2,53 +2,370 @@
 #define AC_APP_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <time.h>
 
+#include <ac/accounts.h>
+#include <ac/arena.h>
+#include <ac/auth.h>
+#include <ac/filter.h>
+#include <ac/history.h>
+#include <ac/intern.h>
 #include <ac/meta.h>
+#include <ac/msglog.h>
+#include <ac/names.h>
 #include <ac/net.h>
+#include <ac/pool.h>
+#include <ac/rate.h>
+#include <ac/search.h>
 #include <ac/str.h>
+#include <ac/token.h>
 
 typedef enum ac_state_e {
     AC_STATE_LOGIN,
+    /** @brief Asked for the password of a registered name. */
+    AC_STATE_PASSWORD,
+    /** @brief Waiting for a worker to check the password. Input waits in
+     * the buffer meanwhile. */
+    AC_STATE_VERIFY,
     AC_STATE_CHAT,
     AC_STATE_EXIT
 } ac_state_t;
 
+/** @brief Kinds of input limited separately. */
+typedef enum ac_rate_class_e {
+    AC_RATE_CHAT,
+    AC_RATE_COMMAND,
+    AC_RATE_WHISPER,
+    AC_RATE_CLASSES
+} ac_rate_class_t;
+
+/** @brief Lines a second and burst size allowed per user and kind. */
+#define AC_RATE_CHAT_PER_SEC    5
+#define AC_RATE_CHAT_BURST      10
+#define AC_RATE_COMMAND_PER_SEC 5
+#define AC_RATE_COMMAND_BURST   10
+#define AC_RATE_WHISPER_PER_SEC 2
+#define AC_RATE_WHISPER_BURST   5
+
+/** @brief Strikes, i.e. lines over the limit, answered by delaying the line.
+ * Strikes beyond drop the line, and strikes beyond AC_RATE_DROP_STRIKES
+ * disconnect the user. */
+#define AC_RATE_DELAY_STRIKES 5
+#define AC_RATE_DROP_STRIKES  20
+
+/** @brief Milliseconds without a strike after which strikes are forgiven.
+ */
+#define AC_RATE_FORGIVE_MS 10000
+
+extern const ac_rate_limit_t ac_rate_limits[AC_RATE_CLASSES];
+
 typedef struct ac_user_s {
     ac_client_handle_t handle;
+    /** @brief Output queue of the user's client, valid as long as the
+     * client. */
+    ac_bytes_t *out;
     ac_state_t state;
-    ac_string_t username;
+    /** @brief Interned username, AC_ATOM_NONE until logged in. */
+    ac_atom_t username;
+    /** @brief Position in the chat member table, AC_MEMBER_NONE while not
+     * in the chat state. */
+    size_t member;
+
+    struct {
+        ac_bucket_t buckets[AC_RATE_CLASSES];
+        /** @brief Strikes since the last forgiveness. */
+        uint32_t strikes;
+        uint64_t last_strike;
+        /** @brief Input is not read before this time. */
+        uint64_t resume_at;
+        /** @brief Lines delayed and dropped over the session. */
+        uint64_t delayed;
+        uint64_t dropped;
+    } rate;
+
+    /** @brief Password checks and registration. */
+    struct {
+        /** @brief Registered name being logged in to, AC_ATOM_NONE outside
+         * the password states. */
+        ac_atom_t name;
+        /** @brief Ticket of the job in flight, 0 if none. */
+        uint64_t ticket;
+        /** @brief Wrong passwords entered on this connection. */
+        uint32_t failures;
+    } auth;
+
+    /** @brief Resumption of the session after its connection drops. */
+    struct {
+        /** @brief Token that resumes the session, AC_TOKEN_NONE if it may
+         * not be resumed. */
+        ac_token_t token;
+        /** @brief Whether the connection dropped and the session waits to
+         * be resumed, out being NULL meanwhile. */
+        bool parked;
+        uint64_t parked_at;
+        /** @brief Chat history position when the session was parked. */
+        uint64_t history_head;
+        /** @brief Whispers received while parked, NULL while not parked,
+         * and the number that did not fit in AC_SESSION_MISSED_BYTES. */
+        ac_bytes_t missed;
+        size_t missed_dropped;
+    } session;
 } ac_user_t;
 
-typedef ac_map(ac_client_handle_t, ac_user_t *) ac_handle_to_user_ptr_map_t;
-typedef ac_map(ac_string_t, ac_user_t *) ac_string_to_user_ptr_map_t;
+/** @brief Member position of a user outside the chat. */
+#define AC_MEMBER_NONE SIZE_MAX
+
+/**
+ * @brief Users in the chat state, as parallel arrays.
+ *
+ * A broadcast sweeps the handles and output queues front to back without
+ * touching the user objects or the client map. Members are unordered, so
+ * adding appends and removing moves the last member into the hole, both in
+ * O(1).
+ */
+typedef struct ac_members_s {
+    ac_arr(ac_user_t *) users;
+    ac_arr(ac_client_handle_t) handles;
+    ac_arr(ac_bytes_t *) outs;
+} ac_members_t;
+
+/** @brief Seconds between refreshes of the rendered server uptime. */
+#define AC_UPTIME_REFRESH 60
+
+/**
+ * @brief A response kept rendered between requests.
+ *
+ * The text is sent as is until the app's render generation moves past the
+ * generation it was rendered at.
+ */
+typedef struct ac_rendered_s {
+    ac_bytes_t text;
+    uint64_t gen;
+} ac_rendered_t;
+
+/** @brief Names a presence notice lists before summing up the rest. */
+#define AC_PRESENCE_NAMES 3
+
+/** @brief Joins and leaves per window above which they are announced as a
+ * digest once per window instead. */
+#define AC_PRESENCE_DIGEST_RATE 20
+#define AC_PRESENCE_WINDOW_MS   10000
+
+/** @brief Ring file keeping recent chat lines across restarts, and its
+ * capacity in bytes. */
+#define AC_HISTORY_PATH "history.ring"
+#define AC_HISTORY_SIZE (1024 * 1024)
+
+/** @brief Lines, and bytes at most, replayed to a user joining the chat. */
+#define AC_HISTORY_REPLAY_LINES 20
+#define AC_HISTORY_REPLAY_BYTES (4 * 1024)
+
+/** @brief Milliseconds a session waits to be resumed after its connection
+ * drops, and the most sessions waiting at once. */
+#define AC_SESSION_GRACE_MS   60000
+#define AC_SESSION_PARKED_MAX AC_CLIENTS_MAX
+
+/** @brief Bytes of whispers kept for a waiting session, and bytes of chat
+ * history at most replayed when it is resumed. */
+#define AC_SESSION_MISSED_BYTES (4 * 1024)
+#define AC_SESSION_REPLAY_BYTES (16 * 1024)
+
+/** @brief File of the account store. */
+#define AC_ACCOUNTS_PATH "accounts.db"
+
+/** @brief Threads hashing passwords, and PBKDF2 iterations of new
+ * password hashes. */
+#define AC_AUTH_WORKERS   4
+#define AC_KDF_ITERATIONS 100000
+
+/** @brief Shortest password, in bytes, and wrong passwords after which a
+ * connection is closed. */
+#define AC_PASSWORD_MIN   6
+#define AC_LOGIN_ATTEMPTS 3
+
+/** @brief Directory of the durable log of every chat line and whisper. */
+#define AC_MSGLOG_DIR "msglog"
+
+/** @brief Pattern file of the content filter, reloaded when it changes. */
+#define AC_FILTER_PATH "filter.txt"
+
+/** @brief Number of users allocated at once by the user pool. */
+#define AC_USERS_PER_SLAB 16
+
+/** @brief Initial size of the per-tick scratch arena. */
+#define AC_SCRATCH_SIZE (64 * 1024)
+
+AC_MAP_DECLARE(ac_user_handle_map, ac_client_handle_t, ac_user_t *,
+               ac_handle_hash, ac_handle_eq);
+AC_MAP_DECLARE(ac_user_name_map, ac_atom_t, ac_user_t *, ac_atom_hash,
+               ac_atom_eq);
+AC_MAP_DECLARE(ac_user_token_map, ac_token_t, ac_user_t *, ac_token_hash,
+               ac_token_eq);
 
 typedef struct ac_app_s {
     ac_server_t server;
 
     struct {
         /** @brief Maps user handles to user pointers. */
-        ac_handle_to_user_ptr_map_t from_handle;
+        ac_user_handle_map_t from_handle;
         /** @brief Maps usernames to user pointers. */
-        ac_string_to_user_ptr_map_t from_username;
+        ac_user_name_map_t from_username;
+        /** @brief Usernames of logged in users in byte order. */
+        ac_name_index_t by_name;
+        /** @brief Storage for user objects. */
+        ac_pool_t pool;
+        /** @brief Users in the chat state. */
+        ac_members_t members;
     } users;
 
+    /**
+     * @brief Sessions whose connection dropped, waiting to be resumed.
+     *
+     * A parked user keeps its name and stays listed, but is out of the
+     * chat member table. Sessions wait the same grace period, so the order
+     * they were parked in is the order they expire in.
+     */
+    struct {
+        ac_user_token_map_t by_token;
+        /** @brief Tokens in the order parked, from head on. Tokens of
+         * sessions resumed meanwhile are skipped. */
+        ac_arr(ac_token_t) queue;
+        size_t head;
+    } parked;
+
+    /** @brief Registered names and their password hashes. */
+    ac_accounts_t accounts;
+
+    /** @brief Workers hashing passwords, and the last ticket handed out to
+     * a job. */
+    ac_auth_t auth;
+    uint64_t auth_ticket;
+
+    /** @brief Recent chat lines. */
+    ac_history_t history;
+
+    /** @brief Every chat line and whisper, kept for good. */
+    ac_msglog_t msglog;
+
+    /** @brief Index of recent chat lines for /search. */
+    ac_search_t search;
+
+    /** @brief Patterns chat lines are checked against. */
+    ac_filter_watch_t filter;
+
+    /** @brief Joins and leaves collected over a tick and announced together
+     * at its end. */
+    struct {
+        ac_arr(ac_atom_t) joined;
+        ac_arr(ac_atom_t) left;
+        /** @brief Start of the current window and the changes in it. */
+        uint64_t window_start;
+        size_t window_changes;
+        /** @brief Whether changes are summed up in a digest, and the counts
+         * for the next one. */
+        bool digest;
+        size_t digest_joined;
+        size_t digest_left;
+    } presence;
+
+    /** @brief Monotonic milliseconds, sampled once at the start of every
+     * ac_app_update(). */
+    uint64_t now;
+    /** @brief Milliseconds since the epoch, sampled along with now. */
+    uint64_t wall_ms;
+
     /** @brief Application start time, used for calculating uptime when a user
      * connects. */
     time_t app_start_time;
+
+    /** @brief Responses that only change when users come and go. */
+    struct {
+        /** @brief Bumped by ac_app_touch() when anything they show changes.
+         */
+        uint64_t gen;
+        /** @brief Server uptime text and when it was last refreshed. */
+        char uptime[64];
+        time_t uptime_at;
+        ac_rendered_t greeting;
+        ac_rendered_t info;
+        /** @brief Pages of the unfiltered /list, rendered on request. */
+        ac_arr(ac_rendered_t) list_pages;
+    } rendered;
+
+    /** @brief Scratch memory for temporaries that live at most one tick.
+     * Reset at the end of every ac_app_update(). */
+    ac_arena_t scratch;
 } ac_app_t;
 
 void ac_user_new(ac_user_t *user, ac_app_t *app, ac_client_handle_t handle);
 void ac_user_free(ac_user_t *user);
-void ac_user_update(ac_user_t *user, ac_app_t *app, ac_bytes_t *in);
+void ac_user_update(ac_user_t *user, ac_app_t *app, ac_input_t *in);
+
+void ac_members_new(ac_members_t *members);
+void ac_members_free(ac_members_t *members);
+void ac_members_add(ac_members_t *members, ac_user_t *user, ac_bytes_t *out);
+void ac_members_remove(ac_members_t *members, ac_user_t *user);
 
 void ac_app_new(ac_app_t *app);
 void ac_app_free(ac_app_t *app);
 void ac_app_update(ac_app_t *app);
 
+/** @brief Milliseconds until a tick has timed work to do with no client
+ * connected, or -1 if it has none. */
+int ac_app_idle_timeout(const ac_app_t *app);
+void ac_app_touch(ac_app_t *app);
+
+/** @brief Forget a user for good once it left the handle map and the chat
+ * member table: release its name, announce its leaving and free it. */
+void ac_app_remove_user(ac_app_t *app, ac_user_t *user);
+
+void ac_presence_join(ac_app_t *app, ac_atom_t name);
+void ac_presence_leave(ac_app_t *app, ac_atom_t name);
+
+/** @brief Append a message to the message log, to be committed at the end of
+ * the tick. TO is AC_ATOM_NONE for chat lines. */
+void ac_app_record(ac_app_t *app, ac_msg_kind_t kind, ac_atom_t from,
+                   ac_atom_t to, ac_str_view_t text);
+
+/** @brief Give a logged in user a new session token and show it to them.
+ */
+void ac_session_issue(ac_user_t *user, ac_app_t *app);
+
+/**
+ * @brief Park the session of a user whose connection dropped, once it left
+ * the handle map and the chat member table.
+ *
+ * @return false if the session may not be resumed, in which case the user
+ * is to be removed.
+ */
+bool ac_session_park(ac_user_t *user, ac_app_t *app);
+
+/** @brief Handle a "/resume <token>" line of a user logging in. */
+void ac_session_resume(ac_user_t *user, ac_app_t *app, ac_str_view_t line);
+
+/**
+ * @brief Keep a whisper to a parked user for when it comes back.
+ *
+ * @return false if the whisper did not fit.
+ */
+bool ac_session_keep(ac_user_t *user, ac_atom_t from, ac_str_view_t msg);
+
+/** @brief Remove parked sessions past their grace period, or beyond
+ * AC_SESSION_PARKED_MAX. */
+void ac_session_expire(ac_app_t *app);
+
+/** @brief When the oldest parked session expires, or UINT64_MAX if none is
+ * parked. */
+uint64_t ac_session_deadline(const ac_app_t *app);
+
 void ac_state_new(ac_user_t *user, ac_app_t *app);
 void ac_state_free(ac_user_t *user, ac_app_t *app);
-void ac_state_update(ac_user_t *user, ac_app_t *app, ac_bytes_t *in);
+void ac_state_update(ac_user_t *user, ac_app_t *app, ac_input_t *in);
 void ac_state_switch(ac_user_t *user, ac_app_t *app, ac_state_t state);
 
+/** @brief Act on the result of a password job the user submitted. */
+void ac_state_auth_done(ac_user_t *user, ac_app_t *app,
+                        const ac_auth_result_t *result);
+
 #endif
@@ -0,0 +1,69 @@
+#ifndef AC_ARENA_H
+#define AC_ARENA_H
+
+#include <stddef.h>
+
+#include <ac/meta.h>
+
+/** @brief Alignment of every arena allocation. */
+#define AC_ARENA_ALIGN 16
+
+/**
+ * @brief Bump-pointer scratch arena.
+ *
+ * Allocations are carved out of one chunk and released all at once by
+ * ac_arena_reset(). Freeing or growing the most recent allocation is done in
+ * place. When a chunk runs out it is retired and replaced by one twice as
+ * large, so after warming up a steady workload causes no heap traffic.
+ */
+typedef struct ac_arena_s {
+    /** @brief Allocator interface backed by this arena, for use with
+     * ac_arr_new_a() and ac_map_new_a(). */
+    ac_allocator_t allocator;
+
+    /** @brief Current chunk. */
+    unsigned char *buf;
+    /** @brief Bytes used in the current chunk. */
+    size_t len;
+    /** @brief Size of the current chunk. */
+    size_t cap;
+
+    /** @brief Outgrown chunks, freed on the next reset. */
+    void *retired;
+
+    /** @brief Highest offset reached in any chunk, in bytes. */
+    size_t high_water;
+} ac_arena_t;
+
+/**
+ * @brief Create an arena.
+ *
+ * @param arena The arena to initialize.
+ * @param cap The initial chunk size in bytes.
+ */
+void ac_arena_new(ac_arena_t *arena, size_t cap);
+
+/**
+ * @brief Free all memory owned by an arena.
+ *
+ * @param arena The arena to free.
+ */
+void ac_arena_free(ac_arena_t *arena);
+
+/**
+ * @brief Allocate from an arena.
+ *
+ * @param arena The arena to allocate from.
+ * @param size The number of bytes.
+ * @return Memory aligned to AC_ARENA_ALIGN, valid until the next reset.
+ */
+void *ac_arena_alloc(ac_arena_t *arena, size_t size);
+
+/**
+ * @brief Release every allocation made since the last reset.
+ *
+ * @param arena The arena to reset.
+ */
+void ac_arena_reset(ac_arena_t *arena);
+
+#endif
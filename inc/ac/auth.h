@@ -0,0 +1,107 @@
+#ifndef AC_AUTH_H
+#define AC_AUTH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include <ac/accounts.h>
+#include <ac/kdf.h>
+#include <ac/meta.h>
+
+/* -------------------------------------------------------------------------
+   Password worker pool.
+   Password hashing is slow on purpose, so it runs on worker threads and the
+   event loop only hands jobs over and picks results up. Jobs wait in a ring
+   under a mutex, which workers sleep on; results come back through a
+   lock-free queue the event loop polls once per tick. At most
+   AC_AUTH_QUEUE_MAX jobs are in flight, which bounds both, so a burst of
+   logins is turned away rather than queued without limit.
+   ------------------------------------------------------------------------- */
+
+/** @brief Most jobs submitted and not yet polled. */
+#define AC_AUTH_QUEUE_MAX 64
+
+/** @brief Longest password, in bytes. */
+#define AC_PASSWORD_MAX 128
+
+typedef enum ac_auth_op_e {
+    /** @brief Check a password against a hash. */
+    AC_AUTH_VERIFY,
+    /** @brief Draw a salt and hash a new password. */
+    AC_AUTH_DERIVE
+} ac_auth_op_t;
+
+typedef struct ac_auth_job_s {
+    ac_auth_op_t op;
+    /** @brief Opaque to the pool, handed back with the result. */
+    uint64_t owner;
+    uint64_t ticket;
+    uint32_t iterations;
+    /** @brief For AC_AUTH_VERIFY, the salt and hash to check against. */
+    unsigned char salt[AC_ACCOUNT_SALT];
+    unsigned char hash[AC_SHA256_LEN];
+    size_t password_len;
+    char password[AC_PASSWORD_MAX];
+} ac_auth_job_t;
+
+typedef struct ac_auth_result_s {
+    ac_auth_op_t op;
+    uint64_t owner;
+    uint64_t ticket;
+    /** @brief Whether the password matched, or a hash was derived. */
+    bool ok;
+    /** @brief For AC_AUTH_DERIVE, the new salt and hash. */
+    uint32_t iterations;
+    unsigned char salt[AC_ACCOUNT_SALT];
+    unsigned char hash[AC_SHA256_LEN];
+} ac_auth_result_t;
+
+typedef struct ac_auth_s {
+    pthread_t *threads;
+    size_t workers;
+
+    /** @brief Jobs from head to tail, AC_AUTH_QUEUE_MAX slots. Guarded by
+     * lock. */
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    ac_auth_job_t *jobs;
+    size_t head;
+    size_t tail;
+    bool stop;
+
+    ac_mpsc(ac_auth_result_t) results;
+
+    /** @brief Jobs submitted and not yet polled. Event loop only. */
+    size_t in_flight;
+} ac_auth_t;
+
+/**
+ * @brief Start a pool of WORKERS threads.
+ *
+ * @return true on success. On failure no worker is left running, and the
+ * pool turns every job away.
+ */
+bool ac_auth_new(ac_auth_t *auth, size_t workers);
+
+/** @brief Stop the workers, waiting for the jobs they are running. Does
+ * nothing for a pool stopped already. */
+void ac_auth_free(ac_auth_t *auth);
+
+/**
+ * @brief Hand a job to the workers. The password is wiped from JOB.
+ *
+ * @return false if AC_AUTH_QUEUE_MAX jobs are in flight, or the pool is not
+ * running.
+ */
+bool ac_auth_submit(ac_auth_t *auth, ac_auth_job_t *job);
+
+/**
+ * @brief Take finished jobs' results.
+ *
+ * @return The number of results written to RESULTS, at most MAX.
+ */
+size_t ac_auth_poll(ac_auth_t *auth, ac_auth_result_t *results, size_t max);
+
+#endif
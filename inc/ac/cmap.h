@@ -0,0 +1,303 @@
+#ifndef AC_CMAP_H
+#define AC_CMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include <ac/meta.h>
+
+/* -------------------------------------------------------------------------
+   Concurrent read-mostly hash map.
+   Keys are spread over AC_CMAP_STRIPES stripes, each holding an immutable
+   open-addressing table. Readers load a stripe's table and search it
+   without locks or retries, so lookups are wait-free. Writers lock only
+   their stripe, build a modified copy of its table and publish it. Replaced
+   tables are freed once no reader that could still see them remains, which
+   is tracked with epochs.
+   ------------------------------------------------------------------------- */
+
+/** @brief Number of independently locked stripes, a power of two. */
+#define AC_CMAP_STRIPES 16
+
+/** @brief Most threads that can be inside a read section at once. */
+#define AC_EPOCH_THREADS_MAX 64
+
+/* -------------------------------------------------------------------------
+   Epoch-based reclamation.
+   ------------------------------------------------------------------------- */
+
+/**
+ * @brief Enter a read section. Memory retired after this call is not freed
+ * until the matching ac_epoch_exit(). Read sections must not nest.
+ */
+void ac_epoch_enter(void);
+
+/** @brief Leave a read section. */
+void ac_epoch_exit(void);
+
+/** @brief Header of every stripe table, also linking retired tables. */
+typedef struct ac_cmap_hdr_s {
+    struct ac_cmap_hdr_s *next;
+    /** @brief Epoch the table was retired in. */
+    uint64_t epoch;
+    /** @brief Number of slots, a power of two. */
+    size_t cap;
+    /** @brief Number of entries. */
+    size_t len;
+} ac_cmap_hdr_t;
+
+/**
+ * @brief Retire a table that has just been unpublished and free every
+ * retired table that no reader can still hold.
+ *
+ * @param retired The list of tables waiting to be freed.
+ * @param table The table to retire, may be NULL.
+ */
+void ac_cmap_retire(ac_cmap_hdr_t **retired, ac_cmap_hdr_t *table);
+
+/** @brief Free every retired table. No reader may be active. */
+void ac_cmap_reclaim_all(ac_cmap_hdr_t **retired);
+
+/** @brief A stripe: the published table plus the writer lock. */
+typedef struct ac_cmap_stripe_s {
+    pthread_mutex_t lock;
+    /** @brief Current table, loaded and stored atomically. */
+    ac_cmap_hdr_t *table;
+    /** @brief Replaced tables not yet freed. */
+    ac_cmap_hdr_t *retired;
+} AC_CACHE_ALIGNED ac_cmap_stripe_t;
+
+/** @brief Stripe of a mixed hash. The top bits pick the stripe and the low
+ * bits the slot, so the two stay independent. */
+static inline size_t ac_cmap_stripe_of(uint64_t h) {
+    return (size_t)(h >> 60) & (AC_CMAP_STRIPES - 1);
+}
+
+/** @brief Slots needed for N entries at no more than 1/2 load. */
+static inline size_t ac_cmap_cap_for(size_t n) {
+    size_t cap = 8;
+    while (cap < n * 2) {
+        cap *= 2;
+    }
+    return cap;
+}
+
+/**
+ * @brief Declare a concurrent map NAME##_t from K to V with the functions
+ * NAME##_new, NAME##_free, NAME##_get, NAME##_contains, NAME##_len,
+ * NAME##_set, NAME##_remove and NAME##_visit.
+ *
+ * Lookups copy the value out, since the table it was found in may be freed
+ * once the read section ends. Values should therefore be small, such as
+ * pointers or handles.
+ */
+#define AC_CMAP_DECLARE(NAME, K, V, HASH, EQ)                                 \
+    typedef struct NAME##_slot_s {                                            \
+        K key;                                                                \
+        V val;                                                                \
+        bool used;                                                            \
+    } NAME##_slot_t;                                                          \
+                                                                              \
+    typedef struct NAME##_table_s {                                           \
+        ac_cmap_hdr_t hdr;                                                    \
+        NAME##_slot_t slots[];                                                \
+    } NAME##_table_t;                                                         \
+                                                                              \
+    typedef struct NAME##_s {                                                 \
+        ac_cmap_stripe_t stripes[AC_CMAP_STRIPES];                            \
+        /** @brief Number of entries, updated by writers. */                  \
+        size_t len;                                                           \
+    } NAME##_t;                                                               \
+                                                                              \
+    void NAME##_new(NAME##_t *map);                                           \
+    void NAME##_free(NAME##_t *map);                                          \
+    bool NAME##_set(NAME##_t *map, K key, V val);                             \
+    bool NAME##_remove(NAME##_t *map, K key);                                 \
+                                                                              \
+    /** @brief Find KEY in a table, returning its slot or NULL. */            \
+    static inline const NAME##_slot_t *NAME##_find(                           \
+        const NAME##_table_t *table, const K *key, uint64_t hash) {           \
+        size_t mask = table->hdr.cap - 1;                                     \
+                                                                              \
+        /* Tables are never full, so an unused slot ends every probe. */      \
+        for (size_t i = (size_t)hash & mask;; i = (i + 1) & mask) {           \
+            if (!table->slots[i].used) {                                      \
+                return NULL;                                                  \
+            }                                                                 \
+            if (EQ(&table->slots[i].key, key)) {                              \
+                return &table->slots[i];                                      \
+            }                                                                 \
+        }                                                                     \
+    }                                                                         \
+                                                                              \
+    /** @brief Copy the value of KEY into VAL. Wait-free. */                  \
+    static inline bool NAME##_get(NAME##_t *map, K key, V *val) {             \
+        uint64_t hash = ac_map_mix(HASH(&key));                               \
+        ac_cmap_stripe_t *stripe = &map->stripes[ac_cmap_stripe_of(hash)];    \
+                                                                              \
+        ac_epoch_enter();                                                     \
+                                                                              \
+        const NAME##_table_t *table = (const NAME##_table_t *)                \
+            __atomic_load_n(&stripe->table, __ATOMIC_SEQ_CST);                \
+        const NAME##_slot_t *slot = NAME##_find(table, &key, hash);           \
+                                                                              \
+        if (slot && val) {                                                    \
+            *val = slot->val;                                                 \
+        }                                                                     \
+                                                                              \
+        ac_epoch_exit();                                                      \
+        return slot != NULL;                                                  \
+    }                                                                         \
+                                                                              \
+    static inline bool NAME##_contains(NAME##_t *map, K key) {                \
+        return NAME##_get(map, key, NULL);                                    \
+    }                                                                         \
+                                                                              \
+    /** @brief Number of entries, possibly stale while writers run. */       \
+    static inline size_t NAME##_len(NAME##_t *map) {                          \
+        return __atomic_load_n(&map->len, __ATOMIC_RELAXED);                  \
+    }                                                                         \
+                                                                              \
+    /** @brief Call FN for every entry. Each stripe is seen as of some      \
+     * moment during the call; entries may change between stripes. */        \
+    static inline void NAME##_visit(NAME##_t *map,                            \
+                                    void (*fn)(void *ctx, K key, V val),      \
+                                    void *ctx) {                              \
+        ac_epoch_enter();                                                     \
+                                                                              \
+        for (size_t s = 0; s < AC_CMAP_STRIPES; s++) {                        \
+            const NAME##_table_t *table = (const NAME##_table_t *)            \
+                __atomic_load_n(&map->stripes[s].table, __ATOMIC_SEQ_CST);    \
+                                                                              \
+            for (size_t i = 0; i < table->hdr.cap; i++) {                     \
+                if (table->slots[i].used) {                                   \
+                    fn(ctx, table->slots[i].key, table->slots[i].val);        \
+                }                                                             \
+            }                                                                 \
+        }                                                                     \
+                                                                              \
+        ac_epoch_exit();                                                      \
+    }                                                                         \
+                                                                              \
+    /* Redeclared so that the invocation ends with a semicolon. */            \
+    void NAME##_new(NAME##_t *map)
+
+/** @brief Emit the writer side of a map declared with AC_CMAP_DECLARE. Use
+ * in exactly one source file. */
+#define AC_CMAP_DEFINE(NAME, K, V, HASH, EQ)                                  \
+    static NAME##_table_t *NAME##_table_new(size_t cap) {                     \
+        NAME##_table_t *table =                                               \
+            calloc(1, sizeof(NAME##_table_t) + cap * sizeof(NAME##_slot_t));  \
+        assert(table);                                                        \
+        table->hdr.cap = cap;                                                 \
+        return table;                                                         \
+    }                                                                         \
+                                                                              \
+    static void NAME##_table_put(NAME##_table_t *table, const K *key,         \
+                                 const V *val, uint64_t hash) {               \
+        size_t mask = table->hdr.cap - 1;                                     \
+        size_t i    = (size_t)hash & mask;                                    \
+                                                                              \
+        while (table->slots[i].used) {                                        \
+            i = (i + 1) & mask;                                               \
+        }                                                                     \
+                                                                              \
+        table->slots[i].key  = *key;                                          \
+        table->slots[i].val  = *val;                                          \
+        table->slots[i].used = true;                                          \
+        table->hdr.len++;                                                     \
+    }                                                                         \
+                                                                              \
+    /* Copy TABLE leaving out SKIP, with room for EXTRA more entries. */      \
+    static NAME##_table_t *NAME##_table_copy(const NAME##_table_t *table,     \
+                                             const NAME##_slot_t *skip,       \
+                                             size_t extra) {                  \
+        NAME##_table_t *copy =                                                \
+            NAME##_table_new(ac_cmap_cap_for(table->hdr.len + extra));        \
+                                                                              \
+        for (size_t i = 0; i < table->hdr.cap; i++) {                         \
+            const NAME##_slot_t *slot = &table->slots[i];                     \
+            if (slot->used && slot != skip) {                                 \
+                NAME##_table_put(copy, &slot->key, &slot->val,                \
+                                 ac_map_mix(HASH(&slot->key)));               \
+            }                                                                 \
+        }                                                                     \
+                                                                              \
+        return copy;                                                          \
+    }                                                                         \
+                                                                              \
+    /* Publish NEXT in place of the stripe's table. The lock must be held. */ \
+    static void NAME##_publish(ac_cmap_stripe_t *stripe,                      \
+                               NAME##_table_t *next) {                        \
+        ac_cmap_hdr_t *prev = stripe->table;                                  \
+        __atomic_store_n(&stripe->table, &next->hdr, __ATOMIC_SEQ_CST);       \
+        ac_cmap_retire(&stripe->retired, prev);                               \
+    }                                                                         \
+                                                                              \
+    void NAME##_new(NAME##_t *map) {                                          \
+        for (size_t s = 0; s < AC_CMAP_STRIPES; s++) {                        \
+            pthread_mutex_init(&map->stripes[s].lock, NULL);                  \
+            map->stripes[s].table   = &NAME##_table_new(8)->hdr;              \
+            map->stripes[s].retired = NULL;                                   \
+        }                                                                     \
+        map->len = 0;                                                         \
+    }                                                                         \
+                                                                              \
+    /* No other thread may use the map any more. */                           \
+    void NAME##_free(NAME##_t *map) {                                         \
+        for (size_t s = 0; s < AC_CMAP_STRIPES; s++) {                        \
+            ac_cmap_reclaim_all(&map->stripes[s].retired);                    \
+            free(map->stripes[s].table);                                      \
+            pthread_mutex_destroy(&map->stripes[s].lock);                     \
+        }                                                                     \
+    }                                                                         \
+                                                                              \
+    /* Insert or replace. Returns whether the key is new. */                  \
+    bool NAME##_set(NAME##_t *map, K key, V val) {                            \
+        uint64_t hash = ac_map_mix(HASH(&key));                               \
+        ac_cmap_stripe_t *stripe = &map->stripes[ac_cmap_stripe_of(hash)];    \
+                                                                              \
+        pthread_mutex_lock(&stripe->lock);                                    \
+                                                                              \
+        const NAME##_table_t *table = (const NAME##_table_t *)stripe->table;  \
+        const NAME##_slot_t *slot   = NAME##_find(table, &key, hash);         \
+                                                                              \
+        NAME##_table_t *next = NAME##_table_copy(table, slot, 1);             \
+        NAME##_table_put(next, &key, &val, hash);                             \
+        NAME##_publish(stripe, next);                                         \
+                                                                              \
+        if (!slot) {                                                          \
+            __atomic_add_fetch(&map->len, 1, __ATOMIC_RELAXED);               \
+        }                                                                     \
+                                                                              \
+        pthread_mutex_unlock(&stripe->lock);                                  \
+        return slot == NULL;                                                  \
+    }                                                                         \
+                                                                              \
+    /* Returns whether the key was present. */                                \
+    bool NAME##_remove(NAME##_t *map, K key) {                                \
+        uint64_t hash = ac_map_mix(HASH(&key));                               \
+        ac_cmap_stripe_t *stripe = &map->stripes[ac_cmap_stripe_of(hash)];    \
+                                                                              \
+        pthread_mutex_lock(&stripe->lock);                                    \
+                                                                              \
+        const NAME##_table_t *table = (const NAME##_table_t *)stripe->table;  \
+        const NAME##_slot_t *slot   = NAME##_find(table, &key, hash);         \
+                                                                              \
+        if (slot) {                                                           \
+            NAME##_publish(stripe, NAME##_table_copy(table, slot, 0));        \
+            __atomic_sub_fetch(&map->len, 1, __ATOMIC_RELAXED);               \
+        }                                                                     \
+                                                                              \
+        pthread_mutex_unlock(&stripe->lock);                                  \
+        return slot != NULL;                                                  \
+    }                                                                         \
+                                                                              \
+    /* Redeclared so that the invocation ends with a semicolon. */            \
+    void NAME##_new(NAME##_t *map)
+
+#endif
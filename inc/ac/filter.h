@@ -0,0 +1,180 @@
+#ifndef AC_FILTER_H
+#define AC_FILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include <ac/meta.h>
+#include <ac/str.h>
+
+/* -------------------------------------------------------------------------
+   Content filter.
+   A list of patterns, each with an action, compiled into an Aho-Corasick
+   automaton, so a line is checked against every pattern in one pass over
+   its bytes. Pattern files hold one pattern per line after its action:
+
+       # Comment
+       mask darn
+       drop spam.example.com
+       flag free money
+
+   Patterns match anywhere in a line, ignoring ASCII case.
+
+   The automaton is a dense DFA over byte classes: bytes no pattern uses
+   share class 0, and every other byte, with upper case folded to lower,
+   gets a class of its own. Transitions are one flat array of rows, one row
+   of classes per state, holding the offset of the target row, so a step is
+   a class lookup and one load. The top bit of an offset marks states where
+   a pattern ends, the only ones whose actions are looked up.
+   ------------------------------------------------------------------------- */
+
+/** @brief How often the pattern file is checked for changes. */
+#define AC_FILTER_CHECK_MS 2000
+
+/** @brief Longest pattern accepted. */
+#define AC_FILTER_PATTERN_MAX 1024
+
+/** @brief Marks transition targets where a pattern ends. */
+#define AC_FILTER_HIT 0x80000000u
+
+/** @brief Actions, as bits of the set a line triggers. */
+typedef enum ac_filter_action_e {
+    /** @brief Replace the matching bytes with asterisks. */
+    AC_FILTER_MASK = 1 << 0,
+    /** @brief Do not deliver the line. */
+    AC_FILTER_DROP = 1 << 1,
+    /** @brief Deliver the line but log it for review. */
+    AC_FILTER_FLAG = 1 << 2
+} ac_filter_action_t;
+
+typedef struct ac_filter_out_s {
+    /** @brief Actions of the patterns ending in this state. */
+    unsigned actions;
+    /** @brief Length of the longest masked pattern ending here. */
+    uint32_t mask_len;
+} ac_filter_out_t;
+
+typedef struct ac_filter_s {
+    uint8_t cls[256];
+    uint32_t classes;
+    /** @brief Transitions, classes entries per state, starting with the
+     * root. */
+    ac_arr(uint32_t) next;
+    /** @brief Per state. */
+    ac_arr(ac_filter_out_t) out;
+    size_t patterns;
+} ac_filter_t;
+
+/** @brief Create a filter without patterns. */
+void ac_filter_new(ac_filter_t *filter);
+void ac_filter_free(ac_filter_t *filter);
+
+/**
+ * @brief Compile a pattern list.
+ *
+ * @param filter Set to the new filter on success.
+ * @param text The pattern list, in the format above.
+ * @param len Length of the text.
+ * @param bad_line Set to the number of the first malformed line on failure.
+ * @return true on success.
+ */
+bool ac_filter_compile(ac_filter_t *filter, const char *text, size_t len,
+                       size_t *bad_line);
+
+/**
+ * @brief Find the actions a line triggers.
+ *
+ * @return The actions, 0 if the line matches no pattern.
+ */
+unsigned ac_filter_scan(const ac_filter_t *filter, ac_str_view_t line);
+
+/**
+ * @brief Copy a line with every match of a masked pattern replaced by
+ * asterisks.
+ *
+ * @param filter The filter.
+ * @param line The line.
+ * @param out Where to write the line, at least line.len bytes.
+ */
+void ac_filter_mask(const ac_filter_t *filter, ac_str_view_t line,
+                    char *out);
+
+/**
+ * @brief A filter loaded from a file and reloaded when the file changes.
+ *
+ * The file is compiled on a thread of its own, and the new filter replaces
+ * the active one on the next poll once it is ready, so the event loop never
+ * waits for a reload. A file that fails to compile leaves the active filter
+ * in place.
+ */
+typedef struct ac_filter_watch_s {
+    char *path;
+    /** @brief The filter in use. Event loop only. */
+    ac_filter_t *active;
+
+    /** @brief When the file was last checked and what it looked like. */
+    uint64_t checked_at;
+    bool present;
+    struct timespec mtime;
+    off_t size;
+
+    /** @brief Whether a reload thread is running, and whether it is done. */
+    bool loading;
+    pthread_t thread;
+    AC_ATOMIC(bool) done;
+    /** @brief Result of the reload, valid once done: the new filter, or NULL
+     * and the error. Reload thread until done. */
+    ac_filter_t *loaded;
+    size_t bad_line;
+} ac_filter_watch_t;
+
+/** @brief Outcome of ac_filter_watch_poll(). */
+typedef enum ac_filter_reload_e {
+    AC_FILTER_UNCHANGED,
+    AC_FILTER_RELOADED,
+    /** @brief The file could not be read. */
+    AC_FILTER_UNREADABLE,
+    /** @brief The file has a malformed line, see bad_line. */
+    AC_FILTER_MALFORMED,
+    /** @brief No reload thread could be started. The reload is retried on
+     * the next check. */
+    AC_FILTER_NO_THREAD
+} ac_filter_reload_t;
+
+/**
+ * @brief Start watching a pattern file, loading it right away.
+ *
+ * @param watch The watch.
+ * @param path The pattern file.
+ * @param now Monotonic milliseconds.
+ * @return AC_FILTER_RELOADED, or why the file was not loaded, in which case
+ * the filter starts without patterns.
+ */
+ac_filter_reload_t ac_filter_watch_new(ac_filter_watch_t *watch,
+                                       const char *path, uint64_t now);
+
+/** @brief Stop watching, waiting for a running reload. */
+void ac_filter_watch_free(ac_filter_watch_t *watch);
+
+/** @brief When ac_filter_watch_poll() next checks the file, which also picks
+ * up a reload still running. */
+uint64_t ac_filter_watch_deadline(const ac_filter_watch_t *watch);
+
+/**
+ * @brief Swap in a finished reload, or start one if the file changed and
+ * AC_FILTER_CHECK_MS passed since the last check. A missing file counts as
+ * one without patterns.
+ *
+ * @param watch The watch.
+ * @param now Monotonic milliseconds.
+ * @return What happened to a finished reload, AC_FILTER_UNCHANGED if none
+ * finished.
+ */
+ac_filter_reload_t ac_filter_watch_poll(ac_filter_watch_t *watch,
+                                        uint64_t now);
+
+#endif
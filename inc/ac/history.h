@@ -0,0 +1,93 @@
+#ifndef AC_HISTORY_H
+#define AC_HISTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <ac/str.h>
+
+/* -------------------------------------------------------------------------
+   Chat history ring.
+   Recent lines live in a fixed-size file mapped into memory: a header page
+   followed by a ring of bytes. Lines are stored exactly as sent, ending in
+   CRLF, so ranges are copied to a client's output queue as they are. They
+   are copied rather than sent with sendfile(): the kernel would keep
+   referring to the page cache until the client reads them, and the ring
+   may have been written over by then. Positions are logical byte counts
+   since the ring was created; the byte at position P is at ring offset
+   P % capacity, and only the last capacity bytes are kept. Lines carry no
+   LF of their own, so line starts are found by scanning back for LF.
+   ------------------------------------------------------------------------- */
+
+/** @brief Size of the header in front of the ring, one page. */
+#define AC_HISTORY_HEADER 4096
+
+typedef struct ac_history_header_s {
+    uint64_t magic;
+    uint64_t cap;
+    /** @brief Bytes ever appended, i.e. the position of the next byte. */
+    uint64_t head;
+} ac_history_header_t;
+
+typedef struct ac_history_s {
+    /** @brief The ring file, or -1 when history is disabled. */
+    int fd;
+    ac_history_header_t *hdr;
+    unsigned char *ring;
+} ac_history_t;
+
+/** @brief Lines between two logical positions. */
+typedef struct ac_history_range_s {
+    uint64_t start;
+    uint64_t end;
+} ac_history_range_t;
+
+/**
+ * @brief Open the ring file at PATH, creating it or starting it over if it
+ * was made with another capacity.
+ *
+ * @param history The history to open.
+ * @param path Path of the ring file.
+ * @param cap Capacity of the ring in bytes.
+ * @return true on success. On failure the history is left disabled.
+ */
+bool ac_history_open(ac_history_t *history, const char *path, size_t cap);
+void ac_history_close(ac_history_t *history);
+
+/** @brief Whether the history is open. */
+bool ac_history_enabled(const ac_history_t *history);
+
+/**
+ * @brief Append a line made of COUNT parts, followed by CRLF.
+ *
+ * Lines longer than a quarter of the ring are not kept.
+ */
+void ac_history_append(ac_history_t *history, const ac_str_view_t *parts,
+                       size_t count);
+
+/**
+ * @brief Find up to LINES complete lines, ending SKIP lines before the
+ * newest one, and spanning no more than MAX_BYTES.
+ *
+ * @return The range, empty if there are no such lines.
+ */
+ac_history_range_t ac_history_lines(const ac_history_t *history,
+                                    size_t skip, size_t lines,
+                                    size_t max_bytes);
+
+/**
+ * @brief Take the next contiguous piece of a range off its front.
+ *
+ * A range wraps around the end of the ring at most once, so it comes in at
+ * most two pieces. They stay valid until the next append.
+ *
+ * @param history The history.
+ * @param range The range, advanced past the piece.
+ * @param data Set to the bytes of the piece in the ring.
+ * @return Length of the piece, 0 once the range is empty.
+ */
+size_t ac_history_piece(const ac_history_t *history, ac_history_range_t *range,
+                        const unsigned char **data);
+
+#endif
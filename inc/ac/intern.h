@@ -0,0 +1,64 @@
+#ifndef AC_INTERN_H
+#define AC_INTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <ac/str.h>
+
+/* -------------------------------------------------------------------------
+   Global string intern pool.
+   Interned strings are identified by 4-byte atoms. Equal strings always get
+   the same atom, so comparing strings becomes comparing atoms, and every
+   atom carries its string hash computed once on interning. Atoms are
+   reference counted and their ids are recycled once released.
+   ------------------------------------------------------------------------- */
+
+typedef uint32_t ac_atom_t;
+
+/** @brief The atom of the empty string. Never released. */
+#define AC_ATOM_NONE 0
+
+/** @brief Expand to the arguments of a "%.*s" conversion for an atom. */
+#define ac_atom_fmt_args(A) (int)ac_atom_len(A), ac_atom_data(A)
+
+/**
+ * @brief Intern a string, taking a reference to its atom.
+ *
+ * @param data The bytes of the string.
+ * @param len The number of bytes.
+ * @return The atom, to be released with ac_atom_release().
+ */
+ac_atom_t ac_intern(const char *data, size_t len);
+
+/**
+ * @brief Find the atom of a string without interning it.
+ *
+ * @param data The bytes of the string.
+ * @param len The number of bytes.
+ * @return The atom, or AC_ATOM_NONE if the string is not interned.
+ */
+ac_atom_t ac_intern_find(const char *data, size_t len);
+
+/** @brief Take another reference to an atom. */
+void ac_atom_retain(ac_atom_t atom);
+
+/** @brief Drop a reference to an atom, freeing it when none are left. */
+void ac_atom_release(ac_atom_t atom);
+
+/** @brief Get the bytes of an atom. Not NUL-terminated and only valid until
+ * the next call to ac_intern(). */
+const char *ac_atom_data(ac_atom_t atom);
+
+/** @brief Get the length of an atom. */
+size_t ac_atom_len(ac_atom_t atom);
+
+/** @brief Precomputed hash of an atom for use as a map key. Equal to
+ * ac_string_hash() of its bytes. */
+uint64_t ac_atom_hash(const ac_atom_t *atom);
+
+/** @brief Compare two atoms for use as map keys. */
+bool ac_atom_eq(const ac_atom_t *a, const ac_atom_t *b);
+
+#endif
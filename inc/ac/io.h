@@ -10,14 +10,49 @@
 
 #define AC_COMMAND_PREFIX '/'
 
+/** @brief What to do with input lines that are not well-formed UTF-8. */
+#define AC_INPUT_UTF8_POLICY AC_UTF8_REPLACE
+
+/** @brief Number of users shown per page of /list. */
+#define AC_LIST_PAGE_SIZE 20
+
+/** @brief Number of chat lines shown per page of /history. */
+#define AC_HISTORY_PAGE_SIZE 20
+
+/** @brief Number of lines shown per page of /search, and the most lines a
+ * search returns. */
+#define AC_SEARCH_PAGE_SIZE   10
+#define AC_SEARCH_MAX_RESULTS 50
+
+/** @brief Number of candidates /who shows when a prefix is ambiguous. */
+#define AC_WHO_SUGGESTIONS 5
+
+/** @brief Bounds of a username, in code points. */
+#define AC_USERNAME_MIN 2
+#define AC_USERNAME_MAX 16
+
 /**
  * @brief Consume and sanitize a line of input.
  *
- * @param line The line to store the sanitized input.
- * @param in The input string to sanitize.
+ * Only bytes not scanned by a previous call are searched for a line end.
+ * The line is sanitized in place according to AC_INPUT_UTF8_POLICY and
+ * returned as a view into the input buffer, valid until the next call or
+ * until more data is received. A rejected line is consumed and counted in
+ * the input's rejected lines instead.
+ *
+ * @param line Set to the sanitized line, without the line end.
+ * @param in The input to take the line from.
  * @return true if a complete line was consumed, false otherwise.
  */
-bool ac_get_line(ac_string_t *line, ac_string_t *in);
+bool ac_get_line(ac_str_view_t *line, ac_input_t *in);
+
+/**
+ * @brief Put the last line from ac_get_line() back, to be handed out again
+ * by the next call.
+ *
+ * @param in The input the line came from.
+ */
+void ac_unget_line(ac_input_t *in);
 
 /**
  * @brief Prompt the user for input.
@@ -38,6 +73,48 @@ typedef enum ac_print_type_e {
     AC_PRINT_INTERRUPT
 } ac_print_type_t;
 
+/**
+ * @brief A message written piece by piece straight into a user's output
+ * queue.
+ *
+ * Every piece is appended in place, so nothing is staged on the way and a
+ * message has no length limit. Start with ac_write_begin() and close with
+ * ac_write_end(), which adds the newline and the prompt.
+ */
+typedef struct ac_writer_s {
+    ac_bytes_t *out;
+} ac_writer_t;
+
+/**
+ * @brief Start a message, on a fresh line for AC_PRINT_INTERRUPT.
+ *
+ * @param user The user to write to.
+ * @param action The print action type.
+ * @return The writer for the message.
+ */
+ac_writer_t ac_write_begin(const ac_user_t *user, ac_print_type_t action);
+
+/** @brief Write raw bytes. */
+void ac_write_bytes(ac_writer_t *w, const void *data, size_t len);
+
+/** @brief Write a NUL-terminated string. */
+void ac_write_str(ac_writer_t *w, const char *str);
+
+/** @brief Write a string view. */
+void ac_write_view(ac_writer_t *w, ac_str_view_t view);
+
+/** @brief Write a username. */
+void ac_write_name(ac_writer_t *w, ac_atom_t name);
+
+/** @brief Write an unsigned integer in decimal. */
+void ac_write_uint(ac_writer_t *w, size_t value);
+
+/** @brief Write formatted text, formatting in place. */
+void ac_write_fmt(ac_writer_t *w, const char *fmt, ...);
+
+/** @brief End a message with a newline and a prompt. */
+void ac_write_end(ac_writer_t *w);
+
 /** 
  * @brief Send formatted output to a user without inserting a newline or a prompt.
  *
@@ -69,6 +146,21 @@ void ac_send(const ac_user_t *user, ac_app_t *app, const char *msg);
 void ac_print_fmt(const ac_user_t *user, ac_app_t *app, ac_print_type_t action,
                   const char *fmt, ...);
 
+/**
+ * @brief Print formatted output to every chat member but one, as with
+ * AC_PRINT_INTERRUPT.
+ *
+ * The output is formatted once and appended to each member's output queue
+ * in a single sweep over the chat member table.
+ *
+ * @param app The application context.
+ * @param except The user to leave out, or NULL.
+ * @param fmt The format string.
+ * @param ... The values to format.
+ */
+void ac_broadcast_fmt(ac_app_t *app, const ac_user_t *except,
+                      const char *fmt, ...);
+
 /** 
  * @brief Print a message to a user.
  *
@@ -83,10 +175,34 @@ void ac_print(const ac_user_t *user, ac_app_t *app, ac_print_type_t action,
 /**
  * @brief Validate a username.
  *
+ * A username is well-formed UTF-8 of AC_USERNAME_MIN to AC_USERNAME_MAX code
+ * points, each of which passes ac_utf8_name_char().
+ *
  * @param username The username to validate.
  * @return true if the username is valid, false otherwise.
  */
-bool ac_validate_username(const ac_string_t username);
+bool ac_validate_username(ac_str_view_t username);
+
+/**
+ * @brief Send the login greeting.
+ *
+ * The greeting is rendered once and shared until the user count or the
+ * uptime it shows changes.
+ *
+ * @param user The user to send the greeting to.
+ * @param app The application context.
+ */
+void ac_send_greeting(const ac_user_t *user, ac_app_t *app);
+
+/**
+ * @brief Send lines of chat history, copied out of the ring.
+ *
+ * @param user The user to send the lines to.
+ * @param app The application context.
+ * @param range The lines, from ac_history_lines().
+ */
+void ac_send_history(const ac_user_t *user, ac_app_t *app,
+                     ac_history_range_t range);
 
 /** 
  * @brief Check if a line is a command.
@@ -94,7 +210,16 @@ bool ac_validate_username(const ac_string_t username);
  * @param line The line to check.
  * @return true if the line is a command, false otherwise.
  */
-bool ac_is_command(const ac_string_t line);
+bool ac_is_command(ac_str_view_t line);
+
+/**
+ * @brief Tell which rate limit a line counts against.
+ *
+ * @param line The line.
+ * @return AC_RATE_WHISPER for whispers, AC_RATE_COMMAND for other commands
+ * and AC_RATE_CHAT for chat lines.
+ */
+ac_rate_class_t ac_rate_class(ac_str_view_t line);
 
 /** 
  * @brief Handle a command from the user.
@@ -103,6 +228,6 @@ bool ac_is_command(const ac_string_t line);
  * @param app The application context.
  * @param line The command line to handle.
  */
-void ac_handle_command(ac_user_t *user, ac_app_t *app, const ac_string_t line);
+void ac_handle_command(ac_user_t *user, ac_app_t *app, ac_str_view_t line);
 
 #endif
@@ -0,0 +1,48 @@
+#ifndef AC_KDF_H
+#define AC_KDF_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* -------------------------------------------------------------------------
+   Password hashing.
+   PBKDF2 with HMAC-SHA-256 (RFC 8018), slow on purpose: every guess at a
+   password costs the guesser one derivation. The HMAC keyed with the
+   password is set up once, so each iteration is two SHA-256 compressions.
+   ------------------------------------------------------------------------- */
+
+#define AC_SHA256_LEN   32
+#define AC_SHA256_BLOCK 64
+
+typedef struct ac_sha256_s {
+    uint32_t h[8];
+    /** @brief Bytes hashed so far. */
+    uint64_t len;
+    unsigned char buf[AC_SHA256_BLOCK];
+} ac_sha256_t;
+
+void ac_sha256_init(ac_sha256_t *ctx);
+void ac_sha256_update(ac_sha256_t *ctx, const void *data, size_t len);
+void ac_sha256_final(ac_sha256_t *ctx, unsigned char out[AC_SHA256_LEN]);
+
+/**
+ * @brief Derive OUT_LEN bytes from a password with PBKDF2-HMAC-SHA-256.
+ *
+ * @param password The password.
+ * @param password_len Length of the password.
+ * @param salt The salt.
+ * @param salt_len Length of the salt.
+ * @param iterations Iterations, at least 1.
+ * @param out Where to write the derived key.
+ * @param out_len Length of the derived key.
+ */
+void ac_pbkdf2_sha256(const void *password, size_t password_len,
+                      const void *salt, size_t salt_len, uint32_t iterations,
+                      unsigned char *out, size_t out_len);
+
+/** @brief Compare two byte ranges in time independent of where they
+ * differ. */
+bool ac_kdf_equal(const void *a, const void *b, size_t len);
+
+#endif
@@ -1,6 +1,13 @@
 #ifndef AC_META_H
 #define AC_META_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
 /* -------------------------------------------------------------------------
    Macro metaprogramming.
    ------------------------------------------------------------------------- */
@@ -30,10 +37,40 @@
 /** @brief Iterate over a range of values. */
 #define ac_foreach(N, I) for (size_t I = 0; I < (N); I++)
 
+/* -------------------------------------------------------------------------
+   Pluggable allocators.
+   ------------------------------------------------------------------------- */
+
+/** @brief An allocator context that arrays and maps can be created with.
+ * A NULL allocator pointer means the C heap. */
+typedef struct ac_allocator_s {
+    /** @brief Resize PTR from OLD_SIZE to NEW_SIZE bytes. A NULL PTR
+     * allocates and a NEW_SIZE of 0 frees. */
+    void *(*resize)(void *ctx, void *ptr, size_t old_size, size_t new_size);
+    void *ctx;
+} ac_allocator_t;
+
+/** @brief Resize a block with an allocator, or the C heap if NULL. */
+static inline void *ac_realloc(const ac_allocator_t *alloc, void *ptr,
+                               size_t old_size, size_t new_size) {
+    if (alloc) {
+        return alloc->resize(alloc->ctx, ptr, old_size, new_size);
+    }
+
+    if (new_size == 0) {
+        free(ptr);
+        return NULL;
+    }
+
+    return realloc(ptr, new_size);
+}
+
 /* -------------------------------------------------------------------------
    Generic type-safe dynamic array.
-   Metadata about array length and capacity is stored at
-   indices -2 and -1 and array elements begin like normal at index 0.
+   Metadata about the allocator, array length and capacity is stored at
+   indices -3, -2 and -1 and array elements begin like normal at index 0.
+   Arrays remember the allocator they were created with, so growing and
+   freeing them needs no allocator argument.
    ------------------------------------------------------------------------- */
 
 #define ac_arr(T) T *
@@ -42,58 +79,73 @@ typedef ac_arr(unsigned char) ac_bytes_t;
 typedef ac_arr(int) ac_ints_t;
 typedef ac_arr(double) ac_doubles_t;
 
+/** @brief Number of metadata words stored before the first element. */
+#define AC_ARR_HEADER 3
+
+ac_static_assert(sizeof(void *) == sizeof(size_t),
+                 "Allocator pointer must fit in a metadata word.");
+
 /** @brief Get the length of an array. */
 #define ac_alen(A) ((size_t *)(A))[-2]
 /** @brief Get the capacity of an array. */
 #define ac_acap(A) ((size_t *)(A))[-1]
+/** @brief Get the allocator of an array, NULL for the C heap. */
+#define ac_aalloc(A) ((const ac_allocator_t **)(void *)(A))[-3]
+
+/** @brief Size in bytes of an array allocation with capacity N. */
+#define ac_arr_bytes(A, N)                                                    \
+    (AC_ARR_HEADER * sizeof(size_t) + (N) * sizeof((A)[0]))
 
 /** @brief Iterate over the elements of an array. */
 #define ac_arr_foreach(A, I) for (size_t I = 0; I < ac_alen(A); I++)
 
+/** @brief Create a new array with a specific capacity using an allocator.
+ */
+#define ac_arr_new_reserve_a(A, N, ALLOC)                                     \
+    do {                                                                      \
+        const ac_allocator_t *ac_uniq(alloc) = (ALLOC);                       \
+        size_t *ac_uniq(mem) =                                                \
+            ac_realloc(ac_uniq(alloc), NULL, 0, ac_arr_bytes(A, N));          \
+        assert(ac_uniq(mem));                                                 \
+        ac_generic_assign((A), ac_uniq(mem) + AC_ARR_HEADER);                 \
+        ac_aalloc(A) = ac_uniq(alloc);                                        \
+        ac_alen(A)   = 0;                                                     \
+        ac_acap(A)   = (N);                                                   \
+    } while (0)
+
+/** @brief Create a new empty array using an allocator. */
+#define ac_arr_new_a(A, ALLOC) ac_arr_new_reserve_a(A, 0, ALLOC)
+
+/** @brief Create a new array with a specific length using an allocator. */
+#define ac_arr_new_n_a(A, N, ALLOC)                                           \
+    do {                                                                      \
+        ac_arr_new_reserve_a(A, N, ALLOC);                                    \
+        ac_alen(A) = (N);                                                     \
+    } while (0)
+
 /** @brief Create a new empty array. */
-#define ac_arr_new(A)                                                         \
-    ac_generic_assign((A), (size_t *)(calloc(2, sizeof(size_t))) + 2);
+#define ac_arr_new(A) ac_arr_new_a(A, NULL)
 
 /** @brief Create a new array with a specific length. */
-#define ac_arr_new_n(A, N)                                                    \
-    do {                                                                      \
-        ac_generic_assign(                                                    \
-            (A),                                                              \
-            (size_t *)malloc(2 * sizeof(size_t) + (N) * sizeof((A)[0])) + 2); \
-        ac_alen(A) = ac_acap(A) = (N);                                        \
-    } while (0);
+#define ac_arr_new_n(A, N) ac_arr_new_n_a(A, N, NULL)
 
 /** @brief Create a new array with all elements initialized to zero. */
 #define ac_arr_new_n_zero(A, N)                                               \
     do {                                                                      \
-        ac_generic_assign(                                                    \
-            (A),                                                              \
-            (size_t *)calloc(1, 2 * sizeof(size_t) + (N) * sizeof((A)[0])) +  \
-                2);                                                           \
-        ac_alen(A) = ac_acap(A) = (N);                                        \
-    } while (0);
+        ac_arr_new_n(A, N);                                                   \
+        memset((A), 0, (N) * sizeof((A)[0]));                                 \
+    } while (0)
 
 /** @brief Create a new array with a specific length. */
-#define ac_arr_new_reserve(A, N)                                              \
-    do {                                                                      \
-        ac_generic_assign(                                                    \
-            (A),                                                              \
-            (size_t *)malloc(2 * sizeof(size_t) + (N) * sizeof((A)[0])) + 2); \
-        ac_alen(A) = 0;                                                       \
-        ac_acap(A) = (N);                                                     \
-    } while (0);
+#define ac_arr_new_reserve(A, N) ac_arr_new_reserve_a(A, N, NULL)
 
 /** @brief Create a new array with a specific length with all elements
  * initialized to zero. */
 #define ac_arr_new_reserve_zero(A, N)                                         \
     do {                                                                      \
-        ac_generic_assign(                                                    \
-            (A),                                                              \
-            (size_t *)calloc(1, 2 * sizeof(size_t) + (N) * sizeof((A)[0])) +  \
-                2);                                                           \
-        ac_alen(A) = 0;                                                       \
-        ac_acap(A) = (N);                                                     \
-    } while (0);
+        ac_arr_new_reserve(A, N);                                             \
+        memset((A), 0, (N) * sizeof((A)[0]));                                 \
+    } while (0)
 
 #if !defined(__SIZEOF_SIZE_T__) || __SIZEOF_SIZE_T__ == 8
 #define AC_ZEROES "\x00\x00\x00\x00\x00\x00"
@@ -116,27 +168,42 @@ typedef ac_arr(double) ac_doubles_t;
 #endif
 
 /** @brief Embed a string literal and its metadata in an array without using
- * heap memory. */
+ * heap memory. The allocator word is zero, i.e. NULL. */
 #define ac_arr_from_string_literal(A, L, LO, HI)                              \
     do {                                                                      \
         ac_static_assert(sizeof(L) - 1 == (((HI) << 8) | (LO)),               \
                          "Invalid length.");                                  \
-        ac_generic_assign((A), (ac_literal(LO, HI) ac_literal(LO, HI) L) +    \
-                                   2 * sizeof(size_t));                       \
+        ac_generic_assign((A), (ac_literal(0, 0) ac_literal(LO, HI)           \
+                                    ac_literal(LO, HI) L) +                   \
+                                   AC_ARR_HEADER * sizeof(size_t));           \
     } while (0)
 
 /** @brief Free the memory allocated for an array. */
-#define ac_arr_free(A) free(((size_t *)A) - 2);
+#define ac_arr_free(A)                                                        \
+    do {                                                                      \
+        ac_realloc(ac_aalloc(A), (size_t *)(A) - AC_ARR_HEADER,               \
+                   ac_arr_bytes(A, ac_acap(A)), 0);                           \
+    } while (0)
+
+/** @brief Internal macro for changing the capacity of an array. */
+#define ac_arr_set_cap(A, N)                                                  \
+    do {                                                                      \
+        size_t ac_uniq(new_cap) = (N);                                        \
+        size_t *ac_uniq(grown) =                                              \
+            ac_realloc(ac_aalloc(A), (size_t *)(A) - AC_ARR_HEADER,           \
+                       ac_arr_bytes(A, ac_acap(A)),                           \
+                       ac_arr_bytes(A, ac_uniq(new_cap)));                    \
+        assert(ac_uniq(grown));                                               \
+        ac_generic_assign((A), ac_uniq(grown) + AC_ARR_HEADER);               \
+        ac_acap(A) = ac_uniq(new_cap);                                        \
+    } while (0)
 
 /** @brief Resize an array to a new length. */
 #define ac_arr_resize(A, N)                                                   \
     do {                                                                      \
-        ac_generic_assign(                                                    \
-            (A),                                                              \
-            (size_t *)(realloc((size_t *)(A) - 2,                             \
-                               2 * sizeof(size_t) + (N) * sizeof((A)[0]))) +  \
-                2);                                                           \
-        ac_alen(A) = ac_acap(A) = (N);                                        \
+        size_t ac_uniq(len) = (N);                                            \
+        ac_arr_set_cap(A, ac_uniq(len));                                      \
+        ac_alen(A) = ac_uniq(len);                                            \
     } while (0)
 
 /** @brief Insert N uninitialized elements into an array at a specific index.
@@ -146,13 +213,7 @@ typedef ac_arr(double) ac_doubles_t;
         assert((I) <= ac_alen(A));                                            \
                                                                               \
         if (ac_alen(A) + (N) > ac_acap(A)) {                                  \
-            ac_acap(A) = (ac_alen(A) + (N)) * 2;                              \
-                                                                              \
-            ac_generic_assign(                                                \
-                (A), (size_t *)(realloc((size_t *)(A) - 2,                    \
-                                        2 * sizeof(size_t) +                  \
-                                            ac_acap(A) * sizeof((A)[0]))) +   \
-                         2);                                                  \
+            ac_arr_set_cap(A, (ac_alen(A) + (N)) * 2);                        \
         }                                                                     \
                                                                               \
         if ((I) != ac_alen(A)) {                                              \
@@ -222,71 +283,308 @@ typedef ac_arr(double) ac_doubles_t;
 
 /* -------------------------------------------------------------------------
    Generic type-safe hash map.
+   Open addressing in the style of Swiss tables: one flat array of inline
+   key-value slots plus one control byte per slot. Slots are probed in
+   groups of AC_MAP_GROUP control bytes at a time (SSE2 where available).
+   A control byte is either AC_CTRL_EMPTY, AC_CTRL_DELETED or the low 7 bits
+   of the hash of the key stored in that slot.
+   Rehashing is incremental: the old table is kept next to the new one and
+   drained a bounded number of slots per insert, so no single operation pays
+   for re-inserting every entry.
    ------------------------------------------------------------------------- */
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define AC_MAP_GROUP    16
+#define AC_CTRL_EMPTY   ((unsigned char)0x80)
+#define AC_CTRL_DELETED ((unsigned char)0xfe)
+
+/** @brief Match a control byte against a group, one bit per slot. */
+static inline uint32_t ac_group_match(const unsigned char *grp,
+                                      unsigned char b) {
+#ifdef __SSE2__
+    __m128i ctrl = _mm_loadu_si128((const __m128i *)(const void *)grp);
+    return (uint32_t)_mm_movemask_epi8(
+        _mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)b)));
+#else
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < AC_MAP_GROUP; i++) {
+        mask |= (uint32_t)(grp[i] == b) << i;
+    }
+    return mask;
+#endif
+}
+
+/** @brief Match all empty or deleted slots in a group. */
+static inline uint32_t ac_group_match_free(const unsigned char *grp) {
+#ifdef __SSE2__
+    /* Both EMPTY and DELETED have the high bit set, full slots do not. */
+    return (uint32_t)_mm_movemask_epi8(
+        _mm_loadu_si128((const __m128i *)(const void *)grp));
+#else
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < AC_MAP_GROUP; i++) {
+        mask |= (uint32_t)(grp[i] >> 7) << i;
+    }
+    return mask;
+#endif
+}
+
+/** @brief Index of the lowest set bit of a non-zero mask. */
+static inline size_t ac_ctz(uint32_t mask) {
+#ifdef __GNUC__
+    return (size_t)__builtin_ctz(mask);
+#else
+    size_t i = 0;
+    for (; !(mask & 1); mask >>= 1) {
+        i++;
+    }
+    return i;
+#endif
+}
+
+/** @brief Scramble a user supplied hash so that both the group index (high
+ * bits) and the control byte (low 7 bits) are well distributed, even for
+ * identity hashes such as socket handles. */
+static inline uint64_t ac_map_mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h;
+}
+
+/** @brief Control byte for a mixed hash. */
+static inline unsigned char ac_map_h2(uint64_t h) {
+    return (unsigned char)(h & 0x7f);
+}
+
+/** @brief First group of the probe sequence for a mixed hash. */
+static inline size_t ac_map_h1(uint64_t h, size_t cap) {
+    return (size_t)(h >> 7) & (cap / AC_MAP_GROUP - 1);
+}
+
+/** @brief Smallest capacity that holds N entries under the 7/8 load factor.
+ */
+static inline size_t ac_map_cap_for(size_t n) {
+    size_t cap = AC_MAP_GROUP;
+    while (cap / 8 * 7 < n) {
+        cap *= 2;
+    }
+    return cap;
+}
+
+/** @brief Index of the first full slot at or after I, or CAP if none. */
+static inline size_t ac_map_next_full(const unsigned char *ctrl, size_t cap,
+                                      size_t i) {
+    while (i < cap) {
+        size_t grp = i & ~(size_t)(AC_MAP_GROUP - 1);
+        /* Ignore slots in this group that come before I. */
+        uint32_t full = ~ac_group_match_free(ctrl + grp) & 0xffffu &
+                        (0xffffu << (i - grp));
+
+        if (full) {
+            return grp + ac_ctz(full);
+        }
+        i = grp + AC_MAP_GROUP;
+    }
+    return cap;
+}
+
+/** @brief Index of the first empty or deleted slot in the probe sequence of
+ * a mixed hash. The table must have at least one free slot. */
+static inline size_t ac_map_probe_free(const unsigned char *ctrl, size_t cap,
+                                       uint64_t h) {
+    size_t mask = cap / AC_MAP_GROUP - 1;
+    size_t grp  = ac_map_h1(h, cap);
+
+    for (size_t step = 1;; step++) {
+        uint32_t free_slots =
+            ac_group_match_free(ctrl + grp * AC_MAP_GROUP);
+
+        if (free_slots) {
+            return grp * AC_MAP_GROUP + ac_ctz(free_slots);
+        }
+
+        /* Triangular probing visits every group of a power-of-two table. */
+        grp = (grp + step) & mask;
+    }
+}
+
+/** @brief Next full slot at or after I in the combined index space of a
+ * map that may be migrating: [0, CAP) is the current table and
+ * [CAP, CAP + OLD_CAP) is the old table. Returns CAP + OLD_CAP if none. */
+static inline size_t ac_map_iter_next(const unsigned char *ctrl, size_t cap,
+                                      const unsigned char *old_ctrl,
+                                      size_t old_cap, size_t i) {
+    if (i < cap) {
+        size_t next = ac_map_next_full(ctrl, cap, i);
+        if (next < cap) {
+            return next;
+        }
+        i = cap;
+    }
+    return old_cap ? cap + ac_map_next_full(old_ctrl, old_cap, i - cap) : cap;
+}
+
+/** @brief Number of old slots migrated per mutating operation while an
+ * incremental rehash is in progress. */
+#define AC_MAP_MIGRATE_SLOTS 64
+
 #define ac_map(K, V)                                                          \
     struct {                                                                  \
-        ac_arr(ac_arr(struct {                                                \
+        struct {                                                              \
             K key;                                                            \
             V val;                                                            \
-        })) bkts;                                                             \
+        } *slots, *old_slots; /* Inline key-value slots. */                   \
+        unsigned char *ctrl;  /* One control byte per slot. */                \
+        unsigned char *old_ctrl;                                              \
                                                                               \
-        size_t len;      /* Number of entries. */                             \
-        size_t pop_bkts; /* Number of populated buckets. */                   \
+        size_t cap;           /* Number of slots, a power of two. */          \
+        size_t old_cap;       /* Slots in the old table, 0 if none. */        \
+        size_t migrated;      /* Old slots already moved to the table. */     \
+        size_t min_cap;       /* Capacity never shrunk below. */              \
+        size_t len;           /* Number of entries in both tables. */         \
+        size_t growth_left;   /* Inserts left before rehashing. */            \
+        bool shrink;          /* Opt-in: shrink when sparse. */               \
+        const ac_allocator_t *alloc; /* NULL for the C heap. */               \
     }
 
-/** @brief Iterate over all key-value pairs in a hash map. */
+/** @brief Get a pointer to the slot at index I of the combined index space,
+ * see ac_map_iter_next(). */
+#define ac_map_slot(M, I)                                                     \
+    ((I) < (M).cap ? &(M).slots[(I)] : &(M).old_slots[(I) - (M).cap])
+
+/** @brief Iterate over all key-value pairs in a hash map. Only occupied
+ * slots are visited. Entries may be removed while iterating, since removal
+ * never moves entries. */
 #define ac_map_foreach(M, K, V)                                               \
-    ac_arr_foreach((M).bkts, ac_uniq(i)) ac_arr_foreach(                      \
-        (M).bkts[ac_uniq(i)],                                                 \
-        ac_uniq(                                                              \
-            j)) for (bool ac_uniq(once) = true;                               \
-                     ac_uniq(                                                 \
-                         once);) for ((K) =                                   \
-                                          &((M).bkts[ac_uniq(i)][ac_uniq(j)]  \
-                                                .key),                        \
-                                      (V) =                                   \
-                                          &((M).bkts[ac_uniq(i)][ac_uniq(j)]  \
-                                                .val);                        \
-                                      ac_uniq(once); ac_uniq(once) = false)
-
-/** @brief Create a new hash map with a specific initial capacity. */
-#define ac_map_new_reserve(M, N)                                              \
+    for (size_t ac_uniq(i) = ac_map_iter_next((M).ctrl, (M).cap,              \
+                                              (M).old_ctrl, (M).old_cap, 0);  \
+         ac_uniq(i) < (M).cap + (M).old_cap;                                  \
+         ac_uniq(i) = ac_map_iter_next((M).ctrl, (M).cap, (M).old_ctrl,       \
+                                       (M).old_cap, ac_uniq(i) + 1))          \
+        for (bool ac_uniq(once) = true; ac_uniq(once);)                       \
+            for ((K) = &ac_map_slot(M, ac_uniq(i))->key,                      \
+                (V)  = &ac_map_slot(M, ac_uniq(i))->val;                      \
+                 ac_uniq(once); ac_uniq(once) = false)
+
+/** @brief Size in bytes of a table with CAP slots. */
+#define ac_map_bytes(M, CAP) ((CAP) * sizeof(*(M).slots) + (CAP))
+
+/** @brief Internal macro for allocating slots and control bytes in a single
+ * block. Control bytes are placed after the slots. */
+#define ac_map_alloc(M, CAP, MEM, CTRL)                                       \
     do {                                                                      \
-        ac_arr_new_n((M).bkts, N);                                            \
-        (M).len = (M).pop_bkts = 0;                                           \
-                                                                              \
-        ac_arr_foreach((M).bkts, ac_uniq(i)) {                                \
-            ac_arr_new_reserve((M).bkts[ac_uniq(i)], 2);                      \
-        }                                                                     \
+        (MEM) = ac_realloc((M).alloc, NULL, 0, ac_map_bytes(M, CAP));         \
+        assert(MEM);                                                          \
+        (CTRL) = (unsigned char *)(MEM) + (CAP) * sizeof(*(M).slots);         \
+        memset((CTRL), AC_CTRL_EMPTY, (CAP));                                 \
+    } while (0)
+
+/** @brief Create a new hash map with room for N entries before rehashing,
+ * using an allocator. */
+#define ac_map_new_reserve_a(M, N, ALLOC)                                     \
+    do {                                                                      \
+        void *ac_uniq(mem);                                                   \
+        (M).alloc = (ALLOC);                                                  \
+        (M).cap = (M).min_cap = ac_map_cap_for(N);                            \
+        ac_map_alloc(M, (M).cap, ac_uniq(mem), (M).ctrl);                     \
+        ac_generic_assign((M).slots, ac_uniq(mem));                           \
+        (M).old_slots   = NULL;                                               \
+        (M).old_ctrl    = NULL;                                               \
+        (M).old_cap     = 0;                                                  \
+        (M).migrated    = 0;                                                  \
+        (M).len         = 0;                                                  \
+        (M).growth_left = (M).cap / 8 * 7;                                    \
+        (M).shrink      = false;                                              \
     } while (0)
 
+/** @brief Create a new hash map with room for N entries before rehashing. */
+#define ac_map_new_reserve(M, N) ac_map_new_reserve_a(M, N, NULL)
+
+/** @brief Create a new hash map with a default initial capacity, using an
+ * allocator. */
+#define ac_map_new_a(M, ALLOC) ac_map_new_reserve_a(M, 16, ALLOC)
+
 /** @brief Create a new hash map with a default initial capacity. */
-#define ac_map_new(M) ac_map_new_reserve(M, 16)
+#define ac_map_new(M) ac_map_new_a(M, NULL)
+
+/** @brief Opt in to shrinking a hash map once it becomes sparse. The map
+ * never shrinks below the capacity it was created with. */
+#define ac_map_enable_shrink(M) ((M).shrink = true)
 
 /** @brief Free the memory allocated for a hash map. */
 #define ac_map_free(M)                                                        \
     do {                                                                      \
-        ac_arr_foreach((M).bkts, ac_uniq(i)) {                                \
-            ac_arr_free((M).bkts[ac_uniq(i)]);                                \
+        ac_realloc((M).alloc, (M).slots, ac_map_bytes(M, (M).cap), 0);        \
+        if ((M).old_slots) {                                                  \
+            ac_realloc((M).alloc, (M).old_slots,                              \
+                       ac_map_bytes(M, (M).old_cap), 0);                      \
         }                                                                     \
-        ac_arr_free((M).bkts);                                                \
     } while (0)
 
-/** @brief Get a value from a hash map, returning NULL if not found. */
-#define ac_map_get_maybe_null(M, HASH, EQ, K, V)                              \
+/** @brief Internal macro for finding the slot index of a key with a
+ * precomputed mixed hash H in a single table. IDX is set to SIZE_MAX if not
+ * found. */
+#define ac_map_find_in(SLOTS, CTRL, CAP, EQ, K, H, IDX)                       \
     do {                                                                      \
-        (V)                  = NULL;                                          \
-        size_t ac_uniq(hash) = HASH(&(K)) % ac_acap((M).bkts);                \
+        size_t ac_uniq(fmask) = (CAP) / AC_MAP_GROUP - 1;                     \
+        size_t ac_uniq(fgrp)  = ac_map_h1(H, CAP);                            \
+        (IDX)                 = SIZE_MAX;                                     \
+                                                                              \
+        for (size_t ac_uniq(fstep) = 1;; ac_uniq(fstep)++) {                  \
+            const unsigned char *ac_uniq(fctrl) =                             \
+                (CTRL) + ac_uniq(fgrp) * AC_MAP_GROUP;                        \
+            uint32_t ac_uniq(fm) =                                            \
+                ac_group_match(ac_uniq(fctrl), ac_map_h2(H));                 \
                                                                               \
-        ac_arr_foreach((M).bkts[ac_uniq(hash)], ac_uniq(i)) {                 \
-            if (EQ(&(M).bkts[ac_uniq(hash)][ac_uniq(i)].key, &(K))) {         \
-                (V) = &(M).bkts[ac_uniq(hash)][ac_uniq(i)].val;               \
+            for (; ac_uniq(fm); ac_uniq(fm) &= ac_uniq(fm) - 1) {             \
+                size_t ac_uniq(fs) =                                          \
+                    ac_uniq(fgrp) * AC_MAP_GROUP + ac_ctz(ac_uniq(fm));       \
+                if (EQ(&(SLOTS)[ac_uniq(fs)].key, &(K))) {                    \
+                    (IDX) = ac_uniq(fs);                                      \
+                    break;                                                    \
+                }                                                             \
+            }                                                                 \
+                                                                              \
+            /* An empty slot ends the probe sequence. */                      \
+            if ((IDX) != SIZE_MAX ||                                          \
+                ac_group_match(ac_uniq(fctrl), AC_CTRL_EMPTY)) {              \
                 break;                                                        \
+            }                                                                 \
+                                                                              \
+            ac_uniq(fgrp) =                                                   \
+                (ac_uniq(fgrp) + ac_uniq(fstep)) & ac_uniq(fmask);            \
+        }                                                                     \
+    } while (0)
+
+/** @brief Internal macro for finding the combined slot index of a key with
+ * a precomputed mixed hash H, looking in the old table while migrating. */
+#define ac_map_find(M, EQ, K, H, IDX)                                         \
+    do {                                                                      \
+        ac_map_find_in((M).slots, (M).ctrl, (M).cap, EQ, K, H, IDX);          \
+                                                                              \
+        if ((IDX) == SIZE_MAX && (M).old_slots) {                             \
+            ac_map_find_in((M).old_slots, (M).old_ctrl, (M).old_cap, EQ, K,   \
+                           H, IDX);                                           \
+            if ((IDX) != SIZE_MAX) {                                          \
+                (IDX) += (M).cap;                                             \
             }                                                                 \
         }                                                                     \
     } while (0)
 
+/** @brief Get a value from a hash map, returning NULL if not found. */
+#define ac_map_get_maybe_null(M, HASH, EQ, K, V)                              \
+    do {                                                                      \
+        uint64_t ac_uniq(hash) = ac_map_mix(HASH(&(K)));                      \
+        size_t ac_uniq(idx);                                                  \
+        ac_map_find(M, EQ, K, ac_uniq(hash), ac_uniq(idx));                   \
+        (V) = ac_uniq(idx) == SIZE_MAX ? NULL                                 \
+                                       : &ac_map_slot(M, ac_uniq(idx))->val;  \
+    } while (0)
+
 /** @brief Get a value from a hash map, it must exist. */
 #define ac_map_get(M, HASH, EQ, K, V)                                         \
     do {                                                                      \
@@ -302,105 +600,580 @@ typedef ac_arr(double) ac_doubles_t;
         (BOOL) = ac_uniq(v) != NULL;                                          \
     } while (0)
 
-/** @brief Internal macro for setting a value in a hash map without rehashing.
- */
-#define ac_map_set_no_rehash(M, CAP, HASH, EQ, K, V)                          \
+/** @brief Internal macro for moving up to N old slots into the current
+ * table. The old table is freed once every slot has been moved. */
+#define ac_map_migrate(M, HASH, N)                                            \
     do {                                                                      \
-        size_t ac_uniq(hash) = HASH(&(K)) % (CAP);                            \
-        /* If two keys within a bucket match the value will be replaced.      \
-           Otherwise append new entry to bucket. */                           \
-        bool ac_uniq(replaced) = false;                                       \
-                                                                              \
-        ac_foreach(ac_alen((M).bkts[ac_uniq(hash)]), ac_uniq(k)) {            \
-            if (EQ(&(M).bkts[ac_uniq(hash)][ac_uniq(k)].key, &(K))) {         \
-                (M).bkts[ac_uniq(hash)][ac_uniq(k)].val = V;                  \
-                ac_uniq(replaced)                       = true;               \
-                break;                                                        \
-            }                                                                 \
-        }                                                                     \
+        if ((M).old_slots) {                                                  \
+            size_t ac_uniq(mend) = (M).old_cap - (M).migrated <= (N)          \
+                                       ? (M).old_cap                          \
+                                       : (M).migrated + (N);                  \
                                                                               \
-        if (!ac_uniq(replaced)) {                                             \
-            (M).len++;                                                        \
+            for (size_t ac_uniq(mi) = ac_map_next_full(                       \
+                     (M).old_ctrl, ac_uniq(mend), (M).migrated);              \
+                 ac_uniq(mi) < ac_uniq(mend);                                 \
+                 ac_uniq(mi) = ac_map_next_full(                              \
+                     (M).old_ctrl, ac_uniq(mend), ac_uniq(mi) + 1)) {         \
+                uint64_t ac_uniq(mh) =                                        \
+                    ac_map_mix(HASH(&(M).old_slots[ac_uniq(mi)].key));        \
+                size_t ac_uniq(ms) =                                          \
+                    ac_map_probe_free((M).ctrl, (M).cap, ac_uniq(mh));        \
+                                                                              \
+                if ((M).ctrl[ac_uniq(ms)] == AC_CTRL_EMPTY) {                 \
+                    (M).growth_left--;                                        \
+                }                                                             \
                                                                               \
-            if (ac_alen((M).bkts[ac_uniq(hash)]) == 0) {                      \
-                (M).pop_bkts++;                                               \
+                (M).ctrl[ac_uniq(ms)]      = ac_map_h2(ac_uniq(mh));          \
+                (M).slots[ac_uniq(ms)]     = (M).old_slots[ac_uniq(mi)];      \
+                (M).old_ctrl[ac_uniq(mi)] = AC_CTRL_DELETED;                  \
             }                                                                 \
                                                                               \
-            ac_arr_append_raw((M).bkts[ac_uniq(hash)]);                       \
-            ((M).bkts[ac_uniq(hash)])[ac_alen((M).bkts[ac_uniq(hash)]) - 1]   \
-                .key = K;                                                     \
-            ((M).bkts[ac_uniq(hash)])[ac_alen((M).bkts[ac_uniq(hash)]) - 1]   \
-                .val = V;                                                     \
+            (M).migrated = ac_uniq(mend);                                     \
+                                                                              \
+            if ((M).migrated == (M).old_cap) {                                \
+                ac_realloc((M).alloc, (M).old_slots,                          \
+                           ac_map_bytes(M, (M).old_cap), 0);                  \
+                (M).old_slots = NULL;                                         \
+                (M).old_ctrl  = NULL;                                         \
+                (M).old_cap = (M).migrated = 0;                               \
+            }                                                                 \
         }                                                                     \
     } while (0)
 
-/** @brief Set a key-value pair in a hash map. Rehash if needed. */
-#define ac_map_set(M, HASH, EQ, K, V)                                         \
+/** @brief Internal macro for starting an incremental rehash into a new
+ * table of capacity CAP. The current table becomes the old table and is
+ * drained by later operations. A rehash already in progress is finished
+ * first. */
+#define ac_map_rehash(M, HASH, CAP)                                           \
     do {                                                                      \
-        /* Grow array if needed. */                                           \
-        if ((M).pop_bkts == ac_acap((M).bkts) / 2) {                          \
-            (M).len = (M).pop_bkts = 0;                                       \
+        ac_map_migrate(M, HASH, SIZE_MAX);                                    \
                                                                               \
-            size_t ac_uniq(old_cap) = ac_acap((M).bkts);                      \
-            size_t ac_uniq(new_cap) = ac_acap((M).bkts) * 2;                  \
+        size_t ac_uniq(rcap) = (CAP);                                         \
+        void *ac_uniq(rmem);                                                  \
                                                                               \
-            /* Double number of buckets. Also allocate a 3rd region to        \
-               temporarily store the old data while re-hashing. */            \
-            ac_arr_resize((M).bkts, ac_uniq(new_cap) + ac_uniq(old_cap));     \
+        (M).old_slots = (M).slots;                                            \
+        (M).old_ctrl  = (M).ctrl;                                             \
+        (M).old_cap   = (M).cap;                                              \
+        (M).migrated  = 0;                                                    \
+                                                                              \
+        ac_map_alloc(M, ac_uniq(rcap), ac_uniq(rmem), (M).ctrl);              \
+        ac_generic_assign((M).slots, ac_uniq(rmem));                          \
+        (M).cap         = ac_uniq(rcap);                                      \
+        (M).growth_left = (M).cap / 8 * 7;                                    \
+    } while (0)
+
+/** @brief Internal macro for starting a shrink if the map opted in, is not
+ * already migrating and has dropped below 1/8 load. The new table has room
+ * for twice the entries plus everything that can be inserted before the
+ * migration completes. */
+#define ac_map_maybe_shrink(M, HASH)                                          \
+    do {                                                                      \
+        if ((M).shrink && !(M).old_slots && (M).cap > (M).min_cap &&          \
+            (M).len < (M).cap / 8) {                                          \
+            size_t ac_uniq(scap) = ac_map_cap_for(                            \
+                (M).len * 2 + (M).cap / AC_MAP_MIGRATE_SLOTS + 1);            \
+            if (ac_uniq(scap) < (M).min_cap) {                                \
+                ac_uniq(scap) = (M).min_cap;                                  \
+            }                                                                 \
+            if (ac_uniq(scap) < (M).cap) {                                    \
+                ac_map_rehash(M, HASH, ac_uniq(scap));                        \
+            }                                                                 \
+        }                                                                     \
+    } while (0)
+
+/** @brief Advance an in-progress rehash by one bounded step and apply the
+ * shrink policy. Call at a point where the map is not being iterated, e.g.
+ * once per tick, so migration completes even without further inserts. */
+#define ac_map_step(M, HASH)                                                  \
+    do {                                                                      \
+        ac_map_migrate(M, HASH, AC_MAP_MIGRATE_SLOTS);                        \
+        ac_map_maybe_shrink(M, HASH);                                         \
+    } while (0)
+
+/** @brief Set a key-value pair in a hash map. Rehashing is incremental:
+ * every call moves at most AC_MAP_MIGRATE_SLOTS old slots. */
+#define ac_map_set(M, HASH, EQ, K, V)                                         \
+    do {                                                                      \
+        ac_map_step(M, HASH);                                                 \
                                                                               \
-            /* Move old data to the 3rd region. */                            \
-            memcpy((M).bkts + ac_uniq(new_cap), (M).bkts,                     \
-                   (ac_uniq(old_cap)) * sizeof((M).bkts[0]));                 \
-            memset((M).bkts, 0x0, ac_uniq(old_cap) * sizeof((M).bkts[0]));    \
+        uint64_t ac_uniq(hash) = ac_map_mix(HASH(&(K)));                      \
+        size_t ac_uniq(idx);                                                  \
+        ac_map_find(M, EQ, K, ac_uniq(hash), ac_uniq(idx));                   \
                                                                               \
-            /* Initialize new buckets. */                                     \
-            ac_foreach(ac_uniq(new_cap), ac_uniq(bkt)) {                      \
-                ac_arr_new_reserve((M).bkts[ac_uniq(bkt)], 2);                \
+        if (ac_uniq(idx) == SIZE_MAX) {                                       \
+            if ((M).growth_left == 0) {                                       \
+                /* Grow if mostly full, otherwise only purge tombstones. */   \
+                ac_map_rehash(M, HASH,                                        \
+                              (M).len >= (M).cap / 16 * 7 ? (M).cap * 2       \
+                                                          : (M).cap);         \
             }                                                                 \
                                                                               \
-            /* Re-hash. */                                                    \
-            ac_foreach(ac_uniq(old_cap), ac_uniq(bkt)) {                      \
-                ac_arr_foreach(((M).bkts + ac_uniq(new_cap))[ac_uniq(bkt)],   \
-                               ac_uniq(j)) {                                  \
-                    ac_map_set_no_rehash(                                     \
-                        M, ac_uniq(new_cap), HASH, EQ,                        \
-                        ((M).bkts +                                           \
-                         ac_uniq(new_cap))[ac_uniq(bkt)][ac_uniq(j)]          \
-                            .key,                                             \
-                        ((M).bkts +                                           \
-                         ac_uniq(new_cap))[ac_uniq(bkt)][ac_uniq(j)]          \
-                            .val);                                            \
-                }                                                             \
+            ac_uniq(idx) =                                                    \
+                ac_map_probe_free((M).ctrl, (M).cap, ac_uniq(hash));          \
                                                                               \
-                /* Free old bucket after re-hash. */                          \
-                ac_arr_free(((M).bkts + ac_uniq(new_cap))[ac_uniq(bkt)]);     \
+            if ((M).ctrl[ac_uniq(idx)] == AC_CTRL_EMPTY) {                    \
+                (M).growth_left--;                                            \
             }                                                                 \
                                                                               \
-            /* Shrink array to new capacity. */                               \
-            ac_acap((M).bkts) = ac_uniq(new_cap);                             \
+            (M).ctrl[ac_uniq(idx)]      = ac_map_h2(ac_uniq(hash));           \
+            (M).slots[ac_uniq(idx)].key = K;                                  \
+            (M).len++;                                                        \
         }                                                                     \
                                                                               \
-        /* Insert new value. */                                               \
-        ac_map_set_no_rehash(M, ac_acap((M).bkts), HASH, EQ, K, V);           \
+        ac_map_slot(M, ac_uniq(idx))->val = V;                                \
+    } while (0)
+
+/** @brief Internal macro for freeing the slot at index I of a single table.
+ * If the group still has an empty slot no probe sequence can pass through
+ * it, so the slot can be emptied outright instead of leaving a tombstone.
+ * FREED is set to whether the slot became empty. */
+#define ac_map_erase_in(CTRL, I, FREED)                                       \
+    do {                                                                      \
+        (FREED) = ac_group_match(                                             \
+                      (CTRL) + ((I) & ~(size_t)(AC_MAP_GROUP - 1)),           \
+                      AC_CTRL_EMPTY) != 0;                                    \
+        (CTRL)[(I)] = (FREED) ? AC_CTRL_EMPTY : AC_CTRL_DELETED;              \
     } while (0)
 
 /** @brief Remove a key-value pair from a hash map. */
 #define ac_map_remove(M, HASH, EQ, K)                                         \
     do {                                                                      \
-        size_t ac_uniq(hash) = HASH(&(K)) % ac_acap((M).bkts);                \
+        uint64_t ac_uniq(hash) = ac_map_mix(HASH(&(K)));                      \
+        size_t ac_uniq(idx);                                                  \
+        bool ac_uniq(freed);                                                  \
+        ac_map_find(M, EQ, K, ac_uniq(hash), ac_uniq(idx));                   \
                                                                               \
-        ac_arr_foreach((M).bkts[ac_uniq(hash)], ac_uniq(j)) {                 \
-            if (EQ(&(M).bkts[ac_uniq(hash)][ac_uniq(j)].key, &(K))) {         \
-                ac_arr_remove((M).bkts[ac_uniq(hash)], ac_uniq(j));           \
+        if (ac_uniq(idx) < (M).cap) {                                         \
+            ac_map_erase_in((M).ctrl, ac_uniq(idx), ac_uniq(freed));          \
+            (M).growth_left += ac_uniq(freed);                                \
+            (M).len--;                                                        \
+        } else if (ac_uniq(idx) != SIZE_MAX) {                                \
+            ac_map_erase_in((M).old_ctrl, ac_uniq(idx) - (M).cap,             \
+                            ac_uniq(freed));                                  \
+            (M).len--;                                                        \
+        }                                                                     \
+    } while (0)
+
+/* -------------------------------------------------------------------------
+   Typed hash map instantiation.
+   AC_MAP_DECLARE emits a map type and static inline functions specialized
+   for its key, value, hash and equality, so call sites compile to a
+   function call the optimizer can inline rather than a statement macro.
+   The rarely taken rehash paths are declared only and emitted once, out of
+   line, by AC_MAP_DEFINE in a single source file.
+   ------------------------------------------------------------------------- */
+
+/** @brief Mark a function as rarely called and keep it out of line. */
+#ifdef __GNUC__
+#define AC_COLD __attribute__((cold, noinline))
+#else
+#define AC_COLD
+#endif
+
+/**
+ * @brief Declare a typed hash map NAME##_t with the functions NAME##_new,
+ * NAME##_new_reserve, NAME##_free, NAME##_get, NAME##_contains, NAME##_set,
+ * NAME##_remove and NAME##_step. Iterate with ac_map_foreach().
+ */
+#define AC_MAP_DECLARE(NAME, K, V, HASH, EQ)                                  \
+    typedef ac_map(K, V) NAME##_t;                                            \
                                                                               \
-                (M).len--;                                                    \
+    AC_COLD void NAME##_step_slow(NAME##_t *map);                             \
+    AC_COLD void NAME##_grow(NAME##_t *map);                                  \
                                                                               \
-                if (ac_alen((M).bkts[ac_uniq(hash)]) == 0) {                  \
-                    (M).pop_bkts--;                                           \
-                }                                                             \
-                break;                                                        \
+    static inline void NAME##_new_reserve(NAME##_t *map, size_t n) {          \
+        ac_map_new_reserve(*map, n);                                          \
+    }                                                                         \
+                                                                              \
+    static inline void NAME##_new(NAME##_t *map) {                            \
+        ac_map_new(*map);                                                     \
+    }                                                                         \
+                                                                              \
+    static inline void NAME##_free(NAME##_t *map) {                           \
+        ac_map_free(*map);                                                    \
+    }                                                                         \
+                                                                              \
+    /** @brief Get a value, or NULL if KEY is not in the map. */              \
+    static inline V *NAME##_get(const NAME##_t *map, K key) {                 \
+        uint64_t hash = ac_map_mix(HASH(&key));                               \
+        size_t idx;                                                           \
+        ac_map_find(*map, EQ, key, hash, idx);                                \
+        return idx == SIZE_MAX ? NULL : &ac_map_slot(*map, idx)->val;         \
+    }                                                                         \
+                                                                              \
+    static inline bool NAME##_contains(const NAME##_t *map, K key) {          \
+        return NAME##_get(map, key) != NULL;                                  \
+    }                                                                         \
+                                                                              \
+    /** @brief Advance an in-progress rehash and apply the shrink policy,    \
+     * see ac_map_step(). Free when there is nothing to do. */                \
+    static inline void NAME##_step(NAME##_t *map) {                           \
+        if (map->old_slots || (map->shrink && map->cap > map->min_cap &&      \
+                               map->len < map->cap / 8)) {                    \
+            NAME##_step_slow(map);                                            \
+        }                                                                     \
+    }                                                                         \
+                                                                              \
+    /** @brief Insert or replace a value, returning where it is stored. */    \
+    static inline V *NAME##_set(NAME##_t *map, K key, V val) {                \
+        NAME##_step(map);                                                     \
+                                                                              \
+        uint64_t hash = ac_map_mix(HASH(&key));                               \
+        size_t idx;                                                           \
+        ac_map_find(*map, EQ, key, hash, idx);                                \
+                                                                              \
+        if (idx == SIZE_MAX) {                                                \
+            if (map->growth_left == 0) {                                      \
+                NAME##_grow(map);                                             \
             }                                                                 \
+                                                                              \
+            idx = ac_map_probe_free(map->ctrl, map->cap, hash);               \
+                                                                              \
+            if (map->ctrl[idx] == AC_CTRL_EMPTY) {                            \
+                map->growth_left--;                                           \
+            }                                                                 \
+                                                                              \
+            map->ctrl[idx]      = ac_map_h2(hash);                            \
+            map->slots[idx].key = key;                                        \
+            map->len++;                                                       \
         }                                                                     \
-    } while (0)
+                                                                              \
+        ac_map_slot(*map, idx)->val = val;                                    \
+        return &ac_map_slot(*map, idx)->val;                                  \
+    }                                                                         \
+                                                                              \
+    static inline void NAME##_remove(NAME##_t *map, K key) {                  \
+        ac_map_remove(*map, HASH, EQ, key);                                   \
+    }                                                                         \
+                                                                              \
+    /* Redeclared so that the invocation ends with a semicolon. */            \
+    void NAME##_grow(NAME##_t *map)
+
+/** @brief Emit the out-of-line functions of a map declared with
+ * AC_MAP_DECLARE. Use in exactly one source file. */
+#define AC_MAP_DEFINE(NAME, K, V, HASH, EQ)                                   \
+    void NAME##_step_slow(NAME##_t *map) {                                    \
+        ac_map_step(*map, HASH);                                              \
+    }                                                                         \
+                                                                              \
+    /* Grow if mostly full, otherwise only purge tombstones. */               \
+    void NAME##_grow(NAME##_t *map) {                                         \
+        ac_map_rehash(*map, HASH,                                             \
+                      map->len >= map->cap / 16 * 7 ? map->cap * 2            \
+                                                    : map->cap);              \
+    }                                                                         \
+                                                                              \
+    /* Redeclared so that the invocation ends with a semicolon. */            \
+    void NAME##_grow(NAME##_t *map)
+
+/* -------------------------------------------------------------------------
+   Bounded lock-free ring queues.
+   ac_spsc(T) has one producer and one consumer thread, ac_mpsc(T) any
+   number of producer threads and one consumer thread. Capacity is rounded
+   up to a power of two. Head and tail live on separate cache lines so the
+   producer and consumer sides do not false share. Elements are copied in
+   and out; batch operations move as many as fit and publish them with a
+   single index update.
+   ------------------------------------------------------------------------- */
+
+/** @brief Size of a cache line, used to keep shared data from false
+ * sharing. */
+#define AC_CACHE_LINE 64
+
+#ifdef __GNUC__
+#define AC_CACHE_ALIGNED __attribute__((aligned(AC_CACHE_LINE)))
+#else
+#define AC_CACHE_ALIGNED
+#endif
+
+/* Atomic backend: C11 atomics when compiling as C11 or later, otherwise the
+   GCC __atomic builtins, which operate on plain integers. */
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L &&              \
+    !defined(__STDC_NO_ATOMICS__)
+#include <stdatomic.h>
+#define AC_ATOMIC(T)       _Atomic(T)
+#define AC_RELAXED         memory_order_relaxed
+#define AC_ACQUIRE         memory_order_acquire
+#define AC_RELEASE         memory_order_release
+#define ac_atomic_load(P, MO)     atomic_load_explicit(P, MO)
+#define ac_atomic_store(P, V, MO) atomic_store_explicit(P, V, MO)
+#define ac_atomic_cas_weak(P, EXP, DES, MO)                                   \
+    atomic_compare_exchange_weak_explicit(P, EXP, DES, MO, AC_RELAXED)
+#else
+#define AC_ATOMIC(T)       T
+#define AC_RELAXED         __ATOMIC_RELAXED
+#define AC_ACQUIRE         __ATOMIC_ACQUIRE
+#define AC_RELEASE         __ATOMIC_RELEASE
+#define ac_atomic_load(P, MO)     __atomic_load_n(P, MO)
+#define ac_atomic_store(P, V, MO) __atomic_store_n(P, V, MO)
+#define ac_atomic_cas_weak(P, EXP, DES, MO)                                   \
+    __atomic_compare_exchange_n(P, EXP, DES, true, MO, AC_RELAXED)
+#endif
+
+/** @brief Indices shared by both queue kinds. Positions only ever grow and
+ * are masked into the slot array. */
+typedef struct ac_ring_s {
+    /** @brief Next position to pop, written by the consumer. */
+    AC_ATOMIC(size_t) head AC_CACHE_ALIGNED;
+    /** @brief The consumer's last look at the tail (SPSC only). */
+    size_t tail_cache;
+
+    /** @brief Next position to push, written by the producer(s). */
+    AC_ATOMIC(size_t) tail AC_CACHE_ALIGNED;
+    /** @brief The producer's last look at the head (SPSC only). */
+    size_t head_cache;
+
+    /** @brief Number of slots, a power of two. */
+    size_t cap AC_CACHE_ALIGNED;
+} ac_ring_t;
+
+/** @brief Declare a single-producer single-consumer queue of T. */
+#define ac_spsc(T)                                                            \
+    struct {                                                                  \
+        ac_ring_t ring;                                                       \
+        T *slots;                                                             \
+    }
+
+/** @brief Declare a multi-producer single-consumer queue of T. Each slot
+ * carries the position it was last written for, so the consumer can tell
+ * a claimed slot from a filled one. */
+#define ac_mpsc(T)                                                            \
+    struct {                                                                  \
+        ac_ring_t ring;                                                       \
+        struct {                                                              \
+            AC_ATOMIC(size_t) seq;                                            \
+            T val;                                                            \
+        } *slots;                                                             \
+    }
+
+/** @brief Internal function allocating the slots of a queue. Slot sequence
+ * numbers start out as 0, which never matches a filled position. */
+static inline void *ac_ring_new(ac_ring_t *ring, size_t cap,
+                                size_t slot_size) {
+    size_t pow2 = 1;
+    while (pow2 < cap) {
+        pow2 *= 2;
+    }
+
+    ac_atomic_store(&ring->head, 0, AC_RELAXED);
+    ac_atomic_store(&ring->tail, 0, AC_RELAXED);
+    ring->tail_cache = 0;
+    ring->head_cache = 0;
+    ring->cap        = pow2;
+
+    void *slots = calloc(pow2, slot_size);
+    assert(slots);
+    return slots;
+}
+
+/** @brief Internal function copying N elements into the slots from
+ * position POS on, wrapping around the end of the slots. */
+static inline void ac_ring_copy_in(const ac_ring_t *ring, void *slots,
+                                   size_t pos, const void *src, size_t n,
+                                   size_t size) {
+    size_t start = pos & (ring->cap - 1);
+    size_t first = ring->cap - start < n ? ring->cap - start : n;
+
+    memcpy((char *)slots + start * size, src, first * size);
+    memcpy(slots, (const char *)src + first * size, (n - first) * size);
+}
+
+/** @brief Internal function copying N elements out of the slots from
+ * position POS on, wrapping around the end of the slots. */
+static inline void ac_ring_copy_out(const ac_ring_t *ring, const void *slots,
+                                    size_t pos, void *dst, size_t n,
+                                    size_t size) {
+    size_t start = pos & (ring->cap - 1);
+    size_t first = ring->cap - start < n ? ring->cap - start : n;
+
+    memcpy(dst, (const char *)slots + start * size, first * size);
+    memcpy((char *)dst + first * size, slots, (n - first) * size);
+}
+
+/** @brief Internal function pushing up to N elements onto an SPSC queue.
+ * Returns the number pushed. */
+static inline size_t ac_spsc_push_n_raw(ac_ring_t *ring, void *slots,
+                                        const void *src, size_t n,
+                                        size_t size) {
+    size_t tail = ac_atomic_load(&ring->tail, AC_RELAXED);
+
+    /* Only read the consumer's cache line when the cached head says the
+       queue is too full. */
+    if (ring->cap - (tail - ring->head_cache) < n) {
+        ring->head_cache = ac_atomic_load(&ring->head, AC_ACQUIRE);
+    }
+
+    size_t space = ring->cap - (tail - ring->head_cache);
+    n            = n < space ? n : space;
+
+    if (n > 0) {
+        ac_ring_copy_in(ring, slots, tail, src, n, size);
+        ac_atomic_store(&ring->tail, tail + n, AC_RELEASE);
+    }
+    return n;
+}
+
+/** @brief Internal function popping up to N elements off an SPSC queue.
+ * Returns the number popped. */
+static inline size_t ac_spsc_pop_n_raw(ac_ring_t *ring, void *slots,
+                                       void *dst, size_t n, size_t size) {
+    size_t head = ac_atomic_load(&ring->head, AC_RELAXED);
+
+    if (ring->tail_cache - head < n) {
+        ring->tail_cache = ac_atomic_load(&ring->tail, AC_ACQUIRE);
+    }
+
+    size_t avail = ring->tail_cache - head;
+    n            = n < avail ? n : avail;
+
+    if (n > 0) {
+        ac_ring_copy_out(ring, slots, head, dst, n, size);
+        ac_atomic_store(&ring->head, head + n, AC_RELEASE);
+    }
+    return n;
+}
+
+/** @brief Internal function pushing up to N elements onto an MPSC queue.
+ * The positions are claimed with one compare-and-swap on the tail, then
+ * each slot is published through its sequence number. Returns the number
+ * pushed. */
+static inline size_t ac_mpsc_push_n_raw(ac_ring_t *ring, void *slots,
+                                        const void *src, size_t n,
+                                        size_t slot_size, size_t val_off,
+                                        size_t val_size) {
+    size_t tail = ac_atomic_load(&ring->tail, AC_RELAXED);
+    size_t count;
+
+    do {
+        /* Positions below head + cap have been popped and are free. */
+        size_t space =
+            ac_atomic_load(&ring->head, AC_ACQUIRE) + ring->cap - tail;
+        count = n < space ? n : space;
+
+        if (count == 0) {
+            return 0;
+        }
+    } while (!ac_atomic_cas_weak(&ring->tail, &tail, tail + count,
+                                 AC_RELAXED));
+
+    const char *src_bytes = (const char *)src;
+
+    for (size_t i = 0; i < count; i++) {
+        char *slot =
+            (char *)slots + ((tail + i) & (ring->cap - 1)) * slot_size;
+
+        memcpy(slot + val_off, src_bytes + i * val_size, val_size);
+        ac_atomic_store((AC_ATOMIC(size_t) *)(void *)slot, tail + i + 1,
+                        AC_RELEASE);
+    }
+    return count;
+}
+
+/** @brief Internal function popping up to N elements off an MPSC queue,
+ * stopping at the first slot whose producer has not finished writing.
+ * Returns the number popped. */
+static inline size_t ac_mpsc_pop_n_raw(ac_ring_t *ring, void *slots,
+                                       void *dst, size_t n, size_t slot_size,
+                                       size_t val_off, size_t val_size) {
+    size_t head = ac_atomic_load(&ring->head, AC_RELAXED);
+    char *dst_bytes = (char *)dst;
+    size_t count    = 0;
+
+    for (; count < n; count++) {
+        char *slot =
+            (char *)slots + ((head + count) & (ring->cap - 1)) * slot_size;
+
+        if (ac_atomic_load((AC_ATOMIC(size_t) *)(void *)slot, AC_ACQUIRE) !=
+            head + count + 1) {
+            break;
+        }
+
+        memcpy(dst_bytes + count * val_size, slot + val_off, val_size);
+    }
+
+    if (count > 0) {
+        ac_atomic_store(&ring->head, head + count, AC_RELEASE);
+    }
+    return count;
+}
+
+/** @brief Number of elements in a queue. Exact only when no other thread is
+ * using it. */
+static inline size_t ac_ring_len(ac_ring_t *ring) {
+    return ac_atomic_load(&ring->tail, AC_ACQUIRE) -
+           ac_atomic_load(&ring->head, AC_ACQUIRE);
+}
+
+/* Both operands of a never-taken conditional must have compatible pointer
+   types, which type-checks the elements passed to the macros below. */
+#define ac_ring_checked(SLOT_PTR, PTR) (0 ? (SLOT_PTR) : (PTR))
+
+/** @brief Create a queue holding at least CAP elements. */
+#define ac_spsc_new(Q, CAP)                                                   \
+    ac_generic_assign((Q).slots,                                              \
+                      ac_ring_new(&(Q).ring, CAP, sizeof(*(Q).slots)))
+
+/** @brief Free the memory of a queue. */
+#define ac_spsc_free(Q) free((Q).slots)
+
+/** @brief Push up to N elements from array B, returning how many fit. */
+#define ac_spsc_push_n(Q, B, N)                                               \
+    ac_spsc_push_n_raw(&(Q).ring, (Q).slots,                                  \
+                       ac_ring_checked((Q).slots, (B)), N,                    \
+                       sizeof(*(Q).slots))
+
+/** @brief Pop up to N elements into array B, returning how many there
+ * were. */
+#define ac_spsc_pop_n(Q, B, N)                                                \
+    ac_spsc_pop_n_raw(&(Q).ring, (Q).slots,                                   \
+                      ac_ring_checked((Q).slots, (B)), N, sizeof(*(Q).slots))
+
+/** @brief Push element E, returning false if the queue is full. */
+#define ac_spsc_push(Q, E) (ac_spsc_push_n(Q, &(E), 1) == 1)
+
+/** @brief Pop into element E, returning false if the queue is empty. */
+#define ac_spsc_pop(Q, E) (ac_spsc_pop_n(Q, &(E), 1) == 1)
+
+/** @brief Number of elements in a queue. Exact only when no other thread is
+ * using it. */
+#define ac_spsc_len(Q) ac_ring_len(&(Q).ring)
+
+/** @brief Create a queue holding at least CAP elements. */
+#define ac_mpsc_new(Q, CAP)                                                   \
+    ac_generic_assign((Q).slots,                                              \
+                      ac_ring_new(&(Q).ring, CAP, sizeof(*(Q).slots)))
+
+/** @brief Free the memory of a queue. */
+#define ac_mpsc_free(Q) free((Q).slots)
+
+/** @brief Internal macro expanding to the slot layout arguments. */
+#define ac_mpsc_layout(Q)                                                     \
+    sizeof(*(Q).slots),                                                       \
+        (size_t)((char *)&(Q).slots->val - (char *)(Q).slots),                \
+        sizeof((Q).slots->val)
+
+/** @brief Push up to N elements from array B, returning how many fit. Safe
+ * to call from any number of threads. */
+#define ac_mpsc_push_n(Q, B, N)                                               \
+    ac_mpsc_push_n_raw(&(Q).ring, (Q).slots,                                  \
+                       ac_ring_checked(&(Q).slots->val, (B)), N,              \
+                       ac_mpsc_layout(Q))
+
+/** @brief Pop up to N elements into array B, returning how many were
+ * ready. Only one thread may pop. */
+#define ac_mpsc_pop_n(Q, B, N)                                                \
+    ac_mpsc_pop_n_raw(&(Q).ring, (Q).slots,                                   \
+                      ac_ring_checked(&(Q).slots->val, (B)), N,               \
+                      ac_mpsc_layout(Q))
+
+/** @brief Push element E, returning false if the queue is full. */
+#define ac_mpsc_push(Q, E) (ac_mpsc_push_n(Q, &(E), 1) == 1)
+
+/** @brief Pop into element E, returning false if no element is ready. */
+#define ac_mpsc_pop(Q, E) (ac_mpsc_pop_n(Q, &(E), 1) == 1)
+
+/** @brief Number of elements in a queue, including ones still being
+ * written. Exact only when no other thread is using it. */
+#define ac_mpsc_len(Q) ac_ring_len(&(Q).ring)
 
 #endif
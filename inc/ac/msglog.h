@@ -0,0 +1,161 @@
+#ifndef AC_MSGLOG_H
+#define AC_MSGLOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include <ac/meta.h>
+#include <ac/str.h>
+
+/* -------------------------------------------------------------------------
+   Message log.
+   Every chat line and whisper is appended to a directory of segment files,
+   each starting with an 8-byte magic and followed by records:
+
+       u32 len    length of the body
+       u32 crc    CRC-32C of the body
+       body       u64 time_ms, u8 kind, u8 from_len, u8 to_len, u8 0,
+                  from, to, text
+
+   All integers are little-endian. Records are encoded on the event loop
+   into a pending buffer, which is handed to a commit thread at the end of
+   every tick. The commit thread writes whatever has gathered and syncs it
+   with a single fdatasync(), at most once every AC_MSGLOG_COMMIT_MS, so the
+   event loop never waits on the disk. A segment is closed for a new one once
+   it passes AC_MSGLOG_SEGMENT_SIZE.
+
+   A batch that fails to write is cut back off the segment and kept, to be
+   retried every AC_MSGLOG_RETRY_MS. One that fails to sync is cut off too,
+   and retried in a new segment. Opening the log truncates a torn record
+   left at the end of the newest segment by a crash. Damaged bytes with
+   intact records after them are left in place and skipped by readers, see
+   ac_msglog_resync().
+   ------------------------------------------------------------------------- */
+
+#define AC_MSGLOG_SEGMENT_SIZE (64 * 1024 * 1024)
+#define AC_MSGLOG_COMMIT_MS    20
+#define AC_MSGLOG_RETRY_MS     1000
+
+/** @brief Most bytes of records kept while writes fail. Records beyond it
+ * are dropped, and the loss logged. */
+#define AC_MSGLOG_BACKLOG_MAX (64 * 1024 * 1024)
+
+/** @brief Bytes in front of the records of a segment, and in front of the
+ * body of a record. */
+#define AC_MSGLOG_SEGMENT_HEADER 8
+#define AC_MSGLOG_RECORD_HEADER  8
+
+/** @brief Largest body of a record. Larger lengths mark a torn record. */
+#define AC_MSGLOG_BODY_MAX (64 * 1024)
+
+typedef enum ac_msg_kind_e {
+    AC_MSG_CHAT    = 1,
+    AC_MSG_WHISPER = 2
+} ac_msg_kind_t;
+
+/** @brief A logged message. Views point into the log's data. */
+typedef struct ac_msg_s {
+    ac_msg_kind_t kind;
+    /** @brief Milliseconds since the epoch. */
+    uint64_t time_ms;
+    ac_str_view_t from;
+    /** @brief Recipient of a whisper, empty for chat. */
+    ac_str_view_t to;
+    ac_str_view_t text;
+} ac_msg_t;
+
+typedef enum ac_msglog_status_e {
+    AC_MSGLOG_OK,
+    /** @brief No bytes left. */
+    AC_MSGLOG_END,
+    /** @brief The bytes left are not a whole, intact record. */
+    AC_MSGLOG_TORN
+} ac_msglog_status_t;
+
+typedef struct ac_msglog_s {
+    char *dir;
+    /** @brief Newest segment, its index and its size. Owned by the commit
+     * thread once the log is open. */
+    int fd;
+    uint64_t segment;
+    uint64_t size;
+
+    /** @brief Records encoded since the last hand-off. Event loop only. */
+    ac_bytes_t pending;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    /** @brief Records handed off and not yet taken by the commit thread.
+     * Guarded by the lock, like stop. */
+    ac_bytes_t queued;
+    bool stop;
+    /** @brief Records being written, kept until they are. Commit thread
+     * only. */
+    ac_bytes_t writing;
+} ac_msglog_t;
+
+/** @brief CRC-32C, continuing from CRC (0 to start). */
+uint32_t ac_crc32c(uint32_t crc, const void *data, size_t len);
+
+/**
+ * @brief Open the log in DIR, creating it if needed, recover the newest
+ * segment and start the commit thread.
+ *
+ * @return true on success. On failure nothing is left open.
+ */
+bool ac_msglog_open(ac_msglog_t *log, const char *dir);
+
+/** @brief Commit everything appended so far and close the log. */
+void ac_msglog_close(ac_msglog_t *log);
+
+/** @brief Encode a message into the pending records. Names and text longer
+ * than a record holds are cut. */
+void ac_msglog_append(ac_msglog_t *log, const ac_msg_t *msg);
+
+/** @brief Hand the pending records to the commit thread. Call once a tick.
+ */
+void ac_msglog_commit(ac_msglog_t *log);
+
+/**
+ * @brief Decode the record at *POS of a segment's records.
+ *
+ * @param data The segment.
+ * @param len Length of the segment.
+ * @param pos Offset of the record, advanced past it on success.
+ * @param msg Set to the message on success.
+ * @return AC_MSGLOG_OK, AC_MSGLOG_END at the end or AC_MSGLOG_TORN.
+ */
+ac_msglog_status_t ac_msglog_decode(const unsigned char *data, size_t len,
+                                    size_t *pos, ac_msg_t *msg);
+
+/**
+ * @brief Find the next intact record after damage, by trying every offset
+ * from POS on.
+ *
+ * @param data The segment.
+ * @param len Length of the segment.
+ * @param pos Where to start looking.
+ * @return Offset of the record, or LEN if no intact record follows.
+ */
+size_t ac_msglog_resync(const unsigned char *data, size_t len, size_t pos);
+
+/** @brief Whether a segment starts with the segment magic. */
+bool ac_msglog_segment_valid(const unsigned char *data, size_t len);
+
+/**
+ * @brief List the segment indices in DIR in ascending order.
+ *
+ * @param dir The log directory.
+ * @param segments A new array, set to the indices.
+ * @return true on success.
+ */
+bool ac_msglog_segments(const char *dir, ac_arr(uint64_t) *segments);
+
+/** @brief Format the path of a segment. */
+void ac_msglog_segment_path(char *buf, size_t size, const char *dir,
+                            uint64_t segment);
+
+#endif
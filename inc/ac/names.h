@@ -0,0 +1,80 @@
+#ifndef AC_NAMES_H
+#define AC_NAMES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <ac/intern.h>
+#include <ac/meta.h>
+
+/* -------------------------------------------------------------------------
+   Ordered name index.
+   A sorted array of atoms, ordered by their bytes, so names sharing a prefix
+   are contiguous and found with two binary searches. Byte order of UTF-8 is
+   code point order, and matching is case-sensitive. Inserting and removing
+   move at most 4 bytes per indexed name, which stays cheaper than a tree
+   for the thousands of users a server holds.
+   ------------------------------------------------------------------------- */
+
+typedef struct ac_name_index_s {
+    ac_arr(ac_atom_t) names;
+} ac_name_index_t;
+
+/** @brief A run of consecutive positions in a name index. */
+typedef struct ac_name_range_s {
+    size_t first;
+    size_t count;
+} ac_name_range_t;
+
+void ac_name_index_new(ac_name_index_t *index);
+void ac_name_index_free(ac_name_index_t *index);
+
+/**
+ * @brief Add a name to the index. The index does not take a reference.
+ *
+ * @param index The index.
+ * @param name The name to add.
+ * @return true if the name was added, false if it was already present.
+ */
+bool ac_name_index_insert(ac_name_index_t *index, ac_atom_t name);
+
+/**
+ * @brief Remove a name from the index.
+ *
+ * @param index The index.
+ * @param name The name to remove.
+ * @return true if the name was removed, false if it was not present.
+ */
+bool ac_name_index_remove(ac_name_index_t *index, ac_atom_t name);
+
+/** @brief Get the number of names in the index. */
+size_t ac_name_index_len(const ac_name_index_t *index);
+
+/** @brief Get the name at a position, in byte order. */
+ac_atom_t ac_name_index_at(const ac_name_index_t *index, size_t i);
+
+/**
+ * @brief Find the names starting with a prefix in O(log n).
+ *
+ * @param index The index.
+ * @param prefix The bytes of the prefix, empty to match every name.
+ * @param len The length of the prefix.
+ * @return The positions of the matching names, in byte order.
+ */
+ac_name_range_t ac_name_index_prefix(const ac_name_index_t *index,
+                                     const char *prefix, size_t len);
+
+/**
+ * @brief Get the longest prefix shared by every name in a range, which is
+ * the prefix shared by its first and last name. Never ends inside a UTF-8
+ * sequence.
+ *
+ * @param index The index.
+ * @param range A non-empty range of positions.
+ * @return The length in bytes of the common prefix of the range's names.
+ */
+size_t ac_name_index_common_prefix(const ac_name_index_t *index,
+                                   ac_name_range_t range);
+
+#endif
@@ -3,12 +3,17 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <time.h>
 #include <arpa/inet.h>
 
 #include <ac/meta.h>
+#include <ac/pool.h>
 
 #define AC_CLIENTS_MAX 50
 
+/** @brief Seconds between giving unused I/O buffers back to the heap. */
+#define AC_BUF_TRIM_INTERVAL 60
+
 typedef int ac_socket_t;
 typedef int ac_client_handle_t;
 
@@ -18,6 +23,19 @@ typedef enum ac_client_state_e {
     AC_CLIENT_STATE_TO_BE_REMOVED
 } ac_client_state_t;
 
+/** @brief Received data and how far it has been split into lines. */
+typedef struct ac_input_s {
+    ac_bytes_t buf;
+    /** @brief Bytes at the front already handed out as lines. */
+    size_t consumed;
+    /** @brief Bytes at the front already scanned for a line end. */
+    size_t scanned;
+    /** @brief Where the last line handed out starts, for ac_unget_line(). */
+    size_t line_start;
+    /** @brief Lines dropped for being ill-formed UTF-8. */
+    size_t rejected;
+} ac_input_t;
+
 typedef struct ac_client_s {
     union {
         ac_client_handle_t handle;
@@ -27,29 +45,60 @@ typedef struct ac_client_s {
     ac_client_state_t state;
 
     /* Received data. */
-    ac_bytes_t in;
+    ac_input_t in;
 
-    /* Outgoing data. */
-    ac_bytes_t out;
+    /* Outgoing data. Kept out of line so that its address stays valid while
+       the client map moves entries. */
+    ac_bytes_t *out;
 
     char ip[INET_ADDRSTRLEN];
 } ac_client_t;
 
-typedef ac_map(ac_client_handle_t, ac_client_t) ac_handle_to_client_map_t;
 uint64_t ac_handle_hash(const ac_client_handle_t *handle);
 bool ac_handle_eq(const ac_client_handle_t *a, const ac_client_handle_t *b);
 
+AC_MAP_DECLARE(ac_client_map, ac_client_handle_t, ac_client_t, ac_handle_hash,
+               ac_handle_eq);
+
 typedef struct ac_server_s {
     ac_socket_t listener;
-    ac_handle_to_client_map_t clients;
+    ac_client_map_t clients;
+
+    /** @brief Storage for the clients' output queues. */
+    ac_pool_t out_queues;
+
+    /** @brief Recycles client in and out buffers across connections. */
+    ac_buf_pool_t buffers;
+    /** @brief Time of the last buffer pool trim. */
+    time_t last_trim;
 } ac_server_t;
 
 void ac_server_new(ac_server_t *server);
 void ac_server_free(ac_server_t *server);
 void ac_server_listen(ac_server_t *server, int port);
-void ac_server_poll(ac_server_t *server);
+
+/**
+ * @brief Wait for and handle network events, then flush output.
+ *
+ * @param server The server.
+ * @param idle_timeout Milliseconds to wait at most while no client is
+ * connected, or -1 to wait for a connection.
+ */
+void ac_server_poll(ac_server_t *server, int idle_timeout);
+
 void ac_server_remove_client(ac_server_t *server, ac_client_handle_t handle);
 void ac_server_send(ac_server_t *server, ac_client_handle_t handle,
                     const ac_bytes_t data);
 
+/**
+ * @brief Get a client's output queue, for appending to directly. The queue
+ * stays at the same address until the client is disconnected.
+ *
+ * @param server The server.
+ * @param handle The client's handle.
+ * @return The client's output queue.
+ */
+ac_bytes_t *ac_server_out_queue(ac_server_t *server,
+                                ac_client_handle_t handle);
+
 #endif
@@ -0,0 +1,132 @@
+#ifndef AC_POOL_H
+#define AC_POOL_H
+
+#include <stddef.h>
+
+#include <ac/meta.h>
+
+/** @brief Alignment of every pooled object and buffer. */
+#define AC_POOL_ALIGN 16
+
+/** @brief Number of buffer size classes, from AC_BUF_POOL_MIN bytes up,
+ * doubling each time. Larger buffers go straight to the heap. */
+#define AC_BUF_POOL_CLASSES 8
+#define AC_BUF_POOL_MIN     64
+
+/** @brief Allocation counters kept by every pool. */
+typedef struct ac_pool_stats_s {
+    /** @brief Blocks handed out. */
+    size_t allocs;
+    /** @brief Blocks handed out from a freelist rather than the heap. */
+    size_t reuses;
+    /** @brief Blocks given back. */
+    size_t frees;
+    /** @brief Blocks currently handed out. */
+    size_t live;
+    /** @brief Highest number of live blocks. */
+    size_t high_water;
+} ac_pool_stats_t;
+
+/**
+ * @brief Slab pool of fixed-size objects.
+ *
+ * Objects are carved out of slabs holding a fixed number of them and
+ * released objects go onto an intrusive freelist, so steady connect and
+ * disconnect churn causes no heap traffic. Slabs are kept until the pool is
+ * freed.
+ */
+typedef struct ac_pool_s {
+    /** @brief Object size rounded up to AC_POOL_ALIGN. */
+    size_t obj_size;
+    /** @brief Objects per slab. */
+    size_t per_slab;
+
+    /** @brief Released objects. */
+    void *free_list;
+    /** @brief All slabs, linked through their headers. */
+    void *slabs;
+
+    ac_pool_stats_t stats;
+} ac_pool_t;
+
+/**
+ * @brief Size-class buffer pool.
+ *
+ * Recycles buffer capacity through one freelist per power-of-two size
+ * class. Growing a buffer within its class is free. Cached blocks above the
+ * recent high-water mark are given back by ac_buf_pool_trim().
+ */
+typedef struct ac_buf_pool_s {
+    /** @brief Allocator interface backed by this pool, for use with
+     * ac_arr_new_a(). */
+    ac_allocator_t allocator;
+
+    /** @brief Cached blocks of each class. */
+    void *free_list[AC_BUF_POOL_CLASSES];
+    /** @brief Number of cached blocks of each class. */
+    size_t cached[AC_BUF_POOL_CLASSES];
+    /** @brief Number of live blocks of each class. */
+    size_t live[AC_BUF_POOL_CLASSES];
+    /** @brief Highest number of live blocks of each class since the last
+     * trim. */
+    size_t peak[AC_BUF_POOL_CLASSES];
+
+    ac_pool_stats_t stats;
+} ac_buf_pool_t;
+
+/**
+ * @brief Create an object pool.
+ *
+ * @param pool The pool to initialize.
+ * @param obj_size The size of each object in bytes.
+ * @param per_slab The number of objects allocated at once.
+ */
+void ac_pool_new(ac_pool_t *pool, size_t obj_size, size_t per_slab);
+
+/**
+ * @brief Free all memory owned by an object pool, including live objects.
+ *
+ * @param pool The pool to free.
+ */
+void ac_pool_free(ac_pool_t *pool);
+
+/**
+ * @brief Allocate an object.
+ *
+ * @param pool The pool to allocate from.
+ * @return Uninitialized memory aligned to AC_POOL_ALIGN.
+ */
+void *ac_pool_alloc(ac_pool_t *pool);
+
+/**
+ * @brief Give an object back to its pool.
+ *
+ * @param pool The pool it was allocated from.
+ * @param obj The object.
+ */
+void ac_pool_release(ac_pool_t *pool, void *obj);
+
+/**
+ * @brief Create a buffer pool.
+ *
+ * @param pool The pool to initialize.
+ */
+void ac_buf_pool_new(ac_buf_pool_t *pool);
+
+/**
+ * @brief Free all cached buffers. Live buffers must already be freed.
+ *
+ * @param pool The pool to free.
+ */
+void ac_buf_pool_free(ac_buf_pool_t *pool);
+
+/**
+ * @brief Give back cached buffers that were not needed to reach the
+ * high-water mark since the last trim, then start a new window.
+ *
+ * @param pool The pool to trim.
+ * @return The number of buffers freed.
+ */
+size_t ac_buf_pool_trim(ac_buf_pool_t *pool);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef AC_RATE_H
+#define AC_RATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* -------------------------------------------------------------------------
+   Token buckets.
+   A bucket holds up to `burst` tokens and refills at `per_sec` tokens a
+   second; every admitted event takes one. Levels are kept in thousandths of
+   a token so that refilling is exact integer arithmetic on milliseconds.
+   Buckets read the time from the caller, who is expected to sample the
+   clock once per tick rather than once per event.
+   ------------------------------------------------------------------------- */
+
+/** @brief Thousandths of a token per token. */
+#define AC_TOKEN 1000u
+
+/** @brief How fast events may come, on average and in a burst. */
+typedef struct ac_rate_limit_s {
+    uint32_t per_sec;
+    uint32_t burst;
+} ac_rate_limit_t;
+
+typedef struct ac_bucket_s {
+    /** @brief Tokens left, in thousandths of a token. */
+    uint64_t level;
+    /** @brief Time of the last refill, in milliseconds. */
+    uint64_t stamp;
+} ac_bucket_t;
+
+/** @brief Milliseconds on a monotonic clock. */
+uint64_t ac_clock_ms(void);
+
+/** @brief Start a bucket full at time NOW. */
+void ac_bucket_new(ac_bucket_t *bucket, const ac_rate_limit_t *limit,
+                   uint64_t now);
+
+/**
+ * @brief Take a token if one is available at time NOW.
+ *
+ * @return true if the event is within the limit, false otherwise.
+ */
+bool ac_bucket_take(ac_bucket_t *bucket, const ac_rate_limit_t *limit,
+                    uint64_t now);
+
+/** @brief Milliseconds from the last refill until a token is available. */
+uint64_t ac_bucket_wait(const ac_bucket_t *bucket,
+                        const ac_rate_limit_t *limit);
+
+#endif
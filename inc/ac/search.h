@@ -0,0 +1,114 @@
+#ifndef AC_SEARCH_H
+#define AC_SEARCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <ac/meta.h>
+#include <ac/str.h>
+
+/* -------------------------------------------------------------------------
+   Chat search index.
+   Recent chat lines are kept in a window bounded by age and by size, and an
+   inverted index maps every term to the lines containing it. Lines get
+   consecutive ids, so a term's postings are ascending ids stored as the
+   first id followed by LEB128 varint deltas, mostly one byte each. Adding a
+   line appends to the postings of its terms; dropping the oldest line pops
+   it off the front of theirs, since it is the first posting of each. Both
+   touch only the terms of that line, so the index costs a few map lookups
+   per chat line.
+
+   Terms are runs of letters, digits and non-ASCII bytes, with ASCII letters
+   folded to lower case and cut to AC_SSTR_INLINE bytes, so they are kept
+   inline in the map keys.
+   ------------------------------------------------------------------------- */
+
+/** @brief Age, and total text bytes, beyond which the oldest lines are
+ * dropped. */
+#define AC_SEARCH_WINDOW_MS (60 * 60 * 1000)
+#define AC_SEARCH_MAX_BYTES (1024 * 1024)
+
+/** @brief Most terms of a query that are looked up. */
+#define AC_SEARCH_QUERY_TERMS 8
+
+typedef struct ac_search_term_s {
+    /** @brief First and last posting and the number of postings. */
+    uint64_t first;
+    uint64_t last;
+    size_t count;
+    /** @brief Varint deltas from the first posting on, starting at offset
+     * start. NULL until the term has a second posting. */
+    ac_bytes_t deltas;
+    size_t start;
+} ac_search_term_t;
+
+AC_MAP_DECLARE(ac_search_terms, ac_sstr_t, ac_search_term_t, ac_sstr_hash,
+               ac_sstr_eq);
+
+typedef struct ac_search_doc_s {
+    /** @brief When the line was said, in monotonic milliseconds. */
+    uint64_t time_ms;
+    /** @brief Logical position of the name followed by the text. */
+    uint64_t pos;
+    uint32_t from_len;
+    uint32_t text_len;
+} ac_search_doc_t;
+
+/** @brief A line found by a search. Views point into the index and are
+ * valid until the next line is added. */
+typedef struct ac_search_hit_s {
+    uint64_t time_ms;
+    ac_str_view_t from;
+    ac_str_view_t text;
+} ac_search_hit_t;
+
+typedef struct ac_search_s {
+    ac_search_terms_t terms;
+
+    /** @brief Lines in the window from index head on. The line at index I
+     * has the id first_id + I - head. */
+    ac_arr(ac_search_doc_t) docs;
+    size_t head;
+    uint64_t first_id;
+
+    /** @brief Names and texts of the lines. The byte at logical position P
+     * is at P - text_base. */
+    ac_bytes_t text;
+    uint64_t text_base;
+    size_t text_bytes;
+
+    /** @brief Decoded postings while a query runs. */
+    ac_arr(uint64_t) matches;
+} ac_search_t;
+
+void ac_search_new(ac_search_t *search);
+void ac_search_free(ac_search_t *search);
+
+/**
+ * @brief Add a chat line to the index, dropping lines that left the window.
+ *
+ * @param search The index.
+ * @param now Monotonic milliseconds.
+ * @param from Who said the line.
+ * @param text The line.
+ */
+void ac_search_add(ac_search_t *search, uint64_t now, ac_str_view_t from,
+                   ac_str_view_t text);
+
+/** @brief Drop lines older than AC_SEARCH_WINDOW_MS. */
+void ac_search_expire(ac_search_t *search, uint64_t now);
+
+/**
+ * @brief Find the newest lines containing every term of a query.
+ *
+ * @param search The index.
+ * @param query Words to look for.
+ * @param hits Set to the lines found, newest first.
+ * @param max The most lines to find.
+ * @return The number of lines found, 0 if the query has no terms.
+ */
+size_t ac_search_find(ac_search_t *search, ac_str_view_t query,
+                      ac_search_hit_t *hits, size_t max);
+
+#endif
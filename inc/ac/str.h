@@ -11,9 +11,182 @@ typedef ac_arr(char) ac_string_t;
 typedef ac_map(ac_string_t, int) ac_string_to_int_map_t;
 typedef ac_map(ac_string_t, ac_string_t) ac_string_to_string_map_t;
 
+/** @brief Seed the string hash from /dev/urandom. Call once at startup,
+ * before any map keyed on strings is populated. */
+void ac_string_hash_init(void);
+
+/** @brief Set the string hash seed explicitly, e.g. for reproducible tests.
+ *
+ * @param seed The new seed.
+ */
+void ac_string_hash_seed(uint64_t seed);
+
+/** @brief Seeded 64-bit hash of a byte range, read 8 bytes at a time in the
+ * style of wyhash.
+ *
+ * @param data The bytes to hash.
+ * @param len The number of bytes.
+ * @return The hash.
+ */
+uint64_t ac_hash_bytes(const void *data, size_t len);
+
+/** @brief Compare two byte ranges of equal length a word at a time.
+ *
+ * @param a The first range.
+ * @param b The second range.
+ * @param len The number of bytes in each range.
+ * @return true if the ranges are equal, false otherwise.
+ */
+bool ac_bytes_eq(const void *a, const void *b, size_t len);
+
 uint64_t ac_string_hash(const ac_string_t *key);
 bool ac_string_eq(const ac_string_t *a, const ac_string_t *b);
 
+/* -------------------------------------------------------------------------
+   Small string with inline storage.
+   Strings of up to AC_SSTR_INLINE bytes are stored inside the struct, with
+   unused bytes zeroed, and longer ones spill to the heap. Usernames and
+   command tokens always fit inline, so they need no allocation and map
+   lookups compare them without chasing a pointer.
+   ------------------------------------------------------------------------- */
+
+#define AC_SSTR_INLINE 20
+
+typedef struct ac_sstr_s {
+    uint32_t len;
+    union {
+        char buf[AC_SSTR_INLINE];
+        char *ptr;
+    } data;
+} ac_sstr_t;
+
+/** @brief Expand to the arguments of a "%.*s" conversion for a small
+ * string. */
+#define ac_sstr_fmt_args(S) (int)ac_sstr_len(S), ac_sstr_data(S)
+
+/** @brief Create an empty small string. */
+void ac_sstr_new(ac_sstr_t *str);
+
+/** @brief Replace the contents of a small string.
+ *
+ * @param str The string to assign to, created with ac_sstr_new().
+ * @param data The bytes to copy.
+ * @param len The number of bytes.
+ */
+void ac_sstr_set(ac_sstr_t *str, const char *data, size_t len);
+
+/** @brief Free the heap storage of a small string, if any. */
+void ac_sstr_free(ac_sstr_t *str);
+
+/** @brief Get the length of a small string. */
+static inline size_t ac_sstr_len(const ac_sstr_t *str) {
+    return str->len;
+}
+
+/** @brief Get the bytes of a small string. Not NUL-terminated. */
+static inline const char *ac_sstr_data(const ac_sstr_t *str) {
+    return str->len <= AC_SSTR_INLINE ? str->data.buf : str->data.ptr;
+}
+
+/** @brief Hash a small string. Equal to ac_string_hash() of the same bytes.
+ */
+uint64_t ac_sstr_hash(const ac_sstr_t *key);
+
+/** @brief Compare two small strings for equality. */
+bool ac_sstr_eq(const ac_sstr_t *a, const ac_sstr_t *b);
+
+/* -------------------------------------------------------------------------
+   Borrowed string views and line scanning.
+   ------------------------------------------------------------------------- */
+
+/** @brief A non-owning view of bytes owned by someone else, such as a line
+ * inside a client's input buffer. */
+typedef struct ac_str_view_s {
+    const char *data;
+    size_t len;
+} ac_str_view_t;
+
+/** @brief Expand to the arguments of a "%.*s" conversion for a view. */
+#define ac_str_view_fmt_args(V) (int)(V).len, (V).data
+
+/** @brief Find the first CR or LF in a byte range, 16 or 32 bytes at a time
+ * where SSE2 or AVX2 is available.
+ *
+ * @param data The bytes to scan.
+ * @param len The number of bytes.
+ * @return The index of the first CR or LF, or LEN if there is none.
+ */
+size_t ac_find_eol(const char *data, size_t len);
+
+/* -------------------------------------------------------------------------
+   UTF-8 validation and sanitizing.
+   ------------------------------------------------------------------------- */
+
+/** @brief Code point reported by ac_utf8_decode() for ill-formed input. */
+#define AC_UTF8_BAD UINT32_MAX
+
+/** @brief Length returned by ac_utf8_sanitize() for rejected input. */
+#define AC_UTF8_INVALID SIZE_MAX
+
+/** @brief What ac_utf8_sanitize() does with ill-formed UTF-8. */
+typedef enum ac_utf8_policy_e {
+    /** @brief Replace each maximal ill-formed subpart with '?'. */
+    AC_UTF8_REPLACE,
+    /** @brief Reject the input as a whole. */
+    AC_UTF8_REJECT
+} ac_utf8_policy_t;
+
+/** @brief Decode the code point at the start of a byte range.
+ *
+ * Only well-formed sequences as defined by the Unicode standard are accepted:
+ * no overlong forms, surrogates or code points above U+10FFFF.
+ *
+ * @param data The bytes to decode.
+ * @param len The number of bytes, at least 1.
+ * @param cp Set to the code point, or AC_UTF8_BAD if the sequence is
+ *           ill-formed.
+ * @return The number of bytes consumed. For ill-formed input this is the
+ *         maximal subpart, at least 1.
+ */
+size_t ac_utf8_decode(const char *data, size_t len, uint32_t *cp);
+
+/** @brief Check whether a byte range is well-formed UTF-8.
+ *
+ * ASCII is skipped 16 bytes at a time where SSE2 is available. With SSSE3,
+ * the rest is validated 16 bytes at a time by table lookups on nibbles of
+ * each byte and the three before it, as in simdutf.
+ *
+ * @param data The bytes to check.
+ * @param len The number of bytes.
+ * @return true if the bytes are well-formed UTF-8, false otherwise.
+ */
+bool ac_utf8_valid(const char *data, size_t len);
+
+/** @brief Strip control characters (C0, DEL and C1) in place, keeping the
+ * order of the rest and every well-formed non-ASCII character. Runs of
+ * printable ASCII are moved 16 at a time where SSE2 is available.
+ *
+ * @param data The bytes to sanitize.
+ * @param len The number of bytes.
+ * @param policy What to do with ill-formed UTF-8.
+ * @return The number of bytes kept, or AC_UTF8_INVALID if the input was
+ *         rejected, in which case it is left unchanged.
+ */
+size_t ac_utf8_sanitize(char *data, size_t len, ac_utf8_policy_t policy);
+
+/** @brief Check whether a code point may appear in a username.
+ *
+ * ASCII is limited to letters, digits and underscores. Other code points are
+ * allowed unless they are controls, spaces, punctuation, symbols, combining
+ * marks that stack on Latin, Greek or Cyrillic letters, blank fillers,
+ * invisible or private use characters, or look-alike forms such as fullwidth
+ * or mathematical letters.
+ *
+ * @param cp The code point, which must not be AC_UTF8_BAD.
+ * @return true if the code point is allowed, false otherwise.
+ */
+bool ac_utf8_name_char(uint32_t cp);
+
 /** @brief Compare two strings for equality, ignoring case.
  *
  * @param a The first string.
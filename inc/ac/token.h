@@ -0,0 +1,58 @@
+#ifndef AC_TOKEN_H
+#define AC_TOKEN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <ac/str.h>
+
+/* -------------------------------------------------------------------------
+   Session tokens.
+   128 random bits handed to a user, who proves with them that a new
+   connection continues an old session. Tokens are shown and entered as 32
+   lower case hex digits. The all-zero token is never issued and stands for
+   no token.
+   ------------------------------------------------------------------------- */
+
+/** @brief Length of a token in hex digits. */
+#define AC_TOKEN_HEX 32
+
+typedef struct ac_token_s {
+    uint64_t hi;
+    uint64_t lo;
+} ac_token_t;
+
+/** @brief The token standing for no token. */
+#define AC_TOKEN_NONE ((ac_token_t){0, 0})
+
+/**
+ * @brief Draw a new token from the kernel's random source.
+ *
+ * @return false if no random bytes could be had, TOKEN is then
+ * AC_TOKEN_NONE.
+ */
+bool ac_token_new(ac_token_t *token);
+
+/** @brief Whether a token is AC_TOKEN_NONE. */
+bool ac_token_none(ac_token_t token);
+
+/** @brief Write a token as AC_TOKEN_HEX digits, not NUL-terminated. */
+void ac_token_format(ac_token_t token, char *out);
+
+/**
+ * @brief Read a token written by ac_token_format(). Upper case digits are
+ * accepted as well.
+ *
+ * @return false if TEXT is not AC_TOKEN_HEX hex digits, or is all zeros.
+ */
+bool ac_token_parse(ac_str_view_t text, ac_token_t *token);
+
+/** @brief Hash a token for use as a map key. Tokens are random, so their
+ * bits are used as is. */
+uint64_t ac_token_hash(const ac_token_t *token);
+
+/** @brief Compare two tokens for use as map keys. */
+bool ac_token_eq(const ac_token_t *a, const ac_token_t *b);
+
+#endif
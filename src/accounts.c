@@ -0,0 +1,514 @@
+#include <ac/accounts.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/random.h>
+#include <sys/stat.h>
+
+#include <ac/log.h>
+
+/* "ACACCNTS" in little-endian byte order. */
+#define AC_ACCOUNTS_MAGIC 0x53544e4343414341ull
+
+/** @brief Slots copied per turn of the lock while growing, so adds on the
+ * event loop wait for little more than one batch. */
+#define AC_ACCOUNTS_COPY_BATCH 4096
+
+static size_t ac_accounts_size(uint64_t slots) {
+    return AC_ACCOUNTS_HEADER + (size_t)slots * sizeof(ac_account_t);
+}
+
+/** @brief FNV-1a over the name, started from the seed and mixed at the
+ * end so the low bits used for the slot depend on every byte. */
+static uint64_t ac_accounts_hash(uint64_t seed, ac_str_view_t name) {
+    uint64_t h = seed ^ 0xcbf29ce484222325ull;
+
+    for (size_t i = 0; i < name.len; i++) {
+        h ^= (unsigned char)name.data[i];
+        h *= 0x100000001b3ull;
+    }
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h;
+}
+
+/** @brief Find the slot of a name, or the free slot where it would go. */
+static ac_account_t *ac_accounts_probe(ac_account_t *slots, uint64_t count,
+                                       uint64_t seed, ac_str_view_t name) {
+    uint64_t mask = count - 1;
+    uint64_t i    = ac_accounts_hash(seed, name) & mask;
+
+    for (;; i = (i + 1) & mask) {
+        ac_account_t *slot = &slots[i];
+
+        if (slot->name_len == 0 ||
+            (slot->name_len == name.len &&
+             memcmp(slot->name, name.data, name.len) == 0)) {
+            return slot;
+        }
+    }
+}
+
+/** @brief Map a store file of SIZE bytes. */
+static bool ac_accounts_map(ac_accounts_table_t *table, int fd, size_t size) {
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+
+    table->fd    = fd;
+    table->hdr   = map;
+    table->slots = (ac_account_t *)((char *)map + AC_ACCOUNTS_HEADER);
+    return true;
+}
+
+static void ac_accounts_unmap(ac_accounts_table_t *table) {
+    munmap(table->hdr, ac_accounts_size(table->hdr->slots));
+    close(table->fd);
+
+    table->fd    = -1;
+    table->hdr   = NULL;
+    table->slots = NULL;
+}
+
+/** @brief Create an empty store of SLOTS slots in FD, with SEED. */
+static bool ac_accounts_init(int fd, uint64_t slots, uint64_t seed) {
+    if (ftruncate(fd, (off_t)ac_accounts_size(slots)) == -1) {
+        return false;
+    }
+
+    ac_accounts_header_t hdr = {AC_ACCOUNTS_MAGIC, slots, 0, seed};
+    return pwrite(fd, &hdr, sizeof hdr, 0) == (ssize_t)sizeof hdr;
+}
+
+/** @brief Write an account into its slot of a table, unless the name has
+ * one already. Call with the lock held once the store is open.
+ *
+ * @return The slot of the name.
+ */
+static ac_account_t *ac_accounts_insert(const ac_accounts_table_t *table,
+                                        const ac_account_t *account) {
+    ac_str_view_t name = {account->name, account->name_len};
+    ac_account_t *slot = ac_accounts_probe(table->slots, table->hdr->slots,
+                                           table->hdr->seed, name);
+
+    if (slot->name_len == 0) {
+        /* Fill the slot before marking it used, so a crash in between
+           leaves it free. */
+        ac_account_t copy = *account;
+        copy.name_len     = 0;
+        *slot             = copy;
+        slot->name_len    = account->name_len;
+
+        table->hdr->len++;
+    }
+    return slot;
+}
+
+/** @brief Sync the pages of written slots, and then the headers. */
+static void ac_accounts_sync(const ac_accounts_dirty_t *dirty, size_t len) {
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+
+    for (size_t i = 0; i < len; i++) {
+        uintptr_t start = (uintptr_t)dirty[i].slot & ~(page - 1);
+        uintptr_t end   = (uintptr_t)(dirty[i].slot + 1);
+
+        if (msync((void *)start, end - start, MS_SYNC) == -1) {
+            ac_log_fmt(AC_LOG_ERROR, "Accounts: msync() failed: %s.",
+                       strerror(errno));
+        }
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        if (i > 0 && dirty[i].hdr == dirty[i - 1].hdr) {
+            continue;
+        }
+        if (msync(dirty[i].hdr, AC_ACCOUNTS_HEADER, MS_SYNC) == -1) {
+            ac_log_fmt(AC_LOG_ERROR, "Accounts: msync() failed: %s.",
+                       strerror(errno));
+        }
+    }
+}
+
+/** @brief Sync the directory of PATH, for a rename in it to last. */
+static void ac_accounts_sync_dir(const char *path) {
+    const char *slash = strrchr(path, '/');
+    char *dir = slash ? strndup(path, (size_t)(slash - path + 1)) : NULL;
+
+    int fd = open(dir ? dir : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd != -1) {
+        fsync(fd);
+        close(fd);
+    }
+    free(dir);
+}
+
+/** @brief Finish a grow, dropping the grown table if it failed. Called on
+ * the sync thread. */
+static void ac_accounts_grow_end(ac_accounts_t *accounts, bool done) {
+    pthread_mutex_lock(&accounts->lock);
+
+    accounts->grow = done ? AC_ACCOUNTS_GROW_DONE : AC_ACCOUNTS_GROW_FAILED;
+
+    ac_accounts_table_t grown = accounts->grown;
+
+    if (!done && grown.fd != -1) {
+        /* Slots mirrored into it need no sync any more. */
+        for (size_t i = ac_alen(accounts->dirty); i-- > 0;) {
+            if (accounts->dirty[i].hdr == grown.hdr) {
+                ac_arr_remove(accounts->dirty, i);
+            }
+        }
+        accounts->grown.fd    = -1;
+        accounts->grown.hdr   = NULL;
+        accounts->grown.slots = NULL;
+    }
+
+    pthread_mutex_unlock(&accounts->lock);
+
+    if (!done) {
+        ac_log_fmt(AC_LOG_WARNING, "Accounts: failed to grow %s.",
+                   accounts->path);
+
+        if (grown.fd != -1) {
+            ac_accounts_unmap(&grown);
+        }
+    }
+}
+
+/** @brief Rewrite the store with twice the slots beside the file, and
+ * rename it over the file. Called on the sync thread, which the event loop
+ * leaves the table OLD to until the grow is done. */
+static void ac_accounts_grow(ac_accounts_t *accounts,
+                             const ac_accounts_table_t *old) {
+    uint64_t slots = old->hdr->slots * 2;
+    uint64_t seed  = old->hdr->seed;
+    size_t size    = ac_accounts_size(slots);
+
+    size_t tmp_len = strlen(accounts->path) + sizeof ".tmp";
+    char *tmp      = malloc(tmp_len);
+    assert(tmp);
+    snprintf(tmp, tmp_len, "%s.tmp", accounts->path);
+
+    int fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        free(tmp);
+        ac_accounts_grow_end(accounts, false);
+        return;
+    }
+
+    ac_accounts_table_t grown;
+
+    if (!ac_accounts_init(fd, slots, seed) ||
+        !ac_accounts_map(&grown, fd, size)) {
+        close(fd);
+        unlink(tmp);
+        free(tmp);
+        ac_accounts_grow_end(accounts, false);
+        return;
+    }
+
+    /* From here on, accounts added are written into both tables. */
+    pthread_mutex_lock(&accounts->lock);
+    accounts->grown = grown;
+    pthread_mutex_unlock(&accounts->lock);
+
+    for (uint64_t i = 0; i < old->hdr->slots;) {
+        pthread_mutex_lock(&accounts->lock);
+
+        for (uint64_t n = 0; n < AC_ACCOUNTS_COPY_BATCH &&
+                             i < old->hdr->slots;
+             n++, i++) {
+            if (old->slots[i].name_len > 0) {
+                ac_accounts_insert(&grown, &old->slots[i]);
+            }
+        }
+
+        pthread_mutex_unlock(&accounts->lock);
+    }
+
+    /* The copy must be on disk before it replaces the file. Slots added
+       from now on are synced like any other. */
+    bool done = msync(grown.hdr, size, MS_SYNC) == 0 &&
+                rename(tmp, accounts->path) == 0;
+
+    if (done) {
+        ac_accounts_sync_dir(accounts->path);
+    } else {
+        unlink(tmp);
+    }
+    free(tmp);
+
+    ac_accounts_grow_end(accounts, done);
+}
+
+static void *ac_accounts_run(void *arg) {
+    ac_accounts_t *accounts = arg;
+
+    ac_arr(ac_accounts_dirty_t) dirty;
+    ac_arr_new(dirty);
+
+    pthread_mutex_lock(&accounts->lock);
+
+    for (;;) {
+        while (ac_alen(accounts->dirty) == 0 && accounts->retired.fd == -1 &&
+               accounts->grow != AC_ACCOUNTS_GROW_REQUESTED &&
+               !accounts->stop) {
+            pthread_cond_wait(&accounts->wake, &accounts->lock);
+        }
+
+        /* A grow not started yet is dropped on the way out. */
+        bool grow = accounts->grow == AC_ACCOUNTS_GROW_REQUESTED &&
+                    !accounts->stop;
+
+        if (ac_alen(accounts->dirty) == 0 && accounts->retired.fd == -1 &&
+            !grow) {
+            break;
+        }
+
+        ac_accounts_dirty_t *taken = accounts->dirty;
+        accounts->dirty            = dirty;
+        dirty                      = taken;
+
+        ac_accounts_table_t retired = accounts->retired;
+        accounts->retired.fd        = -1;
+
+        ac_accounts_table_t old = {accounts->fd, accounts->hdr,
+                                   accounts->slots};
+        if (grow) {
+            accounts->grow = AC_ACCOUNTS_GROW_RUNNING;
+        }
+
+        pthread_mutex_unlock(&accounts->lock);
+
+        /* Slots written into the retired table before it was switched out
+           are among those taken with it. */
+        ac_accounts_sync(dirty, ac_alen(dirty));
+        ac_alen(dirty) = 0;
+
+        if (retired.fd != -1) {
+            ac_accounts_unmap(&retired);
+        }
+        if (grow) {
+            ac_accounts_grow(accounts, &old);
+        }
+
+        pthread_mutex_lock(&accounts->lock);
+    }
+
+    pthread_mutex_unlock(&accounts->lock);
+
+    ac_arr_free(dirty);
+    return NULL;
+}
+
+bool ac_accounts_open(ac_accounts_t *accounts, const char *path) {
+    accounts->fd    = -1;
+    accounts->path  = NULL;
+    accounts->hdr   = NULL;
+    accounts->slots = NULL;
+
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return false;
+    }
+
+    if (st.st_size == 0) {
+        uint64_t seed;
+
+        if (getrandom(&seed, sizeof seed, 0) != (ssize_t)sizeof seed ||
+            !ac_accounts_init(fd, AC_ACCOUNTS_SLOTS, seed) || fsync(fd)) {
+            close(fd);
+            return false;
+        }
+        st.st_size = (off_t)ac_accounts_size(AC_ACCOUNTS_SLOTS);
+    }
+
+    /* Only open a file that is a store, and a whole one. */
+    ac_accounts_header_t hdr;
+
+    if (pread(fd, &hdr, sizeof hdr, 0) != (ssize_t)sizeof hdr ||
+        hdr.magic != AC_ACCOUNTS_MAGIC || hdr.slots == 0 ||
+        (hdr.slots & (hdr.slots - 1)) != 0 ||
+        (uint64_t)st.st_size != ac_accounts_size(hdr.slots)) {
+        close(fd);
+        return false;
+    }
+
+    ac_accounts_table_t table;
+
+    if (!ac_accounts_map(&table, fd, (size_t)st.st_size)) {
+        close(fd);
+        return false;
+    }
+
+    pthread_mutex_init(&accounts->lock, NULL);
+    pthread_cond_init(&accounts->wake, NULL);
+    ac_arr_new(accounts->dirty);
+    accounts->stop       = false;
+    accounts->grow       = AC_ACCOUNTS_GROW_IDLE;
+    accounts->grown.fd   = -1;
+    accounts->retired.fd = -1;
+
+    accounts->path = strdup(path);
+    assert(accounts->path);
+
+    if (pthread_create(&accounts->thread, NULL, ac_accounts_run, accounts) !=
+        0) {
+        free(accounts->path);
+        accounts->path = NULL;
+        ac_arr_free(accounts->dirty);
+        pthread_cond_destroy(&accounts->wake);
+        pthread_mutex_destroy(&accounts->lock);
+        ac_accounts_unmap(&table);
+        return false;
+    }
+
+    accounts->fd    = table.fd;
+    accounts->hdr   = table.hdr;
+    accounts->slots = table.slots;
+    return true;
+}
+
+void ac_accounts_close(ac_accounts_t *accounts) {
+    if (!ac_accounts_enabled(accounts)) {
+        return;
+    }
+
+    pthread_mutex_lock(&accounts->lock);
+    accounts->stop = true;
+    pthread_cond_signal(&accounts->wake);
+    pthread_mutex_unlock(&accounts->lock);
+
+    pthread_join(accounts->thread, NULL);
+
+    /* A finished grow replaced the file already. */
+    ac_accounts_table_t table = {accounts->fd, accounts->hdr,
+                                 accounts->slots};
+
+    if (accounts->grow == AC_ACCOUNTS_GROW_DONE) {
+        ac_accounts_unmap(&table);
+        table = accounts->grown;
+    }
+    ac_accounts_unmap(&table);
+
+    ac_arr_free(accounts->dirty);
+    pthread_cond_destroy(&accounts->wake);
+    pthread_mutex_destroy(&accounts->lock);
+    free(accounts->path);
+
+    accounts->fd    = -1;
+    accounts->path  = NULL;
+    accounts->hdr   = NULL;
+    accounts->slots = NULL;
+}
+
+void ac_accounts_poll(ac_accounts_t *accounts) {
+    if (!ac_accounts_enabled(accounts)) {
+        return;
+    }
+
+    pthread_mutex_lock(&accounts->lock);
+
+    if (accounts->grow == AC_ACCOUNTS_GROW_DONE) {
+        /* The sync thread unmaps the old table once its slots are synced.
+         */
+        accounts->retired.fd    = accounts->fd;
+        accounts->retired.hdr   = accounts->hdr;
+        accounts->retired.slots = accounts->slots;
+
+        accounts->fd    = accounts->grown.fd;
+        accounts->hdr   = accounts->grown.hdr;
+        accounts->slots = accounts->grown.slots;
+
+        accounts->grown.fd    = -1;
+        accounts->grown.hdr   = NULL;
+        accounts->grown.slots = NULL;
+        accounts->grow        = AC_ACCOUNTS_GROW_IDLE;
+
+        pthread_cond_signal(&accounts->wake);
+    }
+
+    pthread_mutex_unlock(&accounts->lock);
+}
+
+bool ac_accounts_enabled(const ac_accounts_t *accounts) {
+    return accounts->fd != -1;
+}
+
+size_t ac_accounts_len(const ac_accounts_t *accounts) {
+    return ac_accounts_enabled(accounts) ? (size_t)accounts->hdr->len : 0;
+}
+
+const ac_account_t *ac_accounts_find(const ac_accounts_t *accounts,
+                                     ac_str_view_t name) {
+    if (!ac_accounts_enabled(accounts) || name.len == 0 ||
+        name.len > AC_ACCOUNT_NAME_MAX) {
+        return NULL;
+    }
+
+    const ac_account_t *slot = ac_accounts_probe(
+        accounts->slots, accounts->hdr->slots, accounts->hdr->seed, name);
+
+    return slot->name_len ? slot : NULL;
+}
+
+ac_accounts_status_t ac_accounts_add(ac_accounts_t *accounts,
+                                     const ac_account_t *account) {
+    assert(ac_accounts_enabled(accounts));
+    assert(account->name_len > 0 &&
+           account->name_len <= AC_ACCOUNT_NAME_MAX);
+
+    ac_str_view_t name = {account->name, account->name_len};
+
+    if (ac_accounts_find(accounts, name)) {
+        return AC_ACCOUNTS_EXISTS;
+    }
+
+    pthread_mutex_lock(&accounts->lock);
+
+    if ((accounts->hdr->len + 1) * 10 > accounts->hdr->slots * 7 &&
+        (accounts->grow == AC_ACCOUNTS_GROW_IDLE ||
+         accounts->grow == AC_ACCOUNTS_GROW_FAILED)) {
+        accounts->grow = AC_ACCOUNTS_GROW_REQUESTED;
+    }
+
+    /* Keep going in the old table while it has room. */
+    if (accounts->hdr->len + 1 >= accounts->hdr->slots) {
+        pthread_cond_signal(&accounts->wake);
+        pthread_mutex_unlock(&accounts->lock);
+        return AC_ACCOUNTS_FULL;
+    }
+
+    ac_accounts_table_t table = {accounts->fd, accounts->hdr,
+                                 accounts->slots};
+    ac_accounts_dirty_t dirty = {table.hdr, NULL};
+
+    dirty.slot = ac_accounts_insert(&table, account);
+    ac_arr_append(accounts->dirty, dirty);
+
+    if (accounts->grown.fd != -1) {
+        dirty.hdr  = accounts->grown.hdr;
+        dirty.slot = ac_accounts_insert(&accounts->grown, account);
+        ac_arr_append(accounts->dirty, dirty);
+    }
+
+    pthread_cond_signal(&accounts->wake);
+    pthread_mutex_unlock(&accounts->lock);
+
+    return AC_ACCOUNTS_ADDED;
+}
@@ -1,53 +1,522 @@
 #include <ac/app.h>
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <limits.h>
 #include <assert.h>
 
 #include <ac/net.h>
 #include <ac/io.h>
+#include <ac/log.h>
 #include <ac/meta.h>
 
+AC_MAP_DEFINE(ac_user_handle_map, ac_client_handle_t, ac_user_t *,
+              ac_handle_hash, ac_handle_eq);
+AC_MAP_DEFINE(ac_user_name_map, ac_atom_t, ac_user_t *, ac_atom_hash,
+              ac_atom_eq);
+AC_MAP_DEFINE(ac_user_token_map, ac_token_t, ac_user_t *, ac_token_hash,
+              ac_token_eq);
+
+const ac_rate_limit_t ac_rate_limits[AC_RATE_CLASSES] = {
+    [AC_RATE_CHAT]    = {AC_RATE_CHAT_PER_SEC, AC_RATE_CHAT_BURST},
+    [AC_RATE_COMMAND] = {AC_RATE_COMMAND_PER_SEC, AC_RATE_COMMAND_BURST},
+    [AC_RATE_WHISPER] = {AC_RATE_WHISPER_PER_SEC, AC_RATE_WHISPER_BURST},
+};
+
 void ac_user_new(ac_user_t *user, ac_app_t *app, ac_client_handle_t handle) {
     user->handle = handle;
+    user->out    = ac_server_out_queue(&app->server, handle);
+
+    user->username = AC_ATOM_NONE;
+    user->member   = AC_MEMBER_NONE;
+
+    for (size_t i = 0; i < AC_RATE_CLASSES; i++) {
+        ac_bucket_new(&user->rate.buckets[i], &ac_rate_limits[i], app->now);
+    }
+    user->rate.strikes     = 0;
+    user->rate.last_strike = 0;
+    user->rate.resume_at   = 0;
+    user->rate.delayed     = 0;
+    user->rate.dropped     = 0;
 
-    ac_arr_new(user->username);
+    user->auth.name     = AC_ATOM_NONE;
+    user->auth.ticket   = 0;
+    user->auth.failures = 0;
+
+    user->session.token          = AC_TOKEN_NONE;
+    user->session.parked         = false;
+    user->session.parked_at      = 0;
+    user->session.history_head   = 0;
+    user->session.missed         = NULL;
+    user->session.missed_dropped = 0;
 
     user->state = AC_STATE_LOGIN;
     ac_state_new(user, app);
 }
 
 void ac_user_free(ac_user_t *user) {
-    ac_arr_free(user->username);
+    ac_atom_release(user->username);
+    ac_atom_release(user->auth.name);
+
+    if (user->session.missed) {
+        ac_arr_free(user->session.missed);
+    }
 }
 
-void ac_user_update(ac_user_t *user, ac_app_t *app, ac_bytes_t *in) {
+void ac_user_update(ac_user_t *user, ac_app_t *app, ac_input_t *in) {
+    /* Input of a user serving a delay waits in the buffer. */
+    if (app->now < user->rate.resume_at) {
+        return;
+    }
+
+    size_t rejected = in->rejected;
+
     ac_state_update(user, app, in);
+
+    if (in->rejected != rejected) {
+        ac_print(user, app, AC_PRINT_AFTER_ENTER,
+                 "Your input was not valid UTF-8 and has been discarded.");
+    }
+}
+
+void ac_members_new(ac_members_t *members) {
+    ac_arr_new_reserve(members->users, AC_CLIENTS_MAX);
+    ac_arr_new_reserve(members->handles, AC_CLIENTS_MAX);
+    ac_arr_new_reserve(members->outs, AC_CLIENTS_MAX);
+}
+
+void ac_members_free(ac_members_t *members) {
+    ac_arr_free(members->users);
+    ac_arr_free(members->handles);
+    ac_arr_free(members->outs);
+}
+
+void ac_members_add(ac_members_t *members, ac_user_t *user, ac_bytes_t *out) {
+    assert(user->member == AC_MEMBER_NONE);
+
+    user->member = ac_alen(members->users);
+
+    ac_arr_append(members->users, user);
+    ac_arr_append(members->handles, user->handle);
+    ac_arr_append(members->outs, out);
+}
+
+void ac_members_remove(ac_members_t *members, ac_user_t *user) {
+    size_t i    = user->member;
+    size_t last = ac_alen(members->users) - 1;
+
+    assert(i <= last && members->users[i] == user);
+
+    /* Fill the hole with the last member. */
+    members->users[i]   = members->users[last];
+    members->handles[i] = members->handles[last];
+    members->outs[i]    = members->outs[last];
+    members->users[i]->member = i;
+
+    ac_alen(members->users)   = last;
+    ac_alen(members->handles) = last;
+    ac_alen(members->outs)    = last;
+
+    user->member = AC_MEMBER_NONE;
+}
+
+/** @brief Milliseconds since the epoch. */
+static uint64_t ac_app_wall_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/** @brief Log the outcome of loading the content filter. */
+static void ac_app_filter_loaded(ac_app_t *app, ac_filter_reload_t result) {
+    switch (result) {
+        case AC_FILTER_UNCHANGED:
+            break;
+
+        case AC_FILTER_RELOADED:
+            ac_log_fmt(AC_LOG_INFO, "Content filter: %zu patterns loaded.",
+                       app->filter.active->patterns);
+            break;
+
+        case AC_FILTER_UNREADABLE:
+            ac_log_fmt(AC_LOG_WARNING,
+                       "Content filter: failed to read %s, keeping the "
+                       "current patterns.",
+                       AC_FILTER_PATH);
+            break;
+
+        case AC_FILTER_MALFORMED:
+            ac_log_fmt(AC_LOG_WARNING,
+                       "Content filter: %s:%zu is malformed, keeping the "
+                       "current patterns.",
+                       AC_FILTER_PATH, app->filter.bad_line);
+            break;
+
+        case AC_FILTER_NO_THREAD:
+            ac_log_fmt(AC_LOG_WARNING,
+                       "Content filter: failed to start a reload of %s, "
+                       "retrying.",
+                       AC_FILTER_PATH);
+            break;
+    }
+}
+
+/** @brief Render the uptime as of NOW and invalidate responses showing it.
+ */
+static void ac_app_refresh_uptime(ac_app_t *app, time_t now) {
+    long minutes = (long)(now - app->app_start_time) / 60;
+
+    snprintf(app->rendered.uptime, sizeof app->rendered.uptime,
+             "%ld days, %02ld:%02ld", minutes / (60 * 24),
+             minutes / 60 % 24, minutes % 60);
+
+    app->rendered.uptime_at = now;
+    ac_app_touch(app);
 }
 
 void ac_app_new(ac_app_t *app) {
-    ac_map_new_reserve(app->users.from_handle, AC_CLIENTS_MAX);
-    ac_map_new_reserve(app->users.from_username, AC_CLIENTS_MAX);
+    ac_user_handle_map_new_reserve(&app->users.from_handle, AC_CLIENTS_MAX);
+    ac_user_name_map_new_reserve(&app->users.from_username, AC_CLIENTS_MAX);
+    ac_name_index_new(&app->users.by_name);
+    ac_members_new(&app->users.members);
 
+    /* Give memory back after a mass disconnect. */
+    ac_map_enable_shrink(app->users.from_handle);
+    ac_map_enable_shrink(app->users.from_username);
+
+    ac_pool_new(&app->users.pool, sizeof(ac_user_t), AC_USERS_PER_SLAB);
+
+    ac_user_token_map_new(&app->parked.by_token);
+    ac_map_enable_shrink(app->parked.by_token);
+    ac_arr_new(app->parked.queue);
+    app->parked.head = 0;
+
+    app->now            = ac_clock_ms();
+    app->wall_ms        = ac_app_wall_ms();
     app->app_start_time = time(NULL);
+
+    /* Generation 0 marks responses that were never rendered. */
+    app->rendered.gen       = 1;
+    app->rendered.uptime_at = 0;
+    ac_arr_new(app->rendered.greeting.text);
+    ac_arr_new(app->rendered.info.text);
+    app->rendered.greeting.gen = 0;
+    app->rendered.info.gen     = 0;
+    ac_arr_new(app->rendered.list_pages);
+    ac_app_refresh_uptime(app, app->app_start_time);
+
+    if (!ac_history_open(&app->history, AC_HISTORY_PATH, AC_HISTORY_SIZE)) {
+        ac_log_fmt(AC_LOG_WARNING,
+                   "Failed to open %s, chat history is disabled.",
+                   AC_HISTORY_PATH);
+    }
+
+    if (!ac_accounts_open(&app->accounts, AC_ACCOUNTS_PATH)) {
+        ac_log_fmt(AC_LOG_WARNING,
+                   "Failed to open %s, names cannot be registered.",
+                   AC_ACCOUNTS_PATH);
+    }
+
+    /* Without workers no password can be checked, nor a name registered.
+     */
+    if (!ac_auth_new(&app->auth, AC_AUTH_WORKERS) &&
+        ac_accounts_enabled(&app->accounts)) {
+        ac_log_fmt(AC_LOG_WARNING,
+                   "Failed to start the password workers, names cannot be "
+                   "registered.");
+        ac_accounts_close(&app->accounts);
+    }
+    app->auth_ticket = 0;
+
+    if (!ac_msglog_open(&app->msglog, AC_MSGLOG_DIR)) {
+        ac_log_fmt(AC_LOG_ERROR, "Failed to open the message log in %s.",
+                   AC_MSGLOG_DIR);
+        exit(EXIT_FAILURE);
+    }
+
+    ac_search_new(&app->search);
+    ac_app_filter_loaded(
+        app, ac_filter_watch_new(&app->filter, AC_FILTER_PATH, app->now));
+
+    ac_arr_new(app->presence.joined);
+    ac_arr_new(app->presence.left);
+    app->presence.window_start   = app->now;
+    app->presence.window_changes = 0;
+    app->presence.digest         = false;
+    app->presence.digest_joined  = 0;
+    app->presence.digest_left    = 0;
+
+    ac_arena_new(&app->scratch, AC_SCRATCH_SIZE);
 }
 
 void ac_app_free(ac_app_t *app) {
-    ac_map_free(app->users.from_handle);
-    ac_map_free(app->users.from_username);
+    /* Parked users are in no other map. Free them before their pool. */
+    ac_token_t *token;
+    ac_user_t **parked;
+
+    ac_map_foreach(app->parked.by_token, token, parked) {
+        ac_user_free(*parked);
+        ac_pool_release(&app->users.pool, *parked);
+    }
+    (void)token;
+
+    ac_user_handle_map_free(&app->users.from_handle);
+    ac_user_name_map_free(&app->users.from_username);
+    ac_name_index_free(&app->users.by_name);
+    ac_members_free(&app->users.members);
+    ac_pool_free(&app->users.pool);
+
+    ac_user_token_map_free(&app->parked.by_token);
+    ac_arr_free(app->parked.queue);
+
+    ac_arr_free(app->rendered.greeting.text);
+    ac_arr_free(app->rendered.info.text);
+    ac_arr_foreach(app->rendered.list_pages, i) {
+        ac_arr_free(app->rendered.list_pages[i].text);
+    }
+    ac_arr_free(app->rendered.list_pages);
+
+    ac_auth_free(&app->auth);
+    ac_accounts_close(&app->accounts);
+    ac_history_close(&app->history);
+    ac_msglog_close(&app->msglog);
+    ac_search_free(&app->search);
+    ac_filter_watch_free(&app->filter);
+
+    ac_arr_foreach(app->presence.joined, i) {
+        ac_atom_release(app->presence.joined[i]);
+    }
+    ac_arr_foreach(app->presence.left, i) {
+        ac_atom_release(app->presence.left[i]);
+    }
+    ac_arr_free(app->presence.joined);
+    ac_arr_free(app->presence.left);
+
+    ac_arena_free(&app->scratch);
+}
+
+void ac_app_touch(ac_app_t *app) { app->rendered.gen++; }
+
+void ac_app_remove_user(ac_app_t *app, ac_user_t *user) {
+    if (user->username != AC_ATOM_NONE) {
+        ac_user_name_map_remove(&app->users.from_username, user->username);
+        ac_name_index_remove(&app->users.by_name, user->username);
+        ac_app_touch(app);
+
+        /* Notify other users that a user has left the chat. */
+        ac_presence_leave(app, user->username);
+    }
+
+    /* Free the user object. */
+    ac_user_free(user);
+    ac_pool_release(&app->users.pool, user);
+}
+
+void ac_app_record(ac_app_t *app, ac_msg_kind_t kind, ac_atom_t from,
+                   ac_atom_t to, ac_str_view_t text) {
+    ac_msg_t msg = {kind, app->wall_ms, {NULL, 0}, {"", 0}, text};
+
+    msg.from.data = ac_atom_data(from);
+    msg.from.len  = ac_atom_len(from);
+
+    if (to != AC_ATOM_NONE) {
+        msg.to.data = ac_atom_data(to);
+        msg.to.len  = ac_atom_len(to);
+    }
+
+    ac_msglog_append(&app->msglog, &msg);
+}
+
+void ac_presence_join(ac_app_t *app, ac_atom_t name) {
+    ac_atom_retain(name);
+    ac_arr_append(app->presence.joined, name);
+}
+
+void ac_presence_leave(ac_app_t *app, ac_atom_t name) {
+    ac_atom_retain(name);
+    ac_arr_append(app->presence.left, name);
+}
+
+/**
+ * @brief Announce NAMES in one notice, listing the first AC_PRESENCE_NAMES
+ * and counting the rest, e.g. "alice, bob, carol and 12 others have left
+ * the chat."
+ */
+static void ac_presence_announce(ac_app_t *app, const ac_user_t *except,
+                                 ac_arr(ac_atom_t) names, const char *one,
+                                 const char *many) {
+    size_t count = ac_alen(names);
+    if (count == 0) {
+        return;
+    }
+
+    size_t listed = count <= AC_PRESENCE_NAMES ? count : AC_PRESENCE_NAMES;
+
+    ac_bytes_t msg;
+    ac_arr_new_a(msg, &app->scratch.allocator);
+
+    for (size_t i = 0; i < listed; i++) {
+        if (i > 0) {
+            const char *sep = i + 1 == count ? " and " : ", ";
+            ac_arr_append_n(msg, strlen(sep), sep);
+        }
+        ac_arr_append_n(msg, ac_atom_len(names[i]), ac_atom_data(names[i]));
+    }
+
+    if (listed < count) {
+        size_t rest = count - listed;
+        ac_broadcast_fmt(app, except, "%.*s and %zu other%s%s",
+                         (int)ac_alen(msg), (const char *)msg, rest,
+                         rest == 1 ? "" : "s", many);
+    } else {
+        ac_broadcast_fmt(app, except, "%.*s%s", (int)ac_alen(msg),
+                         (const char *)msg, count == 1 ? one : many);
+    }
+    ac_arr_free(msg);
+}
+
+/** @brief Release and forget the names collected by a presence list. */
+static void ac_presence_clear(ac_arr(ac_atom_t) names) {
+    ac_arr_foreach(names, i) {
+        ac_atom_release(names[i]);
+    }
+    ac_alen(names) = 0;
+}
+
+/**
+ * @brief Announce the tick's joins and leaves.
+ *
+ * Each kind is announced in a single notice. When a window sees more than
+ * AC_PRESENCE_DIGEST_RATE changes, notices give way to one digest at the end
+ * of every window, until a window stays below the rate again.
+ */
+static void ac_presence_flush(ac_app_t *app) {
+    size_t joined = ac_alen(app->presence.joined);
+    size_t left   = ac_alen(app->presence.left);
+
+    app->presence.window_changes += joined + left;
+
+    if (!app->presence.digest &&
+        app->presence.window_changes > AC_PRESENCE_DIGEST_RATE) {
+        app->presence.digest = true;
+        ac_broadcast_fmt(app, NULL,
+                         "Many users are coming and going. Arrivals and "
+                         "departures are now summed up every %d seconds.",
+                         AC_PRESENCE_WINDOW_MS / 1000);
+    }
+
+    if (app->presence.digest) {
+        app->presence.digest_joined += joined;
+        app->presence.digest_left += left;
+    } else {
+        /* A lone newcomer is greeted by the chat, not by itself. */
+        const ac_user_t *except = NULL;
+
+        if (joined == 1) {
+            ac_user_t **user = ac_user_name_map_get(
+                &app->users.from_username, app->presence.joined[0]);
+            except = user ? *user : NULL;
+        }
+
+        ac_presence_announce(app, except, app->presence.joined,
+                             " joins the chat!", " join the chat!");
+        ac_presence_announce(app, NULL, app->presence.left,
+                             " has left the chat.", " have left the chat.");
+    }
+
+    ac_presence_clear(app->presence.joined);
+    ac_presence_clear(app->presence.left);
+
+    if (app->now - app->presence.window_start < AC_PRESENCE_WINDOW_MS) {
+        return;
+    }
+
+    if (app->presence.digest) {
+        if (app->presence.digest_joined + app->presence.digest_left > 0) {
+            ac_broadcast_fmt(app, NULL,
+                             "Since the last summary, %zu user%s joined and "
+                             "%zu left the chat.",
+                             app->presence.digest_joined,
+                             app->presence.digest_joined == 1 ? "" : "s",
+                             app->presence.digest_left);
+        }
+
+        app->presence.digest_joined = 0;
+        app->presence.digest_left   = 0;
+        app->presence.digest =
+            app->presence.window_changes > AC_PRESENCE_DIGEST_RATE;
+    }
+
+    app->presence.window_start   = app->now;
+    app->presence.window_changes = 0;
+}
+
+int ac_app_idle_timeout(const ac_app_t *app) {
+    /* The message log needs no wake-up: every tick hands its records to the
+       commit thread, which keeps its own time. */
+
+    uint64_t at    = ac_session_deadline(app);
+    uint64_t check = ac_filter_watch_deadline(&app->filter);
+
+    if (check < at) {
+        at = check;
+    }
+    if (at == UINT64_MAX) {
+        return -1;
+    }
+
+    uint64_t now = ac_clock_ms();
+
+    if (at <= now) {
+        return 0;
+    }
+    return at - now > INT_MAX ? INT_MAX : (int)(at - now);
 }
 
 void ac_app_update(ac_app_t *app) {
+    app->now = ac_clock_ms();
+
+    app->wall_ms = ac_app_wall_ms();
+
+    time_t wall = (time_t)(app->wall_ms / 1000);
+
+    if (wall - app->rendered.uptime_at >= AC_UPTIME_REFRESH) {
+        ac_app_refresh_uptime(app, wall);
+    }
+
+    ac_app_filter_loaded(app, ac_filter_watch_poll(&app->filter, app->now));
+    ac_accounts_poll(&app->accounts);
+
+    /* Deliver finished password checks before input is read, so a user
+       logged in by one reads its pending lines this tick. */
+
+    ac_auth_result_t results[AC_AUTH_QUEUE_MAX];
+    size_t finished = ac_auth_poll(&app->auth, results, AC_AUTH_QUEUE_MAX);
+
+    for (size_t i = 0; i < finished; i++) {
+        ac_client_handle_t owner = (ac_client_handle_t)results[i].owner;
+        ac_user_t **waiting =
+            ac_user_handle_map_get(&app->users.from_handle, owner);
+
+        /* The connection may have closed, and its handle been reused. */
+        if (waiting && (*waiting)->auth.ticket == results[i].ticket) {
+            (*waiting)->auth.ticket = 0;
+            ac_state_auth_done(*waiting, app, &results[i]);
+        }
+    }
+
     /* Update users. */
 
     ac_client_handle_t *handle;
     ac_user_t **user;
 
     ac_map_foreach(app->users.from_handle, handle, user) {
-        ac_client_t *client;
-        ac_map_get(app->server.clients, ac_handle_hash, ac_handle_eq,
-                   (*user)->handle, client);
+        ac_client_t *client =
+            ac_client_map_get(&app->server.clients, (*user)->handle);
+        assert(client);
 
         ac_user_update(*user, app, &client->in);
     }
@@ -58,47 +527,45 @@ void ac_app_update(ac_app_t *app) {
         if (client->state == AC_CLIENT_STATE_NEW) {
             /* Create user. */
 
-            ac_user_t *new_user = malloc(sizeof(ac_user_t));
-            assert(new_user);
+            ac_user_t *new_user = ac_pool_alloc(&app->users.pool);
             ac_user_new(new_user, app, client->conn.handle);
 
-            ac_map_set(app->users.from_handle, ac_handle_hash, ac_handle_eq,
-                       new_user->handle, new_user);
+            ac_user_handle_map_set(&app->users.from_handle, new_user->handle,
+                                   new_user);
+            ac_app_touch(app);
         } else if (client->state == AC_CLIENT_STATE_TO_BE_REMOVED) {
             /* Remove user from maps. */
 
-            ac_map_get(app->users.from_handle, ac_handle_hash, ac_handle_eq,
-                       client->conn.handle, user);
-            ac_map_remove(app->users.from_handle, ac_handle_hash, ac_handle_eq,
-                          (*user)->handle);
+            user = ac_user_handle_map_get(&app->users.from_handle,
+                                          client->conn.handle);
+            assert(user);
+            ac_user_handle_map_remove(&app->users.from_handle,
+                                      (*user)->handle);
+            ac_app_touch(app);
 
-            bool username_exists;
-            ac_map_contains(app->users.from_username, ac_string_hash,
-                            ac_string_eq, (*user)->username, username_exists);
+            if ((*user)->member != AC_MEMBER_NONE) {
+                ac_members_remove(&app->users.members, *user);
+            }
 
-            if (username_exists) {
-                ac_map_remove(app->users.from_username, ac_string_hash,
-                              ac_string_eq, (*user)->username);
+            /* Keep the session for a while in case the user reconnects. */
+            if (!ac_session_park(*user, app)) {
+                ac_app_remove_user(app, *user);
             }
+        }
+    }
 
-            /* Notify other users that a user has left the chat. */
+    ac_session_expire(app);
 
-            ac_client_handle_t *other_handle;
-            ac_user_t **other_user;
+    /* Advance incremental rehashing now that no map is being iterated. */
+    ac_user_handle_map_step(&app->users.from_handle);
+    ac_user_name_map_step(&app->users.from_username);
+    ac_user_token_map_step(&app->parked.by_token);
 
-            ac_map_foreach(app->users.from_handle, other_handle,
-                            other_user) {
-                if ((*other_user)->state == AC_STATE_CHAT) {
-                    ac_print_fmt(*other_user, app, AC_PRINT_INTERRUPT,
-                                    "%.*s has left the chat.",
-                                    ac_alen((*user)->username),
-                                    (*user)->username);
-                }
-            }
+    ac_presence_flush(app);
 
-            /* Free the user object. */
-            ac_user_free(*user);
-            free(*user);
-        }
-    }
+    /* Hand this tick's messages to the commit thread. */
+    ac_msglog_commit(&app->msglog);
+
+    /* Release this tick's temporaries. */
+    ac_arena_reset(&app->scratch);
 }
@@ -0,0 +1,125 @@
+#include <ac/arena.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/* Chunks start with a header linking them into the retired list. The
+   header is padded so that allocations stay aligned. */
+typedef struct ac_arena_chunk_s {
+    struct ac_arena_chunk_s *next;
+} ac_arena_chunk_t;
+
+#define AC_ARENA_CHUNK_HEADER                                                 \
+    ((sizeof(ac_arena_chunk_t) + AC_ARENA_ALIGN - 1) &                        \
+     ~(size_t)(AC_ARENA_ALIGN - 1))
+
+static size_t ac_arena_align(size_t n) {
+    return (n + AC_ARENA_ALIGN - 1) & ~(size_t)(AC_ARENA_ALIGN - 1);
+}
+
+static void ac_arena_new_chunk(ac_arena_t *arena, size_t cap) {
+    arena->buf = malloc(cap);
+    assert(arena->buf);
+    ((ac_arena_chunk_t *)(void *)arena->buf)->next = NULL;
+
+    arena->cap = cap;
+    arena->len = AC_ARENA_CHUNK_HEADER;
+}
+
+/** @brief Whether PTR of SIZE bytes is the most recent allocation. */
+static bool ac_arena_is_last(const ac_arena_t *arena, const void *ptr,
+                             size_t size) {
+    return (const unsigned char *)ptr + size == arena->buf + arena->len;
+}
+
+static void *ac_arena_resize(void *ctx, void *ptr, size_t old_size,
+                             size_t new_size) {
+    ac_arena_t *arena = ctx;
+
+    if (!ptr) {
+        return ac_arena_alloc(arena, new_size);
+    }
+
+    if (ac_arena_is_last(arena, ptr, old_size)) {
+        size_t start = (size_t)((unsigned char *)ptr - arena->buf);
+
+        /* Free or resize the most recent allocation in place. */
+        if (new_size == 0) {
+            arena->len = start;
+            return NULL;
+        }
+
+        if (start + new_size <= arena->cap) {
+            arena->len = start + new_size;
+
+            if (arena->len > arena->high_water) {
+                arena->high_water = arena->len;
+            }
+            return ptr;
+        }
+    }
+
+    /* Older allocations are only released by a reset. */
+    if (new_size == 0) {
+        return NULL;
+    }
+
+    void *moved = ac_arena_alloc(arena, new_size);
+    memcpy(moved, ptr, old_size < new_size ? old_size : new_size);
+    return moved;
+}
+
+void ac_arena_new(ac_arena_t *arena, size_t cap) {
+    arena->allocator.resize = ac_arena_resize;
+    arena->allocator.ctx    = arena;
+    arena->retired          = NULL;
+    arena->high_water       = 0;
+
+    ac_arena_new_chunk(arena, AC_ARENA_CHUNK_HEADER + ac_arena_align(cap));
+}
+
+void ac_arena_free(ac_arena_t *arena) {
+    ac_arena_reset(arena);
+    free(arena->buf);
+}
+
+void *ac_arena_alloc(ac_arena_t *arena, size_t size) {
+    size_t start = ac_arena_align(arena->len);
+
+    if (start + size > arena->cap) {
+        /* Retire the chunk, its allocations stay valid until reset. */
+        ac_arena_chunk_t *chunk = (ac_arena_chunk_t *)(void *)arena->buf;
+        chunk->next             = arena->retired;
+        arena->retired          = chunk;
+
+        size_t cap = arena->cap * 2;
+        while (cap < AC_ARENA_CHUNK_HEADER + ac_arena_align(size)) {
+            cap *= 2;
+        }
+
+        ac_arena_new_chunk(arena, cap);
+        start = arena->len;
+    }
+
+    arena->len = start + size;
+
+    if (arena->len > arena->high_water) {
+        arena->high_water = arena->len;
+    }
+
+    return arena->buf + start;
+}
+
+void ac_arena_reset(ac_arena_t *arena) {
+    ac_arena_chunk_t *chunk = arena->retired;
+
+    while (chunk) {
+        ac_arena_chunk_t *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    arena->retired = NULL;
+    arena->len     = AC_ARENA_CHUNK_HEADER;
+}
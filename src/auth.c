@@ -0,0 +1,175 @@
+#include <ac/auth.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/random.h>
+
+/** @brief Run a job, wiping its password. */
+static void ac_auth_run(ac_auth_job_t *job, ac_auth_result_t *result) {
+    result->op         = job->op;
+    result->owner      = job->owner;
+    result->ticket     = job->ticket;
+    result->iterations = job->iterations;
+    result->ok         = false;
+
+    switch (job->op) {
+        case AC_AUTH_VERIFY: {
+            unsigned char hash[AC_SHA256_LEN];
+
+            ac_pbkdf2_sha256(job->password, job->password_len, job->salt,
+                             sizeof job->salt, job->iterations, hash,
+                             sizeof hash);
+            result->ok = ac_kdf_equal(hash, job->hash, sizeof hash);
+            break;
+        }
+
+        case AC_AUTH_DERIVE: {
+            if (getrandom(result->salt, sizeof result->salt, 0) !=
+                (ssize_t)sizeof result->salt) {
+                break;
+            }
+
+            ac_pbkdf2_sha256(job->password, job->password_len, result->salt,
+                             sizeof result->salt, job->iterations,
+                             result->hash, sizeof result->hash);
+            result->ok = true;
+            break;
+        }
+    }
+
+    explicit_bzero(job->password, sizeof job->password);
+}
+
+static bool ac_auth_stopping(ac_auth_t *auth) {
+    pthread_mutex_lock(&auth->lock);
+    bool stop = auth->stop;
+    pthread_mutex_unlock(&auth->lock);
+
+    return stop;
+}
+
+static void *ac_auth_worker(void *arg) {
+    ac_auth_t *auth = arg;
+    ac_auth_job_t job;
+    ac_auth_result_t result;
+
+    while (true) {
+        pthread_mutex_lock(&auth->lock);
+
+        while (!auth->stop && auth->head == auth->tail) {
+            pthread_cond_wait(&auth->wake, &auth->lock);
+        }
+
+        /* Jobs still waiting are dropped. */
+        if (auth->stop) {
+            pthread_mutex_unlock(&auth->lock);
+            return NULL;
+        }
+
+        ac_auth_job_t *slot = &auth->jobs[auth->head % AC_AUTH_QUEUE_MAX];
+        job                 = *slot;
+        explicit_bzero(slot->password, sizeof slot->password);
+        auth->head++;
+
+        pthread_mutex_unlock(&auth->lock);
+
+        memset(&result, 0, sizeof result);
+        ac_auth_run(&job, &result);
+
+        /* The event loop keeps no more jobs in flight than the queue
+           holds, so there is room. Should there not be, wait for a poll
+           rather than lose the result and leave its user waiting. */
+        while (!ac_mpsc_push(auth->results, result)) {
+            if (ac_auth_stopping(auth)) {
+                return NULL;
+            }
+            usleep(1000);
+        }
+    }
+}
+
+bool ac_auth_new(ac_auth_t *auth, size_t workers) {
+    assert(workers > 0);
+
+    pthread_mutex_init(&auth->lock, NULL);
+    pthread_cond_init(&auth->wake, NULL);
+
+    auth->jobs = calloc(AC_AUTH_QUEUE_MAX, sizeof *auth->jobs);
+    assert(auth->jobs);
+    auth->head      = 0;
+    auth->tail      = 0;
+    auth->stop      = false;
+    auth->in_flight = 0;
+
+    ac_mpsc_new(auth->results, AC_AUTH_QUEUE_MAX);
+
+    auth->threads = malloc(workers * sizeof *auth->threads);
+    assert(auth->threads);
+    auth->workers = workers;
+
+    for (size_t i = 0; i < workers; i++) {
+        if (pthread_create(&auth->threads[i], NULL, ac_auth_worker, auth) !=
+            0) {
+            /* Stop the workers started so far. */
+            auth->workers = i;
+            ac_auth_free(auth);
+            return false;
+        }
+    }
+    return true;
+}
+
+void ac_auth_free(ac_auth_t *auth) {
+    if (!auth->threads) {
+        return;
+    }
+
+    pthread_mutex_lock(&auth->lock);
+    auth->stop = true;
+    pthread_cond_broadcast(&auth->wake);
+    pthread_mutex_unlock(&auth->lock);
+
+    for (size_t i = 0; i < auth->workers; i++) {
+        pthread_join(auth->threads[i], NULL);
+    }
+
+    explicit_bzero(auth->jobs, AC_AUTH_QUEUE_MAX * sizeof *auth->jobs);
+    free(auth->jobs);
+    free(auth->threads);
+    auth->threads = NULL;
+    ac_mpsc_free(auth->results);
+    pthread_cond_destroy(&auth->wake);
+    pthread_mutex_destroy(&auth->lock);
+}
+
+bool ac_auth_submit(ac_auth_t *auth, ac_auth_job_t *job) {
+    assert(job->password_len <= AC_PASSWORD_MAX);
+
+    if (!auth->threads || auth->in_flight >= AC_AUTH_QUEUE_MAX) {
+        explicit_bzero(job->password, sizeof job->password);
+        return false;
+    }
+    auth->in_flight++;
+
+    pthread_mutex_lock(&auth->lock);
+    auth->jobs[auth->tail % AC_AUTH_QUEUE_MAX] = *job;
+    auth->tail++;
+    pthread_cond_signal(&auth->wake);
+    pthread_mutex_unlock(&auth->lock);
+
+    explicit_bzero(job->password, sizeof job->password);
+    return true;
+}
+
+size_t ac_auth_poll(ac_auth_t *auth, ac_auth_result_t *results, size_t max) {
+    if (!auth->threads) {
+        return 0;
+    }
+
+    size_t count = ac_mpsc_pop_n(auth->results, results, max);
+
+    auth->in_flight -= count;
+    return count;
+}
@@ -0,0 +1,114 @@
+#include <ac/cmap.h>
+
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+
+/* Global epoch, starting at 1. A reader publishes the epoch it entered in
+   and 0 while outside a read section. A table retired in epoch E is safe to
+   free once every active reader entered after E. */
+static uint64_t ac_epoch_global = 1;
+
+typedef struct ac_epoch_slot_s {
+    uint64_t local;
+    bool taken;
+} AC_CACHE_ALIGNED ac_epoch_slot_t;
+
+static ac_epoch_slot_t ac_epoch_slots[AC_EPOCH_THREADS_MAX];
+
+/* Slot of the calling thread, or NULL before its first read section. */
+static __thread ac_epoch_slot_t *ac_epoch_self;
+
+static pthread_key_t ac_epoch_key;
+static pthread_once_t ac_epoch_once = PTHREAD_ONCE_INIT;
+
+/** @brief Give a thread's slot back when the thread exits. */
+static void ac_epoch_release(void *slot) {
+    __atomic_store_n(&((ac_epoch_slot_t *)slot)->taken, false,
+                     __ATOMIC_RELEASE);
+}
+
+static void ac_epoch_init(void) {
+    pthread_key_create(&ac_epoch_key, ac_epoch_release);
+}
+
+static ac_epoch_slot_t *ac_epoch_register(void) {
+    pthread_once(&ac_epoch_once, ac_epoch_init);
+
+    for (size_t i = 0; i < AC_EPOCH_THREADS_MAX; i++) {
+        if (!__atomic_test_and_set(&ac_epoch_slots[i].taken,
+                                   __ATOMIC_ACQUIRE)) {
+            ac_epoch_self = &ac_epoch_slots[i];
+            pthread_setspecific(ac_epoch_key, ac_epoch_self);
+            return ac_epoch_self;
+        }
+    }
+
+    assert(false && "Too many threads, raise AC_EPOCH_THREADS_MAX.");
+    abort();
+}
+
+void ac_epoch_enter(void) {
+    ac_epoch_slot_t *self = ac_epoch_self;
+
+    if (!self) {
+        self = ac_epoch_register();
+    }
+    assert(self->local == 0 && "Read sections must not nest.");
+
+    /* Sequentially consistent so that either a writer scanning the slots
+       sees this reader, or this reader sees the writer's new table. */
+    __atomic_store_n(&self->local,
+                     __atomic_load_n(&ac_epoch_global, __ATOMIC_SEQ_CST),
+                     __ATOMIC_SEQ_CST);
+}
+
+void ac_epoch_exit(void) {
+    __atomic_store_n(&ac_epoch_self->local, 0, __ATOMIC_RELEASE);
+}
+
+/** @brief Whether no active reader entered in or before EPOCH. */
+static bool ac_epoch_quiescent(uint64_t epoch) {
+    for (size_t i = 0; i < AC_EPOCH_THREADS_MAX; i++) {
+        uint64_t local =
+            __atomic_load_n(&ac_epoch_slots[i].local, __ATOMIC_SEQ_CST);
+
+        if (local != 0 && local <= epoch) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ac_cmap_retire(ac_cmap_hdr_t **retired, ac_cmap_hdr_t *table) {
+    if (table) {
+        /* Readers entering from now on cannot see the table. */
+        table->epoch =
+            __atomic_fetch_add(&ac_epoch_global, 1, __ATOMIC_SEQ_CST);
+        table->next = *retired;
+        *retired    = table;
+    }
+
+    /* The list is newest first, so everything after the first table that
+       is safe to free is safe as well. */
+    for (ac_cmap_hdr_t **link = retired; *link; link = &(*link)->next) {
+        if (ac_epoch_quiescent((*link)->epoch)) {
+            ac_cmap_hdr_t *dead = *link;
+            *link               = NULL;
+            ac_cmap_reclaim_all(&dead);
+            break;
+        }
+    }
+}
+
+void ac_cmap_reclaim_all(ac_cmap_hdr_t **retired) {
+    ac_cmap_hdr_t *table = *retired;
+
+    while (table) {
+        ac_cmap_hdr_t *next = table->next;
+        free(table);
+        table = next;
+    }
+
+    *retired = NULL;
+}
@@ -0,0 +1,484 @@
+#include <ac/filter.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <sys/stat.h>
+
+typedef struct ac_pattern_s {
+    const unsigned char *data;
+    size_t len;
+    unsigned action;
+} ac_pattern_t;
+
+static unsigned char ac_filter_fold(unsigned char c) {
+    return c >= 'A' && c <= 'Z' ? (unsigned char)(c - 'A' + 'a') : c;
+}
+
+void ac_filter_new(ac_filter_t *filter) {
+    memset(filter->cls, 0, sizeof filter->cls);
+    filter->classes = 1;
+
+    /* A lone root looping on itself. */
+    ac_arr_new_n_zero(filter->next, 1);
+    ac_arr_new_n_zero(filter->out, 1);
+    filter->patterns = 0;
+}
+
+void ac_filter_free(ac_filter_t *filter) {
+    ac_arr_free(filter->next);
+    ac_arr_free(filter->out);
+}
+
+/** @brief Split a pattern list into patterns, pointing into TEXT.
+ *
+ * @return 0 on success, otherwise the number of the first malformed line.
+ */
+static size_t ac_filter_parse(const char *text, size_t len,
+                              ac_arr(ac_pattern_t) *patterns) {
+    const char *end = text + len;
+    size_t line_no  = 0;
+
+    for (const char *p = text; p < end;) {
+        const char *eol = memchr(p, '\n', (size_t)(end - p));
+        if (!eol) {
+            eol = end;
+        }
+
+        const char *line = p;
+        const char *stop = eol;
+        p                = eol + 1;
+        line_no++;
+
+        for (; line < stop && (*line == ' ' || *line == '\t'); line++)
+            ;
+        for (; stop > line && (stop[-1] == '\r' || stop[-1] == ' ' ||
+                               stop[-1] == '\t');
+             stop--)
+            ;
+
+        if (line == stop || *line == '#') {
+            continue;
+        }
+
+        const char *word = line;
+        for (; line < stop && *line != ' ' && *line != '\t'; line++)
+            ;
+        size_t word_len = (size_t)(line - word);
+        for (; line < stop && (*line == ' ' || *line == '\t'); line++)
+            ;
+
+        ac_pattern_t pattern = {(const unsigned char *)line,
+                                (size_t)(stop - line), 0};
+
+        if (word_len == 4 && memcmp(word, "mask", 4) == 0) {
+            pattern.action = AC_FILTER_MASK;
+        } else if (word_len == 4 && memcmp(word, "drop", 4) == 0) {
+            pattern.action = AC_FILTER_DROP;
+        } else if (word_len == 4 && memcmp(word, "flag", 4) == 0) {
+            pattern.action = AC_FILTER_FLAG;
+        } else {
+            return line_no;
+        }
+
+        if (pattern.len == 0 || pattern.len > AC_FILTER_PATTERN_MAX) {
+            return line_no;
+        }
+
+        ac_arr_append(*patterns, pattern);
+    }
+
+    return 0;
+}
+
+/** @brief Add a state to a filter being built, returning its index. */
+static uint32_t ac_filter_add_state(ac_filter_t *filter) {
+    size_t state = ac_alen(filter->out);
+
+    ac_arr_append_n_raw(filter->next, filter->classes);
+    memset(filter->next + state * filter->classes, 0,
+           filter->classes * sizeof(uint32_t));
+
+    ac_filter_out_t none = {0, 0};
+    ac_arr_append(filter->out, none);
+
+    return (uint32_t)state;
+}
+
+/**
+ * @brief Build the automaton of a parsed pattern list.
+ *
+ * While building, transitions hold state indices. The trie comes first, with
+ * 0 for a missing edge since nothing leads back to the root. A breadth-first
+ * pass then finds every state's failure state, the longest proper suffix of
+ * its path that is also in the trie, fills in its missing edges from there,
+ * and adds the outputs it inherits. Failure states are shallower, so their
+ * rows are complete by then.
+ *
+ * @return false if the automaton is too large for its offsets.
+ */
+static bool ac_filter_build(ac_filter_t *filter,
+                            ac_arr(ac_pattern_t) patterns) {
+    bool used[256] = {false};
+
+    ac_arr_foreach(patterns, i) {
+        for (size_t j = 0; j < patterns[i].len; j++) {
+            used[ac_filter_fold(patterns[i].data[j])] = true;
+        }
+    }
+
+    uint8_t folded_cls[256] = {0};
+    filter->classes         = 1;
+
+    for (int c = 0; c < 256; c++) {
+        if (used[c]) {
+            folded_cls[c] = (uint8_t)filter->classes++;
+        }
+    }
+    for (int c = 0; c < 256; c++) {
+        filter->cls[c] = folded_cls[ac_filter_fold((unsigned char)c)];
+    }
+
+    uint32_t classes = filter->classes;
+
+    ac_arr_new(filter->next);
+    ac_arr_new(filter->out);
+    ac_filter_add_state(filter);
+    filter->patterns = ac_alen(patterns);
+
+    /* Trie. */
+
+    ac_arr_foreach(patterns, i) {
+        uint32_t state = 0;
+
+        for (size_t j = 0; j < patterns[i].len; j++) {
+            size_t edge =
+                (size_t)state * classes + filter->cls[patterns[i].data[j]];
+
+            if (filter->next[edge] == 0) {
+                uint32_t child     = ac_filter_add_state(filter);
+                filter->next[edge] = child;
+            }
+            state = filter->next[edge];
+        }
+
+        ac_filter_out_t *out = &filter->out[state];
+        out->actions |= patterns[i].action;
+
+        if (patterns[i].action == AC_FILTER_MASK &&
+            patterns[i].len > out->mask_len) {
+            out->mask_len = (uint32_t)patterns[i].len;
+        }
+    }
+
+    size_t states = ac_alen(filter->out);
+
+    if (states * classes >= AC_FILTER_HIT) {
+        ac_filter_free(filter);
+        return false;
+    }
+
+    /* Failure states, breadth first. */
+
+    ac_arr(uint32_t) fail;
+    ac_arr(uint32_t) queue;
+    ac_arr_new_n_zero(fail, states);
+    ac_arr_new_reserve(queue, states);
+
+    for (uint32_t c = 0; c < classes; c++) {
+        if (filter->next[c] != 0) {
+            ac_arr_append(queue, filter->next[c]);
+        }
+    }
+
+    ac_arr_foreach(queue, i) {
+        uint32_t state = queue[i];
+        uint32_t *row  = filter->next + (size_t)state * classes;
+        uint32_t *back = filter->next + (size_t)fail[state] * classes;
+
+        for (uint32_t c = 0; c < classes; c++) {
+            uint32_t child = row[c];
+
+            if (child == 0) {
+                row[c] = back[c];
+                continue;
+            }
+
+            uint32_t child_fail  = back[c];
+            fail[child]          = child_fail;
+            ac_filter_out_t *out = &filter->out[child];
+            ac_filter_out_t *inh = &filter->out[child_fail];
+
+            out->actions |= inh->actions;
+            if (inh->mask_len > out->mask_len) {
+                out->mask_len = inh->mask_len;
+            }
+
+            ac_arr_append(queue, child);
+        }
+    }
+
+    ac_arr_free(fail);
+    ac_arr_free(queue);
+
+    /* State indices to row offsets, marking states where patterns end. */
+
+    ac_arr_foreach(filter->next, i) {
+        uint32_t target = filter->next[i];
+
+        filter->next[i] = target * classes |
+                          (filter->out[target].actions ? AC_FILTER_HIT : 0);
+    }
+
+    return true;
+}
+
+bool ac_filter_compile(ac_filter_t *filter, const char *text, size_t len,
+                       size_t *bad_line) {
+    ac_arr(ac_pattern_t) patterns;
+    ac_arr_new(patterns);
+
+    *bad_line = ac_filter_parse(text, len, &patterns);
+
+    ac_filter_t built;
+    bool ok = *bad_line == 0 && ac_filter_build(&built, patterns);
+
+    ac_arr_free(patterns);
+
+    if (ok) {
+        *filter = built;
+    }
+    return ok;
+}
+
+unsigned ac_filter_scan(const ac_filter_t *filter, ac_str_view_t line) {
+    if (filter->patterns == 0) {
+        return 0;
+    }
+
+    const unsigned char *p   = (const unsigned char *)line.data;
+    const unsigned char *end = p + line.len;
+    const uint32_t *next     = filter->next;
+    uint32_t state           = 0;
+    unsigned actions         = 0;
+
+    for (; p < end; p++) {
+        state = next[(state & ~AC_FILTER_HIT) + filter->cls[*p]];
+
+        if (state & AC_FILTER_HIT) {
+            actions |=
+                filter->out[(state & ~AC_FILTER_HIT) / filter->classes]
+                    .actions;
+        }
+    }
+
+    return actions;
+}
+
+void ac_filter_mask(const ac_filter_t *filter, ac_str_view_t line,
+                    char *out) {
+    memcpy(out, line.data, line.len);
+
+    const unsigned char *p = (const unsigned char *)line.data;
+    uint32_t state         = 0;
+    size_t masked          = 0;
+
+    for (size_t i = 0; i < line.len; i++) {
+        state = filter->next[(state & ~AC_FILTER_HIT) + filter->cls[p[i]]];
+
+        if (!(state & AC_FILTER_HIT)) {
+            continue;
+        }
+
+        size_t len =
+            filter->out[(state & ~AC_FILTER_HIT) / filter->classes].mask_len;
+
+        if (len > 0) {
+            size_t start = i + 1 - len;
+            if (start < masked) {
+                start = masked;
+            }
+
+            memset(out + start, '*', i + 1 - start);
+            masked = i + 1;
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------
+   Reloading.
+   ------------------------------------------------------------------------- */
+
+/** @brief Load a pattern file. A missing file has no patterns.
+ *
+ * @return AC_FILTER_RELOADED on success.
+ */
+static ac_filter_reload_t ac_filter_load(ac_filter_t *filter,
+                                         const char *path, size_t *bad_line) {
+    *bad_line = 0;
+
+    FILE *file = fopen(path, "rb");
+
+    if (!file) {
+        if (errno != ENOENT) {
+            return AC_FILTER_UNREADABLE;
+        }
+
+        ac_filter_new(filter);
+        return AC_FILTER_RELOADED;
+    }
+
+    ac_bytes_t text;
+    ac_arr_new(text);
+
+    unsigned char buf[4096];
+    size_t n;
+
+    while ((n = fread(buf, 1, sizeof buf, file)) > 0) {
+        ac_arr_append_n(text, n, buf);
+    }
+
+    bool failed = ferror(file) != 0;
+    fclose(file);
+
+    ac_filter_reload_t result = AC_FILTER_UNREADABLE;
+
+    if (!failed) {
+        result = ac_filter_compile(filter, (const char *)text, ac_alen(text),
+                                   bad_line)
+                     ? AC_FILTER_RELOADED
+                 : *bad_line ? AC_FILTER_MALFORMED
+                             : AC_FILTER_UNREADABLE;
+    }
+
+    ac_arr_free(text);
+    return result;
+}
+
+static void *ac_filter_watch_run(void *arg) {
+    ac_filter_watch_t *watch = arg;
+
+    ac_filter_t *filter = malloc(sizeof *filter);
+    assert(filter);
+
+    if (ac_filter_load(filter, watch->path, &watch->bad_line) !=
+        AC_FILTER_RELOADED) {
+        free(filter);
+        filter = NULL;
+    }
+
+    watch->loaded = filter;
+    ac_atomic_store(&watch->done, true, AC_RELEASE);
+
+    return NULL;
+}
+
+/** @brief Check the file, recording what it looks like now.
+ *
+ * @return Whether it changed since the last check.
+ */
+static bool ac_filter_watch_changed(ac_filter_watch_t *watch, uint64_t now) {
+    struct stat st;
+    bool present = stat(watch->path, &st) == 0;
+
+    watch->checked_at = now;
+
+    if (present == watch->present &&
+        (!present || (st.st_mtim.tv_sec == watch->mtime.tv_sec &&
+                      st.st_mtim.tv_nsec == watch->mtime.tv_nsec &&
+                      st.st_size == watch->size))) {
+        return false;
+    }
+
+    watch->present = present;
+    if (present) {
+        watch->mtime = st.st_mtim;
+        watch->size  = st.st_size;
+    }
+    return true;
+}
+
+ac_filter_reload_t ac_filter_watch_new(ac_filter_watch_t *watch,
+                                       const char *path, uint64_t now) {
+    watch->path    = strdup(path);
+    watch->present = false;
+    watch->loading = false;
+    watch->loaded  = NULL;
+    ac_atomic_store(&watch->done, false, AC_RELAXED);
+
+    ac_filter_watch_changed(watch, now);
+
+    watch->active = malloc(sizeof *watch->active);
+    assert(watch->active);
+
+    ac_filter_reload_t result =
+        ac_filter_load(watch->active, path, &watch->bad_line);
+
+    if (result != AC_FILTER_RELOADED) {
+        ac_filter_new(watch->active);
+    }
+    return result;
+}
+
+void ac_filter_watch_free(ac_filter_watch_t *watch) {
+    if (watch->loading) {
+        pthread_join(watch->thread, NULL);
+
+        if (watch->loaded) {
+            ac_filter_free(watch->loaded);
+            free(watch->loaded);
+        }
+    }
+
+    ac_filter_free(watch->active);
+    free(watch->active);
+    free(watch->path);
+}
+
+uint64_t ac_filter_watch_deadline(const ac_filter_watch_t *watch) {
+    return watch->checked_at + AC_FILTER_CHECK_MS;
+}
+
+ac_filter_reload_t ac_filter_watch_poll(ac_filter_watch_t *watch,
+                                        uint64_t now) {
+    if (watch->loading) {
+        if (!ac_atomic_load(&watch->done, AC_ACQUIRE)) {
+            return AC_FILTER_UNCHANGED;
+        }
+
+        pthread_join(watch->thread, NULL);
+        watch->loading = false;
+
+        if (!watch->loaded) {
+            return watch->bad_line ? AC_FILTER_MALFORMED
+                                   : AC_FILTER_UNREADABLE;
+        }
+
+        ac_filter_free(watch->active);
+        free(watch->active);
+        watch->active = watch->loaded;
+        watch->loaded = NULL;
+
+        return AC_FILTER_RELOADED;
+    }
+
+    if (now - watch->checked_at < AC_FILTER_CHECK_MS ||
+        !ac_filter_watch_changed(watch, now)) {
+        return AC_FILTER_UNCHANGED;
+    }
+
+    ac_atomic_store(&watch->done, false, AC_RELAXED);
+
+    if (pthread_create(&watch->thread, NULL, ac_filter_watch_run, watch) !=
+        0) {
+        /* Forget what the file looked like, so the next check retries. */
+        watch->present       = true;
+        watch->mtime.tv_nsec = -1;
+        return AC_FILTER_NO_THREAD;
+    }
+
+    watch->loading = true;
+    return AC_FILTER_UNCHANGED;
+}
@@ -0,0 +1,179 @@
+#include <ac/history.h>
+
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/* "ACHISTRY" in little-endian byte order. */
+#define AC_HISTORY_MAGIC 0x5952545349484341ull
+
+bool ac_history_open(ac_history_t *history, const char *path, size_t cap) {
+    assert(cap > 0);
+
+    history->fd   = -1;
+    history->hdr  = NULL;
+    history->ring = NULL;
+
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        return false;
+    }
+
+    size_t size = AC_HISTORY_HEADER + cap;
+
+    if (ftruncate(fd, (off_t)size) == -1) {
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    history->fd   = fd;
+    history->hdr  = map;
+    history->ring = (unsigned char *)map + AC_HISTORY_HEADER;
+
+    if (history->hdr->magic != AC_HISTORY_MAGIC || history->hdr->cap != cap) {
+        history->hdr->magic = AC_HISTORY_MAGIC;
+        history->hdr->cap   = cap;
+        history->hdr->head  = 0;
+    }
+
+    return true;
+}
+
+void ac_history_close(ac_history_t *history) {
+    if (!ac_history_enabled(history)) {
+        return;
+    }
+
+    munmap(history->hdr, AC_HISTORY_HEADER + history->hdr->cap);
+    close(history->fd);
+
+    history->fd   = -1;
+    history->hdr  = NULL;
+    history->ring = NULL;
+}
+
+bool ac_history_enabled(const ac_history_t *history) {
+    return history->fd != -1;
+}
+
+/** @brief Byte at a logical position, which must still be in the ring. */
+static unsigned char ac_history_byte(const ac_history_t *history,
+                                     uint64_t pos) {
+    return history->ring[pos % history->hdr->cap];
+}
+
+/** @brief Copy bytes into the ring at a logical position, wrapping around.
+ */
+static void ac_history_write(ac_history_t *history, uint64_t pos,
+                             const void *data, size_t len) {
+    uint64_t cap = history->hdr->cap;
+    size_t at    = (size_t)(pos % cap);
+    size_t first = len < cap - at ? len : (size_t)(cap - at);
+
+    memcpy(history->ring + at, data, first);
+    memcpy(history->ring, (const unsigned char *)data + first, len - first);
+}
+
+void ac_history_append(ac_history_t *history, const ac_str_view_t *parts,
+                       size_t count) {
+    if (!ac_history_enabled(history)) {
+        return;
+    }
+
+    size_t len = 2;
+    for (size_t i = 0; i < count; i++) {
+        len += parts[i].len;
+    }
+
+    if (len > history->hdr->cap / 4) {
+        return;
+    }
+
+    uint64_t pos = history->hdr->head;
+
+    for (size_t i = 0; i < count; i++) {
+        ac_history_write(history, pos, parts[i].data, parts[i].len);
+        pos += parts[i].len;
+    }
+    ac_history_write(history, pos, "\r\n", 2);
+
+    /* Publish the line only once it is complete. */
+    history->hdr->head = pos + 2;
+}
+
+ac_history_range_t ac_history_lines(const ac_history_t *history,
+                                    size_t skip, size_t lines,
+                                    size_t max_bytes) {
+    ac_history_range_t range = {0, 0};
+
+    if (!ac_history_enabled(history)) {
+        return range;
+    }
+
+    uint64_t head   = history->hdr->head;
+    uint64_t cap    = history->hdr->cap;
+    uint64_t oldest = head > cap ? head - cap : 0;
+
+    range.start = head;
+    range.end   = head;
+
+    /* Walk back a line at a time. POS is where the last line found starts,
+       and the byte before it is the LF ending the line before. */
+
+    uint64_t pos = head;
+    size_t seen  = 0;
+
+    while (seen < skip + lines && pos > oldest) {
+        uint64_t start = pos - 1;
+
+        while (start > oldest && ac_history_byte(history, start - 1) != '\n') {
+            start--;
+        }
+
+        /* The line began before the oldest byte kept. */
+        if (start == oldest && oldest > 0) {
+            break;
+        }
+
+        seen++;
+
+        if (seen <= skip) {
+            range.end = start;
+        } else if (range.end - start > max_bytes) {
+            break;
+        }
+
+        range.start = start;
+        pos         = start;
+    }
+
+    return range;
+}
+
+size_t ac_history_piece(const ac_history_t *history, ac_history_range_t *range,
+                        const unsigned char **data) {
+    if (range->start >= range->end) {
+        return 0;
+    }
+
+    uint64_t cap = history->hdr->cap;
+    uint64_t at  = range->start % cap;
+    uint64_t len = range->end - range->start;
+
+    if (len > cap - at) {
+        len = cap - at;
+    }
+
+    *data = history->ring + at;
+    range->start += len;
+
+    return (size_t)len;
+}
@@ -0,0 +1,178 @@
+#include <ac/intern.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <ac/meta.h>
+
+/* Key that stands for the string being looked up, so that the pool's own
+   map can be keyed on atoms and still be searched by bytes. */
+#define AC_ATOM_PROBE UINT32_MAX
+
+typedef struct ac_intern_entry_s {
+    ac_sstr_t str;
+    uint64_t hash;
+    uint32_t refs;
+    /* Next free id while this entry is unused. */
+    ac_atom_t next_free;
+} ac_intern_entry_t;
+
+static uint64_t ac_intern_key_hash(const ac_atom_t *atom);
+static bool ac_intern_key_eq(const ac_atom_t *a, const ac_atom_t *b);
+
+/* Set of interned atoms. Rehashing uses the stored hashes. */
+AC_MAP_DECLARE(ac_atom_set, ac_atom_t, ac_atom_t, ac_intern_key_hash,
+               ac_intern_key_eq);
+AC_MAP_DEFINE(ac_atom_set, ac_atom_t, ac_atom_t, ac_intern_key_hash,
+              ac_intern_key_eq);
+
+static struct {
+    bool initialized;
+
+    /* Indexed by atom. */
+    ac_arr(ac_intern_entry_t) entries;
+    /* Free list of released ids, AC_ATOM_NONE if empty. */
+    ac_atom_t free_head;
+
+    ac_atom_set_t atoms;
+
+    /* The string being looked up through AC_ATOM_PROBE. */
+    const char *probe_data;
+    size_t probe_len;
+    uint64_t probe_hash;
+} ac_pool;
+
+static uint64_t ac_intern_key_hash(const ac_atom_t *atom) {
+    return *atom == AC_ATOM_PROBE ? ac_pool.probe_hash
+                                  : ac_pool.entries[*atom].hash;
+}
+
+static bool ac_intern_key_eq(const ac_atom_t *a, const ac_atom_t *b) {
+    /* Only the probe needs comparing by bytes, the rest are unique. */
+    if (*a != AC_ATOM_PROBE && *b != AC_ATOM_PROBE) {
+        return *a == *b;
+    }
+
+    const ac_sstr_t *str =
+        &ac_pool.entries[*a == AC_ATOM_PROBE ? *b : *a].str;
+
+    return ac_sstr_len(str) == ac_pool.probe_len &&
+           ac_bytes_eq(ac_sstr_data(str), ac_pool.probe_data,
+                       ac_pool.probe_len);
+}
+
+static void ac_intern_init(void) {
+    ac_pool.initialized = true;
+    ac_pool.free_head   = AC_ATOM_NONE;
+
+    /* Atom 0 is the empty string and is never freed. */
+    ac_arr_new_n(ac_pool.entries, 1);
+    ac_sstr_new(&ac_pool.entries[AC_ATOM_NONE].str);
+    ac_pool.entries[AC_ATOM_NONE].hash      = ac_hash_bytes("", 0);
+    ac_pool.entries[AC_ATOM_NONE].refs      = 1;
+    ac_pool.entries[AC_ATOM_NONE].next_free = AC_ATOM_NONE;
+
+    ac_atom_set_new(&ac_pool.atoms);
+}
+
+/** @brief Look up a string, returning AC_ATOM_PROBE if not interned. */
+static ac_atom_t ac_intern_lookup(const char *data, size_t len,
+                                  uint64_t hash) {
+    if (!ac_pool.initialized) {
+        ac_intern_init();
+    }
+
+    if (len == 0) {
+        return AC_ATOM_NONE;
+    }
+
+    ac_pool.probe_data = data;
+    ac_pool.probe_len  = len;
+    ac_pool.probe_hash = hash;
+
+    ac_atom_t *atom = ac_atom_set_get(&ac_pool.atoms, AC_ATOM_PROBE);
+
+    return atom ? *atom : AC_ATOM_PROBE;
+}
+
+ac_atom_t ac_intern(const char *data, size_t len) {
+    uint64_t hash  = ac_hash_bytes(data, len);
+    ac_atom_t atom = ac_intern_lookup(data, len, hash);
+
+    if (atom != AC_ATOM_PROBE) {
+        ac_atom_retain(atom);
+        return atom;
+    }
+
+    /* Reuse a released id if possible. */
+    if (ac_pool.free_head != AC_ATOM_NONE) {
+        atom              = ac_pool.free_head;
+        ac_pool.free_head = ac_pool.entries[atom].next_free;
+    } else {
+        assert(ac_alen(ac_pool.entries) < AC_ATOM_PROBE);
+        atom = (ac_atom_t)ac_alen(ac_pool.entries);
+        ac_arr_append_raw(ac_pool.entries);
+    }
+
+    ac_intern_entry_t *entry = &ac_pool.entries[atom];
+    ac_sstr_new(&entry->str);
+    ac_sstr_set(&entry->str, data, len);
+    entry->hash      = hash;
+    entry->refs      = 1;
+    entry->next_free = AC_ATOM_NONE;
+
+    ac_atom_set_set(&ac_pool.atoms, atom, atom);
+
+    return atom;
+}
+
+ac_atom_t ac_intern_find(const char *data, size_t len) {
+    ac_atom_t atom = ac_intern_lookup(data, len, ac_hash_bytes(data, len));
+    return atom == AC_ATOM_PROBE ? AC_ATOM_NONE : atom;
+}
+
+void ac_atom_retain(ac_atom_t atom) {
+    if (atom != AC_ATOM_NONE) {
+        ac_pool.entries[atom].refs++;
+    }
+}
+
+void ac_atom_release(ac_atom_t atom) {
+    if (atom == AC_ATOM_NONE) {
+        return;
+    }
+
+    ac_intern_entry_t *entry = &ac_pool.entries[atom];
+    assert(entry->refs > 0);
+
+    if (--entry->refs == 0) {
+        ac_atom_set_remove(&ac_pool.atoms, atom);
+        ac_sstr_free(&entry->str);
+
+        entry->next_free  = ac_pool.free_head;
+        ac_pool.free_head = atom;
+    }
+}
+
+const char *ac_atom_data(ac_atom_t atom) {
+    if (!ac_pool.initialized) {
+        return "";
+    }
+    return ac_sstr_data(&ac_pool.entries[atom].str);
+}
+
+size_t ac_atom_len(ac_atom_t atom) {
+    return ac_pool.initialized ? ac_sstr_len(&ac_pool.entries[atom].str) : 0;
+}
+
+uint64_t ac_atom_hash(const ac_atom_t *atom) {
+    if (!ac_pool.initialized) {
+        ac_intern_init();
+    }
+    return ac_pool.entries[*atom].hash;
+}
+
+bool ac_atom_eq(const ac_atom_t *a, const ac_atom_t *b) {
+    return *a == *b;
+}
@@ -13,145 +13,331 @@
 #include <ac/str.h>
 #include <ac/log.h>
 
-static bool ac_has_complete_line(const ac_string_t in, size_t *len) {
-    for (*len = 0; *len < ac_alen(in); *len += 1) {
-        if (in[*len] == '\r' || in[*len] == '\n') {
-            return true;
-        }
+/** @brief Compact an input buffer: drop the consumed front entirely when
+ * everything was consumed, otherwise only once it outweighs the rest, so
+ * each byte is moved a bounded number of times. */
+static void ac_input_compact(ac_input_t *in) {
+    size_t len = ac_alen(in->buf);
+
+    if (in->consumed == len) {
+        ac_alen(in->buf) = 0;
+    } else if (in->consumed > len - in->consumed) {
+        memmove(in->buf, in->buf + in->consumed, len - in->consumed);
+        ac_alen(in->buf) = len - in->consumed;
+    } else {
+        return;
     }
-    return false;
+
+    in->scanned -= in->consumed;
+    in->consumed = 0;
 }
 
-/** @brief Trim leading and trailing whitespace from a string.
- *
- * @param str The string to trim.
- */
-static void ac_trim_whitespace(ac_string_t *str) {
-    if (ac_alen(*str) == 0) {
-        return;
-    }
+bool ac_get_line(ac_str_view_t *line, ac_input_t *in) {
+    ac_input_compact(in);
 
-    /* Remove leading whitespace. */
+    /* Find the line end, resuming where the last call stopped. */
 
-    size_t start;
-    for (start = 0; start < ac_alen(*str) && (*str)[start] == ' '; start++)
-        ;
-    if (start == ac_alen(*str)) {
-        ac_alen(*str) = 0;
-        return;
-    } else {
-        ac_arr_remove_n(*str, 0, start);
+    char *buf  = (char *)in->buf;
+    size_t len = ac_alen(in->buf);
+    size_t eol = in->scanned + ac_find_eol(buf + in->scanned,
+                                           len - in->scanned);
+
+    if (eol == len) {
+        in->scanned = len;
+        return false;
     }
 
-    /* Remove trailing whitespace. */
+    /* Sanitize in place. */
+
+    size_t start = in->consumed;
+    size_t kept =
+        ac_utf8_sanitize(buf + start, eol - start, AC_INPUT_UTF8_POLICY);
 
-    size_t end = ac_alen(*str);
-    while (end > 0 && (*str)[end - 1] == ' ') {
-        end--;
+    /* Pad what sanitizing removed with spaces, which trimming drops, so the
+       line reads the same if it is handed out again. */
+    if (kept != AC_UTF8_INVALID) {
+        memset(buf + start + kept, ' ', eol - start - kept);
     }
+    in->line_start = start;
 
-    ac_alen(*str) = end;
-}
+    /* Consume line and newline characters. */
 
-bool ac_get_line(ac_string_t *line, ac_string_t *in) {
-    /* Find line length. */
+    for (; eol < len && (buf[eol] == '\r' || buf[eol] == '\n'); eol++)
+        ;
 
-    size_t len;
+    in->consumed = eol;
+    in->scanned  = eol;
 
-    if (!ac_has_complete_line(*in, &len)) {
+    if (kept == AC_UTF8_INVALID) {
+        in->rejected++;
         return false;
     }
 
-    /* Append printable characters to line buffer. */
-    for (size_t i = 0; i < len; i++) {
-        if ((*in)[i] >= 0x20 && (*in)[i] <= 0x7e) {
-            ac_arr_append(*line, (*in)[i]);
-        }
-    }
+    /* Trim spaces off the view. */
 
-    /* Consume line and newline characters. */
+    size_t end = start + kept;
 
-    for (; len < ac_alen(*in) && ((*in)[len] == '\r' || (*in)[len] == '\n');
-         len += 1)
+    for (; start < end && buf[start] == ' '; start++)
+        ;
+    for (; end > start && buf[end - 1] == ' '; end--)
         ;
 
-    ac_arr_remove_n((*in), 0, len);
-
-    ac_trim_whitespace(line);
+    line->data = buf + start;
+    line->len  = end - start;
 
     return true;
 }
 
-void ac_send_fmt(const ac_user_t *user, ac_app_t *app, const char *fmt, ...) {
-    ac_bytes_t out;
-    ac_arr_new_reserve(out, 1024);
+/** @brief Append N uninitialized bytes to an output queue and return them.
+ */
+static unsigned char *ac_out_reserve(ac_bytes_t *out, size_t n) {
+    size_t at = ac_alen(*out);
+    ac_arr_append_n_raw(*out, n);
+    return *out + at;
+}
+
+/** @brief Format into an output queue between LEAD and TRAIL, all in one
+ * reservation. */
+static void ac_out_vprintf(ac_bytes_t *out, const char *lead,
+                           const char *trail, const char *fmt,
+                           va_list args) {
+    va_list measure;
+    va_copy(measure, args);
+    size_t len = (size_t)vsnprintf(NULL, 0, fmt, measure);
+    va_end(measure);
+
+    size_t lead_len  = strlen(lead);
+    size_t trail_len = strlen(trail);
+
+    /* Reserve room for the NUL vsnprintf() writes, then drop it. */
+    unsigned char *p = ac_out_reserve(out, lead_len + len + trail_len + 1);
+    memcpy(p, lead, lead_len);
+    vsnprintf((char *)p + lead_len, len + 1, fmt, args);
+    memcpy(p + lead_len + len, trail, trail_len);
+
+    ac_alen(*out) -= 1;
+}
+
+ac_writer_t ac_write_begin(const ac_user_t *user, ac_print_type_t action) {
+    ac_writer_t w = {user->out};
+
+    if (action == AC_PRINT_INTERRUPT) {
+        ac_write_bytes(&w, "\r\n", 2);
+    }
+    return w;
+}
+
+void ac_write_bytes(ac_writer_t *w, const void *data, size_t len) {
+    memcpy(ac_out_reserve(w->out, len), data, len);
+}
 
+void ac_write_str(ac_writer_t *w, const char *str) {
+    ac_write_bytes(w, str, strlen(str));
+}
+
+void ac_write_view(ac_writer_t *w, ac_str_view_t view) {
+    ac_write_bytes(w, view.data, view.len);
+}
+
+void ac_write_name(ac_writer_t *w, ac_atom_t name) {
+    ac_write_bytes(w, ac_atom_data(name), ac_atom_len(name));
+}
+
+void ac_write_uint(ac_writer_t *w, size_t value) {
+    char digits[20];
+    size_t n = sizeof digits;
+
+    do {
+        digits[--n] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+
+    ac_write_bytes(w, digits + n, sizeof digits - n);
+}
+
+void ac_write_fmt(ac_writer_t *w, const char *fmt, ...) {
     va_list args;
     va_start(args, fmt);
-    ac_alen(out) = (size_t)vsnprintf((char *)out, ac_acap(out), fmt, args);
+    ac_out_vprintf(w->out, "", "", fmt, args);
     va_end(args);
+}
+
+void ac_write_end(ac_writer_t *w) { ac_write_bytes(w, "\r\n>", 3); }
 
-    ac_server_send(&app->server, user->handle, out);
-    ac_arr_free(out);
+void ac_unget_line(ac_input_t *in) {
+    in->consumed = in->line_start;
+    in->scanned  = in->line_start;
+}
+
+void ac_send_fmt(const ac_user_t *user, ac_app_t *app, const char *fmt, ...) {
+    (void)app;
+
+    va_list args;
+    va_start(args, fmt);
+    ac_out_vprintf(user->out, "", "", fmt, args);
+    va_end(args);
 }
 
 void ac_send(const ac_user_t *user, ac_app_t *app, const char *msg) {
-    ac_send_fmt(user, app, "%s", msg);
+    (void)app;
+
+    ac_writer_t w = {user->out};
+    ac_write_str(&w, msg);
 }
 
 void ac_prompt(const ac_user_t *user, ac_app_t *app) {
-    ac_bytes_t msg;
-    ac_arr_from_string_literal(msg, ">", 1, 0);
-    ac_server_send(&app->server, user->handle, msg);
+    (void)app;
+
+    ac_writer_t w = {user->out};
+    ac_write_bytes(&w, ">", 1);
 }
 
 void ac_print_fmt(const ac_user_t *user, ac_app_t *app, ac_print_type_t action,
                   const char *fmt, ...) {
-    ac_bytes_t nl;
-    ac_arr_from_string_literal(nl, "\r\n", 2, 0);
+    (void)app;
 
-    if (action == AC_PRINT_INTERRUPT) {
-        ac_server_send(&app->server, user->handle, nl);
+    va_list args;
+    va_start(args, fmt);
+    ac_out_vprintf(user->out, action == AC_PRINT_INTERRUPT ? "\r\n" : "",
+                   "\r\n>", fmt, args);
+    va_end(args);
+}
+
+void ac_broadcast_fmt(ac_app_t *app, const ac_user_t *except,
+                      const char *fmt, ...) {
+    const ac_members_t *members = &app->users.members;
+    size_t count                = ac_alen(members->handles);
+
+    /* Format straight into the first recipient's queue, then copy from
+       there to everyone else. */
+
+    size_t first = 0;
+    if (first < count && except &&
+        members->handles[first] == except->handle) {
+        first++;
+    }
+    if (first == count) {
+        return;
     }
 
-    ac_bytes_t out;
-    ac_arr_new_reserve(out, 1024);
+    ac_bytes_t *src = members->outs[first];
+    size_t at       = ac_alen(*src);
 
     va_list args;
     va_start(args, fmt);
-    ac_alen(out) = (size_t)vsnprintf((char *)out, ac_acap(out), fmt, args);
+    ac_out_vprintf(src, "\r\n", "\r\n>", fmt, args);
     va_end(args);
 
-    ac_server_send(&app->server, user->handle, out);
-    ac_arr_free(out);
+    size_t len = ac_alen(*src) - at;
 
-    ac_server_send(&app->server, user->handle, nl);
-    ac_prompt(user, app);
+    for (size_t i = first + 1; i < count; i++) {
+        if (except && members->handles[i] == except->handle) {
+            continue;
+        }
+
+        ac_arr_append_n(*members->outs[i], len, *src + at);
+    }
 }
 
 void ac_print(const ac_user_t *user, ac_app_t *app, ac_print_type_t action,
               const char *msg) {
-    ac_print_fmt(user, app, action, "%s", msg);
+    (void)app;
+
+    ac_writer_t w = ac_write_begin(user, action);
+    ac_write_str(&w, msg);
+    ac_write_end(&w);
 }
 
-bool ac_validate_username(const ac_string_t username) {
-    if (ac_alen(username) < 2 || ac_alen(username) > 16) {
+/** @brief Append formatted text to a rendered response. */
+static void ac_render_fmt(ac_rendered_t *r, const char *fmt, ...) {
+    va_list args, measure;
+    va_start(args, fmt);
+    va_copy(measure, args);
+    size_t len = (size_t)vsnprintf(NULL, 0, fmt, measure);
+    va_end(measure);
+
+    /* Reserve room for the NUL vsnprintf() writes, then drop it. */
+    size_t at = ac_alen(r->text);
+    ac_arr_append_n_raw(r->text, len + 1);
+    vsnprintf((char *)r->text + at, len + 1, fmt, args);
+    va_end(args);
+
+    ac_alen(r->text) = at + len;
+}
+
+/** @brief Whether a rendered response must be rendered again, emptying it if
+ * so. */
+static bool ac_render_stale(ac_app_t *app, ac_rendered_t *r) {
+    if (r->gen == app->rendered.gen) {
         return false;
     }
 
-    for (size_t i = 0; i < ac_alen(username); i++) {
-        char c = username[i];
-        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
-              (c >= '0' && c <= '9') || c == '_')) {
+    ac_alen(r->text) = 0;
+    r->gen           = app->rendered.gen;
+    return true;
+}
+
+void ac_send_greeting(const ac_user_t *user, ac_app_t *app) {
+    ac_rendered_t *r = &app->rendered.greeting;
+
+    if (ac_render_stale(app, r)) {
+        size_t count = app->users.from_handle.len;
+
+        ac_render_fmt(
+            r,
+            "[ AuroraComms - Multi-User Communications Server ]\r\n"
+            "There %s currently %zu user%s online.\r\n"
+            "Server uptime: %s\r\n"
+            "\r\n"
+            "Enter a username between 2-16 characters long.\r\n"
+            "It may include letters, numbers and underscores.\r\n"
+            "Reconnecting? Enter /resume and your session token.\r\n>",
+            count == 1 ? "is" : "are", count, count == 1 ? "" : "s",
+            app->rendered.uptime);
+    }
+
+    ac_writer_t w = {user->out};
+    ac_write_bytes(&w, r->text, ac_alen(r->text));
+}
+
+/** @brief Send the /info response. */
+static void ac_send_info(const ac_user_t *user, ac_app_t *app) {
+    ac_rendered_t *r = &app->rendered.info;
+
+    if (ac_render_stale(app, r)) {
+        ac_render_fmt(r,
+                      "AuroraComms Server\n"
+                      " - Uptime: %s\n"
+                      " - Connected users: %zu\r\n>",
+                      app->rendered.uptime, app->users.from_handle.len);
+    }
+
+    ac_writer_t w = {user->out};
+    ac_write_bytes(&w, r->text, ac_alen(r->text));
+}
+
+bool ac_validate_username(ac_str_view_t username) {
+    if (username.len < AC_USERNAME_MIN ||
+        username.len > AC_USERNAME_MAX * 4) {
+        return false;
+    }
+
+    size_t chars = 0;
+
+    for (size_t i = 0; i < username.len; chars++) {
+        uint32_t cp;
+        i += ac_utf8_decode(username.data + i, username.len - i, &cp);
+
+        if (cp == AC_UTF8_BAD || !ac_utf8_name_char(cp)) {
             return false;
         }
     }
 
-    return true;
+    return chars >= AC_USERNAME_MIN && chars <= AC_USERNAME_MAX;
 }
 
-bool ac_is_command(const ac_string_t line) {
-    return ac_alen(line) > 0 && line[0] == AC_COMMAND_PREFIX;
+bool ac_is_command(ac_str_view_t line) {
+    return line.len > 0 && line.data[0] == AC_COMMAND_PREFIX;
 }
 
 typedef enum ac_cmd_e {
@@ -159,34 +345,74 @@ typedef enum ac_cmd_e {
     AC_CMD_EXIT,
     AC_CMD_INFO,
     AC_CMD_LIST,
-    AC_CMD_WHISPER
+    AC_CMD_WHO,
+    AC_CMD_WHISPER,
+    AC_CMD_HISTORY,
+    AC_CMD_SEARCH,
+    AC_CMD_REGISTER
 } ac_cmd_t;
 
-static ac_map(ac_string_t, ac_cmd_t) ac_commands;
-
-static void ac_init_aliases(const char *aliases[], ac_cmd_t cmd) {
-    for (size_t i = 0; aliases[i]; i++) {
-        ac_string_t alias;
-        ac_arr_new_reserve(alias, strlen(aliases[i]));
-        ac_arr_append_n(alias, strlen(aliases[i]), aliases[i]);
+/* Command aliases, one entry each: X(command, first letter, alias). */
+#define AC_COMMAND_ALIASES(X)                                                 \
+    X(AC_CMD_HELP, 'h', "help")                                               \
+    X(AC_CMD_HELP, 'h', "h")                                                  \
+    X(AC_CMD_EXIT, 'e', "exit")                                               \
+    X(AC_CMD_EXIT, 'e', "e")                                                  \
+    X(AC_CMD_EXIT, 'q', "quit")                                               \
+    X(AC_CMD_EXIT, 'q', "q")                                                  \
+    X(AC_CMD_INFO, 'i', "info")                                               \
+    X(AC_CMD_INFO, 'i', "i")                                                  \
+    X(AC_CMD_LIST, 'l', "list")                                               \
+    X(AC_CMD_LIST, 'l', "l")                                                  \
+    X(AC_CMD_WHO, 'w', "who")                                                 \
+    X(AC_CMD_WHISPER, 'w', "whisper")                                         \
+    X(AC_CMD_WHISPER, 'w', "w")                                               \
+    X(AC_CMD_WHISPER, 'm', "msg")                                             \
+    X(AC_CMD_WHISPER, 'm', "m")                                               \
+    X(AC_CMD_HISTORY, 'h', "history")                                         \
+    X(AC_CMD_SEARCH, 's', "search")                                           \
+    X(AC_CMD_SEARCH, 's', "s")                                                \
+    X(AC_CMD_REGISTER, 'r', "register")
+
+/* Perfect hash of an alias from its first letter and length. Every alias
+   becomes a case label below, so a collision is a duplicate case error. */
+#define AC_CMD_SLOT(FIRST, LEN)                                               \
+    ((((unsigned)(FIRST) & 0x1F) << 3) | ((unsigned)(LEN) & 7))
+
+/**
+ * @brief Look up a command by alias. Compiles to a jump table followed by a
+ * single string compare; nothing is built at runtime.
+ *
+ * @param word The alias, not NUL-terminated.
+ * @param len The length of the alias.
+ * @param cmd Set to the command if found.
+ * @return Whether the alias exists.
+ */
+static bool ac_lookup_command(const char *word, size_t len, ac_cmd_t *cmd) {
+    const char *alias;
+    size_t alias_len;
 
-        ac_map_set(ac_commands, ac_string_hash, ac_string_eq, alias, cmd);
+    if (len == 0) {
+        return false;
     }
-}
 
-static void ac_init_commands(void) {
-    ac_map_new(ac_commands);
+    switch (AC_CMD_SLOT(word[0], len)) {
+#define AC_CMD_CASE(CMD, FIRST, ALIAS)                                        \
+    case AC_CMD_SLOT(FIRST, sizeof(ALIAS) - 1):                               \
+        *cmd      = CMD;                                                      \
+        alias     = ALIAS;                                                    \
+        alias_len = sizeof(ALIAS) - 1;                                        \
+        break;
 
-#define AC_INIT_ALIASES(cmd, ...)                                             \
-    ac_init_aliases((const char *[]){__VA_ARGS__, NULL}, cmd)
+        AC_COMMAND_ALIASES(AC_CMD_CASE)
 
-    AC_INIT_ALIASES(AC_CMD_HELP, "help", "h");
-    AC_INIT_ALIASES(AC_CMD_EXIT, "exit", "e", "quit", "q");
-    AC_INIT_ALIASES(AC_CMD_INFO, "info", "i");
-    AC_INIT_ALIASES(AC_CMD_LIST, "list", "l");
-    AC_INIT_ALIASES(AC_CMD_WHISPER, "whisper", "w", "msg", "m");
+#undef AC_CMD_CASE
+
+        default:
+            return false;
+    }
 
-#undef AC_INIT_ALIASES
+    return len == alias_len && memcmp(word, alias, len) == 0;
 }
 
 static void ac_handle_help_cmd(ac_user_t *user, ac_app_t *app) {
@@ -195,50 +421,485 @@ static void ac_handle_help_cmd(ac_user_t *user, ac_app_t *app) {
              " - help (h): Show this help message.\n"
              " - exit (e / quit / q): Exit AuroraComms.\n"
              " - info (i): Show server information.\n"
-             " - list (l): List online users.\n"
-             " - whisper (w / msg / m): Send a private message.");
+             " - list (l) [prefix] [page]: List online users, optionally\n"
+             "   only those whose name starts with a prefix.\n"
+             " - who <prefix>: Complete a username.\n"
+             " - whisper (w / msg / m): Send a private message.\n"
+             " - history [page]: Show earlier chat messages.\n"
+             " - search (s) <words> [page]: Find recent messages with all\n"
+             "   of the words.\n"
+             " - register <password>: Protect your name with a password.");
+}
+
+/** @brief Get the next space separated argument of a command line. Empty
+ * once there are none left.
+ *
+ * @param line The command line.
+ * @param pos Where to start looking, advanced past the argument.
+ */
+static ac_str_view_t ac_next_arg(ac_str_view_t line, size_t *pos) {
+    size_t start = *pos;
+    for (; start < line.len && line.data[start] == ' '; start++)
+        ;
+
+    size_t end = start;
+    for (; end < line.len && line.data[end] != ' '; end++)
+        ;
+
+    *pos = end;
+
+    ac_str_view_t arg = {line.data + start, end - start};
+    return arg;
+}
+
+/** @brief Parse a page number of at most 9 digits, starting at 1. */
+static bool ac_parse_page(ac_str_view_t arg, size_t *page) {
+    if (arg.len == 0 || arg.len > 9) {
+        return false;
+    }
+
+    size_t value = 0;
+    for (size_t i = 0; i < arg.len; i++) {
+        if (arg.data[i] < '0' || arg.data[i] > '9') {
+            return false;
+        }
+        value = value * 10 + (size_t)(arg.data[i] - '0');
+    }
+
+    *page = value;
+    return value > 0;
+}
+
+/** @brief Render one page of /list for the names in RANGE. */
+static void ac_render_list_page(ac_rendered_t *r, ac_app_t *app,
+                                ac_str_view_t prefix, ac_name_range_t range,
+                                size_t page, size_t pages) {
+    if (prefix.len > 0) {
+        ac_render_fmt(r,
+                      "Online users starting with \"%.*s\" (page %zu of "
+                      "%zu):\r\n",
+                      ac_str_view_fmt_args(prefix), page, pages);
+    } else {
+        ac_render_fmt(r, "Online users (page %zu of %zu):\r\n", page,
+                      pages);
+    }
+
+    size_t first = range.first + (page - 1) * AC_LIST_PAGE_SIZE;
+    size_t last  = range.first + range.count;
+    if (last - first > AC_LIST_PAGE_SIZE) {
+        last = first + AC_LIST_PAGE_SIZE;
+    }
+
+    for (size_t i = first; i < last; i++) {
+        ac_render_fmt(r, " - %.*s\r\n",
+                      ac_atom_fmt_args(ac_name_index_at(&app->users.by_name,
+                                                        i)));
+    }
+
+    if (page < pages) {
+        ac_render_fmt(r, "Type /list %.*s%s%zu for more.\r\n",
+                      ac_str_view_fmt_args(prefix), prefix.len ? " " : "",
+                      page + 1);
+    }
+
+    ac_render_fmt(r, ">");
+}
+
+/** @brief Send a rendered /list page, marking the caller's own entry on the
+ * way out so the page itself can be shared. */
+static void ac_send_list_page(const ac_user_t *user, ac_app_t *app,
+                              const ac_bytes_t text, ac_name_range_t range,
+                              size_t page) {
+    ac_writer_t w = {user->out};
+    size_t len    = ac_alen(text);
+
+    size_t first = range.first + (page - 1) * AC_LIST_PAGE_SIZE;
+    size_t last  = range.first + range.count;
+    if (last - first > AC_LIST_PAGE_SIZE) {
+        last = first + AC_LIST_PAGE_SIZE;
+    }
+
+    /* The own name sorts first among the names it is a prefix of. */
+    size_t self = ac_name_index_prefix(&app->users.by_name,
+                                       ac_atom_data(user->username),
+                                       ac_atom_len(user->username))
+                      .first;
+
+    if (self < first || self >= last ||
+        ac_name_index_at(&app->users.by_name, self) != user->username) {
+        ac_write_bytes(&w, text, len);
+        return;
+    }
+
+    /* Entries follow the heading line, one per line. */
+    size_t lines = self - first + 2;
+    size_t mark  = 0;
+
+    for (; mark + 1 < len; mark++) {
+        if (text[mark] == '\r' && text[mark + 1] == '\n' && --lines == 0) {
+            break;
+        }
+    }
+
+    ac_write_bytes(&w, text, mark);
+    ac_write_str(&w, " (You)");
+    ac_write_bytes(&w, text + mark, len - mark);
+}
+
+/** @brief List one page of the online users whose name starts with a
+ * prefix. Only the page is visited, whatever the number of users. */
+static void ac_handle_list_cmd(ac_user_t *user, ac_app_t *app,
+                               ac_str_view_t line, size_t pos) {
+    ac_str_view_t prefix   = ac_next_arg(line, &pos);
+    ac_str_view_t page_arg = ac_next_arg(line, &pos);
+    size_t page            = 1;
+
+    /* A lone number is a page of everyone, so listing names starting with
+       digits needs an explicit page. */
+    if (page_arg.len == 0 && ac_parse_page(prefix, &page)) {
+        prefix.len = 0;
+    } else if (page_arg.len > 0 && !ac_parse_page(page_arg, &page)) {
+        ac_print(user, app, AC_PRINT_AFTER_ENTER,
+                 "Usage: /list [prefix] [page]");
+        return;
+    }
+
+    ac_name_range_t range =
+        ac_name_index_prefix(&app->users.by_name, prefix.data, prefix.len);
+    size_t pages = (range.count + AC_LIST_PAGE_SIZE - 1) / AC_LIST_PAGE_SIZE;
+
+    if (range.count == 0) {
+        ac_print_fmt(user, app, AC_PRINT_AFTER_ENTER,
+                     "No online user's name starts with \"%.*s\".",
+                     ac_str_view_fmt_args(prefix));
+        return;
+    }
+
+    if (page > pages) {
+        ac_print_fmt(user, app, AC_PRINT_AFTER_ENTER,
+                     "There %s only %zu page%s.", pages == 1 ? "is" : "are",
+                     pages, pages == 1 ? "" : "s");
+        return;
+    }
+
+    /* Pages of everyone are shared by all users until someone comes or
+       goes. Filtered pages are rendered for the one request. */
+    if (prefix.len == 0) {
+        while (ac_alen(app->rendered.list_pages) < page) {
+            ac_rendered_t fresh = {.gen = 0};
+            ac_arr_new(fresh.text);
+            ac_arr_append(app->rendered.list_pages, fresh);
+        }
+
+        ac_rendered_t *r = &app->rendered.list_pages[page - 1];
+
+        if (ac_render_stale(app, r)) {
+            ac_render_list_page(r, app, prefix, range, page, pages);
+        }
+
+        ac_send_list_page(user, app, r->text, range, page);
+    } else {
+        ac_rendered_t r = {.gen = 0};
+        ac_arr_new_a(r.text, &app->scratch.allocator);
+
+        ac_render_list_page(&r, app, prefix, range, page, pages);
+
+        ac_send_list_page(user, app, r.text, range, page);
+        ac_arr_free(r.text);
+    }
+}
+
+/** @brief Complete a username from a prefix, as far as it is unambiguous.
+ */
+static void ac_handle_who_cmd(ac_user_t *user, ac_app_t *app,
+                              ac_str_view_t line, size_t pos) {
+    ac_str_view_t prefix = ac_next_arg(line, &pos);
+
+    if (prefix.len == 0) {
+        ac_print(user, app, AC_PRINT_AFTER_ENTER, "Usage: /who <prefix>");
+        return;
+    }
+
+    ac_name_range_t range =
+        ac_name_index_prefix(&app->users.by_name, prefix.data, prefix.len);
+
+    if (range.count == 0) {
+        ac_print_fmt(user, app, AC_PRINT_AFTER_ENTER,
+                     "No online user's name starts with \"%.*s\".",
+                     ac_str_view_fmt_args(prefix));
+        return;
+    }
+
+    if (range.count == 1) {
+        ac_print_fmt(
+            user, app, AC_PRINT_AFTER_ENTER, "%.*s",
+            ac_atom_fmt_args(ac_name_index_at(&app->users.by_name,
+                                              range.first)));
+        return;
+    }
+
+    /* Ambiguous: extend the prefix as far as all candidates agree and show
+       the first few. */
+
+    size_t common = ac_name_index_common_prefix(&app->users.by_name, range);
+    ac_writer_t w = ac_write_begin(user, AC_PRINT_AFTER_ENTER);
+
+    ac_write_bytes(&w,
+                   ac_atom_data(ac_name_index_at(&app->users.by_name,
+                                                 range.first)),
+                   common);
+    ac_write_str(&w, "... (");
+    ac_write_uint(&w, range.count);
+    ac_write_str(&w, " matches)");
+
+    size_t shown =
+        range.count < AC_WHO_SUGGESTIONS ? range.count : AC_WHO_SUGGESTIONS;
+
+    for (size_t i = 0; i < shown; i++) {
+        ac_write_str(&w, "\r\n - ");
+        ac_write_name(&w,
+                      ac_name_index_at(&app->users.by_name, range.first + i));
+    }
+
+    if (range.count > shown) {
+        ac_write_str(&w, "\r\n - and ");
+        ac_write_uint(&w, range.count - shown);
+        ac_write_str(&w, " more");
+    }
+
+    ac_write_end(&w);
+}
+
+/** @brief End of the command word of a command line. */
+static size_t ac_command_end(ac_str_view_t line) {
+    size_t end;
+    for (end = 1; end < line.len && line.data[end] != ' '; end++)
+        ;
+    return end;
+}
+
+ac_rate_class_t ac_rate_class(ac_str_view_t line) {
+    if (!ac_is_command(line)) {
+        return AC_RATE_CHAT;
+    }
+
+    ac_cmd_t cmd;
+    size_t cmd_end = ac_command_end(line);
+
+    if (ac_lookup_command(line.data + 1, cmd_end - 1, &cmd) &&
+        cmd == AC_CMD_WHISPER) {
+        return AC_RATE_WHISPER;
+    }
+    return AC_RATE_COMMAND;
+}
+
+void ac_send_history(const ac_user_t *user, ac_app_t *app,
+                     ac_history_range_t range) {
+    ac_writer_t w = {user->out};
+    const unsigned char *data;
+    size_t len;
+
+    while ((len = ac_history_piece(&app->history, &range, &data)) > 0) {
+        ac_write_bytes(&w, data, len);
+    }
+}
+
+/** @brief Show a page of chat history, page 1 being the most recent. */
+static void ac_handle_history_cmd(ac_user_t *user, ac_app_t *app,
+                                  ac_str_view_t line, size_t pos) {
+    ac_str_view_t page_arg = ac_next_arg(line, &pos);
+    size_t page            = 1;
+
+    if (page_arg.len > 0 && !ac_parse_page(page_arg, &page)) {
+        ac_print(user, app, AC_PRINT_AFTER_ENTER, "Usage: /history [page]");
+        return;
+    }
+
+    ac_history_range_t range =
+        ac_history_lines(&app->history, (page - 1) * AC_HISTORY_PAGE_SIZE,
+                         AC_HISTORY_PAGE_SIZE, SIZE_MAX);
+
+    if (range.start == range.end) {
+        ac_print(user, app, AC_PRINT_AFTER_ENTER,
+                 page == 1 ? "No chat history yet."
+                           : "There are no older messages.");
+        return;
+    }
+
+    ac_send_fmt(user, app, "Chat history (page %zu):\r\n", page);
+    ac_send_history(user, app, range);
+
+    ac_history_range_t older = ac_history_lines(
+        &app->history, page * AC_HISTORY_PAGE_SIZE, 1, SIZE_MAX);
+
+    if (older.start != older.end) {
+        ac_send_fmt(user, app, "Type /history %zu for older messages.\r\n",
+                    page + 1);
+    }
+    ac_prompt(user, app);
+}
+
+/** @brief Write how long ago something happened, e.g. "5m ago". */
+static void ac_write_age(ac_writer_t *w, uint64_t ms) {
+    uint64_t secs = ms / 1000;
+
+    if (secs < 60) {
+        ac_write_uint(w, (size_t)secs);
+        ac_write_str(w, "s ago");
+    } else if (secs < 60 * 60) {
+        ac_write_uint(w, (size_t)(secs / 60));
+        ac_write_str(w, "m ago");
+    } else {
+        ac_write_uint(w, (size_t)(secs / (60 * 60)));
+        ac_write_str(w, "h ago");
+    }
+}
+
+static void ac_handle_search_cmd(ac_user_t *user, ac_app_t *app,
+                                 ac_str_view_t line, size_t pos) {
+    ac_str_view_t query = {line.data + pos, line.len - pos};
+    size_t page         = 1;
+
+    for (; query.len > 0 && query.data[0] == ' '; query.data++, query.len--)
+        ;
+    for (; query.len > 0 && query.data[query.len - 1] == ' '; query.len--)
+        ;
+
+    /* A number after other words is the page, so a lone number is still
+       searched for. */
+    size_t last = query.len;
+    for (; last > 0 && query.data[last - 1] != ' '; last--)
+        ;
+
+    ac_str_view_t page_arg = {query.data + last, query.len - last};
+
+    if (last > 0 && ac_parse_page(page_arg, &page)) {
+        for (query.len = last; query.data[query.len - 1] == ' '; query.len--)
+            ;
+    }
+
+    if (query.len == 0) {
+        ac_print(user, app, AC_PRINT_AFTER_ENTER,
+                 "Usage: /search <words> [page]");
+        return;
+    }
+
+    ac_search_expire(&app->search, app->now);
+
+    ac_search_hit_t hits[AC_SEARCH_MAX_RESULTS];
+    size_t found =
+        ac_search_find(&app->search, query, hits, AC_SEARCH_MAX_RESULTS);
+    size_t pages = (found + AC_SEARCH_PAGE_SIZE - 1) / AC_SEARCH_PAGE_SIZE;
+
+    if (found == 0) {
+        ac_print(user, app, AC_PRINT_AFTER_ENTER, "No messages found.");
+        return;
+    }
+
+    if (page > pages) {
+        ac_print_fmt(user, app, AC_PRINT_AFTER_ENTER,
+                     "There %s only %zu page%s of results.",
+                     pages == 1 ? "is" : "are", pages, pages == 1 ? "" : "s");
+        return;
+    }
+
+    ac_writer_t w = ac_write_begin(user, AC_PRINT_AFTER_ENTER);
+    ac_write_fmt(&w, "Messages with \"%.*s\" (page %zu of %zu):",
+                 ac_str_view_fmt_args(query), page, pages);
+
+    size_t first = (page - 1) * AC_SEARCH_PAGE_SIZE;
+    size_t end   = first + AC_SEARCH_PAGE_SIZE < found
+                       ? first + AC_SEARCH_PAGE_SIZE
+                       : found;
+
+    for (size_t i = first; i < end; i++) {
+        ac_write_str(&w, "\r\n - ");
+        ac_write_age(&w, app->now - hits[i].time_ms);
+        ac_write_str(&w, " [");
+        ac_write_view(&w, hits[i].from);
+        ac_write_str(&w, "]: ");
+        ac_write_view(&w, hits[i].text);
+    }
+
+    if (page < pages) {
+        ac_write_fmt(&w, "\r\nType /search %.*s %zu for more.",
+                     ac_str_view_fmt_args(query), page + 1);
+    }
+
+    ac_write_end(&w);
+}
+
+/** @brief Register the user's name with the password that follows, hashed
+ * on the auth workers. The user hears back once it is done. */
+static void ac_handle_register_cmd(ac_user_t *user, ac_app_t *app,
+                                   ac_str_view_t line, size_t pos) {
+    ac_str_view_t password = {line.data + pos, line.len - pos};
+
+    for (; password.len > 0 && password.data[0] == ' ';
+         password.data++, password.len--)
+        ;
+
+    ac_str_view_t name = {ac_atom_data(user->username),
+                          ac_atom_len(user->username)};
+
+    if (!ac_accounts_enabled(&app->accounts)) {
+        ac_print(user, app, AC_PRINT_AFTER_ENTER,
+                 "Names cannot be registered on this server.");
+    } else if (ac_accounts_find(&app->accounts, name)) {
+        ac_print(user, app, AC_PRINT_AFTER_ENTER,
+                 "Your name is already registered.");
+    } else if (user->auth.ticket != 0) {
+        ac_print(user, app, AC_PRINT_AFTER_ENTER,
+                 "Your name is being registered.");
+    } else if (password.len < AC_PASSWORD_MIN ||
+               password.len > AC_PASSWORD_MAX) {
+        ac_print_fmt(user, app, AC_PRINT_AFTER_ENTER,
+                     "Usage: /register <password>, %d-%d bytes long.",
+                     AC_PASSWORD_MIN, AC_PASSWORD_MAX);
+    } else {
+        ac_auth_job_t job;
+        job.op           = AC_AUTH_DERIVE;
+        job.owner        = (uint64_t)user->handle;
+        job.ticket       = ++app->auth_ticket;
+        job.iterations   = AC_KDF_ITERATIONS;
+        job.password_len = password.len;
+        memcpy(job.password, password.data, password.len);
+
+        if (ac_auth_submit(&app->auth, &job)) {
+            user->auth.ticket = job.ticket;
+        } else {
+            ac_print(user, app, AC_PRINT_AFTER_ENTER,
+                     "The server is busy, please try again in a moment.");
+        }
+    }
 }
 
 void ac_handle_command(ac_user_t *user, ac_app_t *app,
-                       const ac_string_t line) {
+                       ac_str_view_t line) {
     assert(ac_is_command(line) &&
            "Don't forget to call ac_is_command() first.");
 
-    static bool initialized = false;
-    if (!initialized) {
-        initialized = true;
-        ac_init_commands();
-    }
-
     /* Check if input consists only of the command prefix. */
-    if (ac_alen(line) == 1) {
+    if (line.len == 1) {
         ac_handle_help_cmd(user, app);
         return;
     }
 
     /* Extract command (first word after prefix). */
 
-    size_t cmd_end;
-    for (cmd_end = 1; cmd_end < ac_alen(line) && line[cmd_end] != ' ';
-         cmd_end++)
-        ;
-
-    ac_string_t cmd_str;
-    ac_arr_new_reserve(cmd_str, cmd_end - 1);
-    ac_arr_append_n(cmd_str, cmd_end - 1, line + 1);
+    size_t cmd_end = ac_command_end(line);
 
     /* Lookup command. */
-    ac_cmd_t *cmd;
-    ac_map_get_maybe_null(ac_commands, ac_string_hash, ac_string_eq, cmd_str,
-                          cmd);
+    ac_cmd_t cmd;
+    bool found = ac_lookup_command(line.data + 1, cmd_end - 1, &cmd);
 
     /* If unknown command, show help. */
-    if (!cmd) {
+    if (!found) {
         ac_handle_help_cmd(user, app);
         return;
     }
 
-    switch (*cmd) {
+    switch (cmd) {
         case AC_CMD_HELP:
             ac_handle_help_cmd(user, app);
             break;
@@ -248,119 +909,116 @@ void ac_handle_command(ac_user_t *user, ac_app_t *app,
             break;
 
         case AC_CMD_INFO: {
-            /* Calculate server uptime in days. */
-            char uptime[16];
-            snprintf(uptime, sizeof uptime, "%d days",
-                     (int)((time(NULL) - app->app_start_time) / 86400));
-
-            ac_print_fmt(user, app, AC_PRINT_AFTER_ENTER,
-                         "AuroraComms Server\n"
-                         " - Uptime: %s\n"
-                         " - Connected users: %d",
-                         uptime, (int)app->users.from_handle.len);
+            ac_send_info(user, app);
             break;
         }
 
-        case AC_CMD_LIST: {
-            ac_send(user, app, "Online users:\r\n");
-
-            ac_send_fmt(user, app, " - %.*s (You)\r\n",
-                        ac_alen(user->username), user->username);
-
-            ac_client_handle_t *handle;
-            ac_user_t **other_user;
-
-            ac_map_foreach(app->users.from_handle, handle, other_user) {
-                if (user->handle == *handle) {
-                    continue;
-                }
+        case AC_CMD_LIST:
+            ac_handle_list_cmd(user, app, line, cmd_end);
+            break;
 
-                if (user->state != AC_STATE_CHAT) {
-                    continue;
-                }
+        case AC_CMD_WHO:
+            ac_handle_who_cmd(user, app, line, cmd_end);
+            break;
 
-                ac_send_fmt(user, app, " - %.*s\r\n",
-                            ac_alen((*other_user)->username),
-                            (*other_user)->username);
-            }
+        case AC_CMD_HISTORY:
+            ac_handle_history_cmd(user, app, line, cmd_end);
+            break;
 
-            ac_prompt(user, app);
+        case AC_CMD_SEARCH:
+            ac_handle_search_cmd(user, app, line, cmd_end);
+            break;
 
+        case AC_CMD_REGISTER:
+            ac_handle_register_cmd(user, app, line, cmd_end);
             break;
-        }
 
         case AC_CMD_WHISPER: {
             /* Extract recipient username. */
             size_t recipient_start = cmd_end + 1;
-            for (; recipient_start < ac_alen(line) &&
-                   line[recipient_start] == ' ';
+            for (; recipient_start < line.len &&
+                   line.data[recipient_start] == ' ';
                  recipient_start++)
                 ;
 
             size_t recipient_end = recipient_start;
-            for (; recipient_end < ac_alen(line) && line[recipient_end] != ' ';
+            for (; recipient_end < line.len && line.data[recipient_end] != ' ';
                  recipient_end++)
                 ;
 
-            ac_string_t recipient;
-            ac_arr_new_reserve(recipient, recipient_end - recipient_start);
-            ac_arr_append_n(recipient, recipient_end - recipient_start,
-                            line + recipient_start);
+            const char *recipient = line.data + recipient_start;
+            int recipient_len     = (int)(recipient_end - recipient_start);
 
-            ac_user_t **other_user;
-            ac_map_get_maybe_null(app->users.from_username, ac_string_hash,
-                                  ac_string_eq, recipient, other_user);
+            ac_atom_t recipient_atom =
+                ac_intern_find(recipient, (size_t)recipient_len);
+
+            ac_user_t **other_user =
+                recipient_atom == AC_ATOM_NONE
+                    ? NULL
+                    : ac_user_name_map_get(&app->users.from_username,
+                                           recipient_atom);
 
             if (!other_user) {
                 ac_print_fmt(user, app, AC_PRINT_AFTER_ENTER,
-                             "User '%.*s' not found.", ac_alen(recipient),
-                             recipient);
+                             "User '%.*s' not found.",
+                             recipient_len, recipient);
             }
 
             else if ((*other_user)->state != AC_STATE_CHAT) {
                 ac_print_fmt(user, app, AC_PRINT_AFTER_ENTER,
                              "User '%.*s' is not in the chat.",
-                             ac_alen(recipient), recipient);
+                             recipient_len, recipient);
             }
 
             else {
                 /* Extract message. */
                 size_t msg_start = recipient_end + 1;
-                for (; msg_start < ac_alen(line) && line[msg_start] == ' ';
+                for (; msg_start < line.len && line.data[msg_start] == ' ';
                      msg_start++)
                     ;
 
-                if (msg_start >= ac_alen(line)) {
+                if (msg_start >= line.len) {
                     ac_print_fmt(user, app, AC_PRINT_AFTER_ENTER,
                                  "Usage: /whisper <username> <message>");
-                    ac_arr_free(recipient);
                     break;
                 }
 
-                ac_string_t msg;
-                ac_arr_new_reserve(msg, ac_alen(line) - msg_start);
-                ac_arr_append_n(msg, ac_alen(line) - msg_start,
-                                line + msg_start);
-
-                /* Send message to recipient. */
-                ac_print_fmt(*other_user, app, AC_PRINT_INTERRUPT,
-                             "[%.*s -> You]: %.*s",
-                             ac_alen(user->username), user->username,
-                             ac_alen(msg), msg);
+                /* The message is a view into the line, no copy needed. */
+                ac_str_view_t msg = {line.data + msg_start,
+                                     line.len - msg_start};
+
+                if (!(*other_user)->session.parked) {
+                    /* Send message to recipient. */
+                    ac_writer_t w =
+                        ac_write_begin(*other_user, AC_PRINT_INTERRUPT);
+                    ac_write_str(&w, "[");
+                    ac_write_name(&w, user->username);
+                    ac_write_str(&w, " -> You]: ");
+                    ac_write_view(&w, msg);
+                    ac_write_end(&w);
+                } else if (!ac_session_keep(*other_user, user->username,
+                                            msg)) {
+                    /* Kept for the recipient unless too many piled up. */
+                    ac_print_fmt(user, app, AC_PRINT_AFTER_ENTER,
+                                 "User '%.*s' is reconnecting and cannot "
+                                 "take more whispers.",
+                                 recipient_len, recipient);
+                    break;
+                }
 
                 /* Acknowledge sender. */
-                ac_print_fmt(user, app, AC_PRINT_AFTER_ENTER,
-                             "[You -> %.*s]: %.*s",
-                             ac_alen((*other_user)->username),
-                             (*other_user)->username, ac_alen(msg), msg);
-
-                ac_arr_free(msg);
+                ac_writer_t w = ac_write_begin(user, AC_PRINT_AFTER_ENTER);
+                ac_write_str(&w, "[You -> ");
+                ac_write_name(&w, (*other_user)->username);
+                ac_write_str(&w, "]: ");
+                ac_write_view(&w, msg);
+                ac_write_end(&w);
+
+                ac_app_record(app, AC_MSG_WHISPER, user->username,
+                              (*other_user)->username, msg);
             }
 
-            ac_arr_free(recipient);
             break;
         }
     }
-
-    ac_arr_free(cmd_str);
 }
@@ -0,0 +1,233 @@
+#include <ac/kdf.h>
+
+#include <string.h>
+#include <assert.h>
+
+static const uint32_t ac_sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static uint32_t ac_ror32(uint32_t x, unsigned n) {
+    return x >> n | x << (32 - n);
+}
+
+static uint32_t ac_load_be32(const unsigned char *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+           (uint32_t)p[2] << 8 | (uint32_t)p[3];
+}
+
+static void ac_store_be32(unsigned char *p, uint32_t x) {
+    p[0] = (unsigned char)(x >> 24);
+    p[1] = (unsigned char)(x >> 16);
+    p[2] = (unsigned char)(x >> 8);
+    p[3] = (unsigned char)x;
+}
+
+static void ac_sha256_compress(uint32_t h[8],
+                               const unsigned char block[AC_SHA256_BLOCK]) {
+    uint32_t w[64];
+
+    for (size_t i = 0; i < 16; i++) {
+        w[i] = ac_load_be32(block + 4 * i);
+    }
+    for (size_t i = 16; i < 64; i++) {
+        uint32_t s0 = ac_ror32(w[i - 15], 7) ^ ac_ror32(w[i - 15], 18) ^
+                      w[i - 15] >> 3;
+        uint32_t s1 = ac_ror32(w[i - 2], 17) ^ ac_ror32(w[i - 2], 19) ^
+                      w[i - 2] >> 10;
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3];
+    uint32_t e = h[4], f = h[5], g = h[6], k = h[7];
+
+    for (size_t i = 0; i < 64; i++) {
+        uint32_t s1 = ac_ror32(e, 6) ^ ac_ror32(e, 11) ^ ac_ror32(e, 25);
+        uint32_t ch = (e & f) ^ (~e & g);
+        uint32_t t1 = k + s1 + ch + ac_sha256_k[i] + w[i];
+        uint32_t s0 = ac_ror32(a, 2) ^ ac_ror32(a, 13) ^ ac_ror32(a, 22);
+        uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t t2  = s0 + maj;
+
+        k = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+    h[5] += f;
+    h[6] += g;
+    h[7] += k;
+}
+
+void ac_sha256_init(ac_sha256_t *ctx) {
+    static const uint32_t iv[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372,
+                                   0xa54ff53a, 0x510e527f, 0x9b05688c,
+                                   0x1f83d9ab, 0x5be0cd19};
+
+    memcpy(ctx->h, iv, sizeof iv);
+    ctx->len = 0;
+}
+
+void ac_sha256_update(ac_sha256_t *ctx, const void *data, size_t len) {
+    const unsigned char *p = data;
+    size_t used            = (size_t)(ctx->len % AC_SHA256_BLOCK);
+
+    ctx->len += len;
+
+    if (used > 0) {
+        size_t take = AC_SHA256_BLOCK - used < len ? AC_SHA256_BLOCK - used
+                                                   : len;
+        memcpy(ctx->buf + used, p, take);
+        p += take;
+        len -= take;
+
+        if (used + take < AC_SHA256_BLOCK) {
+            return;
+        }
+        ac_sha256_compress(ctx->h, ctx->buf);
+    }
+
+    for (; len >= AC_SHA256_BLOCK; p += AC_SHA256_BLOCK,
+                                   len -= AC_SHA256_BLOCK) {
+        ac_sha256_compress(ctx->h, p);
+    }
+
+    memcpy(ctx->buf, p, len);
+}
+
+void ac_sha256_final(ac_sha256_t *ctx, unsigned char out[AC_SHA256_LEN]) {
+    uint64_t bits = ctx->len * 8;
+    size_t used   = (size_t)(ctx->len % AC_SHA256_BLOCK);
+
+    /* A 1 bit, zeros up to 8 bytes short of a block, and the length. */
+    ctx->buf[used++] = 0x80;
+
+    if (used > AC_SHA256_BLOCK - 8) {
+        memset(ctx->buf + used, 0, AC_SHA256_BLOCK - used);
+        ac_sha256_compress(ctx->h, ctx->buf);
+        used = 0;
+    }
+
+    memset(ctx->buf + used, 0, AC_SHA256_BLOCK - 8 - used);
+    ac_store_be32(ctx->buf + AC_SHA256_BLOCK - 8, (uint32_t)(bits >> 32));
+    ac_store_be32(ctx->buf + AC_SHA256_BLOCK - 4, (uint32_t)bits);
+    ac_sha256_compress(ctx->h, ctx->buf);
+
+    for (size_t i = 0; i < 8; i++) {
+        ac_store_be32(out + 4 * i, ctx->h[i]);
+    }
+}
+
+/** @brief The two hash states of an HMAC after absorbing the padded key. */
+typedef struct ac_hmac_s {
+    ac_sha256_t inner;
+    ac_sha256_t outer;
+} ac_hmac_t;
+
+static void ac_hmac_init(ac_hmac_t *hmac, const void *key, size_t key_len) {
+    unsigned char block[AC_SHA256_BLOCK] = {0};
+
+    if (key_len > AC_SHA256_BLOCK) {
+        ac_sha256_t ctx;
+        ac_sha256_init(&ctx);
+        ac_sha256_update(&ctx, key, key_len);
+        ac_sha256_final(&ctx, block);
+    } else if (key_len > 0) {
+        memcpy(block, key, key_len);
+    }
+
+    unsigned char pad[AC_SHA256_BLOCK];
+
+    for (size_t i = 0; i < AC_SHA256_BLOCK; i++) {
+        pad[i] = block[i] ^ 0x36;
+    }
+    ac_sha256_init(&hmac->inner);
+    ac_sha256_update(&hmac->inner, pad, sizeof pad);
+
+    for (size_t i = 0; i < AC_SHA256_BLOCK; i++) {
+        pad[i] = block[i] ^ 0x5c;
+    }
+    ac_sha256_init(&hmac->outer);
+    ac_sha256_update(&hmac->outer, pad, sizeof pad);
+}
+
+/** @brief Finish the MAC of a message whose inner hash is CTX. */
+static void ac_hmac_final(const ac_hmac_t *hmac, ac_sha256_t *ctx,
+                          unsigned char out[AC_SHA256_LEN]) {
+    unsigned char inner[AC_SHA256_LEN];
+    ac_sha256_final(ctx, inner);
+
+    *ctx = hmac->outer;
+    ac_sha256_update(ctx, inner, sizeof inner);
+    ac_sha256_final(ctx, out);
+}
+
+void ac_pbkdf2_sha256(const void *password, size_t password_len,
+                      const void *salt, size_t salt_len, uint32_t iterations,
+                      unsigned char *out, size_t out_len) {
+    assert(iterations >= 1);
+
+    ac_hmac_t hmac;
+    ac_hmac_init(&hmac, password, password_len);
+
+    for (uint32_t block = 1; out_len > 0; block++) {
+        unsigned char index[4];
+        unsigned char u[AC_SHA256_LEN];
+        unsigned char t[AC_SHA256_LEN];
+        ac_sha256_t ctx;
+
+        /* U1 = PRF(password, salt || INT(block)) */
+        ac_store_be32(index, block);
+        ctx = hmac.inner;
+        ac_sha256_update(&ctx, salt, salt_len);
+        ac_sha256_update(&ctx, index, sizeof index);
+        ac_hmac_final(&hmac, &ctx, u);
+        memcpy(t, u, sizeof t);
+
+        /* Un = PRF(password, Un-1), all XORed together. */
+        for (uint32_t i = 1; i < iterations; i++) {
+            ctx = hmac.inner;
+            ac_sha256_update(&ctx, u, sizeof u);
+            ac_hmac_final(&hmac, &ctx, u);
+
+            for (size_t j = 0; j < AC_SHA256_LEN; j++) {
+                t[j] ^= u[j];
+            }
+        }
+
+        size_t take = out_len < AC_SHA256_LEN ? out_len : AC_SHA256_LEN;
+        memcpy(out, t, take);
+        out += take;
+        out_len -= take;
+    }
+}
+
+bool ac_kdf_equal(const void *a, const void *b, size_t len) {
+    const volatile unsigned char *pa = a;
+    const volatile unsigned char *pb = b;
+    unsigned char diff               = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        diff |= pa[i] ^ pb[i];
+    }
+    return diff == 0;
+}
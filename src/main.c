@@ -4,12 +4,16 @@
 #include <ac/app.h>
 #include <ac/net.h>
 #include <ac/log.h>
+#include <ac/str.h>
 
 #define AC_DEFAULT_PORT 2000
 
 int main(int argc, char *argv[]) {
     int port = argc < 2 ? AC_DEFAULT_PORT : atoi(argv[1]);
 
+    /* Seed string hashing before any username is hashed. */
+    ac_string_hash_init();
+
     ac_app_t app;
     ac_app_new(&app);
     ac_server_new(&app.server);
@@ -18,7 +22,7 @@ int main(int argc, char *argv[]) {
     ac_log_fmt(AC_LOG_INFO, "Server listening on port %d.", port);
 
     while (true) {
-        ac_server_poll(&app.server);
+        ac_server_poll(&app.server, ac_app_idle_timeout(&app));
         ac_app_update(&app);
     }
 }
@@ -0,0 +1,636 @@
+#include <ac/msglog.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+#include <ac/log.h>
+
+static const unsigned char ac_msglog_magic[AC_MSGLOG_SEGMENT_HEADER] = {
+    'A', 'C', 'M', 'S', 'G', 'L', 'O', 'G'};
+
+/* -------------------------------------------------------------------------
+   CRC-32C
+   ------------------------------------------------------------------------- */
+
+#ifdef __SSE4_2__
+
+uint32_t ac_crc32c(uint32_t crc, const void *data, size_t len) {
+    const unsigned char *p = data;
+    uint64_t c             = ~crc;
+
+    for (; len >= 8; p += 8, len -= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        c = _mm_crc32_u64(c, word);
+    }
+
+    uint32_t c32 = (uint32_t)c;
+    for (; len > 0; p++, len--) {
+        c32 = _mm_crc32_u8(c32, *p);
+    }
+
+    return ~c32;
+}
+
+#else
+
+static uint32_t ac_crc32c_table[256];
+static pthread_once_t ac_crc32c_once = PTHREAD_ONCE_INIT;
+
+static void ac_crc32c_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int bit = 0; bit < 8; bit++) {
+            c = c & 1 ? (c >> 1) ^ 0x82F63B78u : c >> 1;
+        }
+        ac_crc32c_table[i] = c;
+    }
+}
+
+uint32_t ac_crc32c(uint32_t crc, const void *data, size_t len) {
+    pthread_once(&ac_crc32c_once, ac_crc32c_init);
+
+    const unsigned char *p = data;
+    uint32_t c             = ~crc;
+
+    for (; len > 0; p++, len--) {
+        c = ac_crc32c_table[(c ^ *p) & 0xFF] ^ (c >> 8);
+    }
+
+    return ~c;
+}
+
+#endif
+
+/* -------------------------------------------------------------------------
+   Encoding
+   ------------------------------------------------------------------------- */
+
+static void ac_put_u32(unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = (unsigned char)(v >> (8 * i));
+    }
+}
+
+static void ac_put_u64(unsigned char *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) {
+        p[i] = (unsigned char)(v >> (8 * i));
+    }
+}
+
+static uint32_t ac_get_u32(const unsigned char *p) {
+    uint32_t v = 0;
+    for (int i = 3; i >= 0; i--) {
+        v = v << 8 | p[i];
+    }
+    return v;
+}
+
+static uint64_t ac_get_u64(const unsigned char *p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) {
+        v = v << 8 | p[i];
+    }
+    return v;
+}
+
+/* Fixed part of a body: time, kind, name lengths and a zero byte. */
+#define AC_MSGLOG_BODY_FIXED 12
+
+void ac_msglog_append(ac_msglog_t *log, const ac_msg_t *msg) {
+    size_t from_len = msg->from.len < UINT8_MAX ? msg->from.len : UINT8_MAX;
+    size_t to_len   = msg->to.len < UINT8_MAX ? msg->to.len : UINT8_MAX;
+    size_t room =
+        AC_MSGLOG_BODY_MAX - AC_MSGLOG_BODY_FIXED - from_len - to_len;
+    size_t text_len = msg->text.len < room ? msg->text.len : room;
+    size_t body     = AC_MSGLOG_BODY_FIXED + from_len + to_len + text_len;
+
+    size_t at = ac_alen(log->pending);
+    ac_arr_append_n_raw(log->pending, AC_MSGLOG_RECORD_HEADER + body);
+
+    unsigned char *p = log->pending + at;
+    unsigned char *b = p + AC_MSGLOG_RECORD_HEADER;
+
+    ac_put_u64(b, msg->time_ms);
+    b[8]  = (unsigned char)msg->kind;
+    b[9]  = (unsigned char)from_len;
+    b[10] = (unsigned char)to_len;
+    b[11] = 0;
+    memcpy(b + AC_MSGLOG_BODY_FIXED, msg->from.data, from_len);
+    memcpy(b + AC_MSGLOG_BODY_FIXED + from_len, msg->to.data, to_len);
+    memcpy(b + AC_MSGLOG_BODY_FIXED + from_len + to_len, msg->text.data,
+           text_len);
+
+    ac_put_u32(p, (uint32_t)body);
+    ac_put_u32(p + 4, ac_crc32c(0, b, body));
+}
+
+ac_msglog_status_t ac_msglog_decode(const unsigned char *data, size_t len,
+                                    size_t *pos, ac_msg_t *msg) {
+    if (*pos == len) {
+        return AC_MSGLOG_END;
+    }
+    if (len - *pos < AC_MSGLOG_RECORD_HEADER) {
+        return AC_MSGLOG_TORN;
+    }
+
+    const unsigned char *p = data + *pos;
+    size_t body            = ac_get_u32(p);
+
+    if (body < AC_MSGLOG_BODY_FIXED || body > AC_MSGLOG_BODY_MAX ||
+        body > len - *pos - AC_MSGLOG_RECORD_HEADER) {
+        return AC_MSGLOG_TORN;
+    }
+
+    const unsigned char *b = p + AC_MSGLOG_RECORD_HEADER;
+    size_t from_len        = b[9];
+    size_t to_len          = b[10];
+
+    /* The cheap checks first, for ac_msglog_resync(). */
+    if (AC_MSGLOG_BODY_FIXED + from_len + to_len > body ||
+        (b[8] != AC_MSG_CHAT && b[8] != AC_MSG_WHISPER) ||
+        ac_crc32c(0, b, body) != ac_get_u32(p + 4)) {
+        return AC_MSGLOG_TORN;
+    }
+
+    const char *names = (const char *)b + AC_MSGLOG_BODY_FIXED;
+
+    msg->kind      = b[8] == AC_MSG_CHAT ? AC_MSG_CHAT : AC_MSG_WHISPER;
+    msg->time_ms   = ac_get_u64(b);
+    msg->from.data = names;
+    msg->from.len  = from_len;
+    msg->to.data   = names + from_len;
+    msg->to.len    = to_len;
+    msg->text.data = names + from_len + to_len;
+    msg->text.len  = body - AC_MSGLOG_BODY_FIXED - from_len - to_len;
+
+    *pos += AC_MSGLOG_RECORD_HEADER + body;
+    return AC_MSGLOG_OK;
+}
+
+size_t ac_msglog_resync(const unsigned char *data, size_t len, size_t pos) {
+    ac_msg_t msg;
+
+    for (; pos < len; pos++) {
+        size_t at = pos;
+
+        if (ac_msglog_decode(data, len, &at, &msg) == AC_MSGLOG_OK) {
+            return pos;
+        }
+    }
+
+    return len;
+}
+
+bool ac_msglog_segment_valid(const unsigned char *data, size_t len) {
+    return len >= AC_MSGLOG_SEGMENT_HEADER &&
+           memcmp(data, ac_msglog_magic, AC_MSGLOG_SEGMENT_HEADER) == 0;
+}
+
+/* -------------------------------------------------------------------------
+   Segments
+   ------------------------------------------------------------------------- */
+
+void ac_msglog_segment_path(char *buf, size_t size, const char *dir,
+                            uint64_t segment) {
+    snprintf(buf, size, "%s/%016" PRIu64 ".log", dir, segment);
+}
+
+static int ac_u64_cmp(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+bool ac_msglog_segments(const char *dir, ac_arr(uint64_t) *segments) {
+    DIR *d = opendir(dir);
+    if (!d) {
+        return false;
+    }
+
+    ac_arr_new(*segments);
+
+    struct dirent *entry;
+
+    while ((entry = readdir(d))) {
+        const char *name = entry->d_name;
+
+        if (strlen(name) != 20 || strcmp(name + 16, ".log") != 0 ||
+            strspn(name, "0123456789") != 16) {
+            continue;
+        }
+
+        uint64_t segment = strtoull(name, NULL, 10);
+        ac_arr_append(*segments, segment);
+    }
+
+    closedir(d);
+
+    qsort(*segments, ac_alen(*segments), sizeof(uint64_t), ac_u64_cmp);
+    return true;
+}
+
+/** @brief Make a directory entry durable. */
+static void ac_msglog_sync_dir(const char *dir) {
+    int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd != -1) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+/** @brief Create a new, empty segment and make it the newest. */
+static bool ac_msglog_create(ac_msglog_t *log, uint64_t segment) {
+    char path[4096];
+    ac_msglog_segment_path(path, sizeof path, log->dir, segment);
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC,
+                  0644);
+    if (fd == -1) {
+        return false;
+    }
+
+    if (write(fd, ac_msglog_magic, AC_MSGLOG_SEGMENT_HEADER) !=
+            AC_MSGLOG_SEGMENT_HEADER ||
+        fdatasync(fd) == -1) {
+        close(fd);
+        return false;
+    }
+
+    ac_msglog_sync_dir(log->dir);
+
+    log->fd      = fd;
+    log->segment = segment;
+    log->size    = AC_MSGLOG_SEGMENT_HEADER;
+    return true;
+}
+
+/**
+ * @brief Reopen the newest segment for appending, cutting off a torn record
+ * at its end. Damage with intact records after it is kept.
+ *
+ * @return false if the segment is unusable, in which case a new one should
+ * be started after it.
+ */
+static bool ac_msglog_recover(ac_msglog_t *log, uint64_t segment) {
+    char path[4096];
+    ac_msglog_segment_path(path, sizeof path, log->dir, segment);
+
+    int fd = open(path, O_RDWR | O_APPEND | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 ||
+        (size_t)st.st_size < AC_MSGLOG_SEGMENT_HEADER) {
+        close(fd);
+        return false;
+    }
+
+    size_t len = (size_t)st.st_size;
+    void *map  = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (map == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    if (!ac_msglog_segment_valid(map, len)) {
+        munmap(map, len);
+        close(fd);
+        return false;
+    }
+
+    size_t pos = AC_MSGLOG_SEGMENT_HEADER;
+    ac_msg_t msg;
+    ac_msglog_status_t status;
+
+    while ((status = ac_msglog_decode(map, len, &pos, &msg)) !=
+           AC_MSGLOG_END) {
+        if (status == AC_MSGLOG_OK) {
+            continue;
+        }
+
+        size_t next = ac_msglog_resync(map, len, pos + 1);
+
+        if (next == len) {
+            break;
+        }
+
+        ac_log_fmt(AC_LOG_WARNING,
+                   "Message log: skipping %zu damaged bytes at offset %zu "
+                   "of %s.",
+                   next - pos, pos, path);
+        pos = next;
+    }
+
+    munmap(map, len);
+
+    if (pos < len) {
+        ac_log_fmt(AC_LOG_WARNING,
+                   "Message log: truncating %zu torn bytes off %s.",
+                   len - pos, path);
+
+        if (ftruncate(fd, (off_t)pos) == -1 || fdatasync(fd) == -1) {
+            close(fd);
+            return false;
+        }
+    }
+
+    log->fd      = fd;
+    log->segment = segment;
+    log->size    = pos;
+    return true;
+}
+
+/* -------------------------------------------------------------------------
+   Group commit
+   ------------------------------------------------------------------------- */
+
+/** @brief Cut what a failed write left of a batch off the newest segment,
+ * or leave it behind in a segment of its own if that fails too. */
+static void ac_msglog_unwrite(ac_msglog_t *log, uint64_t size) {
+    if (log->size == size) {
+        return;
+    }
+
+    if (ftruncate(log->fd, (off_t)size) == 0) {
+        log->size = size;
+        return;
+    }
+
+    ac_log_fmt(AC_LOG_ERROR,
+               "Message log: failed to cut off %" PRIu64
+               " bytes of a failed write: %s.",
+               log->size - size, strerror(errno));
+
+    int damaged = log->fd;
+
+    if (ac_msglog_create(log, log->segment + 1)) {
+        close(damaged);
+    }
+}
+
+/** @brief Write records to the newest segment, sync them, and start a new
+ * segment once it is full. Commit thread only.
+ *
+ * @return false if the records could not be written or synced, in which
+ * case none of them are left in the segment. */
+static bool ac_msglog_write(ac_msglog_t *log, const unsigned char *data,
+                            size_t len) {
+    uint64_t size = log->size;
+
+    while (len > 0) {
+        ssize_t written = write(log->fd, data, len);
+
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ac_log_fmt(AC_LOG_ERROR, "Message log: write() failed: %s.",
+                       strerror(errno));
+            ac_msglog_unwrite(log, size);
+            return false;
+        }
+
+        data += written;
+        len -= (size_t)written;
+        log->size += (size_t)written;
+    }
+
+    if (fdatasync(log->fd) == -1) {
+        ac_log_fmt(AC_LOG_ERROR, "Message log: fdatasync() failed: %s.",
+                   strerror(errno));
+
+        /* Whether any of the records reached the disk is unknown, and the
+           kernel may have dropped the segment's dirty pages. Cut them off
+           and retry in a fresh segment. */
+        int failed = log->fd;
+        ac_msglog_unwrite(log, size);
+
+        if (log->fd == failed) {
+            if (ac_msglog_create(log, log->segment + 1)) {
+                close(failed);
+            } else {
+                ac_log_fmt(AC_LOG_ERROR,
+                           "Message log: failed to start a new segment, "
+                           "retrying in the current one.");
+            }
+        }
+        return false;
+    }
+
+    if (log->size >= AC_MSGLOG_SEGMENT_SIZE) {
+        int full = log->fd;
+
+        if (ac_msglog_create(log, log->segment + 1)) {
+            close(full);
+        } else {
+            ac_log_fmt(AC_LOG_ERROR,
+                       "Message log: failed to start a new segment, "
+                       "growing the current one.");
+        }
+    }
+
+    return true;
+}
+
+/** @brief Take the queued records behind any kept from a failed write.
+ * Called with the lock held. */
+static void ac_msglog_take(ac_msglog_t *log) {
+    if (ac_alen(log->writing) == 0) {
+        ac_bytes_t batch = log->queued;
+        log->queued      = log->writing;
+        log->writing     = batch;
+        return;
+    }
+
+    size_t len = ac_alen(log->queued);
+
+    if (ac_alen(log->writing) + len > AC_MSGLOG_BACKLOG_MAX) {
+        ac_log_fmt(AC_LOG_ERROR,
+                   "Message log: dropping %zu bytes of records, %zu are "
+                   "already waiting to be written.",
+                   len, ac_alen(log->writing));
+    } else {
+        ac_arr_append_n(log->writing, len, log->queued);
+    }
+
+    ac_alen(log->queued) = 0;
+}
+
+static void *ac_msglog_run(void *arg) {
+    ac_msglog_t *log = arg;
+
+    struct timespec due;
+    clock_gettime(CLOCK_MONOTONIC, &due);
+
+    pthread_mutex_lock(&log->lock);
+
+    for (;;) {
+        while (ac_alen(log->queued) == 0 && ac_alen(log->writing) == 0 &&
+               !log->stop) {
+            pthread_cond_wait(&log->wake, &log->lock);
+        }
+        if (ac_alen(log->queued) == 0 && ac_alen(log->writing) == 0) {
+            break;
+        }
+
+        /* Let records from more ticks gather until a commit is due. */
+        if (!log->stop) {
+            pthread_mutex_unlock(&log->lock);
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due,
+                                   NULL) == EINTR)
+                ;
+            pthread_mutex_lock(&log->lock);
+        }
+
+        ac_msglog_take(log);
+        bool stopping = log->stop;
+
+        pthread_mutex_unlock(&log->lock);
+
+        long wait_ms = AC_MSGLOG_COMMIT_MS;
+
+        if (ac_msglog_write(log, log->writing, ac_alen(log->writing))) {
+            ac_alen(log->writing) = 0;
+        } else if (stopping) {
+            ac_log_fmt(AC_LOG_ERROR,
+                       "Message log: closing with %zu bytes of records "
+                       "unwritten.",
+                       ac_alen(log->writing));
+            ac_alen(log->writing) = 0;
+        } else {
+            wait_ms = AC_MSGLOG_RETRY_MS;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &due);
+        due.tv_sec += wait_ms / 1000;
+        due.tv_nsec += wait_ms % 1000 * 1000000L;
+        if (due.tv_nsec >= 1000000000L) {
+            due.tv_sec++;
+            due.tv_nsec -= 1000000000L;
+        }
+
+        pthread_mutex_lock(&log->lock);
+    }
+
+    pthread_mutex_unlock(&log->lock);
+    return NULL;
+}
+
+void ac_msglog_commit(ac_msglog_t *log) {
+    if (ac_alen(log->pending) == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&log->lock);
+
+    if (ac_alen(log->queued) == 0) {
+        ac_bytes_t empty = log->queued;
+        log->queued      = log->pending;
+        log->pending     = empty;
+    } else {
+        /* The commit thread is still busy with earlier records. */
+        ac_arr_append_n(log->queued, ac_alen(log->pending), log->pending);
+        ac_alen(log->pending) = 0;
+    }
+
+    pthread_cond_signal(&log->wake);
+    pthread_mutex_unlock(&log->lock);
+}
+
+bool ac_msglog_open(ac_msglog_t *log, const char *dir) {
+    if (mkdir(dir, 0755) == -1 && errno != EEXIST) {
+        return false;
+    }
+
+    ac_arr(uint64_t) segments;
+    if (!ac_msglog_segments(dir, &segments)) {
+        return false;
+    }
+
+    log->dir = strdup(dir);
+    log->fd  = -1;
+
+    bool opened;
+
+    if (ac_alen(segments) == 0) {
+        opened = ac_msglog_create(log, 0);
+    } else {
+        uint64_t newest = segments[ac_alen(segments) - 1];
+        opened          = ac_msglog_recover(log, newest) ||
+                 ac_msglog_create(log, newest + 1);
+    }
+
+    ac_arr_free(segments);
+
+    if (!opened) {
+        free(log->dir);
+        return false;
+    }
+
+    ac_arr_new(log->pending);
+    ac_arr_new(log->queued);
+    ac_arr_new(log->writing);
+    log->stop = false;
+
+    pthread_mutex_init(&log->lock, NULL);
+    pthread_cond_init(&log->wake, NULL);
+
+    int err = pthread_create(&log->thread, NULL, ac_msglog_run, log);
+
+    if (err != 0) {
+        ac_log_fmt(AC_LOG_ERROR,
+                   "Message log: failed to start the commit thread: %s.",
+                   strerror(err));
+
+        pthread_cond_destroy(&log->wake);
+        pthread_mutex_destroy(&log->lock);
+
+        ac_arr_free(log->pending);
+        ac_arr_free(log->queued);
+        ac_arr_free(log->writing);
+
+        close(log->fd);
+        free(log->dir);
+        return false;
+    }
+
+    return true;
+}
+
+void ac_msglog_close(ac_msglog_t *log) {
+    ac_msglog_commit(log);
+
+    pthread_mutex_lock(&log->lock);
+    log->stop = true;
+    pthread_cond_signal(&log->wake);
+    pthread_mutex_unlock(&log->lock);
+
+    pthread_join(log->thread, NULL);
+
+    pthread_cond_destroy(&log->wake);
+    pthread_mutex_destroy(&log->lock);
+
+    ac_arr_free(log->pending);
+    ac_arr_free(log->queued);
+    ac_arr_free(log->writing);
+
+    close(log->fd);
+    free(log->dir);
+}
@@ -0,0 +1,129 @@
+#include <ac/names.h>
+
+#include <string.h>
+#include <assert.h>
+
+/** @brief Compare a name with a byte string, as memcmp() would. */
+static int ac_name_cmp(ac_atom_t name, const char *data, size_t len) {
+    size_t name_len = ac_atom_len(name);
+    size_t n        = name_len < len ? name_len : len;
+    int cmp         = memcmp(ac_atom_data(name), data, n);
+
+    if (cmp != 0) {
+        return cmp;
+    }
+    return name_len < len ? -1 : name_len > len;
+}
+
+/** @brief First position whose name does not sort before DATA. */
+static size_t ac_name_lower_bound(const ac_name_index_t *index,
+                                  const char *data, size_t len) {
+    size_t lo = 0, hi = ac_alen(index->names);
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (ac_name_cmp(index->names[mid], data, len) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+static bool ac_name_has_prefix(ac_atom_t name, const char *prefix,
+                               size_t len) {
+    return ac_atom_len(name) >= len &&
+           memcmp(ac_atom_data(name), prefix, len) == 0;
+}
+
+void ac_name_index_new(ac_name_index_t *index) {
+    ac_arr_new(index->names);
+}
+
+void ac_name_index_free(ac_name_index_t *index) {
+    ac_arr_free(index->names);
+}
+
+bool ac_name_index_insert(ac_name_index_t *index, ac_atom_t name) {
+    const char *data = ac_atom_data(name);
+    size_t len       = ac_atom_len(name);
+    size_t i         = ac_name_lower_bound(index, data, len);
+
+    if (i < ac_alen(index->names) && index->names[i] == name) {
+        return false;
+    }
+
+    ac_arr_insert(index->names, i, name);
+    return true;
+}
+
+bool ac_name_index_remove(ac_name_index_t *index, ac_atom_t name) {
+    size_t i = ac_name_lower_bound(index, ac_atom_data(name),
+                                   ac_atom_len(name));
+
+    if (i == ac_alen(index->names) || index->names[i] != name) {
+        return false;
+    }
+
+    ac_arr_remove(index->names, i);
+    return true;
+}
+
+size_t ac_name_index_len(const ac_name_index_t *index) {
+    return ac_alen(index->names);
+}
+
+ac_atom_t ac_name_index_at(const ac_name_index_t *index, size_t i) {
+    assert(i < ac_alen(index->names));
+    return index->names[i];
+}
+
+ac_name_range_t ac_name_index_prefix(const ac_name_index_t *index,
+                                     const char *prefix, size_t len) {
+    ac_name_range_t range;
+    range.first = ac_name_lower_bound(index, prefix, len);
+
+    /* Names with the prefix are contiguous from the lower bound on, so the
+       end of the run can be binary searched as well. */
+    size_t lo = range.first, hi = ac_alen(index->names);
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (ac_name_has_prefix(index->names[mid], prefix, len)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    range.count = lo - range.first;
+    return range;
+}
+
+size_t ac_name_index_common_prefix(const ac_name_index_t *index,
+                                   ac_name_range_t range) {
+    assert(range.count > 0 &&
+           range.first + range.count <= ac_alen(index->names));
+
+    ac_atom_t first = index->names[range.first];
+    ac_atom_t last  = index->names[range.first + range.count - 1];
+
+    const char *a = ac_atom_data(first);
+    const char *b = ac_atom_data(last);
+    size_t n      = ac_atom_len(first) < ac_atom_len(last) ? ac_atom_len(first)
+                                                           : ac_atom_len(last);
+    size_t i = 0;
+
+    for (; i < n && a[i] == b[i]; i++)
+        ;
+
+    /* Don't split a UTF-8 sequence. */
+    for (; i > 0 && i < n && ((unsigned char)a[i] & 0xc0) == 0x80; i--)
+        ;
+
+    return i;
+}
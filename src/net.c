@@ -16,6 +16,9 @@
 #include <ac/log.h>
 #include <ac/meta.h>
 
+AC_MAP_DEFINE(ac_client_map, ac_client_handle_t, ac_client_t, ac_handle_hash,
+              ac_handle_eq);
+
 static int ac_socket_set_blocking(ac_socket_t socket, bool blocking) {
     int flags = fcntl(socket, F_GETFL, 0);
 
@@ -45,11 +48,18 @@ bool ac_handle_eq(const ac_client_handle_t *a, const ac_client_handle_t *b) {
 }
 
 void ac_server_new(ac_server_t *server) {
-    ac_map_new_reserve(server->clients, AC_CLIENTS_MAX);
+    ac_client_map_new_reserve(&server->clients, AC_CLIENTS_MAX);
+
+    ac_pool_new(&server->out_queues, sizeof(ac_bytes_t), AC_CLIENTS_MAX);
+    ac_buf_pool_new(&server->buffers);
+    server->last_trim = time(NULL);
 }
 
 void ac_server_free(ac_server_t *server) {
-    ac_map_free(server->clients);
+    ac_client_map_free(&server->clients);
+
+    ac_pool_free(&server->out_queues);
+    ac_buf_pool_free(&server->buffers);
 }
 
 void ac_server_listen(ac_server_t *server, int port) {
@@ -100,11 +110,11 @@ static void ac_disconnect_client(ac_server_t *server, ac_client_t *client) {
 
     close(client->conn.socket);
 
-    ac_arr_free(client->in);
-    ac_arr_free(client->out);
+    ac_arr_free(client->in.buf);
+    ac_arr_free(*client->out);
+    ac_pool_release(&server->out_queues, client->out);
 
-    ac_map_remove(server->clients, ac_handle_hash, ac_handle_eq,
-                  client->conn.handle);
+    ac_client_map_remove(&server->clients, client->conn.handle);
 }
 
 static void ac_handle_conn(ac_server_t *server) {
@@ -150,16 +160,34 @@ static void ac_handle_conn(ac_server_t *server) {
         return;
     }
 
-    ac_arr_new(client.in);
-    ac_arr_new(client.out);
+    ac_arr_new_a(client.in.buf, &server->buffers.allocator);
+    client.in.consumed = 0;
+    client.in.scanned  = 0;
+    client.in.rejected = 0;
+    client.out = ac_pool_alloc(&server->out_queues);
+    ac_arr_new_a(*client.out, &server->buffers.allocator);
 
-    ac_map_set(server->clients, ac_handle_hash, ac_handle_eq,
-               client.conn.handle, client);
+    ac_client_map_set(&server->clients, client.conn.handle, client);
 
     ac_log_fmt(AC_LOG_INFO, "Client connected (%s).", client.ip);
 }
 
-void ac_server_poll(ac_server_t *server) {
+/** @brief Send as much outgoing data as the socket takes without blocking.
+ */
+static void ac_client_flush(ac_client_t *client) {
+    if (ac_alen(*client->out) == 0) {
+        return;
+    }
+
+    ssize_t sent =
+        send(client->conn.socket, *client->out, ac_alen(*client->out), 0);
+
+    if (sent > 0) {
+        ac_arr_remove_n(*client->out, 0, (size_t)sent);
+    }
+}
+
+void ac_server_poll(ac_server_t *server, int idle_timeout) {
     /* Array of file descriptors (sockets) to be polled.
        Set first element to listener socket and the rest to client sockets. */
 
@@ -187,9 +215,10 @@ void ac_server_poll(ac_server_t *server) {
         ac_arr_append(polled_sockets, fd);
     }
 
-    /* poll(): while there are no connected clients, wait indefinitely (-1). */
+    /* poll(): while there are no connected clients, wait until the next
+       timed work is due. */
 
-    int timeout = server->clients.pop_bkts == 0 ? -1 : 0;
+    int timeout = server->clients.len == 0 ? idle_timeout : 0;
 
     switch (poll(polled_sockets, (nfds_t)ac_alen(polled_sockets), timeout)) {
         case -1:
@@ -214,8 +243,8 @@ void ac_server_poll(ac_server_t *server) {
             char buf[512];
             int len = (int)recv(polled_client_socket.fd, buf, sizeof buf, 0);
 
-            ac_map_get(server->clients, ac_handle_hash, ac_handle_eq,
-                       polled_client_socket.fd, client);
+            client =
+                ac_client_map_get(&server->clients, polled_client_socket.fd);
             assert(client);
 
             /* No data to read. */
@@ -232,29 +261,44 @@ void ac_server_poll(ac_server_t *server) {
                 continue;
             }
 
-            ac_arr_append_n(client->in, (size_t)len, buf);
+            ac_arr_append_n(client->in.buf, (size_t)len, buf);
         }
     }
 
 no_events:
     ac_arr_free(polled_sockets);
 
-    /* Send outgoing data to clients. */
-    ac_map_foreach(server->clients, handle, client) {
-        if (ac_alen(client->out) > 0) {
-            ssize_t num_bytes_sent = send(client->conn.socket, client->out,
-                                          ac_alen(client->out), 0);
+    /* Give back buffers cached beyond what the last interval needed. */
+    time_t now = time(NULL);
 
-            if (num_bytes_sent != -1) {
-                ac_arr_remove_n(client->out, 0, (size_t)num_bytes_sent);
-            }
+    if (now - server->last_trim >= AC_BUF_TRIM_INTERVAL) {
+        server->last_trim = now;
+
+        size_t freed = ac_buf_pool_trim(&server->buffers);
+
+        if (freed > 0) {
+            ac_log_fmt(AC_LOG_DEBUG,
+                       "Trimmed %zu I/O buffers (%zu live, %zu allocated, "
+                       "%zu reused).",
+                       freed, server->buffers.stats.live,
+                       server->buffers.stats.allocs,
+                       server->buffers.stats.reuses);
         }
     }
+
+    /* Send outgoing data to clients. */
+    ac_map_foreach(server->clients, handle, client) {
+        ac_client_flush(client);
+    }
 }
 
 void ac_server_remove_client(ac_server_t *server, ac_client_handle_t handle) {
-    ac_client_t *client;
-    ac_map_get(server->clients, ac_handle_hash, ac_handle_eq, handle, client);
+    ac_client_t *client = ac_client_map_get(&server->clients, handle);
+    assert(client);
+
+    /* Flush what is queued, such as the reason for the disconnect, ahead
+       of the goodbye. */
+    ac_client_flush(client);
 
     char *goodbye = "\r\nGoodbye!\r\n";
     send(client->conn.socket, goodbye, strlen(goodbye), 0);
@@ -264,9 +308,17 @@ void ac_server_remove_client(ac_server_t *server, ac_client_handle_t handle) {
 
 void ac_server_send(ac_server_t *server, ac_client_handle_t handle,
                     const ac_bytes_t data) {
-    ac_client_t *client;
-    ac_map_get(server->clients, ac_handle_hash, ac_handle_eq, handle, client);
+    ac_client_t *client = ac_client_map_get(&server->clients, handle);
+    assert(client);
 
     /* Append message to out stream. */
-    ac_arr_append_n(client->out, ac_alen(data), data);
+    ac_arr_append_n(*client->out, ac_alen(data), data);
+}
+
+ac_bytes_t *ac_server_out_queue(ac_server_t *server,
+                                ac_client_handle_t handle) {
+    ac_client_t *client = ac_client_map_get(&server->clients, handle);
+    assert(client);
+
+    return client->out;
 }
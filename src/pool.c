@@ -0,0 +1,235 @@
+#include <ac/pool.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/* Slabs and cached buffers start with a header linking them into a list.
+   The header is padded so that objects stay aligned. */
+typedef struct ac_pool_link_s {
+    struct ac_pool_link_s *next;
+} ac_pool_link_t;
+
+#define AC_POOL_HEADER                                                        \
+    ((sizeof(ac_pool_link_t) + AC_POOL_ALIGN - 1) &                           \
+     ~(size_t)(AC_POOL_ALIGN - 1))
+
+static size_t ac_pool_align(size_t n) {
+    return (n + AC_POOL_ALIGN - 1) & ~(size_t)(AC_POOL_ALIGN - 1);
+}
+
+static void ac_pool_stats_alloc(ac_pool_stats_t *stats, bool reused) {
+    stats->allocs++;
+    stats->reuses += reused;
+    stats->live++;
+
+    if (stats->live > stats->high_water) {
+        stats->high_water = stats->live;
+    }
+}
+
+static void ac_pool_stats_free(ac_pool_stats_t *stats) {
+    assert(stats->live > 0);
+    stats->frees++;
+    stats->live--;
+}
+
+/* -------------------------------------------------------------------------
+   Object pool.
+   ------------------------------------------------------------------------- */
+
+void ac_pool_new(ac_pool_t *pool, size_t obj_size, size_t per_slab) {
+    assert(per_slab > 0);
+
+    pool->obj_size  = ac_pool_align(obj_size < sizeof(ac_pool_link_t)
+                                        ? sizeof(ac_pool_link_t)
+                                        : obj_size);
+    pool->per_slab  = per_slab;
+    pool->free_list = NULL;
+    pool->slabs     = NULL;
+
+    memset(&pool->stats, 0, sizeof pool->stats);
+}
+
+void ac_pool_free(ac_pool_t *pool) {
+    ac_pool_link_t *slab = pool->slabs;
+
+    while (slab) {
+        ac_pool_link_t *next = slab->next;
+        free(slab);
+        slab = next;
+    }
+
+    pool->slabs     = NULL;
+    pool->free_list = NULL;
+}
+
+/** @brief Allocate a slab and push all of its objects onto the freelist. */
+static void ac_pool_grow(ac_pool_t *pool) {
+    unsigned char *slab =
+        malloc(AC_POOL_HEADER + pool->obj_size * pool->per_slab);
+    assert(slab);
+
+    ((ac_pool_link_t *)(void *)slab)->next = pool->slabs;
+    pool->slabs                            = slab;
+
+    /* Push in reverse so that objects are handed out in address order. */
+    for (size_t i = pool->per_slab; i-- > 0;) {
+        ac_pool_link_t *obj =
+            (void *)(slab + AC_POOL_HEADER + i * pool->obj_size);
+        obj->next       = pool->free_list;
+        pool->free_list = obj;
+    }
+}
+
+void *ac_pool_alloc(ac_pool_t *pool) {
+    bool reused = pool->free_list != NULL;
+
+    if (!reused) {
+        ac_pool_grow(pool);
+    }
+
+    ac_pool_link_t *obj = pool->free_list;
+    pool->free_list     = obj->next;
+
+    ac_pool_stats_alloc(&pool->stats, reused);
+    return obj;
+}
+
+void ac_pool_release(ac_pool_t *pool, void *obj) {
+    ac_pool_link_t *link = obj;
+    link->next           = pool->free_list;
+    pool->free_list      = link;
+
+    ac_pool_stats_free(&pool->stats);
+}
+
+/* -------------------------------------------------------------------------
+   Buffer pool.
+   ------------------------------------------------------------------------- */
+
+/** @brief Size class of a buffer, or AC_BUF_POOL_CLASSES if too large. */
+static size_t ac_buf_class(size_t size) {
+    size_t cls = 0;
+
+    while (cls < AC_BUF_POOL_CLASSES &&
+           ((size_t)AC_BUF_POOL_MIN << cls) < size) {
+        cls++;
+    }
+
+    return cls;
+}
+
+static void *ac_buf_pool_get(ac_buf_pool_t *pool, size_t cls, size_t size) {
+    bool reused = false;
+    void *block;
+
+    if (cls == AC_BUF_POOL_CLASSES) {
+        block = malloc(size);
+    } else if (pool->free_list[cls]) {
+        ac_pool_link_t *link  = pool->free_list[cls];
+        pool->free_list[cls]  = link->next;
+        pool->cached[cls]    -= 1;
+        block                 = link;
+        reused                = true;
+    } else {
+        block = malloc((size_t)AC_BUF_POOL_MIN << cls);
+    }
+
+    assert(block);
+
+    if (cls < AC_BUF_POOL_CLASSES &&
+        ++pool->live[cls] > pool->peak[cls]) {
+        pool->peak[cls] = pool->live[cls];
+    }
+
+    ac_pool_stats_alloc(&pool->stats, reused);
+    return block;
+}
+
+static void ac_buf_pool_put(ac_buf_pool_t *pool, void *block, size_t cls) {
+    if (cls == AC_BUF_POOL_CLASSES) {
+        free(block);
+    } else {
+        ac_pool_link_t *link  = block;
+        link->next            = pool->free_list[cls];
+        pool->free_list[cls]  = link;
+        pool->cached[cls]    += 1;
+        pool->live[cls]      -= 1;
+    }
+
+    ac_pool_stats_free(&pool->stats);
+}
+
+static void *ac_buf_pool_resize(void *ctx, void *ptr, size_t old_size,
+                                size_t new_size) {
+    ac_buf_pool_t *pool = ctx;
+    size_t old_class    = ac_buf_class(old_size);
+    size_t new_class    = ac_buf_class(new_size);
+
+    if (!ptr) {
+        return new_size == 0 ? NULL : ac_buf_pool_get(pool, new_class,
+                                                      new_size);
+    }
+
+    if (new_size == 0) {
+        ac_buf_pool_put(pool, ptr, old_class);
+        return NULL;
+    }
+
+    /* Still fits the same block. */
+    if (old_class == new_class && old_class < AC_BUF_POOL_CLASSES) {
+        return ptr;
+    }
+
+    /* Too large to pool either way. */
+    if (old_class == AC_BUF_POOL_CLASSES &&
+        new_class == AC_BUF_POOL_CLASSES) {
+        void *grown = realloc(ptr, new_size);
+        assert(grown);
+        return grown;
+    }
+
+    void *moved = ac_buf_pool_get(pool, new_class, new_size);
+    memcpy(moved, ptr, old_size < new_size ? old_size : new_size);
+    ac_buf_pool_put(pool, ptr, old_class);
+    return moved;
+}
+
+void ac_buf_pool_new(ac_buf_pool_t *pool) {
+    memset(pool, 0, sizeof *pool);
+
+    pool->allocator.resize = ac_buf_pool_resize;
+    pool->allocator.ctx    = pool;
+}
+
+void ac_buf_pool_free(ac_buf_pool_t *pool) {
+    for (size_t cls = 0; cls < AC_BUF_POOL_CLASSES; cls++) {
+        pool->peak[cls] = 0;
+    }
+
+    ac_buf_pool_trim(pool);
+}
+
+size_t ac_buf_pool_trim(ac_buf_pool_t *pool) {
+    size_t freed = 0;
+
+    for (size_t cls = 0; cls < AC_BUF_POOL_CLASSES; cls++) {
+        /* Enough cached blocks to get back to the peak without the heap. */
+        size_t keep = pool->peak[cls] > pool->live[cls]
+                          ? pool->peak[cls] - pool->live[cls]
+                          : 0;
+
+        while (pool->cached[cls] > keep) {
+            ac_pool_link_t *link = pool->free_list[cls];
+            pool->free_list[cls] = link->next;
+            pool->cached[cls]--;
+            free(link);
+            freed++;
+        }
+
+        pool->peak[cls] = pool->live[cls];
+    }
+
+    return freed;
+}
@@ -0,0 +1,61 @@
+#include <ac/rate.h>
+
+#include <time.h>
+#include <assert.h>
+
+uint64_t ac_clock_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+void ac_bucket_new(ac_bucket_t *bucket, const ac_rate_limit_t *limit,
+                   uint64_t now) {
+    assert(limit->burst > 0);
+
+    bucket->level = (uint64_t)limit->burst * AC_TOKEN;
+    bucket->stamp = now;
+}
+
+/** @brief Add the tokens earned since the last refill. */
+static void ac_bucket_refill(ac_bucket_t *bucket, const ac_rate_limit_t *limit,
+                             uint64_t now) {
+    uint64_t full = (uint64_t)limit->burst * AC_TOKEN;
+
+    if (now <= bucket->stamp) {
+        return;
+    }
+
+    /* per_sec tokens a second is per_sec thousandths a millisecond. */
+    uint64_t earned = (now - bucket->stamp) * limit->per_sec;
+
+    bucket->level = full - bucket->level > earned ? bucket->level + earned
+                                                  : full;
+    bucket->stamp = now;
+}
+
+bool ac_bucket_take(ac_bucket_t *bucket, const ac_rate_limit_t *limit,
+                    uint64_t now) {
+    ac_bucket_refill(bucket, limit, now);
+
+    if (bucket->level < AC_TOKEN) {
+        return false;
+    }
+
+    bucket->level -= AC_TOKEN;
+    return true;
+}
+
+uint64_t ac_bucket_wait(const ac_bucket_t *bucket,
+                        const ac_rate_limit_t *limit) {
+    if (bucket->level >= AC_TOKEN) {
+        return 0;
+    }
+    if (limit->per_sec == 0) {
+        return UINT64_MAX;
+    }
+
+    uint64_t missing = AC_TOKEN - bucket->level;
+    return (missing + limit->per_sec - 1) / limit->per_sec;
+}
@@ -0,0 +1,320 @@
+#include <ac/search.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+AC_MAP_DEFINE(ac_search_terms, ac_sstr_t, ac_search_term_t, ac_sstr_hash,
+              ac_sstr_eq);
+
+/** @brief Dead elements at the front of an array worth compacting, once
+ * they are also more than half of it. */
+#define AC_SEARCH_COMPACT_MIN 64
+
+static bool ac_search_word_byte(unsigned char c) {
+    return c >= 0x80 || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+           (c >= 'A' && c <= 'Z');
+}
+
+/** @brief Take the next term off the front of TEXT.
+ *
+ * @return false once there are none left.
+ */
+static bool ac_search_next_term(ac_str_view_t *text, ac_sstr_t *term) {
+    const unsigned char *p   = (const unsigned char *)text->data;
+    const unsigned char *end = p + text->len;
+
+    for (; p < end && !ac_search_word_byte(*p); p++)
+        ;
+
+    char buf[AC_SSTR_INLINE];
+    size_t len = 0;
+
+    for (; p < end && ac_search_word_byte(*p); p++) {
+        if (len < AC_SSTR_INLINE) {
+            buf[len++] =
+                (char)(*p >= 'A' && *p <= 'Z' ? *p - 'A' + 'a' : *p);
+        }
+    }
+
+    text->data = (const char *)p;
+    text->len  = (size_t)(end - p);
+
+    if (len == 0) {
+        return false;
+    }
+
+    ac_sstr_new(term);
+    ac_sstr_set(term, buf, len);
+    return true;
+}
+
+static void ac_varint_put(ac_bytes_t *out, uint64_t value) {
+    unsigned char buf[10];
+    size_t len = 0;
+
+    while (value >= 0x80) {
+        buf[len++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    buf[len++] = (unsigned char)value;
+
+    ac_arr_append_n(*out, len, buf);
+}
+
+static uint64_t ac_varint_get(const unsigned char **p) {
+    uint64_t value = 0;
+
+    for (unsigned shift = 0;; shift += 7) {
+        unsigned char byte = *(*p)++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+}
+
+void ac_search_new(ac_search_t *search) {
+    ac_search_terms_new(&search->terms);
+    ac_map_enable_shrink(search->terms);
+
+    ac_arr_new(search->docs);
+    search->head     = 0;
+    search->first_id = 0;
+
+    ac_arr_new(search->text);
+    search->text_base  = 0;
+    search->text_bytes = 0;
+
+    ac_arr_new(search->matches);
+}
+
+void ac_search_free(ac_search_t *search) {
+    ac_sstr_t *key;
+    ac_search_term_t *term;
+
+    ac_map_foreach(search->terms, key, term) {
+        (void)key;
+
+        if (term->deltas) {
+            ac_arr_free(term->deltas);
+        }
+    }
+
+    ac_search_terms_free(&search->terms);
+    ac_arr_free(search->docs);
+    ac_arr_free(search->text);
+    ac_arr_free(search->matches);
+}
+
+/** @brief Text of a line, after the name. */
+static ac_str_view_t ac_search_doc_text(const ac_search_t *search,
+                                        const ac_search_doc_t *doc) {
+    ac_str_view_t text = {
+        (const char *)search->text + (doc->pos - search->text_base) +
+            doc->from_len,
+        doc->text_len};
+    return text;
+}
+
+/** @brief Drop the oldest line, the first posting of each of its terms. */
+static void ac_search_drop_oldest(ac_search_t *search) {
+    assert(search->head < ac_alen(search->docs));
+
+    const ac_search_doc_t *doc = &search->docs[search->head];
+    uint64_t id                = search->first_id;
+
+    ac_str_view_t rest = ac_search_doc_text(search, doc);
+    ac_sstr_t key;
+
+    while (ac_search_next_term(&rest, &key)) {
+        ac_search_term_t *term = ac_search_terms_get(&search->terms, key);
+
+        /* Gone or popped already, the term occurs twice in the line. */
+        if (!term || term->first != id) {
+            continue;
+        }
+
+        if (term->count == 1) {
+            if (term->deltas) {
+                ac_arr_free(term->deltas);
+            }
+            ac_search_terms_remove(&search->terms, key);
+            continue;
+        }
+
+        const unsigned char *p = term->deltas + term->start;
+        term->first += ac_varint_get(&p);
+        term->start = (size_t)(p - term->deltas);
+        term->count--;
+
+        if (term->start >= AC_SEARCH_COMPACT_MIN &&
+            term->start > ac_alen(term->deltas) / 2) {
+            ac_arr_remove_n(term->deltas, 0, term->start);
+            term->start = 0;
+        }
+    }
+
+    search->text_bytes -= doc->from_len + doc->text_len;
+    search->head++;
+    search->first_id++;
+
+    if (search->head >= AC_SEARCH_COMPACT_MIN &&
+        search->head > ac_alen(search->docs) / 2) {
+        ac_arr_remove_n(search->docs, 0, search->head);
+        search->head = 0;
+    }
+
+    uint64_t live = search->head < ac_alen(search->docs)
+                        ? search->docs[search->head].pos
+                        : search->text_base + ac_alen(search->text);
+    size_t dead   = (size_t)(live - search->text_base);
+
+    if (dead >= AC_SEARCH_COMPACT_MIN &&
+        dead > ac_alen(search->text) / 2) {
+        ac_arr_remove_n(search->text, 0, dead);
+        search->text_base = live;
+    }
+}
+
+void ac_search_expire(ac_search_t *search, uint64_t now) {
+    while (search->head < ac_alen(search->docs) &&
+           now - search->docs[search->head].time_ms > AC_SEARCH_WINDOW_MS) {
+        ac_search_drop_oldest(search);
+    }
+}
+
+void ac_search_add(ac_search_t *search, uint64_t now, ac_str_view_t from,
+                   ac_str_view_t text) {
+    assert(from.len <= UINT32_MAX && text.len <= UINT32_MAX);
+
+    ac_search_expire(search, now);
+
+    uint64_t id = search->first_id + (ac_alen(search->docs) - search->head);
+
+    ac_search_doc_t doc = {now, search->text_base + ac_alen(search->text),
+                           (uint32_t)from.len, (uint32_t)text.len};
+
+    ac_arr_append_n(search->text, from.len, from.data);
+    ac_arr_append_n(search->text, text.len, text.data);
+    ac_arr_append(search->docs, doc);
+    search->text_bytes += from.len + text.len;
+
+    ac_sstr_t key;
+
+    while (ac_search_next_term(&text, &key)) {
+        ac_search_term_t *term = ac_search_terms_get(&search->terms, key);
+
+        if (!term) {
+            ac_search_term_t fresh = {id, id, 1, NULL, 0};
+            ac_search_terms_set(&search->terms, key, fresh);
+        } else if (term->last != id) {
+            if (!term->deltas) {
+                ac_arr_new(term->deltas);
+            }
+            ac_varint_put(&term->deltas, id - term->last);
+            term->last = id;
+            term->count++;
+        }
+    }
+
+    /* Keep the newest line even if it alone is over the limit. */
+    while (search->text_bytes > AC_SEARCH_MAX_BYTES &&
+           ac_alen(search->docs) - search->head > 1) {
+        ac_search_drop_oldest(search);
+    }
+}
+
+/** @brief Keep only the matches that are also postings of TERM. Both are
+ * ascending, so they are walked side by side. */
+static void ac_search_intersect(ac_search_t *search,
+                                const ac_search_term_t *term) {
+    const unsigned char *p = term->deltas ? term->deltas + term->start : NULL;
+    uint64_t id            = term->first;
+    size_t left            = term->count - 1;
+    size_t kept            = 0;
+
+    ac_arr_foreach(search->matches, i) {
+        uint64_t match = search->matches[i];
+
+        while (id < match && left > 0) {
+            id += ac_varint_get(&p);
+            left--;
+        }
+
+        if (id == match) {
+            search->matches[kept++] = match;
+        } else if (id < match) {
+            break;
+        }
+    }
+
+    ac_alen(search->matches) = kept;
+}
+
+size_t ac_search_find(ac_search_t *search, ac_str_view_t query,
+                      ac_search_hit_t *hits, size_t max) {
+    const ac_search_term_t *terms[AC_SEARCH_QUERY_TERMS];
+    size_t count  = 0;
+    size_t rarest = 0;
+    ac_sstr_t key;
+
+    while (count < AC_SEARCH_QUERY_TERMS &&
+           ac_search_next_term(&query, &key)) {
+        const ac_search_term_t *term =
+            ac_search_terms_get(&search->terms, key);
+
+        if (!term) {
+            return 0;
+        }
+
+        if (count == 0 || term->count < terms[rarest]->count) {
+            rarest = count;
+        }
+        terms[count++] = term;
+    }
+
+    if (count == 0 || max == 0) {
+        return 0;
+    }
+
+    /* Start from the rarest term, the others can only narrow it down. */
+
+    const ac_search_term_t *base = terms[rarest];
+    const unsigned char *p = base->deltas ? base->deltas + base->start : NULL;
+    uint64_t id            = base->first;
+
+    ac_alen(search->matches) = 0;
+    ac_arr_append(search->matches, id);
+
+    for (size_t i = 1; i < base->count; i++) {
+        id += ac_varint_get(&p);
+        ac_arr_append(search->matches, id);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (i != rarest) {
+            ac_search_intersect(search, terms[i]);
+        }
+    }
+
+    size_t found = ac_alen(search->matches);
+    if (found > max) {
+        found = max;
+    }
+
+    for (size_t i = 0; i < found; i++) {
+        uint64_t match = search->matches[ac_alen(search->matches) - 1 - i];
+        const ac_search_doc_t *doc =
+            &search->docs[search->head + (size_t)(match - search->first_id)];
+
+        hits[i].time_ms   = doc->time_ms;
+        hits[i].from.data = (const char *)search->text +
+                            (doc->pos - search->text_base);
+        hits[i].from.len  = doc->from_len;
+        hits[i].text      = ac_search_doc_text(search, doc);
+    }
+
+    return found;
+}
@@ -0,0 +1,224 @@
+#include <ac/app.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <ac/history.h>
+#include <ac/io.h>
+#include <ac/log.h>
+#include <ac/meta.h>
+#include <ac/token.h>
+
+/** @brief Tokens popped off the front of the parked queue worth compacting,
+ * once they are also more than half of it. */
+#define AC_SESSION_COMPACT_MIN 64
+
+void ac_session_issue(ac_user_t *user, ac_app_t *app) {
+    if (!ac_token_new(&user->session.token)) {
+        ac_log_fmt(AC_LOG_WARNING,
+                   "Failed to draw a session token, the session of %.*s "
+                   "cannot be resumed.",
+                   ac_atom_fmt_args(user->username));
+        return;
+    }
+
+    char hex[AC_TOKEN_HEX];
+    ac_token_format(user->session.token, hex);
+
+    ac_send_fmt(user, app,
+                "If your connection drops, reconnect and enter /resume %.*s "
+                "within %d seconds to pick up where you left off.\r\n",
+                AC_TOKEN_HEX, hex, AC_SESSION_GRACE_MS / 1000);
+}
+
+bool ac_session_park(ac_user_t *user, ac_app_t *app) {
+    assert(user->member == AC_MEMBER_NONE);
+
+    if (user->username == AC_ATOM_NONE ||
+        ac_token_none(user->session.token)) {
+        return false;
+    }
+
+    /* The output queue goes with the client. */
+    user->out = NULL;
+
+    user->session.parked       = true;
+    user->session.parked_at    = app->now;
+    user->session.history_head = ac_history_enabled(&app->history)
+                                     ? app->history.hdr->head
+                                     : 0;
+    ac_arr_new(user->session.missed);
+    user->session.missed_dropped = 0;
+
+    ac_user_token_map_set(&app->parked.by_token, user->session.token, user);
+    ac_arr_append(app->parked.queue, user->session.token);
+
+    return true;
+}
+
+bool ac_session_keep(ac_user_t *user, ac_atom_t from, ac_str_view_t msg) {
+    assert(user->session.parked);
+
+    size_t len = 1 + ac_atom_len(from) + 10 + msg.len + 2;
+
+    if (ac_alen(user->session.missed) + len > AC_SESSION_MISSED_BYTES) {
+        user->session.missed_dropped++;
+        return false;
+    }
+
+    ac_arr_append_n(user->session.missed, 1, "[");
+    ac_arr_append_n(user->session.missed, ac_atom_len(from),
+                    ac_atom_data(from));
+    ac_arr_append_n(user->session.missed, 10, " -> You]: ");
+    ac_arr_append_n(user->session.missed, msg.len, msg.data);
+    ac_arr_append_n(user->session.missed, 2, "\r\n");
+    return true;
+}
+
+/** @brief Send the chat lines a parked session missed, as far as they are
+ * still in the history and within AC_SESSION_REPLAY_BYTES. */
+static void ac_session_replay(ac_user_t *user, ac_app_t *app,
+                              uint64_t since) {
+    if (!ac_history_enabled(&app->history) ||
+        app->history.hdr->head == since) {
+        return;
+    }
+
+    ac_history_range_t missed = ac_history_lines(&app->history, 0, SIZE_MAX,
+                                                 AC_SESSION_REPLAY_BYTES);
+
+    ac_send(user, app, "Missed messages:\r\n");
+
+    if (missed.start > since) {
+        ac_send(user, app, "(Older messages are not shown.)\r\n");
+    } else {
+        missed.start = since;
+    }
+
+    ac_send_history(user, app, missed);
+}
+
+void ac_session_resume(ac_user_t *user, ac_app_t *app, ac_str_view_t line) {
+    static const char cmd[] = "/resume ";
+    size_t cmd_len          = sizeof cmd - 1;
+
+    if (line.len < cmd_len || memcmp(line.data, cmd, cmd_len) != 0) {
+        ac_print(user, app, AC_PRINT_AFTER_ENTER,
+                 "Please enter a username, or /resume and a session token.");
+        return;
+    }
+
+    ac_str_view_t arg = {line.data + cmd_len, line.len - cmd_len};
+
+    while (arg.len > 0 && arg.data[0] == ' ') {
+        arg.data++;
+        arg.len--;
+    }
+    while (arg.len > 0 && arg.data[arg.len - 1] == ' ') {
+        arg.len--;
+    }
+
+    ac_token_t token;
+    ac_user_t **slot = NULL;
+
+    if (ac_token_parse(arg, &token)) {
+        slot = ac_user_token_map_get(&app->parked.by_token, token);
+    }
+
+    /* Expiry runs at the end of the tick, the grace period may be over. */
+    if (!slot || app->now - (*slot)->session.parked_at >=
+                     AC_SESSION_GRACE_MS) {
+        ac_print(user, app, AC_PRINT_AFTER_ENTER,
+                 "That session cannot be resumed, it may have expired. "
+                 "Please enter a username.");
+        return;
+    }
+
+    ac_user_t *parked = *slot;
+    ac_user_token_map_remove(&app->parked.by_token, token);
+
+    /* Take over the name and standing of the parked user. Its queued token
+       is skipped once it reaches the front. */
+    ac_atom_release(user->username);
+    user->username   = parked->username;
+    parked->username = AC_ATOM_NONE;
+    user->rate       = parked->rate;
+
+    *ac_user_name_map_get(&app->users.from_username, user->username) = user;
+
+    ac_send_fmt(user, app, "Welcome back, %.*s!\r\n",
+                ac_atom_fmt_args(user->username));
+
+    ac_session_replay(user, app, parked->session.history_head);
+
+    if (ac_alen(parked->session.missed) > 0) {
+        /* Written as is, like ac_send(): the kept whispers end in CRLF
+           already, and the prompt comes with the switch to chat. */
+        ac_writer_t w = {user->out};
+        ac_write_str(&w, "Whispers while you were away:\r\n");
+        ac_write_bytes(&w, parked->session.missed,
+                       ac_alen(parked->session.missed));
+    }
+
+    if (parked->session.missed_dropped > 0) {
+        ac_send_fmt(user, app, "(%zu more whisper%s did not fit.)\r\n",
+                    parked->session.missed_dropped,
+                    parked->session.missed_dropped == 1 ? "" : "s");
+    }
+
+    ac_user_free(parked);
+    ac_pool_release(&app->users.pool, parked);
+
+    /* A token is good for one resumption. */
+    ac_session_issue(user, app);
+
+    /* Back in the chat without a join notice. */
+    ac_state_switch(user, app, AC_STATE_CHAT);
+}
+
+uint64_t ac_session_deadline(const ac_app_t *app) {
+    for (size_t i = app->parked.head; i < ac_alen(app->parked.queue); i++) {
+        ac_user_t **slot =
+            ac_user_token_map_get(&app->parked.by_token, app->parked.queue[i]);
+
+        /* Resumed sessions are skipped, the queue is in parking order. */
+        if (slot) {
+            return (*slot)->session.parked_at + AC_SESSION_GRACE_MS;
+        }
+    }
+    return UINT64_MAX;
+}
+
+void ac_session_expire(ac_app_t *app) {
+    size_t len = ac_alen(app->parked.queue);
+
+    for (; app->parked.head < len; app->parked.head++) {
+        ac_token_t token = app->parked.queue[app->parked.head];
+        ac_user_t **slot = ac_user_token_map_get(&app->parked.by_token, token);
+
+        /* Resumed already. */
+        if (!slot) {
+            continue;
+        }
+
+        if (app->now - (*slot)->session.parked_at < AC_SESSION_GRACE_MS &&
+            app->parked.by_token.len <= AC_SESSION_PARKED_MAX) {
+            break;
+        }
+
+        ac_user_t *user = *slot;
+        ac_user_token_map_remove(&app->parked.by_token, token);
+        ac_app_remove_user(app, user);
+    }
+
+    if (app->parked.head == len) {
+        ac_alen(app->parked.queue) = 0;
+        app->parked.head           = 0;
+    } else if (app->parked.head >= AC_SESSION_COMPACT_MIN &&
+               app->parked.head > len / 2) {
+        ac_arr_remove_n(app->parked.queue, 0, app->parked.head);
+        app->parked.head = 0;
+    }
+}
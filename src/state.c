@@ -12,45 +12,279 @@
 #include <ac/net.h>
 #include <ac/str.h>
 
-void ac_state_new(ac_user_t *user, ac_app_t *app) {
-    switch (user->state) {
-        case AC_STATE_LOGIN: {
-            /* Calculate server uptime in days. */
+/**
+ * @brief Charge a chat state line against the user's rate limits.
+ *
+ * Penalties escalate with the user's strikes: the first AC_RATE_DELAY_STRIKES
+ * put the line back and stop reading input until a token is due, further
+ * ones up to AC_RATE_DROP_STRIKES drop the line, and any after that
+ * disconnect the user.
+ *
+ * @return Whether the line may be handled now.
+ */
+static bool ac_state_admit(ac_user_t *user, ac_app_t *app, ac_input_t *in,
+                           ac_str_view_t line) {
+    ac_rate_class_t kind         = ac_rate_class(line);
+    const ac_rate_limit_t *limit = &ac_rate_limits[kind];
+    ac_bucket_t *bucket          = &user->rate.buckets[kind];
+
+    if (ac_bucket_take(bucket, limit, app->now)) {
+        if (app->now - user->rate.last_strike >= AC_RATE_FORGIVE_MS) {
+            user->rate.strikes = 0;
+        }
+        return true;
+    }
+
+    user->rate.strikes++;
+    user->rate.last_strike = app->now;
 
-            char uptime[16];
-            snprintf(uptime, sizeof uptime, "%d days",
-                     (int)((time(NULL) - app->app_start_time) / 86400));
+    if (user->rate.strikes <= AC_RATE_DELAY_STRIKES) {
+        user->rate.delayed++;
+        user->rate.resume_at = app->now + ac_bucket_wait(bucket, limit);
+        ac_unget_line(in);
+    } else if (user->rate.strikes <= AC_RATE_DROP_STRIKES) {
+        user->rate.dropped++;
+
+        if (user->rate.strikes == AC_RATE_DELAY_STRIKES + 1) {
+            ac_print(user, app, AC_PRINT_AFTER_ENTER,
+                     "You are sending too fast, your messages are being "
+                     "dropped.");
+        }
+    } else {
+        ac_log_fmt(AC_LOG_WARNING,
+                   "Disconnecting %.*s for flooding (%llu lines delayed, "
+                   "%llu dropped).",
+                   ac_atom_fmt_args(user->username),
+                   (unsigned long long)user->rate.delayed,
+                   (unsigned long long)user->rate.dropped);
+
+        ac_print(user, app, AC_PRINT_AFTER_ENTER,
+                 "You have been disconnected for flooding.");
+        user->session.token = AC_TOKEN_NONE;
+        ac_server_remove_client(&app->server, user->handle);
+    }
+
+    return false;
+}
+
+/**
+ * @brief Run a chat line through the content filter.
+ *
+ * Flagged lines are logged for review, dropped lines are refused, and masked
+ * patterns are starred out in a copy of the line in the scratch arena.
+ *
+ * @return Whether the line may be broadcast, LINE set to what to broadcast.
+ */
+static bool ac_state_filter(ac_user_t *user, ac_app_t *app,
+                            ac_str_view_t *line) {
+    const ac_filter_t *filter = app->filter.active;
+    unsigned actions          = ac_filter_scan(filter, *line);
+
+    if (actions & AC_FILTER_FLAG) {
+        ac_log_fmt(AC_LOG_WARNING, "Content filter: flagged [%.*s]: %.*s",
+                   ac_atom_fmt_args(user->username),
+                   ac_str_view_fmt_args(*line));
+    }
+
+    if (actions & AC_FILTER_DROP) {
+        ac_print(user, app, AC_PRINT_AFTER_ENTER,
+                 "Your message was blocked by the content filter.");
+        return false;
+    }
+
+    if (actions & AC_FILTER_MASK) {
+        char *masked = ac_arena_alloc(&app->scratch, line->len);
+        ac_filter_mask(filter, *line, masked);
+        line->data = masked;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Log a user in under a name that is free and, if registered,
+ * proven.
+ *
+ * @param user The user.
+ * @param app The app.
+ * @param username The name, whose reference the user takes over.
+ */
+static void ac_state_login(ac_user_t *user, ac_app_t *app,
+                           ac_atom_t username) {
+    ac_atom_release(user->username);
+    user->username = username;
+
+    ac_user_name_map_set(&app->users.from_username, user->username, user);
+    ac_name_index_insert(&app->users.by_name, user->username);
+    ac_app_touch(app);
+
+    /* Catch the newcomer up on the conversation. */
+    ac_history_range_t recent =
+        ac_history_lines(&app->history, 0, AC_HISTORY_REPLAY_LINES,
+                         AC_HISTORY_REPLAY_BYTES);
+
+    if (recent.start != recent.end) {
+        ac_send(user, app, "Recent messages:\r\n");
+        ac_send_history(user, app, recent);
+    }
 
-            /* Format greeting and send to user. */
+    ac_session_issue(user, app);
+    ac_state_switch(user, app, AC_STATE_CHAT);
 
-            char user_count_msg[64];
-            if (app->users.from_handle.len == 1) {
-                snprintf(user_count_msg, sizeof user_count_msg,
-                         "There is currently 1 user online.");
+    /* Broadcast new user to all chat members. */
+    ac_presence_join(app, user->username);
+}
+
+/**
+ * @brief Hand a password entered for a registered name to the workers.
+ *
+ * @return Whether the check is under way.
+ */
+static bool ac_state_check_password(ac_user_t *user, ac_app_t *app,
+                                    ac_str_view_t password) {
+    if (password.len > AC_PASSWORD_MAX) {
+        ac_print_fmt(user, app, AC_PRINT_AFTER_ENTER,
+                     "Passwords are at most %d bytes long. Password:",
+                     AC_PASSWORD_MAX);
+        return false;
+    }
+
+    ac_str_view_t name = {ac_atom_data(user->auth.name),
+                          ac_atom_len(user->auth.name)};
+    const ac_account_t *account = ac_accounts_find(&app->accounts, name);
+    assert(account);
+
+    ac_auth_job_t job;
+    job.op         = AC_AUTH_VERIFY;
+    job.owner      = (uint64_t)user->handle;
+    job.ticket     = ++app->auth_ticket;
+    job.iterations = account->iterations;
+    memcpy(job.salt, account->salt, sizeof job.salt);
+    memcpy(job.hash, account->hash, sizeof job.hash);
+
+    job.password_len = password.len;
+    memcpy(job.password, password.data, password.len);
+
+    if (!ac_auth_submit(&app->auth, &job)) {
+        ac_print(user, app, AC_PRINT_AFTER_ENTER,
+                 "The server is busy, please enter your password again in "
+                 "a moment.");
+        return false;
+    }
+
+    user->auth.ticket = job.ticket;
+    return true;
+}
+
+void ac_state_auth_done(ac_user_t *user, ac_app_t *app,
+                        const ac_auth_result_t *result) {
+    switch (result->op) {
+        case AC_AUTH_VERIFY: {
+            assert(user->state == AC_STATE_VERIFY);
+
+            ac_atom_t name  = user->auth.name;
+            user->auth.name = AC_ATOM_NONE;
+
+            if (!result->ok) {
+                ac_atom_release(name);
+                user->auth.failures++;
+
+                if (user->auth.failures >= AC_LOGIN_ATTEMPTS) {
+                    ac_log_fmt(AC_LOG_WARNING,
+                               "Disconnecting a client after %u wrong "
+                               "passwords.",
+                               user->auth.failures);
+                    ac_print(user, app, AC_PRINT_AFTER_ENTER,
+                             "Too many wrong passwords, goodbye.");
+                    ac_server_remove_client(&app->server, user->handle);
+                    return;
+                }
+
+                ac_print(user, app, AC_PRINT_AFTER_ENTER, "Wrong password.");
+                ac_state_switch(user, app, AC_STATE_LOGIN);
+            } else if (ac_user_name_map_contains(&app->users.from_username,
+                                                 name)) {
+                /* Logged in on another connection meanwhile. */
+                ac_atom_release(name);
+                ac_print(user, app, AC_PRINT_AFTER_ENTER,
+                         "Username is taken. Please choose another one.");
+                ac_state_switch(user, app, AC_STATE_LOGIN);
             } else {
-                snprintf(user_count_msg, sizeof user_count_msg,
-                         "There are currently %d users online.",
-                         (int)app->users.from_handle.len);
+                ac_state_login(user, app, name);
             }
+            break;
+        }
 
-            ac_print_fmt(
-                user, app, AC_PRINT_AFTER_ENTER,
-                "[ AuroraComms - Multi-User Communications Server ]\r\n"
-                "%s\r\n"
-                "Server uptime: %s\r\n"
-                "\r\n"
-                "Enter a username between 2-16 characters long.\r\n"
-                "It may include letters, numbers and underscores.",
-                user_count_msg, uptime);
+        case AC_AUTH_DERIVE: {
+            /* Only logged in users register. */
+            if (user->username == AC_ATOM_NONE) {
+                break;
+            }
 
+            ac_account_t account;
+            memset(&account, 0, sizeof account);
+
+            account.name_len   = (uint8_t)ac_atom_len(user->username);
+            account.iterations = result->iterations;
+            account.created_ms = app->wall_ms;
+            memcpy(account.name, ac_atom_data(user->username),
+                   account.name_len);
+            memcpy(account.salt, result->salt, sizeof account.salt);
+            memcpy(account.hash, result->hash, sizeof account.hash);
+
+            ac_accounts_status_t status =
+                result->ok ? ac_accounts_add(&app->accounts, &account)
+                           : AC_ACCOUNTS_FULL;
+
+            switch (status) {
+                case AC_ACCOUNTS_ADDED:
+                    ac_log_fmt(AC_LOG_INFO, "Registered %.*s.",
+                               ac_atom_fmt_args(user->username));
+                    ac_print(user, app, AC_PRINT_INTERRUPT,
+                             "Your name is registered. You will be asked "
+                             "for your password when you log in.");
+                    break;
+
+                case AC_ACCOUNTS_EXISTS:
+                    ac_print(user, app, AC_PRINT_INTERRUPT,
+                             "Your name is already registered.");
+                    break;
+
+                case AC_ACCOUNTS_FULL:
+                    ac_log_fmt(AC_LOG_WARNING, "Failed to register %.*s.",
+                               ac_atom_fmt_args(user->username));
+                    ac_print(user, app, AC_PRINT_INTERRUPT,
+                             "Your name could not be registered, please try "
+                             "again later.");
+                    break;
+            }
             break;
         }
+    }
+}
+
+void ac_state_new(ac_user_t *user, ac_app_t *app) {
+    switch (user->state) {
+        case AC_STATE_LOGIN: {
+            ac_send_greeting(user, app);
+            break;
+        }
+
+        case AC_STATE_PASSWORD: {
+            ac_print_fmt(user, app, AC_PRINT_AFTER_ENTER,
+                         "%.*s is a registered name. Password:",
+                         ac_atom_fmt_args(user->auth.name));
+            break;
+        }
+
+        case AC_STATE_VERIFY:
+            break;
 
         case AC_STATE_CHAT: {
             ac_print_fmt(user, app, AC_PRINT_AFTER_ENTER,
                          "You may now chat with "
                          "others, %.*s!",
-                         ac_alen(user->username), user->username);
+                         ac_atom_fmt_args(user->username));
 
             break;
         }
@@ -70,6 +304,12 @@ void ac_state_free(ac_user_t *user, ac_app_t *app) {
         case AC_STATE_LOGIN:
             break;
 
+        case AC_STATE_PASSWORD:
+            break;
+
+        case AC_STATE_VERIFY:
+            break;
+
         case AC_STATE_CHAT:
             break;
 
@@ -78,128 +318,124 @@ void ac_state_free(ac_user_t *user, ac_app_t *app) {
     }
 }
 
-void ac_state_update(ac_user_t *user, ac_app_t *app, ac_bytes_t *in) {
+void ac_state_update(ac_user_t *user, ac_app_t *app, ac_input_t *in) {
     switch (user->state) {
         case AC_STATE_LOGIN: {
-            ac_string_t line;
-            ac_arr_new(line);
+            ac_str_view_t line;
 
-            if (ac_get_line(&line, (ac_string_t *)in)) {
-                if (ac_alen(line) == 0) {
+            if (ac_get_line(&line, in)) {
+                if (line.len == 0) {
                     ac_prompt(user, app);
+                } else if (ac_is_command(line)) {
+                    /* The one command before login resumes a session. */
+                    ac_session_resume(user, app, line);
+                } else if (!ac_validate_username(line)) {
+                    ac_print_fmt(
+                        user, app, AC_PRINT_AFTER_ENTER,
+                        "Username must be between 2-16 characters long "
+                        "and may only contain letters, numbers, and "
+                        "underscores. Please try again.");
                 } else {
-                    /* Check if username is taken. */
-                    bool username_taken;
-                    ac_map_contains(app->users.from_username, ac_string_hash,
-                                    ac_string_eq, line, username_taken);
+                    /* Check if username is taken. A name that was never
+                       interned cannot be. */
+                    ac_atom_t username = ac_intern_find(line.data, line.len);
 
-                    if (username_taken) {
+                    if (username != AC_ATOM_NONE &&
+                        ac_user_name_map_contains(&app->users.from_username,
+                                                  username)) {
                         ac_print_fmt(
                             user, app, AC_PRINT_AFTER_ENTER,
                             "Username is taken. Please choose another one.");
-                    } else if (!ac_validate_username(line)) {
-                        ac_print_fmt(
-                            user, app, AC_PRINT_AFTER_ENTER,
-                            "Username must be between 2-16 characters long "
-                            "and may only contain letters, numbers, and "
-                            "underscores. Please try again.");
+                    } else if (ac_accounts_find(&app->accounts, line)) {
+                        /* Registered, ask for the password. */
+                        ac_atom_release(user->auth.name);
+                        user->auth.name = ac_intern(line.data, line.len);
+                        ac_state_switch(user, app, AC_STATE_PASSWORD);
                     } else {
                         /* Username is valid and not taken. */
-
-                        ac_arr_append_n(user->username, ac_alen(line), line);
-
-                        ac_map_set(app->users.from_username, ac_string_hash,
-                                   ac_string_eq, user->username, user);
-
-                        ac_state_switch(user, app, AC_STATE_CHAT);
-
-                        /* Broadcast new user to all clients. */
-
-                        ac_client_handle_t *handle;
-                        ac_user_t **other_user;
-
-                        ac_map_foreach(app->users.from_handle, handle,
-                                       other_user) {
-                            if (user->handle == *handle) {
-                                continue;
-                            }
-
-                            if ((*other_user)->state == AC_STATE_CHAT) {
-                                ac_print_fmt(
-                                    *other_user, app, AC_PRINT_INTERRUPT,
-                                    "%.*s joins the chat!",
-                                    ac_alen(user->username), user->username);
-                            }
-                        }
+                        ac_state_login(user, app,
+                                       ac_intern(line.data, line.len));
                     }
                 }
             }
-
-            ac_arr_free(line);
             break;
         }
 
-        case AC_STATE_CHAT: {
-            ac_string_t line;
-            ac_arr_new(line);
+        case AC_STATE_PASSWORD: {
+            ac_str_view_t line;
 
-            if (ac_get_line(&line, (ac_string_t *)in)) {
-                if (ac_alen(line) == 0) {
+            if (ac_get_line(&line, in)) {
+                if (line.len == 0) {
                     ac_prompt(user, app);
-                    goto cleanup_chat;
+                } else if (ac_state_check_password(user, app, line)) {
+                    ac_state_switch(user, app, AC_STATE_VERIFY);
                 }
+            }
+            break;
+        }
+
+        case AC_STATE_VERIFY:
+            /* Input waits until the password is checked. */
+            break;
+
+        case AC_STATE_CHAT: {
+            ac_str_view_t line;
 
-                if (ac_is_command(line)) {
+            if (ac_get_line(&line, in)) {
+                if (line.len == 0) {
+                    ac_prompt(user, app);
+                } else if (!ac_state_admit(user, app, in, line)) {
+                    /* Over the limit, the penalty is already applied. */
+                } else if (ac_is_command(line)) {
                     ac_handle_command(user, app, line);
+                } else if (!ac_state_filter(user, app, &line)) {
+                    /* Blocked by the content filter. */
                 } else {
-                    /* Broadcast message to all users. */
-
-                    ac_client_handle_t *handle;
-                    ac_user_t **other_user;
-
-                    ac_map_foreach(app->users.from_handle, handle,
-                                   other_user) {
-                        if (user->handle == *handle) {
-                            continue;
-                        }
-
-                        if ((*other_user)->state == AC_STATE_CHAT) {
-                            ac_print_fmt(*other_user, app, AC_PRINT_INTERRUPT,
-                                         "[%.*s]: %.*s",
-                                         ac_alen(user->username),
-                                         user->username, ac_alen(line), line);
-                        }
-                    }
-
-                    ac_print_fmt(user, app, AC_PRINT_AFTER_ENTER,
-                                 "[You]: %.*s", ac_alen(line), line);
+                    /* Broadcast message to all other chat members. */
+                    ac_broadcast_fmt(app, user, "[%.*s]: %.*s",
+                                     ac_atom_fmt_args(user->username),
+                                     ac_str_view_fmt_args(line));
+
+                    ac_str_view_t parts[] = {
+                        {"[", 1},
+                        {ac_atom_data(user->username),
+                         ac_atom_len(user->username)},
+                        {"]: ", 3},
+                        line,
+                    };
+                    ac_history_append(&app->history, parts,
+                                      sizeof parts / sizeof parts[0]);
+                    ac_app_record(app, AC_MSG_CHAT, user->username,
+                                  AC_ATOM_NONE, line);
+
+                    ac_str_view_t name = {ac_atom_data(user->username),
+                                          ac_atom_len(user->username)};
+                    ac_search_add(&app->search, app->now, name, line);
+
+                    ac_writer_t w = ac_write_begin(user, AC_PRINT_AFTER_ENTER);
+                    ac_write_str(&w, "[You]: ");
+                    ac_write_view(&w, line);
+                    ac_write_end(&w);
                 }
             }
-
-        cleanup_chat:
-            ac_arr_free(line);
             break;
         }
 
         case AC_STATE_EXIT: {
-            ac_string_t line;
-            ac_arr_new(line);
+            ac_str_view_t line;
 
-            if (ac_get_line(&line, (ac_string_t *)in)) {
+            if (ac_get_line(&line, in)) {
                 /* If yes, disconnect user. */
-                ac_string_t yes_cmd;
-                ac_arr_from_string_literal(yes_cmd, "y", 1, 0);
-                if (ac_string_eq_ignore_case(line, yes_cmd)) {
-                    /* Remove user from app. */
+                if (line.len == 1 &&
+                    (line.data[0] == 'y' || line.data[0] == 'Y')) {
+                    /* Remove user from app, for good. */
+                    user->session.token = AC_TOKEN_NONE;
                     ac_server_remove_client(&app->server, user->handle);
-                    goto cleanup_exit;
+                    break;
                 }
                 /* If no, return to chat state. */
                 ac_state_switch(user, app, AC_STATE_CHAT);
             }
-
-        cleanup_exit:
-            ac_arr_free(line);
             break;
         }
     }
@@ -207,6 +443,15 @@ void ac_state_update(ac_user_t *user, ac_app_t *app, ac_bytes_t *in) {
 
 void ac_state_switch(ac_user_t *user, ac_app_t *app, ac_state_t state) {
     ac_state_free(user, app);
+
+    /* Keep the chat member table in step with the state. */
+    if (user->state == AC_STATE_CHAT) {
+        ac_members_remove(&app->users.members, user);
+    }
+    if (state == AC_STATE_CHAT) {
+        ac_members_add(&app->users.members, user, user->out);
+    }
+
     user->state = state;
     ac_state_new(user, app);
 }
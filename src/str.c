@@ -1,20 +1,641 @@
 #include <ac/str.h>
 
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <assert.h>
 #include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/* Seed premixed with the secrets by ac_string_hash_seed(). The default is
+   replaced by ac_string_hash_init() at startup. */
+static uint64_t ac_hash_seed = 0x243f6a8885a308d3ull;
+
+/* Secrets from wyhash. Odd, with 32 set bits each. */
+static const uint64_t ac_hash_p0 = 0xa0761d6478bd642full;
+static const uint64_t ac_hash_p1 = 0xe7037ed1a0b428dbull;
+static const uint64_t ac_hash_p2 = 0x8ebc6af09c88c6e3ull;
+static const uint64_t ac_hash_p3 = 0x589965cc75374cc3ull;
+
+/** @brief Multiply two 64-bit words into 128 bits, leaving the low half in
+ * A and the high half in B. */
+static inline void ac_mum(uint64_t *a, uint64_t *b) {
+#ifdef __SIZEOF_INT128__
+    __extension__ typedef unsigned __int128 ac_u128_t;
+    ac_u128_t r = (ac_u128_t)*a * *b;
+    *a          = (uint64_t)r;
+    *b          = (uint64_t)(r >> 64);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32;
+    uint64_t la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t  = rl + (rm0 << 32);
+    uint64_t c  = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline uint64_t ac_mix(uint64_t a, uint64_t b) {
+    ac_mum(&a, &b);
+    return a ^ b;
+}
+
+static inline uint64_t ac_read8(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof v);
+    return v;
+}
+
+static inline uint64_t ac_read4(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof v);
+    return v;
+}
+
+/* Read 1-3 bytes so that every byte contributes. */
+static inline uint64_t ac_read3(const unsigned char *p, size_t len) {
+    return ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) |
+           p[len - 1];
+}
+
+void ac_string_hash_seed(uint64_t seed) {
+    ac_hash_seed = seed ^ ac_mix(seed ^ ac_hash_p0, ac_hash_p1);
+}
+
+void ac_string_hash_init(void) {
+    uint64_t seed = 0;
+
+    FILE *urandom = fopen("/dev/urandom", "rb");
+    if (urandom) {
+        if (fread(&seed, sizeof seed, 1, urandom) != 1) {
+            seed = 0;
+        }
+        fclose(urandom);
+    }
+
+    /* Fall back to something that at least differs between processes. */
+    if (seed == 0) {
+        seed = ac_mix((uint64_t)time(NULL) ^ ac_hash_p0,
+                      (uint64_t)getpid() ^ ac_hash_p1);
+    }
+
+    ac_string_hash_seed(seed);
+}
+
+uint64_t ac_hash_bytes(const void *data, size_t len) {
+    const unsigned char *p = data;
+    uint64_t seed          = ac_hash_seed;
+    uint64_t a, b;
+
+    if (len <= 16) {
+        if (len >= 4) {
+            /* Two overlapping pairs of 4-byte reads cover 4-16 bytes. */
+            size_t off = (len >> 3) << 2;
+            a          = (ac_read4(p) << 32) | ac_read4(p + off);
+            b = (ac_read4(p + len - 4) << 32) | ac_read4(p + len - 4 - off);
+        } else if (len > 0) {
+            a = ac_read3(p, len);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+
+        if (i > 48) {
+            /* Three independent lanes to keep the multipliers busy. */
+            uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = ac_mix(ac_read8(p) ^ ac_hash_p1,
+                              ac_read8(p + 8) ^ seed);
+                see1 = ac_mix(ac_read8(p + 16) ^ ac_hash_p2,
+                              ac_read8(p + 24) ^ see1);
+                see2 = ac_mix(ac_read8(p + 32) ^ ac_hash_p3,
+                              ac_read8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+
+        while (i > 16) {
+            seed = ac_mix(ac_read8(p) ^ ac_hash_p1, ac_read8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+
+        /* The last 16 bytes, overlapping with what was already mixed. */
+        a = ac_read8(p + i - 16);
+        b = ac_read8(p + i - 8);
+    }
+
+    a ^= ac_hash_p1;
+    b ^= seed;
+    ac_mum(&a, &b);
+    return ac_mix(a ^ ac_hash_p0 ^ (uint64_t)len, b ^ ac_hash_p1);
+}
 
 uint64_t ac_string_hash(const ac_string_t *key) {
-    uint64_t hash = 14695981039346656037ul;
+    return ac_hash_bytes(*key, ac_alen(*key));
+}
+
+bool ac_bytes_eq(const void *a, const void *b, size_t len) {
+    const unsigned char *pa = a, *pb = b;
+
+    if (len >= 8) {
+        /* Compare word by word, then the last word overlapping the rest. */
+        for (size_t i = 0; i + 8 <= len; i += 8) {
+            if (ac_read8(pa + i) != ac_read8(pb + i)) {
+                return false;
+            }
+        }
+        return ac_read8(pa + len - 8) == ac_read8(pb + len - 8);
+    }
 
-    for (size_t i = 0; i < ac_alen(*key); i++) {
-        hash ^= (uint64_t)(uint8_t)(*key)[i];
-        hash *= 1099511628211ul;
+    if (len >= 4) {
+        return ac_read4(pa) == ac_read4(pb) &&
+               ac_read4(pa + len - 4) == ac_read4(pb + len - 4);
     }
-    return hash;
+
+    for (size_t i = 0; i < len; i++) {
+        if (pa[i] != pb[i]) {
+            return false;
+        }
+    }
+    return true;
 }
 
 bool ac_string_eq(const ac_string_t *a, const ac_string_t *b) {
-    return ac_alen(*a) == ac_alen(*b) && memcmp(*a, *b, ac_alen(*a)) == 0;
+    /* Length first, it rejects most mismatches without touching data. */
+    return ac_alen(*a) == ac_alen(*b) && ac_bytes_eq(*a, *b, ac_alen(*a));
+}
+
+void ac_sstr_new(ac_sstr_t *str) {
+    memset(str, 0, sizeof *str);
+}
+
+void ac_sstr_set(ac_sstr_t *str, const char *data, size_t len) {
+    assert(len <= UINT32_MAX);
+
+    ac_sstr_free(str);
+    str->len = (uint32_t)len;
+
+    if (len <= AC_SSTR_INLINE) {
+        /* Zero the tail so inline strings compare as whole words. */
+        memset(str->data.buf, 0, AC_SSTR_INLINE);
+        memcpy(str->data.buf, data, len);
+    } else {
+        str->data.ptr = malloc(len);
+        assert(str->data.ptr);
+        memcpy(str->data.ptr, data, len);
+    }
+}
+
+void ac_sstr_free(ac_sstr_t *str) {
+    if (str->len > AC_SSTR_INLINE) {
+        free(str->data.ptr);
+    }
+    ac_sstr_new(str);
+}
+
+uint64_t ac_sstr_hash(const ac_sstr_t *key) {
+    return ac_hash_bytes(ac_sstr_data(key), key->len);
+}
+
+bool ac_sstr_eq(const ac_sstr_t *a, const ac_sstr_t *b) {
+    if (a->len != b->len) {
+        return false;
+    }
+
+    /* Inline buffers are zero padded, compare them in full. */
+    if (a->len <= AC_SSTR_INLINE) {
+        return ac_bytes_eq(a->data.buf, b->data.buf, AC_SSTR_INLINE);
+    }
+
+    return ac_bytes_eq(a->data.ptr, b->data.ptr, a->len);
+}
+
+size_t ac_find_eol(const char *data, size_t len) {
+    size_t i = 0;
+
+#ifdef __AVX2__
+    const __m256i cr32 = _mm256_set1_epi8('\r');
+    const __m256i lf32 = _mm256_set1_epi8('\n');
+
+    for (; i + 32 <= len; i += 32) {
+        __m256i v =
+            _mm256_loadu_si256((const __m256i *)(const void *)(data + i));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(
+            _mm256_cmpeq_epi8(v, cr32), _mm256_cmpeq_epi8(v, lf32)));
+
+        if (mask) {
+            return i + ac_ctz(mask);
+        }
+    }
+#endif
+
+#ifdef __SSE2__
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i v =
+            _mm_loadu_si128((const __m128i *)(const void *)(data + i));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf)));
+
+        if (mask) {
+            return i + ac_ctz(mask);
+        }
+    }
+#endif
+
+    for (; i < len; i++) {
+        if (data[i] == '\r' || data[i] == '\n') {
+            return i;
+        }
+    }
+
+    return len;
+}
+
+size_t ac_utf8_decode(const char *data, size_t len, uint32_t *cp) {
+    const unsigned char *s = (const unsigned char *)data;
+    unsigned char lead     = s[0];
+
+    if (lead < 0x80) {
+        *cp = lead;
+        return 1;
+    }
+
+    /* Well-formed sequences per table 3-7 of the Unicode standard. The
+       second byte of some leads has a narrower range, which excludes
+       overlong forms, surrogates and code points above U+10FFFF. */
+
+    size_t need;
+    uint32_t value;
+    unsigned char lo = 0x80, hi = 0xbf;
+
+    if (lead >= 0xc2 && lead <= 0xdf) {
+        need  = 1;
+        value = (uint32_t)(lead & 0x1f);
+    } else if (lead >= 0xe0 && lead <= 0xef) {
+        need  = 2;
+        value = (uint32_t)(lead & 0x0f);
+        lo    = lead == 0xe0 ? 0xa0 : lo;
+        hi    = lead == 0xed ? 0x9f : hi;
+    } else if (lead >= 0xf0 && lead <= 0xf4) {
+        need  = 3;
+        value = (uint32_t)(lead & 0x07);
+        lo    = lead == 0xf0 ? 0x90 : lo;
+        hi    = lead == 0xf4 ? 0x8f : hi;
+    } else {
+        *cp = AC_UTF8_BAD;
+        return 1;
+    }
+
+    for (size_t i = 1; i <= need; i++) {
+        if (i >= len || s[i] < lo || s[i] > hi) {
+            *cp = AC_UTF8_BAD;
+            return i;
+        }
+
+        value = (value << 6) | (uint32_t)(s[i] & 0x3f);
+        lo    = 0x80;
+        hi    = 0xbf;
+    }
+
+    *cp = value;
+    return need + 1;
+}
+
+#ifdef __SSSE3__
+/* Error classes of the lookup-table validator (Keiser and Lemire, "Validating
+   UTF-8 In Less Than One Instruction Per Byte"). Each table maps a nibble to
+   the classes it can take part in, so a byte pair is an error exactly when
+   the three lookups share a bit. */
+enum {
+    AC_UTF8_TOO_SHORT      = 1 << 0,
+    AC_UTF8_TOO_LONG       = 1 << 1,
+    AC_UTF8_OVERLONG_3     = 1 << 2,
+    AC_UTF8_TOO_LARGE      = 1 << 3,
+    AC_UTF8_SURROGATE      = 1 << 4,
+    AC_UTF8_OVERLONG_2     = 1 << 5,
+    AC_UTF8_TOO_LARGE_1000 = 1 << 6,
+    AC_UTF8_OVERLONG_4     = 1 << 6,
+    AC_UTF8_TWO_CONTS      = 1 << 7,
+    AC_UTF8_CARRY = AC_UTF8_TOO_SHORT | AC_UTF8_TOO_LONG | AC_UTF8_TWO_CONTS
+};
+
+/* Indexed by the high nibble of the previous byte. */
+static const uint8_t ac_utf8_byte1_high[16] = {
+    /* 0xxx: ASCII. */
+    AC_UTF8_TOO_LONG, AC_UTF8_TOO_LONG, AC_UTF8_TOO_LONG, AC_UTF8_TOO_LONG,
+    AC_UTF8_TOO_LONG, AC_UTF8_TOO_LONG, AC_UTF8_TOO_LONG, AC_UTF8_TOO_LONG,
+    /* 10xx: continuation. */
+    AC_UTF8_TWO_CONTS, AC_UTF8_TWO_CONTS, AC_UTF8_TWO_CONTS,
+    AC_UTF8_TWO_CONTS,
+    /* 1100, 1101: 2-byte lead. */
+    AC_UTF8_TOO_SHORT | AC_UTF8_OVERLONG_2, AC_UTF8_TOO_SHORT,
+    /* 1110: 3-byte lead. */
+    AC_UTF8_TOO_SHORT | AC_UTF8_OVERLONG_3 | AC_UTF8_SURROGATE,
+    /* 1111: 4-byte lead. */
+    AC_UTF8_TOO_SHORT | AC_UTF8_TOO_LARGE | AC_UTF8_TOO_LARGE_1000 |
+        AC_UTF8_OVERLONG_4,
+};
+
+/* Indexed by the low nibble of the previous byte. */
+static const uint8_t ac_utf8_byte1_low[16] = {
+    AC_UTF8_CARRY | AC_UTF8_OVERLONG_3 | AC_UTF8_OVERLONG_2 |
+        AC_UTF8_OVERLONG_4,
+    AC_UTF8_CARRY | AC_UTF8_OVERLONG_2,
+    AC_UTF8_CARRY,
+    AC_UTF8_CARRY,
+    AC_UTF8_CARRY | AC_UTF8_TOO_LARGE,
+    AC_UTF8_CARRY | AC_UTF8_TOO_LARGE | AC_UTF8_TOO_LARGE_1000,
+    AC_UTF8_CARRY | AC_UTF8_TOO_LARGE | AC_UTF8_TOO_LARGE_1000,
+    AC_UTF8_CARRY | AC_UTF8_TOO_LARGE | AC_UTF8_TOO_LARGE_1000,
+    AC_UTF8_CARRY | AC_UTF8_TOO_LARGE | AC_UTF8_TOO_LARGE_1000,
+    AC_UTF8_CARRY | AC_UTF8_TOO_LARGE | AC_UTF8_TOO_LARGE_1000,
+    AC_UTF8_CARRY | AC_UTF8_TOO_LARGE | AC_UTF8_TOO_LARGE_1000,
+    AC_UTF8_CARRY | AC_UTF8_TOO_LARGE | AC_UTF8_TOO_LARGE_1000,
+    AC_UTF8_CARRY | AC_UTF8_TOO_LARGE | AC_UTF8_TOO_LARGE_1000,
+    AC_UTF8_CARRY | AC_UTF8_TOO_LARGE | AC_UTF8_TOO_LARGE_1000 |
+        AC_UTF8_SURROGATE,
+    AC_UTF8_CARRY | AC_UTF8_TOO_LARGE | AC_UTF8_TOO_LARGE_1000,
+    AC_UTF8_CARRY | AC_UTF8_TOO_LARGE | AC_UTF8_TOO_LARGE_1000,
+};
+
+/* Indexed by the high nibble of the current byte. */
+static const uint8_t ac_utf8_byte2_high[16] = {
+    /* 0xxx: ASCII. */
+    AC_UTF8_TOO_SHORT, AC_UTF8_TOO_SHORT, AC_UTF8_TOO_SHORT,
+    AC_UTF8_TOO_SHORT, AC_UTF8_TOO_SHORT, AC_UTF8_TOO_SHORT,
+    AC_UTF8_TOO_SHORT, AC_UTF8_TOO_SHORT,
+    /* 1000 to 1011: continuation. */
+    AC_UTF8_TOO_LONG | AC_UTF8_OVERLONG_2 | AC_UTF8_TWO_CONTS |
+        AC_UTF8_OVERLONG_3 | AC_UTF8_TOO_LARGE_1000 | AC_UTF8_OVERLONG_4,
+    AC_UTF8_TOO_LONG | AC_UTF8_OVERLONG_2 | AC_UTF8_TWO_CONTS |
+        AC_UTF8_OVERLONG_3 | AC_UTF8_TOO_LARGE,
+    AC_UTF8_TOO_LONG | AC_UTF8_OVERLONG_2 | AC_UTF8_TWO_CONTS |
+        AC_UTF8_SURROGATE | AC_UTF8_TOO_LARGE,
+    AC_UTF8_TOO_LONG | AC_UTF8_OVERLONG_2 | AC_UTF8_TWO_CONTS |
+        AC_UTF8_SURROGATE | AC_UTF8_TOO_LARGE,
+    /* 11xx: lead. */
+    AC_UTF8_TOO_SHORT, AC_UTF8_TOO_SHORT, AC_UTF8_TOO_SHORT,
+    AC_UTF8_TOO_SHORT,
+};
+
+static inline __m128i ac_utf8_table(const uint8_t table[16]) {
+    return _mm_loadu_si128((const __m128i *)(const void *)table);
+}
+
+static inline __m128i ac_utf8_high_nibbles(__m128i v) {
+    return _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0f));
+}
+
+/** @brief Error bits of a block given the block before it. */
+static __m128i ac_utf8_block_errors(__m128i in, __m128i prev) {
+    __m128i prev1 = _mm_alignr_epi8(in, prev, 15);
+
+    /* Errors decidable from two consecutive bytes. */
+    __m128i special = _mm_and_si128(
+        _mm_and_si128(_mm_shuffle_epi8(ac_utf8_table(ac_utf8_byte1_high),
+                                       ac_utf8_high_nibbles(prev1)),
+                      _mm_shuffle_epi8(ac_utf8_table(ac_utf8_byte1_low),
+                                       _mm_and_si128(prev1,
+                                                     _mm_set1_epi8(0x0f)))),
+        _mm_shuffle_epi8(ac_utf8_table(ac_utf8_byte2_high),
+                         ac_utf8_high_nibbles(in)));
+
+    /* A continuation after a continuation must be the third or fourth byte
+       of a sequence whose lead is two or three bytes back. */
+    __m128i third  = _mm_subs_epu8(_mm_alignr_epi8(in, prev, 14),
+                                   _mm_set1_epi8(0xe0 - 0x80));
+    __m128i fourth = _mm_subs_epu8(_mm_alignr_epi8(in, prev, 13),
+                                   _mm_set1_epi8(0xf0 - 0x80));
+    __m128i must_be_cont =
+        _mm_and_si128(_mm_or_si128(third, fourth), _mm_set1_epi8(-0x80));
+
+    return _mm_xor_si128(must_be_cont, special);
+}
+#endif
+
+bool ac_utf8_valid(const char *data, size_t len) {
+    size_t i = 0;
+
+#ifdef __SSSE3__
+    /* Bytes at the end of a block that still expect continuations. */
+    const __m128i incomplete_max = _mm_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        (char)(0xf0 - 1), (char)(0xe0 - 1), (char)(0xc0 - 1));
+
+    __m128i prev       = _mm_setzero_si128();
+    __m128i error      = _mm_setzero_si128();
+    __m128i incomplete = _mm_setzero_si128();
+
+    for (; i < len; i += 16) {
+        __m128i v;
+
+        if (i + 16 <= len) {
+            v = _mm_loadu_si128((const __m128i *)(const void *)(data + i));
+        } else {
+            /* Zero padding is ASCII, so a truncated sequence still fails. */
+            char tail[16] = {0};
+            memcpy(tail, data + i, len - i);
+            v = _mm_loadu_si128((const __m128i *)(const void *)tail);
+        }
+
+        if (!_mm_movemask_epi8(v)) {
+            error = _mm_or_si128(error, incomplete);
+        } else {
+            error      = _mm_or_si128(error, ac_utf8_block_errors(v, prev));
+            incomplete = _mm_subs_epu8(v, incomplete_max);
+        }
+        prev = v;
+    }
+
+    error = _mm_or_si128(error, incomplete);
+
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) ==
+           0xffff;
+#else
+    while (i < len) {
+        size_t end = len;
+
+#ifdef __SSE2__
+        if (i + 16 <= len) {
+            __m128i v =
+                _mm_loadu_si128((const __m128i *)(const void *)(data + i));
+
+            if (!_mm_movemask_epi8(v)) {
+                i += 16;
+                continue;
+            }
+
+            /* Decode up to the end of the block, then look for ASCII
+               again. */
+            end = i + 16;
+        }
+#endif
+
+        while (i < end) {
+            uint32_t cp;
+            i += ac_utf8_decode(data + i, len - i, &cp);
+
+            if (cp == AC_UTF8_BAD) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+#endif
+}
+
+size_t ac_utf8_sanitize(char *data, size_t len, ac_utf8_policy_t policy) {
+    if (policy == AC_UTF8_REJECT && !ac_utf8_valid(data, len)) {
+        return AC_UTF8_INVALID;
+    }
+
+    size_t r = 0, w = 0;
+
+    while (r < len) {
+        size_t end = len;
+
+#ifdef __SSE2__
+        if (r + 16 <= len) {
+            /* Signed compares: bytes from 0x80 up are negative and fail
+               the first. */
+            __m128i v =
+                _mm_loadu_si128((const __m128i *)(const void *)(data + r));
+            uint32_t keep = (uint32_t)_mm_movemask_epi8(
+                _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(0x1f)),
+                              _mm_cmplt_epi8(v, _mm_set1_epi8(0x7f))));
+
+            if (keep == 0xffff) {
+                /* Nothing to drop. Only move the block if something
+                   before it was dropped; W never passes R, so the store
+                   cannot clobber unread bytes. */
+                if (w != r) {
+                    _mm_storeu_si128((__m128i *)(void *)(data + w), v);
+                }
+                w += 16;
+                r += 16;
+                continue;
+            }
+
+            if (!_mm_movemask_epi8(v)) {
+                /* ASCII with control characters. */
+                for (; keep; keep &= keep - 1) {
+                    data[w++] = data[r + ac_ctz(keep)];
+                }
+                r += 16;
+                continue;
+            }
+
+            /* Decode up to the end of the block, then look for ASCII
+               again. */
+            end = r + 16;
+        }
+#endif
+
+        while (r < end) {
+            uint32_t cp;
+            size_t n = ac_utf8_decode(data + r, len - r, &cp);
+
+            if (cp == AC_UTF8_BAD) {
+                data[w++] = '?';
+            } else if (cp >= 0x20 && cp != 0x7f && (cp < 0x80 || cp >= 0xa0)) {
+                for (size_t k = 0; k < n; k++) {
+                    data[w++] = data[r + k];
+                }
+            }
+
+            r += n;
+        }
+    }
+
+    return w;
+}
+
+/* Non-ASCII code points not allowed in names, sorted by start. */
+static const struct {
+    uint32_t first, last;
+} ac_utf8_name_excluded[] = {
+    {0x0080, 0x00bf},    /* C1 controls, Latin-1 punctuation and symbols */
+    {0x00d7, 0x00d7},    /* Multiplication sign */
+    {0x00f7, 0x00f7},    /* Division sign */
+    {0x0300, 0x036f},    /* Combining diacritics */
+    {0x037e, 0x037e},    /* Greek question mark */
+    {0x0387, 0x0387},    /* Greek ano teleia */
+    {0x0483, 0x0489},    /* Combining Cyrillic marks */
+    {0x0600, 0x0605},    /* Arabic number signs */
+    {0x061c, 0x061c},    /* Arabic letter mark */
+    {0x06dd, 0x06dd},    /* Arabic end of ayah */
+    {0x070f, 0x070f},    /* Syriac abbreviation mark */
+    {0x0890, 0x0891},    /* Arabic currency marks above */
+    {0x08e2, 0x08e2},    /* Arabic disputed end of ayah */
+    {0x115f, 0x1160},    /* Hangul choseong and jungseong fillers */
+    {0x1680, 0x1680},    /* Ogham space mark */
+    {0x17b4, 0x17b5},    /* Khmer inherent vowels */
+    {0x180b, 0x180f},    /* Mongolian variation selectors and separator */
+    {0x1ab0, 0x1aff},    /* Combining diacritics extended */
+    {0x1dc0, 0x1dff},    /* Combining diacritics supplement */
+    {0x2000, 0x2bff},    /* Punctuation, format characters and symbols */
+    {0x2e00, 0x2e7f},    /* Supplemental punctuation */
+    {0x3000, 0x303f},    /* CJK symbols and punctuation */
+    {0x3164, 0x3164},    /* Hangul filler */
+    {0xd800, 0xf8ff},    /* Surrogates and private use */
+    {0xfe00, 0xfe6f},    /* Variation selectors and punctuation forms */
+    {0xfeff, 0xfeff},    /* Byte order mark */
+    {0xff00, 0xffff},    /* Fullwidth forms and specials */
+    {0x110bd, 0x110bd},  /* Kaithi number sign */
+    {0x110cd, 0x110cd},  /* Kaithi number sign above */
+    {0x13430, 0x1343f},  /* Egyptian hieroglyph format controls */
+    {0x1bca0, 0x1bca3},  /* Shorthand format controls */
+    {0x1d000, 0x1d24f},  /* Musical symbols and their format controls */
+    {0x1d400, 0x1d7ff},  /* Mathematical alphanumerics */
+    {0x1f000, 0x1faff},  /* Emoji and pictographs */
+    {0xe0000, 0x10ffff}, /* Tags and private use */
+};
+
+bool ac_utf8_name_char(uint32_t cp) {
+    if (cp < 0x80) {
+        return (cp >= 'a' && cp <= 'z') || (cp >= 'A' && cp <= 'Z') ||
+               (cp >= '0' && cp <= '9') || cp == '_';
+    }
+
+    size_t lo = 0,
+           hi = sizeof(ac_utf8_name_excluded) / sizeof(*ac_utf8_name_excluded);
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (cp < ac_utf8_name_excluded[mid].first) {
+            hi = mid;
+        } else if (cp > ac_utf8_name_excluded[mid].last) {
+            lo = mid + 1;
+        } else {
+            return false;
+        }
+    }
+
+    return true;
 }
 
 bool ac_string_eq_ignore_case(const ac_string_t a, const ac_string_t b) {
@@ -0,0 +1,85 @@
+#include <ac/token.h>
+
+#include <errno.h>
+#include <sys/random.h>
+
+bool ac_token_new(ac_token_t *token) {
+    uint64_t bits[2];
+    size_t got = 0;
+
+    while (got < sizeof bits) {
+        ssize_t n = getrandom((char *)bits + got, sizeof bits - got, 0);
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            *token = AC_TOKEN_NONE;
+            return false;
+        }
+        got += (size_t)n;
+    }
+
+    token->hi = bits[0];
+    token->lo = bits[1];
+
+    /* Vanishingly unlikely, but zero means no token. */
+    if (ac_token_none(*token)) {
+        token->lo = 1;
+    }
+    return true;
+}
+
+bool ac_token_none(ac_token_t token) {
+    return (token.hi | token.lo) == 0;
+}
+
+void ac_token_format(ac_token_t token, char *out) {
+    static const char digits[] = "0123456789abcdef";
+
+    for (size_t i = 0; i < 16; i++) {
+        out[i]      = digits[(token.hi >> (60 - 4 * i)) & 0xF];
+        out[16 + i] = digits[(token.lo >> (60 - 4 * i)) & 0xF];
+    }
+}
+
+static int ac_token_digit(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+bool ac_token_parse(ac_str_view_t text, ac_token_t *token) {
+    if (text.len != AC_TOKEN_HEX) {
+        return false;
+    }
+
+    uint64_t half[2] = {0, 0};
+
+    for (size_t i = 0; i < AC_TOKEN_HEX; i++) {
+        int digit = ac_token_digit(text.data[i]);
+        if (digit < 0) {
+            return false;
+        }
+        half[i / 16] = half[i / 16] << 4 | (uint64_t)digit;
+    }
+
+    token->hi = half[0];
+    token->lo = half[1];
+    return !ac_token_none(*token);
+}
+
+uint64_t ac_token_hash(const ac_token_t *token) {
+    return token->hi ^ token->lo;
+}
+
+bool ac_token_eq(const ac_token_t *a, const ac_token_t *b) {
+    return a->hi == b->hi && a->lo == b->lo;
+}
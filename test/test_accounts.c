@@ -0,0 +1,137 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <unity.h>
+#include <ac/str.h>
+#include <ac/log.h>
+#include <ac/accounts.h>
+
+static char path[64];
+static ac_accounts_t accounts;
+
+static ac_str_view_t view(const char *str) {
+    ac_str_view_t v = {str, strlen(str)};
+    return v;
+}
+
+static ac_account_t account(const char *name, unsigned char tag) {
+    ac_account_t a;
+    memset(&a, 0, sizeof a);
+
+    a.name_len   = (uint8_t)strlen(name);
+    a.iterations = 1000;
+    a.created_ms = 42;
+    memcpy(a.name, name, a.name_len);
+    memset(a.salt, tag, sizeof a.salt);
+    memset(a.hash, tag, sizeof a.hash);
+    return a;
+}
+
+/* Add an account, waiting out a full store while it is grown. */
+static ac_accounts_status_t add(const ac_account_t *a) {
+    ac_accounts_status_t status;
+
+    while ((status = ac_accounts_add(&accounts, a)) == AC_ACCOUNTS_FULL) {
+        usleep(1000);
+        ac_accounts_poll(&accounts);
+    }
+    return status;
+}
+
+void setUp(void) {
+    strcpy(path, "/tmp/ac_accounts_XXXXXX");
+    close(mkstemp(path));
+    unlink(path);
+
+    TEST_ASSERT_TRUE(ac_accounts_open(&accounts, path));
+}
+
+void tearDown(void) {
+    ac_accounts_close(&accounts);
+    unlink(path);
+}
+
+void test_accounts_add_and_find(void) {
+    ac_account_t alice = account("alice", 1);
+
+    TEST_ASSERT_NULL(ac_accounts_find(&accounts, view("alice")));
+    TEST_ASSERT_EQUAL_INT(AC_ACCOUNTS_ADDED,
+                          ac_accounts_add(&accounts, &alice));
+    TEST_ASSERT_EQUAL_INT(AC_ACCOUNTS_EXISTS,
+                          ac_accounts_add(&accounts, &alice));
+
+    const ac_account_t *found = ac_accounts_find(&accounts, view("alice"));
+    TEST_ASSERT_NOT_NULL(found);
+    TEST_ASSERT_EQUAL_MEMORY(&alice, found, sizeof alice);
+
+    TEST_ASSERT_NULL(ac_accounts_find(&accounts, view("Alice")));
+    TEST_ASSERT_NULL(ac_accounts_find(&accounts, view("alic")));
+    TEST_ASSERT_EQUAL_size_t(1, ac_accounts_len(&accounts));
+}
+
+void test_accounts_persist_across_reopen(void) {
+    ac_account_t bob = account("bob", 2);
+    ac_accounts_add(&accounts, &bob);
+
+    ac_accounts_close(&accounts);
+    TEST_ASSERT_FALSE(ac_accounts_enabled(&accounts));
+    TEST_ASSERT_TRUE(ac_accounts_open(&accounts, path));
+
+    const ac_account_t *found = ac_accounts_find(&accounts, view("bob"));
+    TEST_ASSERT_NOT_NULL(found);
+    TEST_ASSERT_EQUAL_MEMORY(&bob, found, sizeof bob);
+}
+
+void test_accounts_grow_keeps_every_account(void) {
+    char name[32];
+    size_t count = 3 * AC_ACCOUNTS_SLOTS;
+
+    for (size_t i = 0; i < count; i++) {
+        snprintf(name, sizeof name, "user%zu", i);
+        ac_account_t a = account(name, (unsigned char)i);
+        TEST_ASSERT_EQUAL_INT(AC_ACCOUNTS_ADDED, add(&a));
+        ac_accounts_poll(&accounts);
+    }
+
+    /* The last grow may still be running. */
+    while (accounts.hdr->slots < 4 * AC_ACCOUNTS_SLOTS) {
+        usleep(1000);
+        ac_accounts_poll(&accounts);
+    }
+
+    ac_accounts_close(&accounts);
+    TEST_ASSERT_TRUE(ac_accounts_open(&accounts, path));
+    TEST_ASSERT_EQUAL_size_t(count, ac_accounts_len(&accounts));
+
+    for (size_t i = 0; i < count; i++) {
+        snprintf(name, sizeof name, "user%zu", i);
+        const ac_account_t *found = ac_accounts_find(&accounts, view(name));
+        TEST_ASSERT_NOT_NULL(found);
+        TEST_ASSERT_EQUAL_UINT8((unsigned char)i, found->hash[0]);
+    }
+}
+
+void test_accounts_refuse_a_foreign_file(void) {
+    ac_accounts_t other;
+    char foreign[] = "/tmp/ac_accounts_XXXXXX";
+    int fd         = mkstemp(foreign);
+
+    TEST_ASSERT_EQUAL_INT(5, (int)write(fd, "hello", 5));
+    close(fd);
+
+    TEST_ASSERT_FALSE(ac_accounts_open(&other, foreign));
+    TEST_ASSERT_FALSE(ac_accounts_enabled(&other));
+
+    /* Left as it was. */
+    FILE *f = fopen(foreign, "rb");
+    char buf[8] = {0};
+    TEST_ASSERT_EQUAL_size_t(5, fread(buf, 1, sizeof buf, f));
+    fclose(f);
+    TEST_ASSERT_EQUAL_STRING("hello", buf);
+
+    unlink(foreign);
+}
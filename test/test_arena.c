@@ -0,0 +1,113 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include <unity.h>
+#include <ac/meta.h>
+#include <ac/arena.h>
+
+static ac_arena_t arena;
+
+static uint64_t int_hash(const int *key) {
+    return (uint64_t)(*key);
+}
+
+static bool int_eq(const int *a, const int *b) {
+    return *a == *b;
+}
+
+void setUp(void) {
+    ac_arena_new(&arena, 256);
+}
+
+void tearDown(void) {
+    ac_arena_free(&arena);
+}
+
+void test_arena_allocations_are_aligned(void) {
+    for (size_t size = 1; size < 40; size++) {
+        void *p = ac_arena_alloc(&arena, size);
+        TEST_ASSERT_EQUAL_INT(0, (int)((uintptr_t)p % AC_ARENA_ALIGN));
+    }
+}
+
+void test_arena_reset_reuses_memory(void) {
+    void *first = ac_arena_alloc(&arena, 64);
+    ac_arena_reset(&arena);
+    void *second = ac_arena_alloc(&arena, 64);
+    TEST_ASSERT_EQUAL_PTR(first, second);
+}
+
+void test_arena_grows_last_allocation_in_place(void) {
+    ac_bytes_t a;
+    ac_arr_new_reserve_a(a, 8, &arena.allocator);
+    unsigned char *before = a;
+
+    for (unsigned char i = 0; i < 64; i++) {
+        ac_arr_append(a, i);
+    }
+
+    TEST_ASSERT_EQUAL_PTR(before, a);
+    TEST_ASSERT_EQUAL_INT(64, ac_alen(a));
+    for (unsigned char i = 0; i < 64; i++) {
+        TEST_ASSERT_EQUAL_INT(i, a[i]);
+    }
+}
+
+void test_arena_free_of_last_allocation_is_reused(void) {
+    ac_bytes_t a;
+    ac_arr_new_reserve_a(a, 32, &arena.allocator);
+    unsigned char *before = a;
+    ac_arr_free(a);
+
+    ac_bytes_t b;
+    ac_arr_new_reserve_a(b, 32, &arena.allocator);
+    TEST_ASSERT_EQUAL_PTR(before, b);
+}
+
+void test_arena_data_survives_chunk_growth(void) {
+    /* Interleave two arrays so neither can grow in place, then outgrow the
+       initial chunk several times. */
+    ac_ints_t a, b;
+    ac_arr_new_a(a, &arena.allocator);
+    ac_arr_new_a(b, &arena.allocator);
+
+    for (int i = 0; i < 1000; i++) {
+        ac_arr_append(a, i);
+        int neg = -i;
+        ac_arr_append(b, neg);
+    }
+
+    for (int i = 0; i < 1000; i++) {
+        TEST_ASSERT_EQUAL_INT(i, a[i]);
+        TEST_ASSERT_EQUAL_INT(-i, b[i]);
+    }
+
+    ac_arena_reset(&arena);
+    TEST_ASSERT_NULL(arena.retired);
+}
+
+void test_arena_backed_map(void) {
+    ac_map(int, int) map;
+    ac_map_new_a(map, &arena.allocator);
+
+    for (int i = 0; i < 500; i++) {
+        ac_map_set(map, int_hash, int_eq, i, i);
+    }
+    for (int i = 0; i < 500; i++) {
+        int *val;
+        ac_map_get(map, int_hash, int_eq, i, val);
+        TEST_ASSERT_EQUAL_INT(i, *val);
+    }
+
+    ac_map_free(map);
+}
+
+void test_heap_array_has_null_allocator(void) {
+    ac_bytes_t a;
+    ac_arr_new(a);
+    TEST_ASSERT_NULL(ac_aalloc(a));
+    ac_arr_free(a);
+}
@@ -0,0 +1,122 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include <unity.h>
+#include <ac/meta.h>
+#include <ac/kdf.h>
+#include <ac/log.h>
+#include <ac/accounts.h>
+#include <ac/auth.h>
+
+#define ITERATIONS 1000
+
+static ac_auth_t auth;
+
+static ac_auth_job_t job(ac_auth_op_t op, uint64_t ticket,
+                         const char *password) {
+    ac_auth_job_t j;
+    memset(&j, 0, sizeof j);
+
+    j.op           = op;
+    j.owner        = 7;
+    j.ticket       = ticket;
+    j.iterations   = ITERATIONS;
+    j.password_len = strlen(password);
+    memcpy(j.password, password, j.password_len);
+    return j;
+}
+
+/** @brief Wait for COUNT results. */
+static void wait_for(ac_auth_result_t *results, size_t count) {
+    size_t got = 0;
+
+    while (got < count) {
+        got += ac_auth_poll(&auth, results + got, count - got);
+        if (got < count) {
+            usleep(1000);
+        }
+    }
+}
+
+void setUp(void) {
+    TEST_ASSERT_TRUE(ac_auth_new(&auth, 3));
+}
+
+void tearDown(void) {
+    ac_auth_free(&auth);
+}
+
+void test_auth_derives_then_verifies(void) {
+    ac_auth_job_t j = job(AC_AUTH_DERIVE, 1, "hunter22");
+    ac_auth_result_t derived;
+
+    TEST_ASSERT_TRUE(ac_auth_submit(&auth, &j));
+    /* The caller's copy of the password is wiped. */
+    TEST_ASSERT_EQUAL_INT(0, j.password[0]);
+
+    wait_for(&derived, 1);
+    TEST_ASSERT_TRUE(derived.ok);
+    TEST_ASSERT_EQUAL_INT(AC_AUTH_DERIVE, derived.op);
+    TEST_ASSERT_TRUE(derived.owner == 7 && derived.ticket == 1);
+
+    unsigned char expected[AC_SHA256_LEN];
+    ac_pbkdf2_sha256("hunter22", 8, derived.salt, sizeof derived.salt,
+                     ITERATIONS, expected, sizeof expected);
+    TEST_ASSERT_EQUAL_MEMORY(expected, derived.hash, sizeof expected);
+
+    ac_auth_result_t checked[2];
+    ac_auth_job_t right = job(AC_AUTH_VERIFY, 2, "hunter22");
+    ac_auth_job_t wrong = job(AC_AUTH_VERIFY, 3, "hunter23");
+
+    memcpy(right.salt, derived.salt, sizeof right.salt);
+    memcpy(right.hash, derived.hash, sizeof right.hash);
+    memcpy(wrong.salt, derived.salt, sizeof wrong.salt);
+    memcpy(wrong.hash, derived.hash, sizeof wrong.hash);
+
+    TEST_ASSERT_TRUE(ac_auth_submit(&auth, &right));
+    TEST_ASSERT_TRUE(ac_auth_submit(&auth, &wrong));
+    wait_for(checked, 2);
+
+    for (size_t i = 0; i < 2; i++) {
+        TEST_ASSERT_EQUAL_INT(AC_AUTH_VERIFY, checked[i].op);
+        TEST_ASSERT_TRUE(checked[i].ok == (checked[i].ticket == 2));
+    }
+}
+
+void test_auth_bounds_jobs_in_flight(void) {
+    ac_auth_result_t results[AC_AUTH_QUEUE_MAX];
+
+    for (uint64_t i = 0; i < AC_AUTH_QUEUE_MAX; i++) {
+        ac_auth_job_t j = job(AC_AUTH_DERIVE, i, "pw");
+        TEST_ASSERT_TRUE(ac_auth_submit(&auth, &j));
+    }
+
+    ac_auth_job_t extra = job(AC_AUTH_DERIVE, 999, "pw");
+    TEST_ASSERT_FALSE(ac_auth_submit(&auth, &extra));
+    TEST_ASSERT_EQUAL_INT(0, extra.password[0]);
+
+    wait_for(results, AC_AUTH_QUEUE_MAX);
+    TEST_ASSERT_EQUAL_size_t(0, auth.in_flight);
+
+    /* Every job answered once. */
+    uint64_t seen = 0;
+    for (size_t i = 0; i < AC_AUTH_QUEUE_MAX; i++) {
+        TEST_ASSERT_TRUE(results[i].ok);
+        seen |= 1ull << results[i].ticket;
+    }
+    TEST_ASSERT_TRUE(seen == UINT64_MAX);
+}
+
+void test_auth_stopped_pool_turns_jobs_away(void) {
+    ac_auth_free(&auth);
+
+    ac_auth_job_t j = job(AC_AUTH_DERIVE, 1, "hunter22");
+    TEST_ASSERT_FALSE(ac_auth_submit(&auth, &j));
+    TEST_ASSERT_EQUAL_INT(0, j.password[0]);
+
+    ac_auth_result_t result;
+    TEST_ASSERT_EQUAL_size_t(0, ac_auth_poll(&auth, &result, 1));
+}
@@ -0,0 +1,204 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include <unity.h>
+#include <ac/meta.h>
+#include <ac/cmap.h>
+
+static uint64_t int_hash(const int *key) {
+    return (uint64_t)*key;
+}
+
+static bool int_eq(const int *a, const int *b) {
+    return *a == *b;
+}
+
+AC_CMAP_DECLARE(int_cmap, int, int, int_hash, int_eq);
+AC_CMAP_DEFINE(int_cmap, int, int, int_hash, int_eq);
+
+static int_cmap_t map;
+
+void setUp(void) {
+    int_cmap_new(&map);
+}
+
+void tearDown(void) {
+    int_cmap_free(&map);
+}
+
+void test_cmap_set_get_remove(void) {
+    TEST_ASSERT_TRUE(int_cmap_set(&map, 1, 10));
+    TEST_ASSERT_TRUE(int_cmap_set(&map, 2, 20));
+    TEST_ASSERT_FALSE(int_cmap_set(&map, 1, 11));
+    TEST_ASSERT_EQUAL_INT(2, (int)int_cmap_len(&map));
+
+    int val;
+    TEST_ASSERT_TRUE(int_cmap_get(&map, 1, &val));
+    TEST_ASSERT_EQUAL_INT(11, val);
+
+    TEST_ASSERT_TRUE(int_cmap_remove(&map, 1));
+    TEST_ASSERT_FALSE(int_cmap_remove(&map, 1));
+    TEST_ASSERT_FALSE(int_cmap_contains(&map, 1));
+    TEST_ASSERT_TRUE(int_cmap_contains(&map, 2));
+    TEST_ASSERT_EQUAL_INT(1, (int)int_cmap_len(&map));
+}
+
+void test_cmap_many_keys(void) {
+    for (int i = 0; i < 5000; i++) {
+        int_cmap_set(&map, i, i * 3);
+    }
+    TEST_ASSERT_EQUAL_INT(5000, (int)int_cmap_len(&map));
+
+    for (int i = 0; i < 5000; i++) {
+        int val = -1;
+        TEST_ASSERT_TRUE(int_cmap_get(&map, i, &val));
+        TEST_ASSERT_EQUAL_INT(i * 3, val);
+    }
+    TEST_ASSERT_FALSE(int_cmap_contains(&map, 5000));
+
+    for (int i = 0; i < 5000; i += 2) {
+        int_cmap_remove(&map, i);
+    }
+    for (int i = 0; i < 5000; i++) {
+        TEST_ASSERT_EQUAL_INT(i % 2 == 1, int_cmap_contains(&map, i));
+    }
+}
+
+static void sum_visitor(void *ctx, int key, int val) {
+    (void)key;
+    *(int *)ctx += val;
+}
+
+void test_cmap_visit(void) {
+    for (int i = 1; i <= 100; i++) {
+        int_cmap_set(&map, i, i);
+    }
+
+    int sum = 0;
+    int_cmap_visit(&map, sum_visitor, &sum);
+    TEST_ASSERT_EQUAL_INT(5050, sum);
+}
+
+/* Stress: writers churn their own key ranges while readers check that
+   every value they see belongs to its key and that keys that are never
+   removed are always found. */
+
+#define STRESS_STABLE  256
+#define STRESS_CHURN   1024
+#define STRESS_WRITERS 4
+#define STRESS_READERS 4
+#define STRESS_ROUNDS  20
+
+static bool stress_done;
+static size_t stress_errors;
+static size_t stress_reads;
+
+static void *stress_writer(void *arg) {
+    int base = STRESS_STABLE + (int)(intptr_t)arg * STRESS_CHURN;
+
+    for (int round = 0; round < STRESS_ROUNDS; round++) {
+        for (int i = 0; i < STRESS_CHURN; i++) {
+            int_cmap_set(&map, base + i, (base + i) * 3);
+        }
+        for (int i = 0; i < STRESS_CHURN; i++) {
+            int_cmap_remove(&map, base + i);
+        }
+    }
+
+    return NULL;
+}
+
+static void *stress_reader(void *arg) {
+    unsigned seed = (unsigned)(uintptr_t)arg + 1;
+    size_t errors = 0, reads = 0;
+    int limit     = STRESS_STABLE + STRESS_WRITERS * STRESS_CHURN;
+
+    while (!__atomic_load_n(&stress_done, __ATOMIC_ACQUIRE)) {
+        seed    = seed * 1103515245u + 12345u;
+        int key = (int)((seed >> 8) % (unsigned)limit);
+        int val = -1;
+
+        bool found = int_cmap_get(&map, key, &val);
+
+        if ((found && val != key * 3) || (key < STRESS_STABLE && !found)) {
+            errors++;
+        }
+        reads++;
+    }
+
+    __atomic_add_fetch(&stress_errors, errors, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stress_reads, reads, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+void test_cmap_concurrent_readers_and_writers(void) {
+    for (int i = 0; i < STRESS_STABLE; i++) {
+        int_cmap_set(&map, i, i * 3);
+    }
+
+    stress_done   = false;
+    stress_errors = 0;
+    stress_reads  = 0;
+
+    pthread_t readers[STRESS_READERS], writers[STRESS_WRITERS];
+
+    for (intptr_t i = 0; i < STRESS_READERS; i++) {
+        pthread_create(&readers[i], NULL, stress_reader, (void *)i);
+    }
+    for (intptr_t i = 0; i < STRESS_WRITERS; i++) {
+        pthread_create(&writers[i], NULL, stress_writer, (void *)i);
+    }
+
+    for (int i = 0; i < STRESS_WRITERS; i++) {
+        pthread_join(writers[i], NULL);
+    }
+    __atomic_store_n(&stress_done, true, __ATOMIC_RELEASE);
+    for (int i = 0; i < STRESS_READERS; i++) {
+        pthread_join(readers[i], NULL);
+    }
+
+    TEST_ASSERT_EQUAL_INT(0, (int)stress_errors);
+    TEST_ASSERT_TRUE(stress_reads > 0);
+    TEST_ASSERT_EQUAL_INT(STRESS_STABLE, (int)int_cmap_len(&map));
+}
+
+static void *stress_same_keys(void *arg) {
+    int offset = (int)(intptr_t)arg;
+
+    for (int round = 0; round < STRESS_ROUNDS * 10; round++) {
+        for (int i = 0; i < 64; i++) {
+            int_cmap_set(&map, i, i * 3);
+            if ((i + offset) % 2) {
+                int_cmap_remove(&map, i);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+void test_cmap_writers_contend_on_same_keys(void) {
+    pthread_t writers[STRESS_WRITERS];
+
+    for (intptr_t i = 0; i < STRESS_WRITERS; i++) {
+        pthread_create(&writers[i], NULL, stress_same_keys, (void *)i);
+    }
+    for (int i = 0; i < STRESS_WRITERS; i++) {
+        pthread_join(writers[i], NULL);
+    }
+
+    /* Every key ends up present or absent, and len agrees. */
+    int present = 0;
+    for (int i = 0; i < 64; i++) {
+        int val = -1;
+        if (int_cmap_get(&map, i, &val)) {
+            TEST_ASSERT_EQUAL_INT(i * 3, val);
+            present++;
+        }
+    }
+    TEST_ASSERT_EQUAL_INT(present, (int)int_cmap_len(&map));
+}
@@ -0,0 +1,180 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <unity.h>
+#include <ac/meta.h>
+#include <ac/str.h>
+#include <ac/filter.h>
+
+static ac_filter_t filter;
+static bool compiled;
+
+static ac_str_view_t view(const char *str) {
+    ac_str_view_t v = {str, strlen(str)};
+    return v;
+}
+
+static void compile(const char *text) {
+    size_t bad_line;
+    TEST_ASSERT_TRUE(
+        ac_filter_compile(&filter, text, strlen(text), &bad_line));
+    compiled = true;
+}
+
+static const char *mask(const char *line) {
+    static char buf[256];
+    size_t len = strlen(line);
+
+    ac_filter_mask(&filter, view(line), buf);
+    buf[len] = '\0';
+    return buf;
+}
+
+void setUp(void) {
+    compiled = false;
+}
+
+void tearDown(void) {
+    if (compiled) {
+        ac_filter_free(&filter);
+    }
+}
+
+void test_filter_finds_overlapping_patterns(void) {
+    compile("flag he\nflag she\ndrop his\nmask hers\n");
+
+    TEST_ASSERT_EQUAL_UINT(AC_FILTER_FLAG,
+                           ac_filter_scan(&filter, view("SHE")));
+    TEST_ASSERT_EQUAL_UINT(AC_FILTER_FLAG | AC_FILTER_MASK,
+                           ac_filter_scan(&filter, view("ushers")));
+    TEST_ASSERT_EQUAL_UINT(AC_FILTER_FLAG | AC_FILTER_DROP,
+                           ac_filter_scan(&filter, view("this here")));
+    TEST_ASSERT_EQUAL_UINT(0, ac_filter_scan(&filter, view("h e s i r")));
+}
+
+void test_filter_masks_only_masked_patterns(void) {
+    compile("# Comments and blank lines are skipped.\r\n"
+            "\r\n"
+            "  mask   darn  \r\n"
+            "mask arnold\r\n"
+            "flag hello\r\n");
+
+    TEST_ASSERT_EQUAL_STRING("hello ****, arn", mask("hello DaRn, arn"));
+    TEST_ASSERT_EQUAL_STRING("*******s", mask("darnolds"));
+    TEST_ASSERT_EQUAL_STRING("x******", mask("xarnold"));
+    TEST_ASSERT_EQUAL_STRING("nothing here", mask("nothing here"));
+}
+
+void test_filter_rejects_malformed_lines(void) {
+    const char *text = "mask ok\nblock nope\n";
+    size_t bad_line  = 0;
+
+    TEST_ASSERT_FALSE(
+        ac_filter_compile(&filter, text, strlen(text), &bad_line));
+    TEST_ASSERT_EQUAL_size_t(2, bad_line);
+
+    text = "drop\n";
+    TEST_ASSERT_FALSE(
+        ac_filter_compile(&filter, text, strlen(text), &bad_line));
+    TEST_ASSERT_EQUAL_size_t(1, bad_line);
+
+    ac_filter_new(&filter);
+    compiled = true;
+    TEST_ASSERT_EQUAL_UINT(0, ac_filter_scan(&filter, view("anything")));
+}
+
+void test_filter_agrees_with_naive_search(void) {
+    static char text[64 * 1024];
+    static char words[3000][8];
+    size_t len = 0;
+
+    srand(7);
+
+    for (size_t i = 0; i < 3000; i++) {
+        size_t word_len = 2 + (size_t)rand() % 5;
+        for (size_t j = 0; j < word_len; j++) {
+            words[i][j] = (char)('a' + rand() % 6);
+        }
+        words[i][word_len] = '\0';
+
+        len += (size_t)snprintf(text + len, sizeof text - len, "%s %s\n",
+                                i % 2 ? "flag" : "drop", words[i]);
+    }
+
+    compile(text);
+
+    for (int round = 0; round < 200; round++) {
+        char line[24];
+        size_t line_len = (size_t)rand() % (sizeof line - 1);
+
+        for (size_t j = 0; j < line_len; j++) {
+            line[j] = (char)('a' + rand() % 7);
+        }
+        line[line_len] = '\0';
+
+        unsigned expected = 0;
+        for (size_t i = 0; i < 3000; i++) {
+            if (strstr(line, words[i])) {
+                expected |= i % 2 ? AC_FILTER_FLAG : AC_FILTER_DROP;
+            }
+        }
+
+        TEST_ASSERT_EQUAL_UINT(expected, ac_filter_scan(&filter, view(line)));
+    }
+}
+
+void test_filter_watch_reloads_changed_file(void) {
+    char path[] = "/tmp/ac_filter_XXXXXX";
+    close(mkstemp(path));
+    unlink(path);
+
+    ac_filter_watch_t watch;
+    uint64_t now = 1;
+
+    TEST_ASSERT_EQUAL_INT(AC_FILTER_RELOADED,
+                          ac_filter_watch_new(&watch, path, now));
+    TEST_ASSERT_EQUAL_size_t(0, watch.active->patterns);
+
+    FILE *f = fopen(path, "w");
+    fputs("mask darn\ndrop spam\n", f);
+    fclose(f);
+
+    /* Not checked again until AC_FILTER_CHECK_MS passed. */
+    TEST_ASSERT_EQUAL_INT(AC_FILTER_UNCHANGED,
+                          ac_filter_watch_poll(&watch, now + 1));
+    TEST_ASSERT_FALSE(watch.loading);
+
+    now += AC_FILTER_CHECK_MS;
+    ac_filter_reload_t result;
+    while ((result = ac_filter_watch_poll(&watch, now)) ==
+           AC_FILTER_UNCHANGED) {
+        TEST_ASSERT_TRUE(watch.loading);
+        usleep(1000);
+    }
+
+    TEST_ASSERT_EQUAL_INT(AC_FILTER_RELOADED, result);
+    TEST_ASSERT_EQUAL_size_t(2, watch.active->patterns);
+
+    /* A broken file keeps the patterns in use. */
+    f = fopen(path, "w");
+    fputs("mask darn\nbad line\nflag x\n", f);
+    fclose(f);
+
+    now += AC_FILTER_CHECK_MS;
+    while ((result = ac_filter_watch_poll(&watch, now)) ==
+           AC_FILTER_UNCHANGED) {
+        usleep(1000);
+    }
+
+    TEST_ASSERT_EQUAL_INT(AC_FILTER_MALFORMED, result);
+    TEST_ASSERT_EQUAL_size_t(2, watch.bad_line);
+    TEST_ASSERT_EQUAL_size_t(2, watch.active->patterns);
+
+    ac_filter_watch_free(&watch);
+    unlink(path);
+}
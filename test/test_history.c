@@ -0,0 +1,118 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <unity.h>
+#include <ac/str.h>
+#include <ac/history.h>
+
+static char path[] = "/tmp/ac_history_XXXXXX";
+static ac_history_t history;
+
+static void add(const char *line) {
+    ac_str_view_t part = {line, strlen(line)};
+    ac_history_append(&history, &part, 1);
+}
+
+/* Copy a range out piece by piece, the way it is sent. */
+static const char *read_range(ac_history_range_t range) {
+    static char buf[1024];
+    size_t len = 0;
+    size_t piece;
+    const unsigned char *data;
+
+    while ((piece = ac_history_piece(&history, &range, &data)) > 0) {
+        TEST_ASSERT_TRUE(len + piece < sizeof buf);
+        memcpy(buf + len, data, piece);
+        len += piece;
+    }
+
+    buf[len] = '\0';
+    return buf;
+}
+
+void setUp(void) {
+    strcpy(path, "/tmp/ac_history_XXXXXX");
+    close(mkstemp(path));
+    TEST_ASSERT_TRUE(ac_history_open(&history, path, 4096));
+}
+
+void tearDown(void) {
+    ac_history_close(&history);
+    unlink(path);
+}
+
+void test_history_starts_empty(void) {
+    ac_history_range_t range = ac_history_lines(&history, 0, 10, SIZE_MAX);
+    TEST_ASSERT_TRUE(range.start == range.end);
+}
+
+void test_history_returns_newest_lines(void) {
+    add("one");
+    add("two");
+    add("three");
+
+    TEST_ASSERT_EQUAL_STRING(
+        "two\r\nthree\r\n",
+        read_range(ac_history_lines(&history, 0, 2, SIZE_MAX)));
+    TEST_ASSERT_EQUAL_STRING(
+        "one\r\ntwo\r\nthree\r\n",
+        read_range(ac_history_lines(&history, 0, 10, SIZE_MAX)));
+}
+
+void test_history_pages_back_and_caps_bytes(void) {
+    add("one");
+    add("two");
+    add("three");
+    add("four");
+
+    TEST_ASSERT_EQUAL_STRING(
+        "one\r\ntwo\r\n",
+        read_range(ac_history_lines(&history, 2, 2, SIZE_MAX)));
+    TEST_ASSERT_EQUAL_STRING(
+        "", read_range(ac_history_lines(&history, 4, 2, SIZE_MAX)));
+
+    /* "four\r\n" fits in 10 bytes, "three\r\nfour\r\n" does not. */
+    TEST_ASSERT_EQUAL_STRING("four\r\n",
+                             read_range(ac_history_lines(&history, 0, 4, 10)));
+}
+
+void test_history_wraps_and_drops_cut_lines(void) {
+    ac_history_close(&history);
+    TEST_ASSERT_TRUE(ac_history_open(&history, path, 64));
+
+    char line[16];
+    for (int i = 0; i < 41; i++) {
+        snprintf(line, sizeof line, "line %02d", i);
+        add(line);
+    }
+
+    /* The last 64 bytes start in the middle of line 33. */
+    TEST_ASSERT_EQUAL_STRING(
+        "line 34\r\nline 35\r\nline 36\r\nline 37\r\nline 38\r\n"
+        "line 39\r\nline 40\r\n",
+        read_range(ac_history_lines(&history, 0, 100, SIZE_MAX)));
+
+    /* Lines longer than a quarter of the ring are not kept. */
+    add("this line is far too long to keep");
+    TEST_ASSERT_EQUAL_STRING(
+        "line 40\r\n", read_range(ac_history_lines(&history, 0, 1, SIZE_MAX)));
+}
+
+void test_history_survives_reopening(void) {
+    add("kept");
+    ac_history_close(&history);
+
+    TEST_ASSERT_TRUE(ac_history_open(&history, path, 4096));
+    TEST_ASSERT_EQUAL_STRING(
+        "kept\r\n", read_range(ac_history_lines(&history, 0, 10, SIZE_MAX)));
+
+    /* A different capacity starts over. */
+    ac_history_close(&history);
+    TEST_ASSERT_TRUE(ac_history_open(&history, path, 8192));
+    TEST_ASSERT_EQUAL_STRING(
+        "", read_range(ac_history_lines(&history, 0, 10, SIZE_MAX)));
+}
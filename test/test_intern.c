@@ -0,0 +1,124 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <assert.h>
+
+#include <unity.h>
+#include <ac/meta.h>
+#include <ac/str.h>
+#include <ac/intern.h>
+
+void test_intern_equal_strings_share_atom(void) {
+    ac_atom_t a = ac_intern("alice", 5);
+    ac_atom_t b = ac_intern("alice", 5);
+    ac_atom_t c = ac_intern("alicf", 5);
+
+    TEST_ASSERT_TRUE(a != AC_ATOM_NONE);
+    TEST_ASSERT_TRUE(a == b);
+    TEST_ASSERT_TRUE(a != c);
+
+    ac_atom_release(a);
+    ac_atom_release(b);
+    ac_atom_release(c);
+}
+
+void test_intern_data_and_length(void) {
+    const char *long_name = "a_name_too_long_to_fit_inline";
+    ac_atom_t a = ac_intern("bob", 3);
+    ac_atom_t b = ac_intern(long_name, strlen(long_name));
+
+    TEST_ASSERT_EQUAL_INT(3, (int)ac_atom_len(a));
+    TEST_ASSERT_EQUAL_MEMORY("bob", ac_atom_data(a), 3);
+    TEST_ASSERT_EQUAL_INT((int)strlen(long_name), (int)ac_atom_len(b));
+    TEST_ASSERT_EQUAL_MEMORY(long_name, ac_atom_data(b), strlen(long_name));
+
+    ac_atom_release(a);
+    ac_atom_release(b);
+}
+
+void test_intern_empty_string_is_none(void) {
+    TEST_ASSERT_TRUE(ac_intern("", 0) == AC_ATOM_NONE);
+    TEST_ASSERT_EQUAL_INT(0, (int)ac_atom_len(AC_ATOM_NONE));
+
+    /* Releasing the empty atom is a no-op. */
+    ac_atom_release(AC_ATOM_NONE);
+    TEST_ASSERT_TRUE(ac_intern_find("", 0) == AC_ATOM_NONE);
+}
+
+void test_intern_find_does_not_insert(void) {
+    TEST_ASSERT_TRUE(ac_intern_find("carol", 5) == AC_ATOM_NONE);
+
+    ac_atom_t a = ac_intern("carol", 5);
+    TEST_ASSERT_TRUE(ac_intern_find("carol", 5) == a);
+
+    ac_atom_release(a);
+}
+
+void test_intern_released_when_unreferenced(void) {
+    ac_atom_t a = ac_intern("dave", 4);
+    ac_atom_retain(a);
+
+    ac_atom_release(a);
+    TEST_ASSERT_TRUE(ac_intern_find("dave", 4) == a);
+
+    ac_atom_release(a);
+    TEST_ASSERT_TRUE(ac_intern_find("dave", 4) == AC_ATOM_NONE);
+
+    /* The id is recycled for the next new string. */
+    ac_atom_t b = ac_intern("erin", 4);
+    TEST_ASSERT_TRUE(b == a);
+    ac_atom_release(b);
+}
+
+void test_intern_hash_is_precomputed_string_hash(void) {
+    ac_atom_t a = ac_intern("frank", 5);
+    TEST_ASSERT_TRUE(ac_atom_hash(&a) == ac_hash_bytes("frank", 5));
+    ac_atom_release(a);
+}
+
+void test_intern_many(void) {
+    ac_atom_t atoms[1000];
+    char buf[16];
+
+    for (int i = 0; i < 1000; i++) {
+        int len  = snprintf(buf, sizeof buf, "user_%d", i);
+        atoms[i] = ac_intern(buf, (size_t)len);
+    }
+
+    for (int i = 0; i < 1000; i++) {
+        int len = snprintf(buf, sizeof buf, "user_%d", i);
+        TEST_ASSERT_TRUE(ac_intern_find(buf, (size_t)len) == atoms[i]);
+        TEST_ASSERT_EQUAL_MEMORY(buf, ac_atom_data(atoms[i]), (size_t)len);
+    }
+
+    for (int i = 0; i < 1000; i++) {
+        ac_atom_release(atoms[i]);
+    }
+
+    TEST_ASSERT_TRUE(ac_intern_find("user_500", 8) == AC_ATOM_NONE);
+}
+
+void test_atom_as_map_key(void) {
+    ac_map(ac_atom_t, int) map;
+    ac_map_new(map);
+
+    const char *names[] = {"gina", "hank", "ivan", "judy"};
+    ac_atom_t atoms[4];
+    for (int i = 0; i < 4; i++) {
+        atoms[i] = ac_intern(names[i], strlen(names[i]));
+        ac_map_set(map, ac_atom_hash, ac_atom_eq, atoms[i], i);
+    }
+
+    ac_atom_t key = ac_intern_find("ivan", 4);
+
+    int *val;
+    ac_map_get(map, ac_atom_hash, ac_atom_eq, key, val);
+    TEST_ASSERT_EQUAL_INT(2, *val);
+
+    for (int i = 0; i < 4; i++) {
+        ac_atom_release(atoms[i]);
+    }
+    ac_map_free(map);
+}
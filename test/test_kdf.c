@@ -0,0 +1,75 @@
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include <unity.h>
+#include <ac/kdf.h>
+
+static const char *hex(const unsigned char *data, size_t len) {
+    static char buf[2 * 64 + 1];
+
+    for (size_t i = 0; i < len; i++) {
+        snprintf(buf + 2 * i, 3, "%02x", data[i]);
+    }
+    return buf;
+}
+
+void test_sha256_known_digests(void) {
+    unsigned char out[AC_SHA256_LEN];
+    ac_sha256_t ctx;
+
+    ac_sha256_init(&ctx);
+    ac_sha256_update(&ctx, "abc", 3);
+    ac_sha256_final(&ctx, out);
+    TEST_ASSERT_EQUAL_STRING(
+        "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",
+        hex(out, sizeof out));
+
+    /* Fed in uneven pieces across block boundaries. */
+    char a[1000];
+    memset(a, 'a', sizeof a);
+
+    ac_sha256_init(&ctx);
+    for (size_t pos = 0, step = 1; pos < sizeof a; pos += step, step += 7) {
+        size_t len = sizeof a - pos < step ? sizeof a - pos : step;
+        ac_sha256_update(&ctx, a + pos, len);
+    }
+    ac_sha256_final(&ctx, out);
+    TEST_ASSERT_EQUAL_STRING(
+        "41edece42d63e8d9bf515a9ba6932e1c20cbc9f5a5d134645adb5db1b9737ea3",
+        hex(out, sizeof out));
+}
+
+void test_pbkdf2_rfc7914_vectors(void) {
+    unsigned char out[64];
+
+    ac_pbkdf2_sha256("passwd", 6, "salt", 4, 1, out, sizeof out);
+    TEST_ASSERT_EQUAL_STRING(
+        "55ac046e56e3089fec1691c22544b605f94185216dde0465e68b9d57c20dacbc"
+        "49ca9cccf179b645991664b39d77ef317c71b845b1e30bd509112041d3a19783",
+        hex(out, sizeof out));
+
+    ac_pbkdf2_sha256("Password", 8, "NaCl", 4, 80000, out, sizeof out);
+    TEST_ASSERT_EQUAL_STRING(
+        "4ddcd8f60b98be21830cee5ef22701f9641a4418d04c0414aeff08876b34ab56"
+        "a1d425a1225833549adb841b51c9b3176a272bdebba1d078478f62b397f33c8d",
+        hex(out, sizeof out));
+}
+
+void test_pbkdf2_hashes_long_passwords_first(void) {
+    char password[100];
+    unsigned char out[20];
+
+    memset(password, 'k', sizeof password);
+    ac_pbkdf2_sha256(password, sizeof password, "", 0, 3, out, sizeof out);
+    TEST_ASSERT_EQUAL_STRING("593d3303be41b1ff04423a60798c560215814a1c",
+                             hex(out, sizeof out));
+}
+
+void test_kdf_equal(void) {
+    TEST_ASSERT_TRUE(ac_kdf_equal("abcd", "abcd", 4));
+    TEST_ASSERT_FALSE(ac_kdf_equal("abcd", "abce", 4));
+    TEST_ASSERT_FALSE(ac_kdf_equal("xbcd", "abcd", 4));
+    TEST_ASSERT_TRUE(ac_kdf_equal("", "", 0));
+}
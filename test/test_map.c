@@ -15,6 +15,9 @@ bool int_eq(const int *a, const int *b) {
     return *a == *b;
 }
 
+AC_MAP_DECLARE(int_map, int, int, int_hash, int_eq);
+AC_MAP_DEFINE(int_map, int, int, int_hash, int_eq);
+
 static ac_map(int, int) map;
 static int keys[5] = {1, 2, 3, 4, 5};
 static int vals[5] = {6, 7, 8, 9, 10};
@@ -81,4 +84,231 @@ void test_map_remove_keys(void) {
         ac_map_remove(map, int_hash, int_eq, keys[i]);
     }
     TEST_ASSERT_EQUAL_INT(0, map.len);
-}
\ No newline at end of file
+}
+void test_map_grows_past_initial_capacity(void) {
+    for (int i = 0; i < 1000; i++) {
+        int val = i * 2;
+        ac_map_set(map, int_hash, int_eq, i, val);
+    }
+    TEST_ASSERT_EQUAL_INT(1000, map.len);
+
+    for (int i = 0; i < 1000; i++) {
+        int *retrieved;
+        ac_map_get(map, int_hash, int_eq, i, retrieved);
+        TEST_ASSERT_EQUAL_INT(i * 2, *retrieved);
+    }
+}
+
+void test_map_set_replaces_existing_value(void) {
+    int key = 42, a = 1, b = 2;
+    ac_map_set(map, int_hash, int_eq, key, a);
+    ac_map_set(map, int_hash, int_eq, key, b);
+    TEST_ASSERT_EQUAL_INT(1, map.len);
+
+    int *retrieved;
+    ac_map_get(map, int_hash, int_eq, key, retrieved);
+    TEST_ASSERT_EQUAL_INT(2, *retrieved);
+}
+
+void test_map_remove_and_reinsert_churn(void) {
+    /* Repeated insert/remove cycles must not exhaust free slots. */
+    for (int round = 0; round < 100; round++) {
+        for (int i = 0; i < 20; i++) {
+            int key = round * 20 + i;
+            ac_map_set(map, int_hash, int_eq, key, i);
+        }
+        for (int i = 0; i < 20; i++) {
+            int key = round * 20 + i;
+            ac_map_remove(map, int_hash, int_eq, key);
+        }
+    }
+    TEST_ASSERT_EQUAL_INT(0, map.len);
+
+    bool exists;
+    int key = 5;
+    ac_map_contains(map, int_hash, int_eq, key, exists);
+    TEST_ASSERT_FALSE(exists);
+}
+
+void test_map_foreach_visits_each_entry_once(void) {
+    for (int i = 0; i < 100; i++) {
+        ac_map_set(map, int_hash, int_eq, i, i);
+    }
+    for (int i = 0; i < 100; i += 2) {
+        ac_map_remove(map, int_hash, int_eq, i);
+    }
+
+    int *key, *val;
+    int count = 0, sum = 0;
+    ac_map_foreach(map, key, val) {
+        TEST_ASSERT_EQUAL_INT(*key, *val);
+        count++;
+        sum += *key;
+    }
+    TEST_ASSERT_EQUAL_INT(50, count);
+    TEST_ASSERT_EQUAL_INT(2500, sum);
+}
+
+void test_map_remove_while_iterating(void) {
+    for (int i = 0; i < 40; i++) {
+        ac_map_set(map, int_hash, int_eq, i, i);
+    }
+
+    int *key, *val;
+    ac_map_foreach(map, key, val) {
+        ac_map_remove(map, int_hash, int_eq, *key);
+    }
+    TEST_ASSERT_EQUAL_INT(0, map.len);
+}
+
+void test_map_lookup_during_incremental_rehash(void) {
+    /* Fill past the first rehash so old and new tables coexist. */
+    int i = 0;
+    while (map.old_slots == NULL) {
+        ac_map_set(map, int_hash, int_eq, i, i);
+        i++;
+    }
+    TEST_ASSERT_TRUE(map.old_cap > 0);
+
+    for (int j = 0; j < i; j++) {
+        int *retrieved;
+        ac_map_get(map, int_hash, int_eq, j, retrieved);
+        TEST_ASSERT_EQUAL_INT(j, *retrieved);
+    }
+
+    int *key, *val;
+    int count = 0;
+    ac_map_foreach(map, key, val) {
+        count++;
+    }
+    TEST_ASSERT_EQUAL_INT(i, count);
+    TEST_ASSERT_EQUAL_INT(i, map.len);
+}
+
+void test_map_incremental_rehash_completes(void) {
+    for (int i = 0; i < 5000; i++) {
+        ac_map_set(map, int_hash, int_eq, i, i);
+    }
+    while (map.old_slots) {
+        ac_map_step(map, int_hash);
+    }
+    TEST_ASSERT_EQUAL_INT(5000, map.len);
+
+    for (int i = 0; i < 5000; i++) {
+        ac_map_remove(map, int_hash, int_eq, i);
+    }
+    TEST_ASSERT_EQUAL_INT(0, map.len);
+}
+
+void test_map_shrinks_when_enabled(void) {
+    ac_map_enable_shrink(map);
+    size_t min_cap = map.cap;
+
+    for (int i = 0; i < 5000; i++) {
+        ac_map_set(map, int_hash, int_eq, i, i);
+    }
+    size_t grown_cap = map.cap;
+    TEST_ASSERT_TRUE(grown_cap > min_cap);
+
+    for (int i = 10; i < 5000; i++) {
+        ac_map_remove(map, int_hash, int_eq, i);
+    }
+    for (int n = 0; n < 1000; n++) {
+        ac_map_step(map, int_hash);
+    }
+    TEST_ASSERT_TRUE(map.cap < grown_cap);
+    TEST_ASSERT_TRUE(map.cap >= min_cap);
+    TEST_ASSERT_EQUAL_INT(10, map.len);
+
+    for (int i = 0; i < 10; i++) {
+        int *retrieved;
+        ac_map_get(map, int_hash, int_eq, i, retrieved);
+        TEST_ASSERT_EQUAL_INT(i, *retrieved);
+    }
+}
+
+void test_map_does_not_shrink_by_default(void) {
+    for (int i = 0; i < 5000; i++) {
+        ac_map_set(map, int_hash, int_eq, i, i);
+    }
+    while (map.old_slots) {
+        ac_map_step(map, int_hash);
+    }
+    size_t grown_cap = map.cap;
+
+    for (int i = 0; i < 5000; i++) {
+        ac_map_remove(map, int_hash, int_eq, i);
+    }
+    ac_map_step(map, int_hash);
+    TEST_ASSERT_EQUAL_INT(grown_cap, map.cap);
+}
+
+void test_typed_map_set_get_remove(void) {
+    int_map_t typed;
+    int_map_new(&typed);
+
+    for (int i = 0; i < 5; i++) {
+        int_map_set(&typed, keys[i], vals[i]);
+    }
+    TEST_ASSERT_EQUAL_INT(5, typed.len);
+
+    for (int i = 0; i < 5; i++) {
+        int *retrieved = int_map_get(&typed, keys[i]);
+        TEST_ASSERT_NOT_NULL(retrieved);
+        TEST_ASSERT_EQUAL_INT(vals[i], *retrieved);
+    }
+
+    int_map_remove(&typed, keys[2]);
+    TEST_ASSERT_FALSE(int_map_contains(&typed, keys[2]));
+    TEST_ASSERT_NULL(int_map_get(&typed, keys[2]));
+    TEST_ASSERT_EQUAL_INT(4, typed.len);
+
+    int_map_free(&typed);
+}
+
+void test_typed_map_set_returns_value_slot(void) {
+    int_map_t typed;
+    int_map_new(&typed);
+
+    int *val = int_map_set(&typed, 7, 1);
+    *val += 1;
+    TEST_ASSERT_EQUAL_INT(2, *int_map_get(&typed, 7));
+
+    int_map_free(&typed);
+}
+
+void test_typed_map_grows_and_shrinks(void) {
+    int_map_t typed;
+    int_map_new(&typed);
+    ac_map_enable_shrink(typed);
+    size_t min_cap = typed.cap;
+
+    for (int i = 0; i < 5000; i++) {
+        int_map_set(&typed, i, -i);
+    }
+    size_t grown_cap = typed.cap;
+    TEST_ASSERT_TRUE(grown_cap > min_cap);
+
+    for (int i = 0; i < 5000; i++) {
+        TEST_ASSERT_EQUAL_INT(-i, *int_map_get(&typed, i));
+    }
+
+    for (int i = 10; i < 5000; i++) {
+        int_map_remove(&typed, i);
+    }
+    for (int n = 0; n < 1000; n++) {
+        int_map_step(&typed);
+    }
+    TEST_ASSERT_TRUE(typed.cap < grown_cap);
+    TEST_ASSERT_NULL(typed.old_slots);
+
+    int *key, *val;
+    int count = 0;
+    ac_map_foreach(typed, key, val) {
+        TEST_ASSERT_EQUAL_INT(-*key, *val);
+        count++;
+    }
+    TEST_ASSERT_EQUAL_INT(10, count);
+
+    int_map_free(&typed);
+}
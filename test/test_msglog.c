@@ -0,0 +1,337 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+#include <unity.h>
+#include <ac/meta.h>
+#include <ac/str.h>
+#include <ac/log.h>
+#include <ac/msglog.h>
+
+static char dir[] = "/tmp/ac_msglog_XXXXXX";
+
+static ac_msg_t msg(ac_msg_kind_t kind, const char *from, const char *to,
+                    const char *text) {
+    ac_msg_t m = {kind, 1700000000123ull, {from, strlen(from)},
+                  {to, strlen(to)}, {text, strlen(text)}};
+    return m;
+}
+
+static void segment_path(char *buf, size_t size, uint64_t segment) {
+    ac_msglog_segment_path(buf, size, dir, segment);
+}
+
+/* Read a whole file into a new array. */
+static ac_bytes_t slurp(const char *path) {
+    ac_bytes_t data;
+    ac_arr_new(data);
+
+    FILE *f = fopen(path, "rb");
+    TEST_ASSERT_NOT_NULL(f);
+
+    int c;
+    while ((c = fgetc(f)) != EOF) {
+        unsigned char byte = (unsigned char)c;
+        ac_arr_append(data, byte);
+    }
+
+    fclose(f);
+    return data;
+}
+
+static size_t count_records(const char *path) {
+    ac_bytes_t data = slurp(path);
+    TEST_ASSERT_TRUE(ac_msglog_segment_valid(data, ac_alen(data)));
+
+    size_t pos   = AC_MSGLOG_SEGMENT_HEADER;
+    size_t count = 0;
+    ac_msg_t m;
+
+    while (ac_msglog_decode(data, ac_alen(data), &pos, &m) == AC_MSGLOG_OK) {
+        count++;
+    }
+    TEST_ASSERT_EQUAL_size_t(ac_alen(data), pos);
+
+    ac_arr_free(data);
+    return count;
+}
+
+void setUp(void) {
+    strcpy(dir, "/tmp/ac_msglog_XXXXXX");
+    TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+}
+
+void tearDown(void) {
+    ac_arr(uint64_t) segments;
+
+    if (ac_msglog_segments(dir, &segments)) {
+        ac_arr_foreach(segments, i) {
+            char path[256];
+            segment_path(path, sizeof path, segments[i]);
+            unlink(path);
+        }
+        ac_arr_free(segments);
+    }
+
+    rmdir(dir);
+}
+
+void test_msglog_crc32c_check_value(void) {
+    TEST_ASSERT_EQUAL_HEX32(0xE3069283, ac_crc32c(0, "123456789", 9));
+    TEST_ASSERT_EQUAL_HEX32(0xE3069283,
+                            ac_crc32c(ac_crc32c(0, "1234", 4), "56789", 5));
+}
+
+void test_msglog_records_round_trip(void) {
+    ac_msglog_t log;
+    ac_arr_new(log.pending);
+
+    ac_msg_t chat    = msg(AC_MSG_CHAT, "alice", "", "hello there");
+    ac_msg_t whisper = msg(AC_MSG_WHISPER, "bob", "alice", "psst");
+    ac_msglog_append(&log, &chat);
+    ac_msglog_append(&log, &whisper);
+
+    size_t pos = 0;
+    ac_msg_t m;
+
+    TEST_ASSERT_EQUAL_INT(AC_MSGLOG_OK,
+                          ac_msglog_decode(log.pending, ac_alen(log.pending),
+                                           &pos, &m));
+    TEST_ASSERT_EQUAL_INT(AC_MSG_CHAT, m.kind);
+    TEST_ASSERT_TRUE(m.time_ms == 1700000000123ull);
+    TEST_ASSERT_EQUAL_STRING_LEN("alice", m.from.data, m.from.len);
+    TEST_ASSERT_EQUAL_size_t(0, m.to.len);
+    TEST_ASSERT_EQUAL_STRING_LEN("hello there", m.text.data, m.text.len);
+
+    TEST_ASSERT_EQUAL_INT(AC_MSGLOG_OK,
+                          ac_msglog_decode(log.pending, ac_alen(log.pending),
+                                           &pos, &m));
+    TEST_ASSERT_EQUAL_INT(AC_MSG_WHISPER, m.kind);
+    TEST_ASSERT_EQUAL_STRING_LEN("bob", m.from.data, m.from.len);
+    TEST_ASSERT_EQUAL_STRING_LEN("alice", m.to.data, m.to.len);
+    TEST_ASSERT_EQUAL_STRING_LEN("psst", m.text.data, m.text.len);
+
+    TEST_ASSERT_EQUAL_INT(AC_MSGLOG_END,
+                          ac_msglog_decode(log.pending, ac_alen(log.pending),
+                                           &pos, &m));
+
+    ac_arr_free(log.pending);
+}
+
+void test_msglog_detects_torn_records(void) {
+    ac_msglog_t log;
+    ac_arr_new(log.pending);
+
+    ac_msg_t chat = msg(AC_MSG_CHAT, "alice", "", "hello");
+    ac_msglog_append(&log, &chat);
+
+    size_t len = ac_alen(log.pending);
+    size_t pos = 0;
+    ac_msg_t m;
+
+    /* Cut short. */
+    TEST_ASSERT_EQUAL_INT(AC_MSGLOG_TORN,
+                          ac_msglog_decode(log.pending, len - 1, &pos, &m));
+    TEST_ASSERT_EQUAL_size_t(0, pos);
+
+    /* Corrupted body. */
+    log.pending[len - 1] ^= 1;
+    TEST_ASSERT_EQUAL_INT(AC_MSGLOG_TORN,
+                          ac_msglog_decode(log.pending, len, &pos, &m));
+    TEST_ASSERT_EQUAL_size_t(0, pos);
+
+    ac_arr_free(log.pending);
+}
+
+void test_msglog_recovery_truncates_torn_tail(void) {
+    ac_msglog_t log;
+    char path[256];
+    segment_path(path, sizeof path, 0);
+
+    TEST_ASSERT_TRUE(ac_msglog_open(&log, dir));
+    ac_msg_t chat = msg(AC_MSG_CHAT, "alice", "", "before the crash");
+    ac_msglog_append(&log, &chat);
+    ac_msglog_append(&log, &chat);
+    ac_msglog_commit(&log);
+    ac_msglog_close(&log);
+
+    TEST_ASSERT_EQUAL_size_t(2, count_records(path));
+
+    struct stat st;
+    TEST_ASSERT_EQUAL_INT(0, stat(path, &st));
+    off_t good = st.st_size;
+
+    /* Half a record, as a crash mid-write would leave. */
+    int fd = open(path, O_WRONLY | O_APPEND);
+    TEST_ASSERT_TRUE(fd != -1);
+    TEST_ASSERT_EQUAL_INT(5, (int)write(fd, "\x20\0\0\0\x99", 5));
+    close(fd);
+
+    TEST_ASSERT_TRUE(ac_msglog_open(&log, dir));
+    TEST_ASSERT_EQUAL_INT(0, stat(path, &st));
+    TEST_ASSERT_TRUE(st.st_size == good);
+
+    ac_msg_t after = msg(AC_MSG_CHAT, "alice", "", "after the crash");
+    ac_msglog_append(&log, &after);
+    ac_msglog_close(&log);
+
+    TEST_ASSERT_EQUAL_size_t(3, count_records(path));
+}
+
+void test_msglog_recovery_keeps_records_after_damage(void) {
+    ac_msglog_t log;
+    char path[256];
+    segment_path(path, sizeof path, 0);
+
+    TEST_ASSERT_TRUE(ac_msglog_open(&log, dir));
+    ac_msg_t first  = msg(AC_MSG_CHAT, "alice", "", "first");
+    ac_msg_t second = msg(AC_MSG_CHAT, "alice", "", "second");
+    ac_msg_t third  = msg(AC_MSG_CHAT, "alice", "", "third");
+    ac_msglog_append(&log, &first);
+    ac_msglog_append(&log, &second);
+    ac_msglog_append(&log, &third);
+    ac_msglog_close(&log);
+
+    /* Flip the last byte of "second". Bodies are 12 fixed bytes, the name
+       and the text. */
+    struct stat st;
+    TEST_ASSERT_EQUAL_INT(0, stat(path, &st));
+    off_t size   = st.st_size;
+    off_t damage = AC_MSGLOG_SEGMENT_HEADER + 2 * AC_MSGLOG_RECORD_HEADER +
+                   12 + 5 + 5 + 12 + 5 + 6 - 1;
+
+    int fd = open(path, O_RDWR);
+    TEST_ASSERT_TRUE(fd != -1);
+    TEST_ASSERT_EQUAL_INT(1, (int)pwrite(fd, "?", 1, damage));
+    close(fd);
+
+    /* Nothing is cut off, and new records follow the intact ones. */
+    TEST_ASSERT_TRUE(ac_msglog_open(&log, dir));
+    TEST_ASSERT_EQUAL_INT(0, stat(path, &st));
+    TEST_ASSERT_TRUE(st.st_size == size);
+
+    ac_msg_t fourth = msg(AC_MSG_CHAT, "alice", "", "fourth");
+    ac_msglog_append(&log, &fourth);
+    ac_msglog_close(&log);
+
+    ac_bytes_t data = slurp(path);
+    const char *expected[] = {"first", "third", "fourth"};
+    size_t pos             = AC_MSGLOG_SEGMENT_HEADER;
+    size_t count           = 0;
+    ac_msg_t m;
+    ac_msglog_status_t status;
+
+    while ((status = ac_msglog_decode(data, ac_alen(data), &pos, &m)) !=
+           AC_MSGLOG_END) {
+        if (status == AC_MSGLOG_TORN) {
+            pos = ac_msglog_resync(data, ac_alen(data), pos + 1);
+            TEST_ASSERT_TRUE(pos < ac_alen(data));
+            continue;
+        }
+
+        TEST_ASSERT_TRUE(count < 3);
+        TEST_ASSERT_EQUAL_STRING_LEN(expected[count], m.text.data,
+                                     m.text.len);
+        count++;
+    }
+
+    TEST_ASSERT_EQUAL_size_t(3, count);
+    ac_arr_free(data);
+}
+
+void test_msglog_failed_write_is_cut_off_and_retried(void) {
+    ac_msglog_t log;
+    char path[256];
+    segment_path(path, sizeof path, 0);
+
+    TEST_ASSERT_TRUE(ac_msglog_open(&log, dir));
+
+    /* Let the segment grow by less than a record, so the write stops
+       half way and then fails. */
+    struct rlimit saved, limit;
+    TEST_ASSERT_EQUAL_INT(0, getrlimit(RLIMIT_FSIZE, &saved));
+    limit          = saved;
+    limit.rlim_cur = AC_MSGLOG_SEGMENT_HEADER + 20;
+    signal(SIGXFSZ, SIG_IGN);
+    TEST_ASSERT_EQUAL_INT(0, setrlimit(RLIMIT_FSIZE, &limit));
+
+    ac_msg_t chat = msg(AC_MSG_CHAT, "alice", "", "while the disk is full");
+    ac_msglog_append(&log, &chat);
+    ac_msglog_append(&log, &chat);
+    ac_msglog_commit(&log);
+    usleep(200 * 1000);
+
+    struct stat st;
+    TEST_ASSERT_EQUAL_INT(0, stat(path, &st));
+    TEST_ASSERT_EQUAL_INT(AC_MSGLOG_SEGMENT_HEADER, (int)st.st_size);
+
+    /* Once there is room again, the kept records are written. */
+    TEST_ASSERT_EQUAL_INT(0, setrlimit(RLIMIT_FSIZE, &saved));
+    signal(SIGXFSZ, SIG_DFL);
+    ac_msglog_close(&log);
+
+    TEST_ASSERT_EQUAL_size_t(2, count_records(path));
+}
+
+void test_msglog_failed_sync_is_retried_in_a_new_segment(void) {
+    ac_msglog_t log;
+    char first[256];
+    char second[256];
+    segment_path(first, sizeof first, 0);
+    segment_path(second, sizeof second, 1);
+
+    TEST_ASSERT_TRUE(ac_msglog_open(&log, dir));
+
+    /* Put a pipe in place of the segment: writes to it succeed, and
+       fdatasync() fails. */
+    int fds[2];
+    TEST_ASSERT_EQUAL_INT(0, pipe(fds));
+    TEST_ASSERT_EQUAL_INT(log.fd, dup2(fds[1], log.fd));
+    close(fds[1]);
+
+    ac_msg_t chat = msg(AC_MSG_CHAT, "alice", "", "while the disk fails");
+    ac_msglog_append(&log, &chat);
+    ac_msglog_append(&log, &chat);
+    ac_msglog_commit(&log);
+    usleep(200 * 1000);
+    ac_msglog_close(&log);
+
+    /* The pipe took the records once, and the retry wrote them again. */
+    char buf[256];
+    TEST_ASSERT_TRUE(read(fds[0], buf, sizeof buf) > 0);
+    close(fds[0]);
+
+    TEST_ASSERT_EQUAL_size_t(0, count_records(first));
+    TEST_ASSERT_EQUAL_size_t(2, count_records(second));
+}
+
+void test_msglog_lists_segments_in_order(void) {
+    const char *names[] = {"0000000000000010.log", "0000000000000002.log",
+                           "notes.txt", "000000000000000x.log"};
+
+    for (size_t i = 0; i < sizeof names / sizeof names[0]; i++) {
+        char path[256];
+        snprintf(path, sizeof path, "%s/%s", dir, names[i]);
+        close(open(path, O_WRONLY | O_CREAT, 0644));
+    }
+
+    ac_arr(uint64_t) segments;
+    TEST_ASSERT_TRUE(ac_msglog_segments(dir, &segments));
+    TEST_ASSERT_EQUAL_size_t(2, ac_alen(segments));
+    TEST_ASSERT_TRUE(segments[0] == 2);
+    TEST_ASSERT_TRUE(segments[1] == 10);
+    ac_arr_free(segments);
+
+    for (size_t i = 2; i < sizeof names / sizeof names[0]; i++) {
+        char path[256];
+        snprintf(path, sizeof path, "%s/%s", dir, names[i]);
+        unlink(path);
+    }
+}
@@ -0,0 +1,122 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <assert.h>
+
+#include <unity.h>
+#include <ac/meta.h>
+#include <ac/str.h>
+#include <ac/intern.h>
+#include <ac/names.h>
+
+static ac_name_index_t idx;
+
+static ac_atom_t add(const char *name) {
+    ac_atom_t atom = ac_intern(name, strlen(name));
+    ac_name_index_insert(&idx, atom);
+    return atom;
+}
+
+static void assert_name(const char *expected, size_t i) {
+    ac_atom_t atom = ac_name_index_at(&idx, i);
+    TEST_ASSERT_EQUAL_INT((int)strlen(expected), (int)ac_atom_len(atom));
+    TEST_ASSERT_EQUAL_MEMORY(expected, ac_atom_data(atom), strlen(expected));
+}
+
+void setUp(void) {
+    ac_name_index_new(&idx);
+}
+
+void tearDown(void) {
+    for (size_t i = 0; i < ac_name_index_len(&idx); i++) {
+        ac_atom_release(ac_name_index_at(&idx, i));
+    }
+    ac_name_index_free(&idx);
+}
+
+void test_names_kept_in_byte_order(void) {
+    const char *names[] = {"carol", "alice", "bob", "al", "Zed", "alicia"};
+    for (size_t i = 0; i < 6; i++) {
+        add(names[i]);
+    }
+
+    TEST_ASSERT_EQUAL_INT(6, (int)ac_name_index_len(&idx));
+    assert_name("Zed", 0);
+    assert_name("al", 1);
+    assert_name("alice", 2);
+    assert_name("alicia", 3);
+    assert_name("bob", 4);
+    assert_name("carol", 5);
+}
+
+void test_names_insert_remove(void) {
+    ac_atom_t bob = add("bob");
+    ac_atom_t ann = add("ann");
+
+    TEST_ASSERT_FALSE(ac_name_index_insert(&idx, bob));
+    TEST_ASSERT_TRUE(ac_name_index_remove(&idx, bob));
+    TEST_ASSERT_FALSE(ac_name_index_remove(&idx, bob));
+    TEST_ASSERT_EQUAL_INT(1, (int)ac_name_index_len(&idx));
+    assert_name("ann", 0);
+
+    ac_atom_release(bob);
+    (void)ann;
+}
+
+void test_names_prefix_range(void) {
+    const char *names[] = {"al", "alice", "alicia", "bob", "albert", "b"};
+    for (size_t i = 0; i < 6; i++) {
+        add(names[i]);
+    }
+
+    ac_name_range_t range = ac_name_index_prefix(&idx, "ali", 3);
+    TEST_ASSERT_EQUAL_INT(2, (int)range.first);
+    TEST_ASSERT_EQUAL_INT(2, (int)range.count);
+
+    range = ac_name_index_prefix(&idx, "al", 2);
+    TEST_ASSERT_EQUAL_INT(0, (int)range.first);
+    TEST_ASSERT_EQUAL_INT(4, (int)range.count);
+
+    range = ac_name_index_prefix(&idx, "", 0);
+    TEST_ASSERT_EQUAL_INT(6, (int)range.count);
+
+    range = ac_name_index_prefix(&idx, "c", 1);
+    TEST_ASSERT_EQUAL_INT(0, (int)range.count);
+}
+
+void test_names_common_prefix(void) {
+    add("alice");
+    add("alicia");
+    add("albert");
+    /* Differ only in the second byte of a two byte sequence. */
+    add("z\xc3\xa8");
+    add("z\xc3\xa9");
+
+    ac_name_range_t range = ac_name_index_prefix(&idx, "ali", 3);
+    TEST_ASSERT_EQUAL_INT(4, (int)ac_name_index_common_prefix(&idx, range));
+
+    range = ac_name_index_prefix(&idx, "a", 1);
+    TEST_ASSERT_EQUAL_INT(2, (int)ac_name_index_common_prefix(&idx, range));
+
+    range = ac_name_index_prefix(&idx, "z", 1);
+    TEST_ASSERT_EQUAL_INT(1, (int)ac_name_index_common_prefix(&idx, range));
+}
+
+void test_names_many(void) {
+    char name[16];
+
+    for (int i = 999; i >= 0; i--) {
+        snprintf(name, sizeof(name), "user%03d", i);
+        add(name);
+    }
+
+    TEST_ASSERT_EQUAL_INT(1000, (int)ac_name_index_len(&idx));
+    assert_name("user000", 0);
+    assert_name("user999", 999);
+
+    ac_name_range_t range = ac_name_index_prefix(&idx, "user12", 6);
+    TEST_ASSERT_EQUAL_INT(120, (int)range.first);
+    TEST_ASSERT_EQUAL_INT(10, (int)range.count);
+}
@@ -0,0 +1,159 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include <unity.h>
+#include <ac/meta.h>
+#include <ac/pool.h>
+
+typedef struct {
+    int id;
+    char name[20];
+} test_obj_t;
+
+void test_pool_alloc_is_aligned_and_distinct(void) {
+    ac_pool_t pool;
+    ac_pool_new(&pool, sizeof(test_obj_t), 4);
+
+    test_obj_t *objs[10];
+    for (int i = 0; i < 10; i++) {
+        objs[i] = ac_pool_alloc(&pool);
+        TEST_ASSERT_EQUAL_INT(0, (int)((uintptr_t)objs[i] % AC_POOL_ALIGN));
+        objs[i]->id = i;
+    }
+
+    for (int i = 0; i < 10; i++) {
+        TEST_ASSERT_EQUAL_INT(i, objs[i]->id);
+    }
+
+    TEST_ASSERT_EQUAL_INT(10, (int)pool.stats.live);
+    ac_pool_free(&pool);
+}
+
+void test_pool_reuses_released_objects(void) {
+    ac_pool_t pool;
+    ac_pool_new(&pool, sizeof(test_obj_t), 4);
+
+    void *a = ac_pool_alloc(&pool);
+    ac_pool_release(&pool, a);
+    void *b = ac_pool_alloc(&pool);
+
+    TEST_ASSERT_TRUE(a == b);
+    TEST_ASSERT_EQUAL_INT(2, (int)pool.stats.allocs);
+    TEST_ASSERT_EQUAL_INT(1, (int)pool.stats.frees);
+    TEST_ASSERT_EQUAL_INT(1, (int)pool.stats.live);
+
+    ac_pool_release(&pool, b);
+    ac_pool_free(&pool);
+}
+
+void test_pool_counts_high_water(void) {
+    ac_pool_t pool;
+    ac_pool_new(&pool, sizeof(test_obj_t), 2);
+
+    void *objs[5];
+    for (int i = 0; i < 5; i++) {
+        objs[i] = ac_pool_alloc(&pool);
+    }
+    for (int i = 0; i < 5; i++) {
+        ac_pool_release(&pool, objs[i]);
+    }
+
+    TEST_ASSERT_EQUAL_INT(0, (int)pool.stats.live);
+    TEST_ASSERT_EQUAL_INT(5, (int)pool.stats.high_water);
+
+    ac_pool_free(&pool);
+}
+
+void test_buf_pool_array_growth(void) {
+    ac_buf_pool_t pool;
+    ac_buf_pool_new(&pool);
+
+    ac_bytes_t buf;
+    ac_arr_new_a(buf, &pool.allocator);
+
+    for (int i = 0; i < 10000; i++) {
+        uint8_t byte = (uint8_t)i;
+        ac_arr_append(buf, byte);
+    }
+
+    for (int i = 0; i < 10000; i++) {
+        TEST_ASSERT_EQUAL_INT((uint8_t)i, buf[i]);
+    }
+
+    ac_arr_free(buf);
+    TEST_ASSERT_EQUAL_INT(0, (int)pool.stats.live);
+    ac_buf_pool_free(&pool);
+}
+
+void test_buf_pool_recycles_capacity(void) {
+    ac_buf_pool_t pool;
+    ac_buf_pool_new(&pool);
+
+    ac_bytes_t a;
+    ac_arr_new_a(a, &pool.allocator);
+    ac_arr_append_n(a, 5, "hello");
+    ac_arr_free(a);
+
+    size_t allocs = pool.stats.allocs;
+
+    ac_bytes_t b;
+    ac_arr_new_a(b, &pool.allocator);
+    ac_arr_append_n(b, 5, "world");
+
+    TEST_ASSERT_TRUE(pool.stats.allocs > allocs);
+    TEST_ASSERT_TRUE(pool.stats.reuses > 0);
+
+    ac_arr_free(b);
+    ac_buf_pool_free(&pool);
+}
+
+void test_buf_pool_trim_keeps_high_water(void) {
+    ac_buf_pool_t pool;
+    ac_buf_pool_new(&pool);
+
+    ac_bytes_t bufs[8];
+    for (int i = 0; i < 8; i++) {
+        ac_arr_new_a(bufs[i], &pool.allocator);
+    }
+    for (int i = 0; i < 8; i++) {
+        ac_arr_free(bufs[i]);
+    }
+
+    /* The peak since the last trim was 8, so nothing is given back. */
+    TEST_ASSERT_EQUAL_INT(0, (int)ac_buf_pool_trim(&pool));
+
+    /* Only 2 were needed during this window, keep those. */
+    for (int i = 0; i < 2; i++) {
+        ac_arr_new_a(bufs[i], &pool.allocator);
+    }
+    for (int i = 0; i < 2; i++) {
+        ac_arr_free(bufs[i]);
+    }
+
+    TEST_ASSERT_EQUAL_INT(6, (int)ac_buf_pool_trim(&pool));
+    TEST_ASSERT_EQUAL_INT(2, (int)ac_buf_pool_trim(&pool));
+
+    ac_buf_pool_free(&pool);
+}
+
+void test_buf_pool_large_buffers_bypass_classes(void) {
+    ac_buf_pool_t pool;
+    ac_buf_pool_new(&pool);
+
+    size_t large = (size_t)AC_BUF_POOL_MIN << AC_BUF_POOL_CLASSES;
+
+    ac_bytes_t buf;
+    ac_arr_new_reserve_a(buf, large, &pool.allocator);
+    memset(buf, 0xAB, large);
+    ac_arr_resize(buf, large * 2);
+    TEST_ASSERT_EQUAL_INT(0xAB, buf[large - 1]);
+
+    ac_arr_free(buf);
+    TEST_ASSERT_EQUAL_INT(0, (int)pool.stats.live);
+    TEST_ASSERT_EQUAL_INT(0, (int)ac_buf_pool_trim(&pool));
+
+    ac_buf_pool_free(&pool);
+}
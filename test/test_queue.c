@@ -0,0 +1,199 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <unity.h>
+#include <ac/meta.h>
+
+#define STRESS_ITEMS     200000
+#define STRESS_PRODUCERS 4
+
+typedef ac_spsc(int) int_spsc_t;
+typedef ac_mpsc(uint64_t) u64_mpsc_t;
+
+typedef struct point_s {
+    int x, y;
+} point_t;
+
+void test_spsc_fifo_and_capacity(void) {
+    int_spsc_t q;
+    ac_spsc_new(q, 5);
+
+    /* Rounded up to a power of two. */
+    TEST_ASSERT_EQUAL_INT(8, (int)q.ring.cap);
+
+    for (int i = 0; i < 8; i++) {
+        TEST_ASSERT_TRUE(ac_spsc_push(q, i));
+    }
+
+    int extra = 8;
+    TEST_ASSERT_FALSE(ac_spsc_push(q, extra));
+    TEST_ASSERT_EQUAL_INT(8, (int)ac_spsc_len(q));
+
+    for (int i = 0; i < 8; i++) {
+        int val;
+        TEST_ASSERT_TRUE(ac_spsc_pop(q, val));
+        TEST_ASSERT_EQUAL_INT(i, val);
+    }
+
+    int val;
+    TEST_ASSERT_FALSE(ac_spsc_pop(q, val));
+
+    ac_spsc_free(q);
+}
+
+void test_spsc_batch_wraps_around(void) {
+    int_spsc_t q;
+    ac_spsc_new(q, 8);
+
+    int in[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+    int out[8];
+
+    /* Move the positions so the next batch straddles the end. */
+    TEST_ASSERT_EQUAL_INT(5, (int)ac_spsc_push_n(q, in, 5));
+    TEST_ASSERT_EQUAL_INT(5, (int)ac_spsc_pop_n(q, out, 8));
+
+    /* Only as many as fit are pushed. */
+    TEST_ASSERT_EQUAL_INT(8, (int)ac_spsc_push_n(q, in, 8));
+    TEST_ASSERT_EQUAL_INT(0, (int)ac_spsc_push_n(q, in, 8));
+
+    TEST_ASSERT_EQUAL_INT(3, (int)ac_spsc_pop_n(q, out, 3));
+    TEST_ASSERT_EQUAL_INT_ARRAY(in, out, 3);
+    TEST_ASSERT_EQUAL_INT(5, (int)ac_spsc_pop_n(q, out, 8));
+    TEST_ASSERT_EQUAL_INT_ARRAY(in + 3, out, 5);
+
+    ac_spsc_free(q);
+}
+
+void test_mpsc_struct_elements(void) {
+    ac_mpsc(point_t) q;
+    ac_mpsc_new(q, 4);
+
+    point_t points[4] = {{1, 2}, {3, 4}, {5, 6}, {7, 8}};
+    TEST_ASSERT_EQUAL_INT(4, (int)ac_mpsc_push_n(q, points, 4));
+    TEST_ASSERT_FALSE(ac_mpsc_push(q, points[0]));
+
+    point_t p;
+    TEST_ASSERT_TRUE(ac_mpsc_pop(q, p));
+    TEST_ASSERT_EQUAL_INT(1, p.x);
+    TEST_ASSERT_EQUAL_INT(2, p.y);
+
+    /* A freed slot can be claimed again, behind the rest. */
+    TEST_ASSERT_TRUE(ac_mpsc_push(q, points[0]));
+
+    point_t out[8];
+    TEST_ASSERT_EQUAL_INT(4, (int)ac_mpsc_pop_n(q, out, 8));
+    TEST_ASSERT_EQUAL_INT(7, out[2].x);
+    TEST_ASSERT_EQUAL_INT(1, out[3].x);
+    TEST_ASSERT_FALSE(ac_mpsc_pop(q, p));
+
+    ac_mpsc_free(q);
+}
+
+static int_spsc_t spsc;
+
+static void *spsc_producer(void *arg) {
+    (void)arg;
+
+    int batch[7];
+    for (int next = 0; next < STRESS_ITEMS;) {
+        int n = 0;
+        for (; n < 7 && next + n < STRESS_ITEMS; n++) {
+            batch[n] = next + n;
+        }
+
+        /* Push the whole batch, in pieces if the queue is full. */
+        for (int pushed = 0; pushed < n;) {
+            size_t k = ac_spsc_push_n(spsc, batch + pushed,
+                                      (size_t)(n - pushed));
+            if (k == 0) {
+                sched_yield();
+            }
+            pushed += (int)k;
+        }
+        next += n;
+    }
+    return NULL;
+}
+
+void test_spsc_threads_keep_order(void) {
+    ac_spsc_new(spsc, 64);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, spsc_producer, NULL);
+
+    int expected = 0;
+    int out[16];
+    bool in_order = true;
+
+    while (expected < STRESS_ITEMS) {
+        size_t n = ac_spsc_pop_n(spsc, out, 16);
+        if (n == 0) {
+            sched_yield();
+        }
+        for (size_t i = 0; i < n; i++) {
+            in_order &= out[i] == expected++;
+        }
+    }
+
+    pthread_join(thread, NULL);
+    TEST_ASSERT_TRUE(in_order);
+
+    ac_spsc_free(spsc);
+}
+
+static u64_mpsc_t mpsc;
+
+static void *mpsc_producer(void *arg) {
+    uint64_t id = (uint64_t)(uintptr_t)arg;
+
+    for (uint64_t i = 0; i < STRESS_ITEMS / STRESS_PRODUCERS; i++) {
+        /* Producer in the high bits, its own sequence in the low. */
+        uint64_t val = id << 32 | i;
+        while (!ac_mpsc_push(mpsc, val)) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+void test_mpsc_threads_deliver_everything(void) {
+    ac_mpsc_new(mpsc, 128);
+
+    pthread_t threads[STRESS_PRODUCERS];
+    for (uintptr_t i = 0; i < STRESS_PRODUCERS; i++) {
+        pthread_create(&threads[i], NULL, mpsc_producer, (void *)i);
+    }
+
+    /* Each producer's elements must arrive complete and in its order. */
+    uint64_t next[STRESS_PRODUCERS] = {0};
+    uint64_t out[32];
+    size_t received = 0;
+    bool in_order   = true;
+
+    while (received < STRESS_ITEMS) {
+        size_t n = ac_mpsc_pop_n(mpsc, out, 32);
+        if (n == 0) {
+            sched_yield();
+        }
+        for (size_t i = 0; i < n; i++) {
+            uint64_t id = out[i] >> 32;
+            in_order &= id < STRESS_PRODUCERS &&
+                        (out[i] & 0xffffffffu) == next[id]++;
+        }
+        received += n;
+    }
+
+    for (size_t i = 0; i < STRESS_PRODUCERS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    TEST_ASSERT_TRUE(in_order);
+    TEST_ASSERT_EQUAL_INT(0, (int)ac_mpsc_len(mpsc));
+
+    ac_mpsc_free(mpsc);
+}
@@ -0,0 +1,74 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <unity.h>
+#include <ac/rate.h>
+
+static const ac_rate_limit_t limit = {.per_sec = 4, .burst = 3};
+
+void test_bucket_starts_full_and_allows_a_burst(void) {
+    ac_bucket_t bucket;
+    ac_bucket_new(&bucket, &limit, 1000);
+
+    TEST_ASSERT_TRUE(ac_bucket_take(&bucket, &limit, 1000));
+    TEST_ASSERT_TRUE(ac_bucket_take(&bucket, &limit, 1000));
+    TEST_ASSERT_TRUE(ac_bucket_take(&bucket, &limit, 1000));
+    TEST_ASSERT_FALSE(ac_bucket_take(&bucket, &limit, 1000));
+}
+
+void test_bucket_refills_at_rate(void) {
+    ac_bucket_t bucket;
+    ac_bucket_new(&bucket, &limit, 0);
+
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_TRUE(ac_bucket_take(&bucket, &limit, 0));
+    }
+
+    /* Four tokens a second is one every 250 ms. */
+    TEST_ASSERT_FALSE(ac_bucket_take(&bucket, &limit, 249));
+    TEST_ASSERT_TRUE(ac_bucket_take(&bucket, &limit, 250));
+    TEST_ASSERT_FALSE(ac_bucket_take(&bucket, &limit, 250));
+    TEST_ASSERT_TRUE(ac_bucket_take(&bucket, &limit, 500));
+}
+
+void test_bucket_never_exceeds_burst(void) {
+    ac_bucket_t bucket;
+    ac_bucket_new(&bucket, &limit, 0);
+
+    TEST_ASSERT_TRUE(ac_bucket_take(&bucket, &limit, 0));
+
+    /* A long quiet spell refills to the burst size and no further. */
+    int taken = 0;
+    while (ac_bucket_take(&bucket, &limit, 60000)) {
+        taken++;
+    }
+    TEST_ASSERT_EQUAL_INT(3, taken);
+}
+
+void test_bucket_wait_is_time_to_next_token(void) {
+    ac_bucket_t bucket;
+    ac_bucket_new(&bucket, &limit, 0);
+
+    TEST_ASSERT_EQUAL_UINT64(0, ac_bucket_wait(&bucket, &limit));
+
+    for (int i = 0; i < 3; i++) {
+        ac_bucket_take(&bucket, &limit, 0);
+    }
+    TEST_ASSERT_FALSE(ac_bucket_take(&bucket, &limit, 100));
+
+    uint64_t wait = ac_bucket_wait(&bucket, &limit);
+    TEST_ASSERT_EQUAL_UINT64(150, wait);
+    TEST_ASSERT_FALSE(ac_bucket_take(&bucket, &limit, 100 + wait - 1));
+    TEST_ASSERT_TRUE(ac_bucket_take(&bucket, &limit, 100 + wait));
+}
+
+void test_bucket_ignores_time_going_backwards(void) {
+    ac_bucket_t bucket;
+    ac_bucket_new(&bucket, &limit, 500);
+
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_TRUE(ac_bucket_take(&bucket, &limit, 500));
+    }
+    TEST_ASSERT_FALSE(ac_bucket_take(&bucket, &limit, 100));
+    TEST_ASSERT_TRUE(ac_bucket_take(&bucket, &limit, 750));
+}
@@ -0,0 +1,124 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include <unity.h>
+#include <ac/meta.h>
+#include <ac/str.h>
+#include <ac/search.h>
+
+static ac_search_t search;
+static ac_search_hit_t hits[16];
+
+static ac_str_view_t view(const char *str) {
+    ac_str_view_t v = {str, strlen(str)};
+    return v;
+}
+
+static void add(uint64_t now, const char *from, const char *text) {
+    ac_search_add(&search, now, view(from), view(text));
+}
+
+static size_t find(const char *query) {
+    return ac_search_find(&search, view(query), hits,
+                          sizeof hits / sizeof hits[0]);
+}
+
+void setUp(void) {
+    ac_string_hash_seed(42);
+    ac_search_new(&search);
+}
+
+void tearDown(void) {
+    ac_search_free(&search);
+}
+
+void test_search_finds_lines_with_every_word_newest_first(void) {
+    add(0, "alice", "the link is https://example.com/a");
+    add(1, "bob", "no link here");
+    add(2, "carol", "Another LINK: https://example.com/b");
+    add(3, "dave", "example without the word");
+
+    TEST_ASSERT_EQUAL_size_t(2, find("example link"));
+    TEST_ASSERT_EQUAL_STRING_LEN("carol", hits[0].from.data, hits[0].from.len);
+    TEST_ASSERT_EQUAL_size_t(5, hits[0].from.len);
+    TEST_ASSERT_EQUAL_STRING_LEN("Another LINK: https://example.com/b",
+                                 hits[0].text.data, hits[0].text.len);
+    TEST_ASSERT_TRUE(hits[0].time_ms == 2);
+    TEST_ASSERT_EQUAL_STRING_LEN("alice", hits[1].from.data, hits[1].from.len);
+
+    TEST_ASSERT_EQUAL_size_t(3, find("LiNk"));
+}
+
+void test_search_needs_every_word(void) {
+    add(0, "alice", "hello world");
+
+    TEST_ASSERT_EQUAL_size_t(0, find("hello there"));
+    TEST_ASSERT_EQUAL_size_t(0, find(""));
+    TEST_ASSERT_EQUAL_size_t(0, find("  ?! "));
+    TEST_ASSERT_EQUAL_size_t(1, find("world, hello!"));
+}
+
+void test_search_drops_lines_out_of_the_time_window(void) {
+    add(0, "alice", "old news");
+    add(AC_SEARCH_WINDOW_MS, "bob", "fresh news");
+
+    TEST_ASSERT_EQUAL_size_t(2, find("news"));
+
+    ac_search_expire(&search, AC_SEARCH_WINDOW_MS + 1);
+
+    TEST_ASSERT_EQUAL_size_t(1, find("news"));
+    TEST_ASSERT_EQUAL_STRING_LEN("bob", hits[0].from.data, hits[0].from.len);
+    TEST_ASSERT_EQUAL_size_t(0, find("old"));
+
+    ac_search_expire(&search, 3 * AC_SEARCH_WINDOW_MS);
+
+    TEST_ASSERT_EQUAL_size_t(0, find("news"));
+    TEST_ASSERT_EQUAL_size_t(0, search.terms.len);
+    TEST_ASSERT_EQUAL_size_t(0, search.text_bytes);
+}
+
+void test_search_bounds_the_text_kept(void) {
+    char text[1024];
+    memset(text, 'z', sizeof text - 1);
+    text[sizeof text - 1] = '\0';
+
+    add(0, "alice", "first words");
+
+    for (size_t i = 0; i < 2 * AC_SEARCH_MAX_BYTES / sizeof text; i++) {
+        add(1, "bob", text);
+    }
+
+    TEST_ASSERT_TRUE(search.text_bytes <= AC_SEARCH_MAX_BYTES);
+    TEST_ASSERT_EQUAL_size_t(0, find("first"));
+    TEST_ASSERT_EQUAL_size_t(sizeof hits / sizeof hits[0],
+                             find(text));
+}
+
+void test_search_postings_survive_compaction(void) {
+    char line[64];
+
+    for (uint64_t i = 0; i < 5000; i++) {
+        snprintf(line, sizeof line, "common word%llu %s",
+                 (unsigned long long)i, i % 3 == 0 ? "fizz" : "");
+        add(i, "user", line);
+    }
+
+    /* Drop the first 4000 lines one expiry at a time. */
+    for (uint64_t i = 0; i < 4000; i++) {
+        ac_search_expire(&search, i + AC_SEARCH_WINDOW_MS + 1);
+    }
+
+    TEST_ASSERT_EQUAL_size_t(0, find("word3999"));
+    TEST_ASSERT_EQUAL_size_t(1, find("word4000"));
+
+    TEST_ASSERT_EQUAL_size_t(16, find("fizz common"));
+    for (size_t i = 0; i < 16; i++) {
+        snprintf(line, sizeof line, "common word%zu fizz", 4998 - 3 * i);
+        TEST_ASSERT_EQUAL_size_t(strlen(line), hits[i].text.len);
+        TEST_ASSERT_EQUAL_STRING_LEN(line, hits[i].text.data,
+                                     hits[i].text.len);
+    }
+}
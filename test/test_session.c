@@ -0,0 +1,352 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <limits.h>
+
+#include <unity.h>
+
+/* The app is built from every module. */
+#include <ac/meta.h>
+#include <ac/str.h>
+#include <ac/intern.h>
+#include <ac/arena.h>
+#include <ac/pool.h>
+#include <ac/log.h>
+#include <ac/rate.h>
+#include <ac/token.h>
+#include <ac/kdf.h>
+#include <ac/names.h>
+#include <ac/search.h>
+#include <ac/history.h>
+#include <ac/accounts.h>
+#include <ac/auth.h>
+#include <ac/msglog.h>
+#include <ac/filter.h>
+#include <ac/net.h>
+#include <ac/io.h>
+#include <ac/app.h>
+
+/* Sessions are driven through whole ticks of the app, with clients added
+   to the server by hand in place of sockets. */
+TEST_SOURCE_FILE("session.c")
+TEST_SOURCE_FILE("state.c")
+
+#define CLIENTS (AC_SESSION_PARKED_MAX + 2)
+
+/* The app runs in a directory of its own, for the files it opens. */
+static char dir[] = "/tmp/ac_session_XXXXXX";
+static char cwd[PATH_MAX];
+static ac_app_t app;
+
+/* Output queues of the clients, indexed by handle. */
+static ac_bytes_t outs[CLIENTS];
+static ac_client_handle_t next_handle;
+
+static void tick(void) {
+    ac_app_update(&app);
+
+    ac_client_handle_t *handle;
+    ac_client_t *client;
+
+    ac_map_foreach(app.server.clients, handle, client) {
+        if (client->state == AC_CLIENT_STATE_NEW) {
+            client->state = AC_CLIENT_STATE_ONLINE;
+        }
+    }
+}
+
+/* Everything sent to a client since the last call. */
+static const char *output(ac_client_handle_t handle) {
+    static char buf[16 * 1024];
+    size_t len = ac_alen(outs[handle]);
+
+    TEST_ASSERT_TRUE(len < sizeof buf);
+    memcpy(buf, outs[handle], len);
+    buf[len] = '\0';
+
+    ac_alen(outs[handle]) = 0;
+    return buf;
+}
+
+/* Send a line, and run the tick that reads it. */
+static void say(ac_client_handle_t handle, const char *line) {
+    ac_client_t *client = ac_client_map_get(&app.server.clients, handle);
+    TEST_ASSERT_NOT_NULL(client);
+
+    ac_arr_append_n(client->in.buf, strlen(line), line);
+    ac_arr_append_n(client->in.buf, 2, "\r\n");
+    tick();
+}
+
+static ac_client_handle_t connect_client(void) {
+    TEST_ASSERT_TRUE(next_handle < CLIENTS);
+
+    ac_client_t client;
+    memset(&client, 0, sizeof client);
+
+    client.conn.handle = next_handle++;
+    client.state       = AC_CLIENT_STATE_NEW;
+    client.out         = &outs[client.conn.handle];
+    ac_arr_new(client.in.buf);
+    ac_arr_new(*client.out);
+
+    ac_client_map_set(&app.server.clients, client.conn.handle, client);
+    tick();
+    output(client.conn.handle);
+
+    return client.conn.handle;
+}
+
+/* Connect and log in as NAME, returning the session token. */
+static ac_client_handle_t join(const char *name, char token[AC_TOKEN_HEX]) {
+    ac_client_handle_t handle = connect_client();
+    say(handle, name);
+
+    const char *resume = strstr(output(handle), "/resume ");
+    TEST_ASSERT_NOT_NULL(resume);
+    memcpy(token, resume + 8, AC_TOKEN_HEX);
+
+    return handle;
+}
+
+/* Drop the connection, and run the tick that notices. */
+static void drop(ac_client_handle_t handle) {
+    ac_client_t *client = ac_client_map_get(&app.server.clients, handle);
+    TEST_ASSERT_NOT_NULL(client);
+
+    client->state = AC_CLIENT_STATE_TO_BE_REMOVED;
+    tick();
+
+    ac_arr_free(client->in.buf);
+    ac_arr_free(*client->out);
+    ac_client_map_remove(&app.server.clients, handle);
+}
+
+static ac_user_t *parked(const char token[AC_TOKEN_HEX]) {
+    ac_token_t parsed;
+    ac_str_view_t hex = {token, AC_TOKEN_HEX};
+
+    TEST_ASSERT_TRUE(ac_token_parse(hex, &parsed));
+
+    ac_user_t **slot = ac_user_token_map_get(&app.parked.by_token, parsed);
+    return slot ? *slot : NULL;
+}
+
+static bool online(const char *name) {
+    ac_atom_t atom = ac_intern_find(name, strlen(name));
+    return atom != AC_ATOM_NONE &&
+           ac_user_name_map_get(&app.users.from_username, atom) != NULL;
+}
+
+static void resume(ac_client_handle_t handle, const char token[AC_TOKEN_HEX]) {
+    char line[8 + AC_TOKEN_HEX + 1];
+    snprintf(line, sizeof line, "/resume %.*s", AC_TOKEN_HEX, token);
+    say(handle, line);
+}
+
+void setUp(void) {
+    TEST_ASSERT_NOT_NULL(getcwd(cwd, sizeof cwd));
+    strcpy(dir, "/tmp/ac_session_XXXXXX");
+    TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+    TEST_ASSERT_EQUAL_INT(0, chdir(dir));
+
+    ac_app_new(&app);
+    ac_server_new(&app.server);
+    next_handle = 0;
+}
+
+void tearDown(void) {
+    ac_client_handle_t *handle;
+    ac_client_t *client;
+
+    ac_map_foreach(app.server.clients, handle, client) {
+        ac_arr_free(client->in.buf);
+        ac_arr_free(*client->out);
+    }
+
+    ac_server_free(&app.server);
+    ac_app_free(&app);
+
+    ac_arr(uint64_t) segments;
+
+    if (ac_msglog_segments(AC_MSGLOG_DIR, &segments)) {
+        ac_arr_foreach(segments, i) {
+            char path[256];
+            ac_msglog_segment_path(path, sizeof path, AC_MSGLOG_DIR,
+                                   segments[i]);
+            unlink(path);
+        }
+        ac_arr_free(segments);
+    }
+
+    rmdir(AC_MSGLOG_DIR);
+    unlink(AC_HISTORY_PATH);
+    unlink(AC_ACCOUNTS_PATH);
+    unlink("log.txt");
+
+    TEST_ASSERT_EQUAL_INT(0, chdir(cwd));
+    rmdir(dir);
+}
+
+void test_session_resume_takes_over_name_and_catches_up(void) {
+    char token[AC_TOKEN_HEX];
+    ac_client_handle_t alice = join("alice", token);
+    char other[AC_TOKEN_HEX];
+    ac_client_handle_t bob = join("bob", other);
+
+    drop(alice);
+    TEST_ASSERT_NOT_NULL(parked(token));
+    TEST_ASSERT_TRUE(online("alice"));
+
+    say(bob, "while you were out");
+    say(bob, "/w alice psst");
+    output(bob);
+
+    ac_client_handle_t back = connect_client();
+    resume(back, token);
+
+    const char *out = output(back);
+    const char *welcome = strstr(out, "Welcome back, alice!\r\n");
+    const char *missed = strstr(out, "Missed messages:\r\n");
+    const char *whispers =
+        strstr(out, "Whispers while you were away:\r\n"
+                    "[bob -> You]: psst\r\n"
+                    "If your connection drops");
+
+    TEST_ASSERT_NOT_NULL(welcome);
+    TEST_ASSERT_NOT_NULL(missed);
+    TEST_ASSERT_NOT_NULL(strstr(missed, "while you were out\r\n"));
+    TEST_ASSERT_NOT_NULL(whispers);
+    TEST_ASSERT_TRUE(welcome < missed && missed < whispers);
+
+    /* The token is spent, and the name belongs to the new connection. */
+    TEST_ASSERT_NULL(parked(token));
+    TEST_ASSERT_EQUAL_size_t(0, app.parked.by_token.len);
+
+    ac_atom_t name = ac_intern_find("alice", 5);
+    ac_user_t **user = ac_user_name_map_get(&app.users.from_username, name);
+    TEST_ASSERT_NOT_NULL(user);
+    TEST_ASSERT_EQUAL_INT(back, (*user)->handle);
+
+    ac_client_handle_t again = connect_client();
+    resume(again, token);
+    TEST_ASSERT_NOT_NULL(strstr(output(again), "cannot be resumed"));
+}
+
+void test_session_expires_in_parking_order(void) {
+    char first[AC_TOKEN_HEX];
+    char second[AC_TOKEN_HEX];
+    char third[AC_TOKEN_HEX];
+    ac_client_handle_t a = join("alice", first);
+    ac_client_handle_t b = join("bob", second);
+    ac_client_handle_t c = join("carol", third);
+
+    drop(a);
+    drop(b);
+    drop(c);
+
+    /* Parked a second apart, the last one just now. */
+    uint64_t start = app.now - 2000;
+    parked(first)->session.parked_at  = start;
+    parked(second)->session.parked_at = start + 1000;
+    parked(third)->session.parked_at  = start + 2000;
+
+    TEST_ASSERT_EQUAL_UINT64(start + AC_SESSION_GRACE_MS,
+                             ac_session_deadline(&app));
+
+    /* Not due yet. */
+    app.now = start + AC_SESSION_GRACE_MS - 1;
+    ac_session_expire(&app);
+    TEST_ASSERT_EQUAL_size_t(3, app.parked.by_token.len);
+
+    app.now = start + AC_SESSION_GRACE_MS;
+    ac_session_expire(&app);
+    TEST_ASSERT_NULL(parked(first));
+    TEST_ASSERT_FALSE(online("alice"));
+    TEST_ASSERT_NOT_NULL(parked(second));
+    TEST_ASSERT_TRUE(online("bob"));
+
+    /* A resumed session is skipped on the way to the next deadline. */
+    ac_client_handle_t back = connect_client();
+    resume(back, second);
+    TEST_ASSERT_NULL(parked(second));
+    TEST_ASSERT_EQUAL_UINT64(start + 2000 + AC_SESSION_GRACE_MS,
+                             ac_session_deadline(&app));
+
+    app.now = start + 2000 + AC_SESSION_GRACE_MS;
+    ac_session_expire(&app);
+    TEST_ASSERT_NULL(parked(third));
+    TEST_ASSERT_FALSE(online("carol"));
+    TEST_ASSERT_TRUE(online("bob"));
+    TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, ac_session_deadline(&app));
+}
+
+void test_session_expired_token_is_refused(void) {
+    char token[AC_TOKEN_HEX];
+    drop(join("alice", token));
+
+    /* Past the grace period, but not yet expired by a tick. */
+    parked(token)->session.parked_at -= AC_SESSION_GRACE_MS;
+
+    ac_client_handle_t back = connect_client();
+    resume(back, token);
+    TEST_ASSERT_NOT_NULL(strstr(output(back), "cannot be resumed"));
+    TEST_ASSERT_FALSE(online("alice"));
+}
+
+void test_session_parked_max_evicts_oldest(void) {
+    char tokens[AC_SESSION_PARKED_MAX + 1][AC_TOKEN_HEX];
+
+    for (size_t i = 0; i <= AC_SESSION_PARKED_MAX; i++) {
+        char name[16];
+        snprintf(name, sizeof name, "user%zu", i);
+        drop(join(name, tokens[i]));
+    }
+
+    TEST_ASSERT_EQUAL_size_t(AC_SESSION_PARKED_MAX, app.parked.by_token.len);
+    TEST_ASSERT_NULL(parked(tokens[0]));
+    TEST_ASSERT_FALSE(online("user0"));
+
+    for (size_t i = 1; i <= AC_SESSION_PARKED_MAX; i++) {
+        TEST_ASSERT_NOT_NULL(parked(tokens[i]));
+    }
+}
+
+void test_session_caps_missed_whispers(void) {
+    char token[AC_TOKEN_HEX];
+    drop(join("alice", token));
+
+    ac_user_t *user = parked(token);
+    ac_atom_t from  = ac_intern("bob", 3);
+
+    /* Each whisper takes "[bob -> You]: ", the text and CRLF. */
+    char text[1000];
+    memset(text, 'x', sizeof text);
+    ac_str_view_t msg = {text, sizeof text};
+    size_t each = 14 + sizeof text + 2;
+    size_t fit  = AC_SESSION_MISSED_BYTES / each;
+
+    for (size_t i = 0; i < fit; i++) {
+        TEST_ASSERT_TRUE(ac_session_keep(user, from, msg));
+    }
+    TEST_ASSERT_FALSE(ac_session_keep(user, from, msg));
+    TEST_ASSERT_FALSE(ac_session_keep(user, from, msg));
+
+    TEST_ASSERT_EQUAL_size_t(fit * each, ac_alen(user->session.missed));
+    TEST_ASSERT_EQUAL_size_t(2, user->session.missed_dropped);
+
+    /* A short one still fits in what is left. */
+    ac_str_view_t hi = {"hi", 2};
+    TEST_ASSERT_TRUE(ac_session_keep(user, from, hi));
+
+    ac_client_handle_t back = connect_client();
+    resume(back, token);
+    TEST_ASSERT_NOT_NULL(
+        strstr(output(back), "[bob -> You]: hi\r\n"
+                             "(2 more whispers did not fit.)\r\n"));
+
+    ac_atom_release(from);
+}
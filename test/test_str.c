@@ -21,3 +21,303 @@ void test_string_concat(void) {
     ac_arr_append_n(b, 6, " world");
     TEST_ASSERT_EQUAL_INT(11, (int)ac_alen(b));
 }
+
+void test_string_hash_equal_strings_hash_equal(void) {
+    ac_string_t a, b;
+    ac_arr_from_string_literal(a, "some_username", 13, 0);
+    ac_arr_new(b);
+    ac_arr_append_n(b, 13, "some_username");
+
+    TEST_ASSERT_TRUE(ac_string_hash(&a) == ac_string_hash(&b));
+    ac_arr_free(b);
+}
+
+void test_string_hash_depends_on_seed(void) {
+    ac_string_t a;
+    ac_arr_from_string_literal(a, "alice", 5, 0);
+
+    ac_string_hash_seed(1);
+    uint64_t h1 = ac_string_hash(&a);
+    ac_string_hash_seed(2);
+    uint64_t h2 = ac_string_hash(&a);
+
+    TEST_ASSERT_TRUE(h1 != h2);
+}
+
+void test_string_hash_distinguishes_all_lengths(void) {
+    /* Every prefix of a long key must hash differently, which exercises
+       the short, medium and multi-lane paths. */
+    char buf[128];
+    memset(buf, 'a', sizeof buf);
+
+    uint64_t prev = ac_hash_bytes(buf, 0);
+    for (size_t len = 1; len <= sizeof buf; len++) {
+        uint64_t h = ac_hash_bytes(buf, len);
+        TEST_ASSERT_TRUE(h != prev);
+        prev = h;
+    }
+}
+
+void test_bytes_eq_all_lengths(void) {
+    char a[64], b[64];
+    for (size_t i = 0; i < sizeof a; i++) {
+        a[i] = b[i] = (char)('a' + i % 26);
+    }
+
+    for (size_t len = 0; len <= sizeof a; len++) {
+        TEST_ASSERT_TRUE(ac_bytes_eq(a, b, len));
+
+        /* A difference at any position must be detected. */
+        for (size_t i = 0; i < len; i++) {
+            b[i] = '#';
+            TEST_ASSERT_FALSE(ac_bytes_eq(a, b, len));
+            b[i] = a[i];
+        }
+    }
+}
+
+void test_string_eq_compares_length_first(void) {
+    ac_string_t a, b;
+    ac_arr_from_string_literal(a, "user", 4, 0);
+    ac_arr_from_string_literal(b, "user1", 5, 0);
+
+    TEST_ASSERT_FALSE(ac_string_eq(&a, &b));
+    TEST_ASSERT_TRUE(ac_string_eq(&a, &a));
+}
+
+void test_sstr_short_strings_are_inline(void) {
+    ac_sstr_t s;
+    ac_sstr_new(&s);
+    ac_sstr_set(&s, "alice", 5);
+
+    TEST_ASSERT_EQUAL_INT(5, (int)ac_sstr_len(&s));
+    TEST_ASSERT_EQUAL_PTR(s.data.buf, ac_sstr_data(&s));
+    TEST_ASSERT_EQUAL_MEMORY("alice", ac_sstr_data(&s), 5);
+    ac_sstr_free(&s);
+}
+
+void test_sstr_long_strings_spill_to_heap(void) {
+    const char *text = "a string that is longer than the inline buffer";
+    ac_sstr_t s;
+    ac_sstr_new(&s);
+    ac_sstr_set(&s, text, strlen(text));
+
+    TEST_ASSERT_EQUAL_INT((int)strlen(text), (int)ac_sstr_len(&s));
+    TEST_ASSERT_EQUAL_MEMORY(text, ac_sstr_data(&s), strlen(text));
+
+    /* Reassigning a short value frees the heap copy. */
+    ac_sstr_set(&s, "bob", 3);
+    TEST_ASSERT_EQUAL_PTR(s.data.buf, ac_sstr_data(&s));
+    ac_sstr_free(&s);
+}
+
+void test_sstr_hash_matches_string_hash(void) {
+    ac_string_t a;
+    ac_arr_from_string_literal(a, "username", 8, 0);
+
+    ac_sstr_t s;
+    ac_sstr_new(&s);
+    ac_sstr_set(&s, "username", 8);
+
+    TEST_ASSERT_TRUE(ac_sstr_hash(&s) == ac_string_hash(&a));
+}
+
+void test_sstr_eq(void) {
+    ac_sstr_t a, b, c;
+    ac_sstr_new(&a);
+    ac_sstr_new(&b);
+    ac_sstr_new(&c);
+
+    /* b first holds a longer value, so stale bytes must not matter. */
+    ac_sstr_set(&b, "bob_the_builder", 15);
+    ac_sstr_set(&a, "bob", 3);
+    ac_sstr_set(&b, "bob", 3);
+    ac_sstr_set(&c, "bop", 3);
+
+    TEST_ASSERT_TRUE(ac_sstr_eq(&a, &b));
+    TEST_ASSERT_FALSE(ac_sstr_eq(&a, &c));
+}
+
+void test_sstr_as_map_key(void) {
+    ac_map(ac_sstr_t, int) map;
+    ac_map_new(map);
+
+    const char *names[] = {"alice", "bob", "carol", "dave"};
+    for (int i = 0; i < 4; i++) {
+        ac_sstr_t key;
+        ac_sstr_new(&key);
+        ac_sstr_set(&key, names[i], strlen(names[i]));
+        ac_map_set(map, ac_sstr_hash, ac_sstr_eq, key, i);
+    }
+
+    ac_sstr_t key;
+    ac_sstr_new(&key);
+    ac_sstr_set(&key, "carol", 5);
+
+    int *val;
+    ac_map_get(map, ac_sstr_hash, ac_sstr_eq, key, val);
+    TEST_ASSERT_EQUAL_INT(2, *val);
+
+    ac_map_free(map);
+}
+
+void test_find_eol_every_position(void) {
+    /* Long enough to cover the vector loops and the scalar tail. */
+    char buf[100];
+
+    for (size_t eol = 0; eol < sizeof(buf); eol++) {
+        memset(buf, 'a', sizeof(buf));
+        buf[eol] = (eol % 2) ? '\n' : '\r';
+        TEST_ASSERT_EQUAL_INT((int)eol, (int)ac_find_eol(buf, sizeof(buf)));
+    }
+
+    memset(buf, 'a', sizeof(buf));
+    TEST_ASSERT_EQUAL_INT(100, (int)ac_find_eol(buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_INT(0, (int)ac_find_eol(buf, 0));
+}
+
+void test_utf8_decode(void) {
+    uint32_t cp;
+
+    TEST_ASSERT_EQUAL_INT(1, (int)ac_utf8_decode("A", 1, &cp));
+    TEST_ASSERT_EQUAL_UINT32(0x41, cp);
+    TEST_ASSERT_EQUAL_INT(2, (int)ac_utf8_decode("\xc3\xa9", 2, &cp));
+    TEST_ASSERT_EQUAL_UINT32(0xe9, cp);
+    TEST_ASSERT_EQUAL_INT(3, (int)ac_utf8_decode("\xe2\x82\xac", 3, &cp));
+    TEST_ASSERT_EQUAL_UINT32(0x20ac, cp);
+    TEST_ASSERT_EQUAL_INT(4, (int)ac_utf8_decode("\xf0\x9f\x98\x80", 4, &cp));
+    TEST_ASSERT_EQUAL_UINT32(0x1f600, cp);
+
+    /* Overlong, surrogate, too large, stray continuation. */
+    const char *bad[] = {"\xc0\xaf", "\xe0\x80\xaf", "\xed\xa0\x80",
+                         "\xf4\x90\x80\x80", "\x80", "\xff"};
+    for (size_t i = 0; i < sizeof(bad) / sizeof(*bad); i++) {
+        ac_utf8_decode(bad[i], strlen(bad[i]), &cp);
+        TEST_ASSERT_EQUAL_UINT32(AC_UTF8_BAD, cp);
+    }
+
+    /* A truncated sequence is consumed as one maximal subpart. */
+    TEST_ASSERT_EQUAL_INT(2, (int)ac_utf8_decode("\xe2\x82" "A", 3, &cp));
+    TEST_ASSERT_EQUAL_UINT32(AC_UTF8_BAD, cp);
+}
+
+/** @brief Reference validator built on the scalar decoder. */
+static bool utf8_valid_scalar(const char *data, size_t len) {
+    for (size_t i = 0; i < len;) {
+        uint32_t cp;
+        i += ac_utf8_decode(data + i, len - i, &cp);
+        if (cp == AC_UTF8_BAD) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void test_utf8_valid_matches_decoder(void) {
+    /* Random strings built from valid and broken pieces, long enough to
+       put sequences across vector block boundaries. */
+    const char *pieces[] = {"a",  "hello, ",  "\xc3\xa9", "\xe2\x82\xac",
+                            "\xf0\x9f\x98\x80", "\xd0\x96", "\xc3",
+                            "\x80", "\xed\xa0\x80", "\xf4\x90\x80\x80",
+                            "\xe0\x80\xaf", "\xe2\x82"};
+    size_t npieces = sizeof(pieces) / sizeof(*pieces);
+    uint32_t rng   = 12345;
+    char buf[128];
+
+    for (int round = 0; round < 5000; round++) {
+        size_t len = 0;
+        /* Mostly well-formed strings, so both answers are exercised. */
+        size_t pool = round % 2 ? npieces : 6;
+
+        for (;;) {
+            rng = rng * 1103515245u + 12345u;
+            const char *piece = pieces[(rng >> 16) % pool];
+            size_t n          = strlen(piece);
+            if (len + n > sizeof(buf) || (rng >> 8) % 23 == 0) {
+                break;
+            }
+            memcpy(buf + len, piece, n);
+            len += n;
+        }
+
+        TEST_ASSERT_EQUAL(utf8_valid_scalar(buf, len),
+                          ac_utf8_valid(buf, len));
+    }
+}
+
+void test_utf8_sanitize_replace(void) {
+    char mixed[] = "he\x01llo\x7f w\torld\xc2\x85 caf\xc3\xa9\xff!";
+    size_t len =
+        ac_utf8_sanitize(mixed, sizeof(mixed) - 1, AC_UTF8_REPLACE);
+    TEST_ASSERT_EQUAL_INT(19, (int)len);
+    TEST_ASSERT_EQUAL_MEMORY("hello world caf\xc3\xa9?!", mixed, len);
+
+    /* Control bytes spread across several vector blocks. */
+    char buf[80];
+    char expected[80];
+    size_t n = 0;
+
+    for (size_t i = 0; i < sizeof(buf); i++) {
+        buf[i] = (i % 7 == 3) ? '\x1b' : (char)('a' + i % 26);
+        if (buf[i] != '\x1b') {
+            expected[n++] = buf[i];
+        }
+    }
+
+    len = ac_utf8_sanitize(buf, sizeof(buf), AC_UTF8_REPLACE);
+    TEST_ASSERT_EQUAL_INT((int)n, (int)len);
+    TEST_ASSERT_EQUAL_MEMORY(expected, buf, len);
+}
+
+void test_utf8_sanitize_reject(void) {
+    char text[] = "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82, "
+                  "\xe4\xb8\x96\xe7\x95\x8c\t";
+    size_t len  = ac_utf8_sanitize(text, sizeof(text) - 1, AC_UTF8_REJECT);
+    TEST_ASSERT_EQUAL_INT((int)sizeof(text) - 2, (int)len);
+
+    char broken[] = "valid until here \xe2\x82 and then not";
+    char copy[sizeof(broken)];
+    memcpy(copy, broken, sizeof(broken));
+
+    TEST_ASSERT_TRUE(ac_utf8_sanitize(broken, sizeof(broken) - 1,
+                                      AC_UTF8_REJECT) == AC_UTF8_INVALID);
+    TEST_ASSERT_EQUAL_MEMORY(copy, broken, sizeof(broken));
+}
+
+void test_utf8_name_char_letters(void) {
+    const uint32_t letters[] = {'a', 'Z', '7', '_', 0xe9, 0x0416, 0x05d0,
+                                0x0915, 0x0941, 0x4e16, 0xac00, 0x1100};
+    for (size_t i = 0; i < sizeof(letters) / sizeof(*letters); i++) {
+        TEST_ASSERT_TRUE(ac_utf8_name_char(letters[i]));
+    }
+
+    const uint32_t other[] = {' ', '-', 0x7f, 0xa0, 0xd7, 0x2014, 0xff21,
+                              0x1d400, 0x1f600, 0xe0041};
+    for (size_t i = 0; i < sizeof(other) / sizeof(*other); i++) {
+        TEST_ASSERT_FALSE(ac_utf8_name_char(other[i]));
+    }
+}
+
+void test_utf8_name_char_invisible(void) {
+    /* Blank fillers and format characters that render as nothing. */
+    const uint32_t invisible[] = {0x00ad, 0x034f, 0x0600, 0x061c, 0x115f,
+                                  0x1160, 0x17b4, 0x17b5, 0x180b, 0x180e,
+                                  0x180f, 0x200b, 0x2060, 0x2800, 0x3164,
+                                  0xfeff, 0xffa0, 0x1bca0, 0x1d173};
+    for (size_t i = 0; i < sizeof(invisible) / sizeof(*invisible); i++) {
+        TEST_ASSERT_FALSE(ac_utf8_name_char(invisible[i]));
+    }
+}
+
+void test_utf8_name_char_combining(void) {
+    /* Marks that stack on Latin, Greek or Cyrillic letters. */
+    const uint32_t marks[] = {0x0300, 0x036f, 0x0483, 0x0489, 0x1ab0,
+                              0x1aff, 0x1dc0, 0x1dff, 0x20d0, 0xfe20};
+    for (size_t i = 0; i < sizeof(marks) / sizeof(*marks); i++) {
+        TEST_ASSERT_FALSE(ac_utf8_name_char(marks[i]));
+    }
+
+    /* Letters right after the Cyrillic marks and the supplement. */
+    TEST_ASSERT_TRUE(ac_utf8_name_char(0x048a));
+    TEST_ASSERT_TRUE(ac_utf8_name_char(0x1e00));
+}
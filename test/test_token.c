@@ -0,0 +1,54 @@
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <unity.h>
+#include <ac/str.h>
+#include <ac/token.h>
+
+static ac_str_view_t view(const char *str) {
+    ac_str_view_t v = {str, strlen(str)};
+    return v;
+}
+
+void test_token_new_is_random_and_never_none(void) {
+    ac_token_t a, b;
+
+    TEST_ASSERT_TRUE(ac_token_new(&a));
+    TEST_ASSERT_TRUE(ac_token_new(&b));
+
+    TEST_ASSERT_FALSE(ac_token_none(a));
+    TEST_ASSERT_FALSE(ac_token_eq(&a, &b));
+    TEST_ASSERT_TRUE(ac_token_none(AC_TOKEN_NONE));
+}
+
+void test_token_round_trips_through_hex(void) {
+    ac_token_t token = {0x0123456789abcdefull, 0xfedcba9876543210ull};
+    char hex[AC_TOKEN_HEX + 1];
+
+    ac_token_format(token, hex);
+    hex[AC_TOKEN_HEX] = '\0';
+    TEST_ASSERT_EQUAL_STRING("0123456789abcdeffedcba9876543210", hex);
+
+    ac_token_t parsed;
+    TEST_ASSERT_TRUE(ac_token_parse(view(hex), &parsed));
+    TEST_ASSERT_TRUE(ac_token_eq(&token, &parsed));
+
+    TEST_ASSERT_TRUE(
+        ac_token_parse(view("0123456789ABCDEFFEDCBA9876543210"), &parsed));
+    TEST_ASSERT_TRUE(ac_token_eq(&token, &parsed));
+}
+
+void test_token_parse_rejects_malformed_text(void) {
+    ac_token_t token;
+
+    TEST_ASSERT_FALSE(ac_token_parse(view(""), &token));
+    TEST_ASSERT_FALSE(
+        ac_token_parse(view("0123456789abcdeffedcba987654321"), &token));
+    TEST_ASSERT_FALSE(
+        ac_token_parse(view("0123456789abcdeffedcba98765432100"), &token));
+    TEST_ASSERT_FALSE(
+        ac_token_parse(view("0123456789abcdeffedcba987654321g"), &token));
+    TEST_ASSERT_FALSE(
+        ac_token_parse(view("00000000000000000000000000000000"), &token));
+}
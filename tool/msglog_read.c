@@ -0,0 +1,154 @@
+/* Offline reader for the message log: prints every record of the given
+   segment files, or of every segment in the given log directories, one
+   message per line. A torn tail is reported rather than printed, so the
+   reader is safe to run against the log of a live or crashed server.
+   Damaged bytes with intact records after them are reported and skipped.
+
+       msglog_read msglog
+       msglog_read msglog/0000000000000003.log */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <ac/meta.h>
+#include <ac/msglog.h>
+
+static void print_msg(const ac_msg_t *msg) {
+    time_t secs = (time_t)(msg->time_ms / 1000);
+    struct tm tm;
+    char when[32];
+
+    localtime_r(&secs, &tm);
+    strftime(when, sizeof when, "%Y-%m-%d %H:%M:%S", &tm);
+
+    printf("%s.%03u [%.*s", when, (unsigned)(msg->time_ms % 1000),
+           ac_str_view_fmt_args(msg->from));
+
+    if (msg->kind == AC_MSG_WHISPER) {
+        printf(" -> %.*s", ac_str_view_fmt_args(msg->to));
+    }
+
+    printf("]: %.*s\n", ac_str_view_fmt_args(msg->text));
+}
+
+/** @return false if the segment could not be read, is damaged or torn. */
+static bool read_segment(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        perror(path);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        perror(path);
+        close(fd);
+        return false;
+    }
+
+    size_t len = (size_t)st.st_size;
+    if (len == 0) {
+        fprintf(stderr, "%s: empty segment\n", path);
+        close(fd);
+        return false;
+    }
+
+    unsigned char *data = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        perror(path);
+        return false;
+    }
+
+    bool ok = ac_msglog_segment_valid(data, len);
+
+    if (!ok) {
+        fprintf(stderr, "%s: not a message log segment\n", path);
+    } else {
+        size_t pos = AC_MSGLOG_SEGMENT_HEADER;
+        ac_msg_t msg;
+        ac_msglog_status_t status;
+
+        while ((status = ac_msglog_decode(data, len, &pos, &msg)) !=
+               AC_MSGLOG_END) {
+            if (status == AC_MSGLOG_OK) {
+                print_msg(&msg);
+                continue;
+            }
+
+            size_t next = ac_msglog_resync(data, len, pos + 1);
+            if (next == len) {
+                break;
+            }
+
+            fflush(stdout);
+            fprintf(stderr, "%s: skipped %zu damaged bytes at offset %zu\n",
+                    path, next - pos, pos);
+            pos = next;
+            ok  = false;
+        }
+
+        if (status == AC_MSGLOG_TORN) {
+            fflush(stdout);
+            fprintf(stderr, "%s: torn tail of %zu bytes at offset %zu\n",
+                    path, len - pos, pos);
+            ok = false;
+        }
+    }
+
+    munmap(data, len);
+    return ok;
+}
+
+static bool read_dir(const char *dir) {
+    ac_arr(uint64_t) segments;
+
+    if (!ac_msglog_segments(dir, &segments)) {
+        perror(dir);
+        return false;
+    }
+
+    bool ok = true;
+
+    ac_arr_foreach(segments, i) {
+        char path[4096];
+        ac_msglog_segment_path(path, sizeof path, dir, segments[i]);
+
+        ok = read_segment(path) && ok;
+    }
+
+    ac_arr_free(segments);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <log directory | segment>...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    bool ok = true;
+
+    for (int i = 1; i < argc; i++) {
+        struct stat st;
+
+        if (stat(argv[i], &st) == -1) {
+            perror(argv[i]);
+            ok = false;
+        } else if (S_ISDIR(st.st_mode)) {
+            ok = read_dir(argv[i]) && ok;
+        } else {
+            ok = read_segment(argv[i]) && ok;
+        }
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}